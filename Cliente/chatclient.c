@@ -0,0 +1,556 @@
+// ============================================================================
+// chatclient.c - Implementación de la biblioteca de cliente del chat
+// ============================================================================
+
+#include "chatclient.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "network.h"
+#include "protocol.h"
+#include "shm_channel.h"
+#include "../Servidor/reply.h"
+
+#define CHAT_CLIENT_RECV_SIZE 16384
+#define CHAT_CLIENT_MAX_PRESENCE 64  // Avisos por línea PRESENCE que se entregan
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+// Un comando enviado que espera su respuesta
+typedef struct {
+    ChatCommand command;
+    uint64_t sent_ns;
+    int error;
+} Pending;
+
+struct ChatClient {
+    int fd;                      // Socket TCP o socket UNIX del canal local
+    int local;
+    ShmChannel channel;
+    int nonblocking;
+    int closed;
+    int shutdown_requested;
+    int nick_sent;
+    
+    ChatClientCallbacks cb;
+    void *user;
+    
+    // Lote de salida y cola de respuestas esperadas: los comparten el
+    // thread que envía y el que recibe (que responde los PING)
+    pthread_mutex_t mutex;
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+    Pending *pending;
+    size_t pending_head;
+    size_t pending_count;
+    size_t pending_cap;
+    
+    // Lo usa solo el thread que recibe
+    char in[CHAT_CLIENT_LINE_SIZE];
+    size_t in_len;
+    char token[CHAT_CLIENT_TOKEN_SIZE];  // Sesión (vacío = sin sesión)
+    uint64_t last_seq;
+};
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int starts_with(const char *line, const char *prefix) {
+    return strncmp(line, prefix, strlen(prefix)) == 0;
+}
+
+// Texto después del prefijo, sin el espacio que lo separa
+static const char *after(const char *line, const char *prefix) {
+    const char *text = line + strlen(prefix);
+    while (*text == ' ') text++;
+    return text;
+}
+
+// Como after(), salteando el "#<seq> " de los mensajes de una sesión
+static const char *after_push(ChatClient *c, const char *line, const char *prefix) {
+    const char *text = after(line, prefix);
+    if (text[0] != RESP_SEQ_MARK || text[1] < '0' || text[1] > '9') return text;
+    
+    char *end;
+    uint64_t seq = strtoull(text + 1, &end, 10);
+    if (seq > c->last_seq) c->last_seq = seq;
+    while (*end == ' ') end++;
+    return end;
+}
+
+// Qué respuesta espera una línea enviada (-1 = ninguna)
+static int classify(ChatClient *c, const char *line, size_t len) {
+    char cmd[16];
+    size_t n = strcspn(line, " ");
+    if (n > len) n = len;
+    if (n >= sizeof(cmd)) n = sizeof(cmd) - 1;
+    memcpy(cmd, line, n);
+    cmd[n] = '\0';
+    
+    if (!c->nick_sent) return strcmp(cmd, CMD_RESUME) == 0 ? CHAT_CMD_RESUME : CHAT_CMD_NICK;
+    if (strcmp(cmd, CMD_PONG) == 0 || strcmp(cmd, CMD_QUIT) == 0) return -1;
+    if (strcmp(cmd, CMD_LIST) == 0) return CHAT_CMD_LIST;
+    if (strcmp(cmd, CMD_MSG) == 0) return CHAT_CMD_MSG;
+    if (strcmp(cmd, CMD_BROADCAST) == 0) return CHAT_CMD_BROADCAST;
+    if (strcmp(cmd, CMD_HISTORY) == 0) return CHAT_CMD_HISTORY;
+    if (strcmp(cmd, CMD_HELP) == 0) return CHAT_CMD_HELP;
+    if (strcmp(cmd, CMD_WATCH) == 0 || strcmp(cmd, CMD_UNWATCH) == 0) return CHAT_CMD_WATCH;
+    if (strcmp(cmd, CMD_SESSION) == 0) return CHAT_CMD_SESSION;
+    if (strcmp(cmd, CMD_SEARCH) == 0) return CHAT_CMD_SEARCH;
+    return CHAT_CMD_OTHER;
+}
+
+static int push_pending(ChatClient *c, ChatCommand command) {
+    if (c->pending_head > 0 && c->pending_head == c->pending_count) {
+        c->pending_head = c->pending_count = 0;
+    }
+    if (c->pending_count == c->pending_cap) {
+        size_t cap = c->pending_cap ? c->pending_cap * 2 : 16;
+        Pending *pending = realloc(c->pending, cap * sizeof(Pending));
+        if (!pending) return -1;
+        c->pending = pending;
+        c->pending_cap = cap;
+    }
+    
+    Pending *p = &c->pending[c->pending_count++];
+    p->command = command;
+    p->sent_ns = now_ns();
+    p->error = 0;
+    return 0;
+}
+
+// Una línea que es parte de la respuesta más vieja: retorna 1 si la completa
+static int resolve_pending(ChatClient *c, const char *line, ChatReply *reply) {
+    int done = 0;
+    
+    pthread_mutex_lock(&c->mutex);
+    if (c->pending_head < c->pending_count) {
+        Pending *p = &c->pending[c->pending_head];
+        int error = starts_with(line, RESP_ERROR) ||
+                    strncmp(line, REPLY_SERVER_FULL, REPLY_LEN(REPLY_SERVER_FULL) - 1) == 0;
+        p->error |= error;
+        
+        switch (p->command) {
+            case CHAT_CMD_LIST:
+                done = starts_with(line, RESP_LIST_END) || error;
+                break;
+            case CHAT_CMD_HISTORY:
+                done = starts_with(line, RESP_HISTORY_END) || error;
+                break;
+            case CHAT_CMD_SEARCH:
+                done = starts_with(line, RESP_SEARCH_END) || error;
+                break;
+            case CHAT_CMD_HELP:
+                done = starts_with(line, RESP_HELP_END) || error;
+                break;
+            default:
+                done = 1;
+                break;
+        }
+        
+        if (done) {
+            // Retomada: lo que siga ya son comandos (si falló, va el nick)
+            if (p->command == CHAT_CMD_RESUME && !p->error) c->nick_sent = 1;
+            reply->command = p->command;
+            reply->error = p->error;
+            reply->latency_ns = now_ns() - p->sent_ns;
+            c->pending_head++;
+        }
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return done;
+}
+
+// "nick: texto" -> from y text (from apunta a una copia local)
+static void split_sender(const char *content, char *from, size_t size, const char **text) {
+    const char *colon = strstr(content, ": ");
+    size_t len = colon ? (size_t)(colon - content) : 0;
+    if (len >= size) len = size - 1;
+    memcpy(from, content, len);
+    from[len] = '\0';
+    *text = colon ? colon + 2 : content;
+}
+
+static void deliver_presence(ChatClient *c, const char *content) {
+    char events[CHAT_CLIENT_LINE_SIZE];
+    ChatPresence list[CHAT_CLIENT_MAX_PRESENCE];
+    int count = 0;
+    char *saveptr;
+    
+    snprintf(events, sizeof(events), "%s", content);
+    for (char *token = strtok_r(events, " ", &saveptr); token && count < CHAT_CLIENT_MAX_PRESENCE;
+         token = strtok_r(NULL, " ", &saveptr)) {
+        if (token[0] != '+' && token[0] != '-') continue;
+        list[count].nick = token + 1;
+        list[count].joined = token[0] == '+';
+        count++;
+    }
+    if (count > 0) c->cb.on_presence(c, list, count, c->user);
+}
+
+// "<id> <nick|token> <bytes> [nombre]" o, en FILE_END, "<id> <estado> <bytes>"
+static void deliver_file(ChatClient *c, ChatFileEvent event, const char *content) {
+    char field[CHAT_CLIENT_TOKEN_SIZE];
+    unsigned long long size;
+    int consumed = 0;
+    ChatFile file;
+    
+    if (sscanf(content, "%u %63s %llu %n", &file.id, field, &size, &consumed) < 3) return;
+    file.size = size;
+    file.nick = event == CHAT_FILE_OFFER ? field : "";
+    file.token = event == CHAT_FILE_SEND || event == CHAT_FILE_RECV ? field : "";
+    file.status = event == CHAT_FILE_END ? field : "";
+    file.name = event != CHAT_FILE_END && consumed > 0 ? content + consumed : "";
+    c->cb.on_file(c, event, &file, c->user);
+}
+
+// Entrega una línea completa recibida del servidor
+static void dispatch_line(ChatClient *c, const char *line) {
+    char from[MAX_NICK_LENGTH * 2];
+    const char *text;
+    
+    // Sondeo de vida: se responde sin molestar a quien usa la biblioteca
+    if (strcmp(line, RESP_PING) == 0) {
+        chat_client_send(c, CMD_PONG);
+        return;
+    }
+    
+    // Lo que llega sin pedirlo no cierra ninguna respuesta
+    if (starts_with(line, RESP_MSG_FROM)) {
+        split_sender(after_push(c, line, RESP_MSG_FROM), from, sizeof(from), &text);
+        if (c->cb.on_private) c->cb.on_private(c, from, text, c->user);
+        return;
+    }
+    if (starts_with(line, RESP_BROADCAST)) {
+        split_sender(after_push(c, line, RESP_BROADCAST), from, sizeof(from), &text);
+        if (c->cb.on_broadcast) c->cb.on_broadcast(c, from, text, c->user);
+        return;
+    }
+    if (starts_with(line, RESP_PRESENCE)) {
+        const char *events = after_push(c, line, RESP_PRESENCE);
+        if (c->cb.on_presence) deliver_presence(c, events);
+        return;
+    }
+    if (starts_with(line, RESP_FILE_OFFER)) {
+        const char *content = after_push(c, line, RESP_FILE_OFFER);
+        if (c->cb.on_file) deliver_file(c, CHAT_FILE_OFFER, content);
+        return;
+    }
+    if (starts_with(line, RESP_FILE_SEND)) {
+        const char *content = after_push(c, line, RESP_FILE_SEND);
+        if (c->cb.on_file) deliver_file(c, CHAT_FILE_SEND, content);
+        return;
+    }
+    if (starts_with(line, RESP_FILE_END)) {
+        const char *content = after_push(c, line, RESP_FILE_END);
+        if (c->cb.on_file) deliver_file(c, CHAT_FILE_END, content);
+        return;
+    }
+    
+    // Parte de una respuesta (o un aviso suelto, como el cierre por inactividad)
+    if (starts_with(line, RESP_LIST_START)) {
+        if (c->cb.on_list) c->cb.on_list(c, CHAT_BLOCK_BEGIN, "", c->user);
+    } else if (starts_with(line, RESP_LIST_ITEM)) {
+        if (c->cb.on_list) c->cb.on_list(c, CHAT_BLOCK_ITEM, after(line, RESP_LIST_ITEM), c->user);
+    } else if (starts_with(line, RESP_LIST_END)) {
+        if (c->cb.on_list) c->cb.on_list(c, CHAT_BLOCK_END, "", c->user);
+    } else if (starts_with(line, RESP_HISTORY_START)) {
+        if (c->cb.on_history) c->cb.on_history(c, CHAT_BLOCK_BEGIN, after(line, RESP_HISTORY_START), c->user);
+    } else if (starts_with(line, RESP_HISTORY_END)) {
+        if (c->cb.on_history) c->cb.on_history(c, CHAT_BLOCK_END, "", c->user);
+    } else if (starts_with(line, RESP_HISTORY)) {
+        if (c->cb.on_history) c->cb.on_history(c, CHAT_BLOCK_ITEM, after(line, RESP_HISTORY), c->user);
+    } else if (starts_with(line, RESP_SEARCH_START)) {
+        if (c->cb.on_search) c->cb.on_search(c, CHAT_BLOCK_BEGIN, after(line, RESP_SEARCH_START), c->user);
+    } else if (starts_with(line, RESP_SEARCH_END)) {
+        if (c->cb.on_search) c->cb.on_search(c, CHAT_BLOCK_END, "", c->user);
+    } else if (starts_with(line, RESP_SEARCH)) {
+        if (c->cb.on_search) c->cb.on_search(c, CHAT_BLOCK_ITEM, after(line, RESP_SEARCH), c->user);
+    } else if (starts_with(line, RESP_SESSION)) {
+        snprintf(c->token, sizeof(c->token), "%s", after(line, RESP_SESSION));
+        if (c->cb.on_session) c->cb.on_session(c, c->token, c->user);
+    } else if (starts_with(line, RESP_FILE_RECV)) {
+        if (c->cb.on_file) deliver_file(c, CHAT_FILE_RECV, after(line, RESP_FILE_RECV));
+    } else if (starts_with(line, RESP_HELP_END)) {
+        // Solo cierra la respuesta a /help
+    } else if (starts_with(line, RESP_INFO)) {
+        if (c->cb.on_info) c->cb.on_info(c, after(line, RESP_INFO), c->user);
+    } else if (starts_with(line, RESP_ERROR)) {
+        if (c->cb.on_error) c->cb.on_error(c, after(line, RESP_ERROR), c->user);
+    } else if (c->cb.on_line) {
+        c->cb.on_line(c, line, c->user);
+    }
+    
+    ChatReply reply;
+    if (resolve_pending(c, line, &reply) && c->cb.on_reply) {
+        c->cb.on_reply(c, &reply, c->user);
+    }
+}
+
+// Arma líneas con lo recibido; lo que quede sin '\n' espera al próximo bloque
+static void feed(ChatClient *c, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != '\n') {
+            if (c->in_len < sizeof(c->in) - 1) c->in[c->in_len++] = data[i];
+            continue;
+        }
+        c->in[c->in_len] = '\0';
+        if (c->in_len > 0 && c->in[c->in_len - 1] == '\r') c->in[--c->in_len] = '\0';
+        if (c->in_len > 0) dispatch_line(c, c->in);
+        c->in_len = 0;
+    }
+}
+
+static ChatClient *chat_client_new(const ChatClientCallbacks *callbacks, void *user) {
+    ChatClient *c = calloc(1, sizeof(ChatClient));
+    if (!c) return NULL;
+    
+    c->fd = -1;
+    if (callbacks) c->cb = *callbacks;
+    c->user = user;
+    pthread_mutex_init(&c->mutex, NULL);
+    return c;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+ChatClient *chat_client_connect(const char *host, int port, const ChatClientCallbacks *callbacks, void *user) {
+    ChatClient *c = chat_client_new(callbacks, user);
+    if (!c) return NULL;
+    
+    c->fd = ConnectToServer((char *)host, port);
+    if (c->fd <= 0) {
+        pthread_mutex_destroy(&c->mutex);
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+ChatClient *chat_client_connect_local(const char *path, const ChatClientCallbacks *callbacks, void *user) {
+    ChatClient *c = chat_client_new(callbacks, user);
+    if (!c) return NULL;
+    
+    if (shm_channel_connect(&c->channel, path) < 0) {
+        pthread_mutex_destroy(&c->mutex);
+        free(c);
+        return NULL;
+    }
+    c->fd = c->channel.peer_fd;
+    c->local = 1;
+    return c;
+}
+
+void chat_client_close(ChatClient *c) {
+    if (!c) return;
+    
+    if (c->local) shm_channel_destroy(&c->channel);
+    DisconnectFromServer(c->fd);
+    pthread_mutex_destroy(&c->mutex);
+    free(c->out);
+    free(c->pending);
+    free(c);
+}
+
+int chat_client_fd(const ChatClient *c) {
+    return c->local ? c->channel.rx_data_efd : c->fd;
+}
+
+void chat_client_set_nonblocking(ChatClient *c) {
+    if (c->local) return;
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+    c->nonblocking = 1;
+}
+
+int chat_client_queue(ChatClient *c, const char *line, size_t len) {
+    pthread_mutex_lock(&c->mutex);
+    if (c->closed || c->shutdown_requested) {
+        pthread_mutex_unlock(&c->mutex);
+        return -1;
+    }
+    
+    if (c->out_len + len + 1 > c->out_cap) {
+        size_t cap = (c->out_len + len + 1) * 2;
+        char *out = realloc(c->out, cap);
+        if (!out) {
+            pthread_mutex_unlock(&c->mutex);
+            return -1;
+        }
+        c->out = out;
+        c->out_cap = cap;
+    }
+    
+    int command = classify(c, line, len);
+    if (command >= 0 && push_pending(c, (ChatCommand)command) < 0) {
+        pthread_mutex_unlock(&c->mutex);
+        return -1;
+    }
+    if (command != CHAT_CMD_RESUME) c->nick_sent = 1;
+    
+    memcpy(c->out + c->out_len, line, len);
+    c->out[c->out_len + len] = '\n';
+    c->out_len += len + 1;
+    size_t queued = c->out_len;
+    pthread_mutex_unlock(&c->mutex);
+    
+    // Lotes muy grandes: vaciar sin esperar al flush del usuario
+    if (queued >= CHAT_CLIENT_FLUSH_BYTES && chat_client_flush(c) < 0) return -1;
+    return 0;
+}
+
+ssize_t chat_client_flush(ChatClient *c) {
+    pthread_mutex_lock(&c->mutex);
+    if (c->closed) {
+        pthread_mutex_unlock(&c->mutex);
+        return -1;
+    }
+    
+    size_t done = 0;
+    if (c->local) {
+        if (c->out_len > 0 && shm_channel_write(&c->channel, c->out, c->out_len, -1) < 0) c->closed = 1;
+        else done = c->out_len;
+    } else {
+        while (done < c->out_len) {
+            ssize_t n = send(c->fd, c->out + done, c->out_len - done, MSG_NOSIGNAL);
+            if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                if (errno == EAGAIN) break;
+                continue;
+            }
+            if (n <= 0) {
+                c->closed = 1;
+                break;
+            }
+            done += (size_t)n;
+        }
+    }
+    
+    memmove(c->out, c->out + done, c->out_len - done);
+    c->out_len -= done;
+    if (!c->closed && c->out_len == 0 && c->shutdown_requested && !c->local) shutdown(c->fd, SHUT_WR);
+    
+    ssize_t left = c->closed ? -1 : (ssize_t)c->out_len;
+    pthread_mutex_unlock(&c->mutex);
+    return left;
+}
+
+int chat_client_send(ChatClient *c, const char *line) {
+    if (chat_client_queue(c, line, strlen(line)) < 0) return -1;
+    return chat_client_flush(c) < 0 ? -1 : 0;
+}
+
+void chat_client_shutdown(ChatClient *c) {
+    pthread_mutex_lock(&c->mutex);
+    c->shutdown_requested = 1;
+    pthread_mutex_unlock(&c->mutex);
+    chat_client_flush(c);
+}
+
+int chat_client_process(ChatClient *c) {
+    char buffer[CHAT_CLIENT_RECV_SIZE];
+    
+    if (c->local) {
+        shm_channel_ack(&c->channel);
+        for (;;) {
+            ssize_t n = shm_channel_read(&c->channel, buffer, sizeof(buffer));
+            if (n < 0) return -1;
+            if (n == 0) return 0;  // Vacío: queda armado el aviso por el eventfd
+            feed(c, buffer, (size_t)n);
+        }
+    }
+    
+    // Bloqueante: un recv por llamada. No bloqueante: hasta vaciar el socket.
+    do {
+        ssize_t n = recv(c->fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+        if (n <= 0) {
+            pthread_mutex_lock(&c->mutex);
+            c->closed = 1;
+            pthread_mutex_unlock(&c->mutex);
+            return -1;
+        }
+        feed(c, buffer, (size_t)n);
+    } while (c->nonblocking);
+    
+    return 0;
+}
+
+void chat_client_run(ChatClient *c) {
+    while (chat_client_process(c) == 0) {
+        // Anillo vacío: dormir en el eventfd hasta que el servidor escriba
+        if (c->local && shm_channel_wait(&c->channel, -1) < 0) break;
+    }
+}
+
+int chat_client_resume(ChatClient *c, const char *token, uint64_t last_seq) {
+    char line[CHAT_CLIENT_TOKEN_SIZE + 64];
+    
+    snprintf(c->token, sizeof(c->token), "%s", token);
+    c->last_seq = last_seq;
+    snprintf(line, sizeof(line), CMD_RESUME " %s %llu", c->token, (unsigned long long)last_seq);
+    return chat_client_send(c, line);
+}
+
+const char *chat_client_session_token(const ChatClient *c) {
+    return c->token[0] ? c->token : NULL;
+}
+
+uint64_t chat_client_last_seq(const ChatClient *c) {
+    return c->last_seq;
+}
+
+size_t chat_client_pending_replies(const ChatClient *c) {
+    return c->pending_count - c->pending_head;
+}
+
+int chat_client_transfer_open(const char *host, int port, const char *token, uint64_t *size) {
+    char line[CHAT_CLIENT_TOKEN_SIZE + 16];
+    
+    int fd = ConnectToServer((char *)host, port);
+    if (fd <= 0) return -1;
+    
+    int len = snprintf(line, sizeof(line), CMD_XFER " %s\n", token);
+    if (send(fd, line, (size_t)len, MSG_NOSIGNAL) != len) {
+        close(fd);
+        return -1;
+    }
+    
+    // De a un byte: lo que sigue al '\n' ya son datos del archivo
+    size_t used = 0;
+    for (;;) {
+        ssize_t n = recv(fd, line + used, 1, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        if (line[used] == '\n') break;
+        if (used < sizeof(line) - 1) used++;
+    }
+    line[used] = '\0';
+    
+    // Si no, un ERROR (token vencido o ya usado)
+    if (!starts_with(line, RESP_FILE_START)) {
+        close(fd);
+        return -1;
+    }
+    if (size) *size = strtoull(after(line, RESP_FILE_START), NULL, 10);
+    return fd;
+}
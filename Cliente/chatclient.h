@@ -0,0 +1,215 @@
+// ============================================================================
+// chatclient.h - Biblioteca de cliente del chat (libchatclient.a)
+// ============================================================================
+// Habla el protocolo de protocol.h para que el cliente interactivo, el
+// replay y cualquier bot no lo reimplementen:
+//   - Envío por lotes: chat_client_queue() junta comandos y
+//     chat_client_flush() los manda con un solo send().
+//   - Demultiplexado: separa lo que llega sin pedirlo (privados, broadcasts,
+//     avisos de /watch, PING) de las respuestas a los comandos, que el
+//     servidor devuelve en orden. Al completarse una respuesta llama a
+//     on_reply con el comando y la latencia.
+//   - PING se responde solo.
+//   - Sesiones: tras /session guarda el token y el último número de
+//     secuencia recibido; chat_client_resume() los usa en una conexión
+//     nueva para recibir solo lo que se perdió.
+//   - Archivos: entrega las ofertas y avisos de /send por on_file y
+//     chat_client_transfer_open() abre la conexión de datos (solo TCP).
+//
+// Dos formas de usarla:
+//   - Con un thread: chat_client_run() bloquea entregando eventos y otro
+//     thread envía (el envío está protegido por un mutex).
+//   - Con un loop propio: chat_client_set_nonblocking(), registrar
+//     chat_client_fd() en epoll/poll y llamar a chat_client_process() cuando
+//     haya datos y a chat_client_flush() cuando el socket acepte más.
+// ============================================================================
+
+#ifndef CHATCLIENT_H
+#define CHATCLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "protocol.h"
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define CHAT_CLIENT_LINE_SIZE (MAX_MSG_LENGTH + 256)  // Línea recibida más larga (se corta)
+#define CHAT_CLIENT_FLUSH_BYTES (64 * 1024)           // queue() vacía el lote al pasar este tamaño
+#define CHAT_CLIENT_TOKEN_SIZE 64                     // Token de sesión más largo que se guarda
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct ChatClient ChatClient;
+
+// Comando al que corresponde una respuesta
+typedef enum {
+    CHAT_CMD_NICK,       // Primera línea de la conexión
+    CHAT_CMD_LIST,
+    CHAT_CMD_MSG,
+    CHAT_CMD_BROADCAST,
+    CHAT_CMD_HISTORY,
+    CHAT_CMD_HELP,
+    CHAT_CMD_WATCH,      // /watch y /unwatch
+    CHAT_CMD_SESSION,
+    CHAT_CMD_RESUME,     // Primera línea en lugar del nick (chat_client_resume)
+    CHAT_CMD_SEARCH,
+    CHAT_CMD_OTHER       // Cualquier otra línea (una respuesta de una línea)
+} ChatCommand;
+
+// Eventos de las respuestas en bloque (/list, /history y /search)
+typedef enum {
+    CHAT_BLOCK_BEGIN,    // text: vacío en /list, la cantidad en /history, "<mostrados> <encontrados>" en /search
+    CHAT_BLOCK_ITEM,     // text: un cliente o un mensaje
+    CHAT_BLOCK_END
+} ChatBlockEvent;
+
+typedef struct {
+    ChatCommand command;
+    int error;           // La respuesta fue un ERROR (o "Servidor lleno")
+    uint64_t latency_ns; // Desde que se encoló el comando
+} ChatReply;
+
+typedef struct {
+    const char *nick;    // "nick" o "nick@nodo"
+    int joined;          // 1 = entró, 0 = salió
+} ChatPresence;
+
+// Avisos de una transferencia de archivo (ver transfer.h del servidor)
+typedef enum {
+    CHAT_FILE_OFFER,     // Te ofrecen un archivo: /accept <id> o /reject <id>
+    CHAT_FILE_SEND,      // Aceptaron tu oferta: abrir la conexión de datos y enviar
+    CHAT_FILE_RECV,      // Respuesta a /accept: abrir la conexión de datos y recibir
+    CHAT_FILE_END        // Terminó (bien o mal)
+} ChatFileEvent;
+
+typedef struct {
+    unsigned id;
+    const char *nick;    // Quien la ofrece (solo en CHAT_FILE_OFFER, si no "")
+    uint64_t size;       // En CHAT_FILE_END, los bytes que se movieron
+    const char *name;    // Nombre sugerido ("" si no hay o en CHAT_FILE_END)
+    const char *token;   // Para chat_client_transfer_open() (SEND y RECV, si no "")
+    const char *status;  // En CHAT_FILE_END: completa, cortada, rechazada o vencida
+} ChatFile;
+
+// Todos opcionales (NULL = ignorar). text no incluye el '\n'.
+typedef struct {
+    void (*on_private)(ChatClient *c, const char *from, const char *text, void *user);
+    void (*on_broadcast)(ChatClient *c, const char *from, const char *text, void *user);
+    void (*on_list)(ChatClient *c, ChatBlockEvent event, const char *text, void *user);
+    void (*on_history)(ChatClient *c, ChatBlockEvent event, const char *text, void *user);
+    void (*on_search)(ChatClient *c, ChatBlockEvent event, const char *text, void *user);
+    void (*on_presence)(ChatClient *c, const ChatPresence *events, int count, void *user);
+    void (*on_info)(ChatClient *c, const char *text, void *user);
+    void (*on_error)(ChatClient *c, const char *text, void *user);
+    void (*on_line)(ChatClient *c, const char *line, void *user);  // Sin prefijo conocido
+    void (*on_reply)(ChatClient *c, const ChatReply *reply, void *user);
+    void (*on_session)(ChatClient *c, const char *token, void *user);  // Respuesta a /session
+    void (*on_file)(ChatClient *c, ChatFileEvent event, const ChatFile *file, void *user);
+} ChatClientCallbacks;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Se conecta por TCP (ConnectToServer). La primera línea que se envíe es el nick.
+ * @return El cliente o NULL en caso de error
+ */
+ChatClient *chat_client_connect(const char *host, int port, const ChatClientCallbacks *callbacks, void *user);
+
+/**
+ * Se conecta al --local-socket del servidor (memoria compartida)
+ * @return El cliente o NULL en caso de error
+ */
+ChatClient *chat_client_connect_local(const char *path, const ChatClientCallbacks *callbacks, void *user);
+
+/**
+ * Cierra la conexión y libera el cliente
+ */
+void chat_client_close(ChatClient *c);
+
+/**
+ * Socket para registrar en epoll/poll (en modo local, el eventfd de datos)
+ */
+int chat_client_fd(const ChatClient *c);
+
+/**
+ * Pone el socket en modo no bloqueante (solo TCP; para loops propios)
+ */
+void chat_client_set_nonblocking(ChatClient *c);
+
+/**
+ * Agrega una línea (sin '\n') al lote de salida sin enviarla
+ * @return 0 si tiene éxito, -1 si no hay memoria o la conexión se cerró
+ */
+int chat_client_queue(ChatClient *c, const char *line, size_t len);
+
+/**
+ * Envía el lote acumulado
+ * @return Bytes que quedaron sin enviar (socket lleno en modo no bloqueante),
+ *         -1 si la conexión se cerró
+ */
+ssize_t chat_client_flush(ChatClient *c);
+
+/**
+ * chat_client_queue() + chat_client_flush() de una línea terminada en '\0'
+ * @return 0 si tiene éxito, -1 si la conexión se cerró
+ */
+int chat_client_send(ChatClient *c, const char *line);
+
+/**
+ * Cierra la escritura al terminar de enviar el lote (las respuestas
+ * pendientes siguen llegando)
+ */
+void chat_client_shutdown(ChatClient *c);
+
+/**
+ * Lee lo disponible y entrega los eventos
+ * @return 0 si la conexión sigue, -1 si se cerró
+ */
+int chat_client_process(ChatClient *c);
+
+/**
+ * Entrega eventos hasta que la conexión se cierre (modo con thread)
+ */
+void chat_client_run(ChatClient *c);
+
+/**
+ * Primera línea de una conexión nueva en lugar del nick: retoma la sesión
+ * y pide lo recibido después de last_seq (la respuesta es un INFO seguido
+ * de los mensajes perdidos; si es un ERROR, se puede enviar el nick)
+ * @return 0 si tiene éxito, -1 si la conexión se cerró
+ */
+int chat_client_resume(ChatClient *c, const char *token, uint64_t last_seq);
+
+/**
+ * Token de la sesión (NULL si no se pidió /session ni se retomó una)
+ */
+const char *chat_client_session_token(const ChatClient *c);
+
+/**
+ * Último número de secuencia recibido en la sesión
+ */
+uint64_t chat_client_last_seq(const ChatClient *c);
+
+/**
+ * Comandos enviados que todavía esperan respuesta
+ */
+size_t chat_client_pending_replies(const ChatClient *c);
+
+/**
+ * Abre la conexión de datos de una transferencia con el token de
+ * CHAT_FILE_SEND o CHAT_FILE_RECV y espera a que el otro lado se conecte.
+ * Bloquea hasta el FILE_START; después el emisor escribe los bytes y el
+ * receptor los lee hasta el EOF.
+ * @param size Tamaño anunciado por el servidor (puede ser NULL)
+ * @return El socket (cerrarlo con close) o -1 en caso de error
+ */
+int chat_client_transfer_open(const char *host, int port, const char *token, uint64_t *size);
+
+#endif // CHATCLIENT_H
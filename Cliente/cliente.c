@@ -1,8 +1,9 @@
 // ============================================================================
 // cliente.c - Cliente de chat simple usando sockets
 // ============================================================================
-// Compilar: gcc cliente.c ../util/network.c -o cliente -I../util -pthread
+// Compilar: make cliente (enlaza Cliente/libchatclient.a)
 // Ejecutar: ./cliente 127.0.0.1 5000
+//           ./cliente --local /tmp/chat.sock   (mismo host, memoria compartida)
 // ============================================================================
 
 #include <stdio.h>
@@ -10,14 +11,54 @@
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
-#include "network.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "chatclient.h"
 #include "protocol.h"
 
-#define BUF_SIZE 1024
+#define BUF_SIZE (MAX_MSG_LENGTH + 128)  // Línea escrita más larga (comando y texto)
+#define RESUME_ATTEMPTS 10  // Reintentos (uno por segundo) para retomar la sesión
+#define MAX_OFFERS 8        // Archivos ofrecidos esperando que los acepten
+#define FILE_NAME_SIZE 128  // Como TRANSFER_NAME_SIZE del servidor
 
 // Variable global para controlar el estado de ejecución
 volatile int running = 1;
 
+// Conexión actual: el thread receptor la cambia al retomar la sesión
+static ChatClient* client = NULL;
+static pthread_mutex_t client_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int session_active = 0;
+
+// Datos para reconectar
+static int use_local = 0;
+static const char* server_addr = NULL;  // IP o ruta del socket local
+static int server_port = 0;
+static char nick[32];
+
+// Archivos ofrecidos con /send: al llegar FILE_SEND se busca la ruta
+typedef struct {
+    int used;
+    char name[FILE_NAME_SIZE];
+    char path[PATH_MAX];
+    uint64_t size;
+} Offer;
+
+static Offer offers[MAX_OFFERS];
+static pthread_mutex_t offers_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Lo que necesita el thread de una conexión de datos
+typedef struct {
+    int sending;
+    unsigned id;
+    char token[CHAT_CLIENT_TOKEN_SIZE];
+    char path[PATH_MAX];
+} FileJob;
+
+
 // Códigos ANSI para colores en el cliente
 #define COLOR_RESET "\033[0m"
 #define COLOR_GREEN "\033[32m"
@@ -32,70 +73,355 @@ volatile int running = 1;
 // Funciones auxiliares
 // ============================================================================
 
-/**
- * Procesa y muestra las respuestas del servidor
- * Retorna 1 si debe continuar, 0 si debe salir
- */
-int process_server_response(const char* buffer) {
-    // Verificar si es inicio de lista
-    if (strncmp(buffer, RESP_LIST_START, strlen(RESP_LIST_START)) == 0) {
+// Borrar la línea del prompt para que el mensaje se vea limpio
+static void begin_output(void) {
+    printf("\r\033[K");
+}
+
+// Restaurar el prompt
+static void end_output(void) {
+    printf(COLOR_CYAN BOLD "Tú: " COLOR_RESET);
+    fflush(stdout);
+}
+
+// ============================================================================
+// Archivos (/send): cada transferencia abre su propia conexión de datos
+// ============================================================================
+
+// Envía el archivo entero por la conexión de datos (sendfile, sin copiarlo)
+static int send_file(int sockfd, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    
+    struct stat st;
+    off_t offset = 0;
+    int result = fstat(fd, &st);
+    while (result == 0 && offset < st.st_size) {
+        ssize_t n = sendfile(sockfd, fd, &offset, (size_t)(st.st_size - offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) result = -1;
+    }
+    close(fd);
+    return result;
+}
+
+// Guarda lo que llegue hasta que el servidor cierre la conexión de datos
+static int receive_file(int sockfd, const char* path) {
+    char buffer[65536];
+    
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    
+    int result = 0;
+    for (;;) {
+        ssize_t n = recv(sockfd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        if (write(fd, buffer, (size_t)n) != n) {
+            result = -1;
+            break;
+        }
+    }
+    close(fd);
+    return result;
+}
+
+// El resultado llega después por el chat (FILE_END); acá solo los errores locales
+static void* file_thread(void* arg) {
+    FileJob* job = arg;
+    
+    int sockfd = chat_client_transfer_open(server_addr, server_port, job->token, NULL);
+    int result = sockfd < 0 ? -1 : job->sending ? send_file(sockfd, job->path)
+                                                : receive_file(sockfd, job->path);
+    if (sockfd >= 0) close(sockfd);
+    
+    if (result < 0) {
+        begin_output();
+        printf(COLOR_RED "✗ Transferencia #%u: no se pudo %s %s\n" COLOR_RESET, job->id,
+               job->sending ? "enviar" : "guardar", job->path);
+        end_output();
+    }
+    free(job);
+    return NULL;
+}
+
+static void start_file_thread(int sending, const ChatFile* file, const char* path) {
+    FileJob* job = calloc(1, sizeof(FileJob));
+    if (!job) return;
+    job->sending = sending;
+    job->id = file->id;
+    snprintf(job->token, sizeof(job->token), "%s", file->token);
+    snprintf(job->path, sizeof(job->path), "%s", path);
+    
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, file_thread, job) != 0) {
+        free(job);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+// Busca (y olvida) la ruta de un archivo ofrecido
+static int take_offer(const char* name, uint64_t size, char* path, size_t path_size) {
+    int found = 0;
+    pthread_mutex_lock(&offers_mutex);
+    for (int i = 0; i < MAX_OFFERS && !found; i++) {
+        if (offers[i].used && offers[i].size == size && strcmp(offers[i].name, name) == 0) {
+            snprintf(path, path_size, "%s", offers[i].path);
+            offers[i].used = 0;
+            found = 1;
+        }
+    }
+    pthread_mutex_unlock(&offers_mutex);
+    return found;
+}
+
+// Nombre local para lo recibido: sin directorios ni archivos ocultos
+static void received_path(const char* name, char* path, size_t size) {
+    snprintf(path, size, "recibido-%s", name[0] ? name : "archivo");
+    for (char* p = path; *p; p++) {
+        if (*p == '/') *p = '_';
+    }
+}
+
+// ============================================================================
+// Eventos de la conexión (los entrega libchatclient desde el thread receptor)
+// ============================================================================
+
+static void on_list(ChatClient* c, ChatBlockEvent event, const char* text, void* user) {
+    (void)c; (void)user;
+    begin_output();
+    if (event == CHAT_BLOCK_BEGIN) {
         printf(COLOR_CYAN BOLD "\n╔═══════════════════════════════════════════╗\n" COLOR_RESET);
         printf(COLOR_CYAN BOLD "║     CLIENTES CONECTADOS AL SERVIDOR      ║\n" COLOR_RESET);
         printf(COLOR_CYAN BOLD "╠═══════════════════════════════════════════╣\n" COLOR_RESET);
-        return 1;
+    } else if (event == CHAT_BLOCK_ITEM) {
+        printf(COLOR_WHITE "║ • %s\n" COLOR_RESET, text);
+    } else {
+        printf(COLOR_CYAN BOLD "╚═══════════════════════════════════════════╝\n" COLOR_RESET);
     }
-    
-    // Verificar si es fin de lista
-    if (strncmp(buffer, RESP_LIST_END, strlen(RESP_LIST_END)) == 0) {
+    end_output();
+}
+
+static void on_history(ChatClient* c, ChatBlockEvent event, const char* text, void* user) {
+    (void)c; (void)user;
+    begin_output();
+    if (event == CHAT_BLOCK_BEGIN) {
+        printf(COLOR_CYAN BOLD "\n╔═══════════════════════════════════════════╗\n" COLOR_RESET);
+        printf(COLOR_CYAN BOLD "║   HISTORIAL (%5s mensajes)               ║\n" COLOR_RESET, text);
+        printf(COLOR_CYAN BOLD "╠═══════════════════════════════════════════╣\n" COLOR_RESET);
+    } else if (event == CHAT_BLOCK_ITEM) {
+        printf(COLOR_WHITE "║ %s\n" COLOR_RESET, text);
+    } else {
         printf(COLOR_CYAN BOLD "╚═══════════════════════════════════════════╝\n" COLOR_RESET);
-        return 1;
     }
-    
-    // Verificar si es un item de la lista
-    if (strncmp(buffer, RESP_LIST_ITEM, strlen(RESP_LIST_ITEM)) == 0) {
-        const char* content = buffer + strlen(RESP_LIST_ITEM);
-        printf(COLOR_WHITE "║ • %s" COLOR_RESET, content);
-        if (content[strlen(content)-1] != '\n') printf("\n");
-        return 1;
+    end_output();
+}
+
+static void on_search(ChatClient* c, ChatBlockEvent event, const char* text, void* user) {
+    unsigned long shown = 0, total = 0;
+    (void)c; (void)user;
+    begin_output();
+    if (event == CHAT_BLOCK_BEGIN) {
+        sscanf(text, "%lu %lu", &shown, &total);
+        printf(COLOR_CYAN BOLD "\n╔═══════════════════════════════════════════╗\n" COLOR_RESET);
+        printf(COLOR_CYAN BOLD "║   BÚSQUEDA (%5lu de %7lu)             ║\n" COLOR_RESET, shown, total);
+        printf(COLOR_CYAN BOLD "╠═══════════════════════════════════════════╣\n" COLOR_RESET);
+    } else if (event == CHAT_BLOCK_ITEM) {
+        printf(COLOR_WHITE "║ %s\n" COLOR_RESET, text);
+    } else {
+        printf(COLOR_CYAN BOLD "╚═══════════════════════════════════════════╝\n" COLOR_RESET);
     }
-    
-    // Verificar si es un mensaje de información
-    if (strncmp(buffer, RESP_INFO, strlen(RESP_INFO)) == 0) {
-        const char* content = buffer + strlen(RESP_INFO);
-        printf(COLOR_GREEN "ℹ %s" COLOR_RESET, content);
-        if (content[strlen(content)-1] != '\n') printf("\n");
-        return 1;
+    end_output();
+}
+
+static void on_info(ChatClient* c, const char* text, void* user) {
+    (void)c; (void)user;
+    begin_output();
+    printf(COLOR_GREEN "ℹ %s\n" COLOR_RESET, text);
+    end_output();
+}
+
+static void on_error(ChatClient* c, const char* text, void* user) {
+    (void)c; (void)user;
+    begin_output();
+    printf(COLOR_RED "✗ Error: %s\n" COLOR_RESET, text);
+    end_output();
+}
+
+static void on_private(ChatClient* c, const char* from, const char* text, void* user) {
+    (void)c; (void)user;
+    begin_output();
+    printf(COLOR_MAGENTA BOLD "📩 [Mensaje privado] %s: %s\n" COLOR_RESET, from, text);
+    end_output();
+}
+
+static void on_broadcast(ChatClient* c, const char* from, const char* text, void* user) {
+    (void)c; (void)user;
+    begin_output();
+    printf(COLOR_YELLOW BOLD "📢 [Broadcast] %s: %s\n" COLOR_RESET, from, text);
+    end_output();
+}
+
+// Entradas y salidas (/watch), todas las de un aviso en una línea
+static void on_presence(ChatClient* c, const ChatPresence* events, int count, void* user) {
+    (void)c; (void)user;
+    begin_output();
+    printf(COLOR_CYAN "👥 ");
+    for (int i = 0; i < count; i++) {
+        printf("%s%s %s", i > 0 ? " · " : "", events[i].nick, events[i].joined ? "entró" : "salió");
     }
+    printf(COLOR_RESET "\n");
+    end_output();
+}
+
+// El servidor guarda la sesión: si la conexión se corta, se retoma sola
+static void on_session(ChatClient* c, const char* token, void* user) {
+    (void)c; (void)token; (void)user;
+    session_active = 1;
+    begin_output();
+    printf(COLOR_GREEN "ℹ Sesión reanudable: si se corta la conexión no se pierden mensajes\n" COLOR_RESET);
+    end_output();
+}
+
+static void on_file(ChatClient* c, ChatFileEvent event, const ChatFile* file, void* user) {
+    char path[PATH_MAX];
+    (void)c; (void)user;
     
-    // Verificar si es un mensaje de error
-    if (strncmp(buffer, RESP_ERROR, strlen(RESP_ERROR)) == 0) {
-        const char* content = buffer + strlen(RESP_ERROR);
-        printf(COLOR_RED "✗ Error: %s" COLOR_RESET, content);
-        if (content[strlen(content)-1] != '\n') printf("\n");
-        return 1;
+    begin_output();
+    if (event == CHAT_FILE_OFFER) {
+        printf(COLOR_MAGENTA BOLD "📎 %s te ofrece %s (%llu bytes): /accept %u o /reject %u\n" COLOR_RESET,
+               file->nick, file->name[0] ? file->name : "un archivo", (unsigned long long)file->size,
+               file->id, file->id);
+    } else if (event == CHAT_FILE_SEND) {
+        if (take_offer(file->name, file->size, path, sizeof(path))) {
+            printf(COLOR_GREEN "📎 Aceptaron #%u, enviando %s...\n" COLOR_RESET, file->id, path);
+            start_file_thread(1, file, path);
+        } else {
+            printf(COLOR_RED "✗ Aceptaron #%u pero no se sabe qué archivo era\n" COLOR_RESET, file->id);
+        }
+    } else if (event == CHAT_FILE_RECV && use_local) {
+        printf(COLOR_RED "✗ Los archivos viajan por TCP: #%u vence sin recibirse\n" COLOR_RESET, file->id);
+    } else if (event == CHAT_FILE_RECV) {
+        received_path(file->name, path, sizeof(path));
+        printf(COLOR_GREEN "📎 Recibiendo #%u en %s...\n" COLOR_RESET, file->id, path);
+        start_file_thread(0, file, path);
+    } else {
+        int ok = strcmp(file->status, "completa") == 0;
+        printf("%s📎 Transferencia #%u %s (%llu bytes)\n" COLOR_RESET, ok ? COLOR_GREEN : COLOR_RED,
+               file->id, file->status, (unsigned long long)file->size);
+    }
+    end_output();
+}
+
+// La sesión venció mientras estábamos afuera: entrar de nuevo con el nick
+static void on_reply(ChatClient* c, const ChatReply* reply, void* user) {
+    (void)user;
+    if (reply->command == CHAT_CMD_RESUME && reply->error) {
+        chat_client_send(c, nick);
+        chat_client_send(c, CMD_SESSION);
     }
+}
+
+// Mensaje normal del servidor
+static void on_line(ChatClient* c, const char* line, void* user) {
+    (void)c; (void)user;
+    begin_output();
+    printf(COLOR_YELLOW "%s\n" COLOR_RESET, line);
+    end_output();
+}
+
+static const ChatClientCallbacks callbacks = {
+    .on_private = on_private,
+    .on_broadcast = on_broadcast,
+    .on_list = on_list,
+    .on_history = on_history,
+    .on_search = on_search,
+    .on_presence = on_presence,
+    .on_info = on_info,
+    .on_error = on_error,
+    .on_line = on_line,
+    .on_reply = on_reply,
+    .on_session = on_session,
+    .on_file = on_file
+};
+
+static ChatClient* connect_server(void) {
+    if (use_local) return chat_client_connect_local(server_addr, &callbacks, NULL);
+    return chat_client_connect(server_addr, server_port, &callbacks, NULL);
+}
+
+// Envía una línea por la conexión actual
+static int send_line(const char* line) {
+    pthread_mutex_lock(&client_mutex);
+    int result = chat_client_send(client, line);
+    pthread_mutex_unlock(&client_mutex);
+    return result;
+}
+
+// /send <nick> <ruta>: se ofrece con el tamaño y el nombre sin directorios
+static void offer_file(const char* args) {
+    char dest[32];
+    int consumed = 0;
+    struct stat st;
     
-    // Verificar si es un mensaje privado
-    if (strncmp(buffer, RESP_MSG_FROM, strlen(RESP_MSG_FROM)) == 0) {
-        const char* content = buffer + strlen(RESP_MSG_FROM);
-        printf(COLOR_MAGENTA BOLD "📩 [Mensaje privado] %s" COLOR_RESET, content);
-        if (content[strlen(content)-1] != '\n') printf("\n");
-        return 1;
+    if (use_local) {
+        printf(COLOR_RED "✗ Los archivos viajan por TCP: conéctate con <ip> <puerto>\n" COLOR_RESET);
+        return;
+    }
+    if (sscanf(args, " %31s %n", dest, &consumed) < 1 || consumed == 0 || !args[consumed]) {
+        printf(COLOR_RED "✗ Uso: /send <nick> <ruta>\n" COLOR_RESET);
+        return;
     }
+    const char* path = args + consumed;
+    if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+        printf(COLOR_RED "✗ No se puede leer %s\n" COLOR_RESET, path);
+        return;
+    }
+    
+    const char* name = strrchr(path, '/');
+    name = name ? name + 1 : path;
     
-    // Verificar si es un mensaje broadcast
-    if (strncmp(buffer, RESP_BROADCAST, strlen(RESP_BROADCAST)) == 0) {
-        const char* content = buffer + strlen(RESP_BROADCAST);
-        printf(COLOR_YELLOW BOLD "📢 [Broadcast] %s" COLOR_RESET, content);
-        if (content[strlen(content)-1] != '\n') printf("\n");
-        return 1;
+    pthread_mutex_lock(&offers_mutex);
+    Offer* offer = NULL;
+    for (int i = 0; i < MAX_OFFERS && !offer; i++) {
+        if (!offers[i].used) offer = &offers[i];
+    }
+    if (offer) {
+        offer->used = 1;
+        offer->size = (uint64_t)st.st_size;
+        snprintf(offer->name, sizeof(offer->name), "%s", name);
+        snprintf(offer->path, sizeof(offer->path), "%s", path);
+    }
+    pthread_mutex_unlock(&offers_mutex);
+    if (!offer) {
+        printf(COLOR_RED "✗ Ya hay %d archivos esperando que los acepten\n" COLOR_RESET, MAX_OFFERS);
+        return;
     }
     
-    // Mensaje normal del servidor
-    printf(COLOR_YELLOW "%s" COLOR_RESET, buffer);
-    if (buffer[strlen(buffer)-1] != '\n') printf("\n");
+    char line[BUF_SIZE];
+    snprintf(line, sizeof(line), CMD_SEND " %s %llu %s", dest, (unsigned long long)st.st_size, offer->name);
+    send_line(line);
+}
+
+// La conexión se cortó: reconectar y retomar la sesión para recibir solo
+// lo que se perdió en el medio (sin /session no hay nada que retomar)
+static ChatClient* resume_session(ChatClient* old) {
+    const char* token = chat_client_session_token(old);
+    if (!token) return NULL;
+    
+    begin_output();
+    printf(COLOR_YELLOW "⟳ Conexión cortada, retomando la sesión...\n" COLOR_RESET);
+    fflush(stdout);
     
-    return 1;
+    for (int attempt = 0; attempt < RESUME_ATTEMPTS && running; attempt++) {
+        if (attempt > 0) sleep(1);
+        ChatClient* c = connect_server();
+        if (!c) continue;
+        if (chat_client_resume(c, token, chat_client_last_seq(old)) == 0) return c;
+        chat_client_close(c);
+    }
+    return NULL;
 }
 
 /**
@@ -105,11 +431,20 @@ void show_local_help() {
     printf(COLOR_CYAN BOLD "\n╔═══════════════════════════════════════════╗\n" COLOR_RESET);
     printf(COLOR_CYAN BOLD "║          COMANDOS DISPONIBLES            ║\n" COLOR_RESET);
     printf(COLOR_CYAN BOLD "╠═══════════════════════════════════════════╣\n" COLOR_RESET);
-    printf(COLOR_WHITE "║ " COLOR_GREEN "/list" COLOR_WHITE "  - Ver clientes conectados         ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║ " COLOR_GREEN "/list [n]" COLOR_WHITE " - Ver clientes conectados     ║\n" COLOR_RESET);
     printf(COLOR_WHITE "║ " COLOR_GREEN "/msg <nick> <texto>" COLOR_WHITE "                 ║\n" COLOR_RESET);
     printf(COLOR_WHITE "║         Enviar mensaje privado           ║\n" COLOR_RESET);
     printf(COLOR_WHITE "║ " COLOR_GREEN "/broadcast <texto>" COLOR_WHITE "                  ║\n" COLOR_RESET);
     printf(COLOR_WHITE "║         Enviar a todos los clientes      ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║ " COLOR_GREEN "/history [n|HH:MM|30m]" COLOR_WHITE "              ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║         Ver mensajes anteriores          ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║ " COLOR_GREEN "/search <palabras> [from:nick]" COLOR_WHITE "      ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║         Buscar en el historial           ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║ " COLOR_GREEN "/watch" COLOR_WHITE " - Avisos de entradas/salidas     ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║ " COLOR_GREEN "/send <nick> <ruta>" COLOR_WHITE "                 ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║         Ofrecer un archivo               ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║ " COLOR_GREEN "/accept <id>" COLOR_WHITE ", " COLOR_GREEN "/reject <id>" COLOR_WHITE "           ║\n" COLOR_RESET);
+    printf(COLOR_WHITE "║         Aceptar o rechazar una oferta    ║\n" COLOR_RESET);
     printf(COLOR_WHITE "║ " COLOR_GREEN "/help" COLOR_WHITE "  - Mostrar esta ayuda             ║\n" COLOR_RESET);
     printf(COLOR_WHITE "║ " COLOR_GREEN "/quit" COLOR_WHITE "  - Salir del chat                 ║\n" COLOR_RESET);
     printf(COLOR_CYAN BOLD "╚═══════════════════════════════════════════╝\n" COLOR_RESET);
@@ -119,59 +454,43 @@ void show_local_help() {
  * Thread que recibe mensajes del servidor continuamente (full-duplex)
  */
 void* receiver_thread(void* arg) {
-    int sockfd = *((int*)arg);
-    char buffer[BUF_SIZE];
-    int bytes;
+    ChatClient* current = arg;
     
-    while (running) {
-        memset(buffer, 0, BUF_SIZE);
-        bytes = recv(sockfd, buffer, BUF_SIZE - 1, 0);
-        
-        if (bytes <= 0) {
-            if (running) {  // Solo mostrar mensaje si no fue un cierre intencional
-                printf(COLOR_RED "\n✗ Servidor desconectado.\n" COLOR_RESET);
-                printf("Cliente cerrado.\n\n");
-            }
-            running = 0;
-            exit(0);  // KISS: Terminar el proceso inmediatamente
-        }
-        
-        buffer[bytes] = '\0';
+    for (;;) {
+        chat_client_run(current);
+        if (!running) break;
         
-        // Borrar la línea actual del prompt para que el mensaje se vea limpio
-        printf("\r\033[K");  // Retorno de carro + borrar línea
+        ChatClient* next = resume_session(current);
+        if (!next) break;
         
-        // Procesar cada línea de la respuesta
-        char buffer_copy[BUF_SIZE];
-        strncpy(buffer_copy, buffer, BUF_SIZE);
-        
-        char* line = strtok(buffer_copy, "\n");
-        while (line != NULL) {
-            process_server_response(line);
-            line = strtok(NULL, "\n");
-        }
-        
-        // Restaurar el prompt
-        printf(COLOR_CYAN BOLD "Tú: " COLOR_RESET);
-        fflush(stdout);
+        pthread_mutex_lock(&client_mutex);
+        client = next;
+        pthread_mutex_unlock(&client_mutex);
+        chat_client_close(current);
+        current = next;
     }
     
-    return NULL;
+    if (running) {  // Solo mostrar mensaje si no fue un cierre intencional
+        printf(COLOR_RED "\n✗ Servidor desconectado.\n" COLOR_RESET);
+        printf("Cliente cerrado.\n\n");
+    }
+    running = 0;
+    exit(0);  // KISS: Terminar el proceso inmediatamente
 }
 
 int main(int argc, char* argv[]) {
     // Verificar argumentos
     if (argc != 3) {
         printf("Uso: %s <ip> <puerto>\n", argv[0]);
+        printf("     %s --local <socket>   (servidor en el mismo host)\n", argv[0]);
         printf("Ejemplo: %s 127.0.0.1 5000\n", argv[0]);
         return EXIT_FAILURE;
     }
-
-    char* ip = argv[1];
-    int port = atoi(argv[2]);
-    int sockfd;
+    
+    use_local = strcmp(argv[1], "--local") == 0;
+    server_addr = use_local ? argv[2] : argv[1];
+    server_port = use_local ? 0 : atoi(argv[2]);
     char buffer[BUF_SIZE] = {0};
-    char nick[32];
     
     printf("\n=== CLIENTE DE CHAT ===\n");
     
@@ -193,24 +512,34 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE;
     }
     
-
-    printf("Conectando a %s:%d...\n", ip, port);
-
-    // Conectar al servidor (crea socket y hace connect)
-    sockfd = ConnectToServer(ip, port);
-    if (sockfd <= 0) {
+    
+    if (use_local) {
+        printf("Conectando a %s (memoria compartida)...\n", argv[2]);
+        
+        // Socket UNIX + negociación de los anillos compartidos
+        client = connect_server();
+    } else {
+        printf("Conectando a %s:%d...\n", server_addr, server_port);
+        
+        // Conectar al servidor (crea socket y hace connect)
+        client = connect_server();
+    }
+    if (!client) {
         printf("Error: No se pudo conectar al servidor\n");
         printf("¿Está el servidor corriendo?\n\n");
         return EXIT_FAILURE;
     }
     
     // Enviar el nick al servidor como primer mensaje
-    if (send(sockfd, nick, strlen(nick), 0) < 0) {
+    if (chat_client_send(client, nick) < 0) {
         printf("Error al enviar nick al servidor\n");
-        DisconnectFromServer(sockfd);
+        chat_client_close(client);
         return EXIT_FAILURE;
     }
     
+    // Pedir una sesión reanudable (si el servidor no guarda sesiones lo avisa)
+    chat_client_send(client, CMD_SESSION);
+    
     printf(COLOR_GREEN BOLD "✓ Conectado al servidor como '%s'!\n" COLOR_RESET, nick);
     
     // Dar un pequeño tiempo para recibir el mensaje de bienvenida
@@ -218,9 +547,9 @@ int main(int argc, char* argv[]) {
     
     // Crear thread para recibir mensajes del servidor (FULL-DUPLEX)
     pthread_t recv_thread;
-    if (pthread_create(&recv_thread, NULL, receiver_thread, &sockfd) != 0) {
+    if (pthread_create(&recv_thread, NULL, receiver_thread, client) != 0) {
         printf(COLOR_RED "Error al crear thread de recepción\n" COLOR_RESET);
-        DisconnectFromServer(sockfd);
+        chat_client_close(client);
         return EXIT_FAILURE;
     }
     
@@ -230,7 +559,7 @@ int main(int argc, char* argv[]) {
     printf(COLOR_CYAN "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" COLOR_RESET);
     printf(COLOR_YELLOW "Escribe " COLOR_GREEN "/help" COLOR_YELLOW " para ver comandos disponibles\n" COLOR_RESET);
     printf(COLOR_CYAN "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n\n" COLOR_RESET);
-
+    
     // Loop principal del chat - SOLO ENVÍO (recepción en thread separado)
     while (running) {
         printf(COLOR_CYAN BOLD "Tú: " COLOR_RESET);
@@ -255,16 +584,27 @@ int main(int argc, char* argv[]) {
             continue;  // No enviar al servidor, ya lo procesamos localmente
         }
         
+        // Archivo: se ofrece con su tamaño, los bytes van después aparte
+        if (strncmp(buffer, CMD_SEND " ", strlen(CMD_SEND) + 1) == 0) {
+            offer_file(buffer + strlen(CMD_SEND));
+            continue;
+        }
+        
         // Verificar si el usuario quiere salir
         if (strcmp(buffer, "/quit") == 0) {
             printf(COLOR_YELLOW "Cerrando conexión...\n" COLOR_RESET);
             running = 0;
-            send(sockfd, buffer, strlen(buffer), 0);
+            send_line(buffer);
             break;
         }
         
         // Enviar comando/mensaje al servidor
-        if (send(sockfd, buffer, strlen(buffer), 0) < 0) {
+        if (send_line(buffer) < 0) {
+            if (session_active) {
+                // El thread receptor está retomando la sesión
+                printf(COLOR_RED "✗ Sin conexión: no se envió, reintenta en un momento\n" COLOR_RESET);
+                continue;
+            }
             printf(COLOR_RED "Error al enviar mensaje\n" COLOR_RESET);
             running = 0;
             break;
@@ -275,9 +615,9 @@ int main(int argc, char* argv[]) {
     
     // Esperar a que termine el thread receptor
     pthread_join(recv_thread, NULL);
-
+    
     // Cerrar conexión
-    DisconnectFromServer(sockfd);
+    chat_client_close(client);
     printf("\nCliente cerrado.\n\n");
     
     return EXIT_SUCCESS;
@@ -0,0 +1,336 @@
+// ============================================================================
+// admin.c - Implementación del socket de administración
+// ============================================================================
+
+#define _GNU_SOURCE  // accept4(), pipe2()
+
+#include "admin.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+typedef struct {
+    const char *name;
+    const char *usage;
+    AdminCommandFn fn;
+} AdminCommand;
+
+typedef struct {
+    int fd;
+    char line[ADMIN_LINE_SIZE];
+    size_t len;
+} AdminClient;
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static AdminTunable tunables[ADMIN_MAX_TUNABLES];
+static int tunable_count = 0;
+static AdminCommand commands[ADMIN_MAX_COMMANDS];
+static int command_count = 0;
+static pthread_mutex_t apply_mutex = PTHREAD_MUTEX_INITIALIZER;  // Un cambio a la vez
+
+static struct {
+    pthread_t thread;
+    int listen_fd;
+    int stop_pipe[2];
+    int running;
+    char path[108];
+} admin = { .listen_fd = -1, .stop_pipe = { -1, -1 } };
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static AdminTunable *find_tunable(const char *name) {
+    for (int i = 0; i < tunable_count; i++) {
+        if (strcmp(tunables[i].name, name) == 0) return &tunables[i];
+    }
+    return NULL;
+}
+
+static size_t append(char *out, size_t size, size_t used, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static size_t append(char *out, size_t size, size_t used, const char *fmt, ...) {
+    if (used >= size) return used;
+    
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(out + used, size - used, fmt, ap);
+    va_end(ap);
+    
+    if (n < 0) return used;
+    return used + (size_t)n < size ? used + (size_t)n : size - 1;
+}
+
+static size_t set_tunable(const char *name, const char *arg, char *out, size_t size) {
+    AdminTunable *t = find_tunable(name);
+    if (!t) return append(out, size, 0, "ERROR: ajuste desconocido '%s'\n", name);
+    
+    char *end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    while (*end == ' ') end++;
+    if (end == arg || *end != '\0' || errno != 0 || value < t->min || value > t->max) {
+        return append(out, size, 0, "ERROR: %s va de %d a %d\n", t->name, t->min, t->max);
+    }
+    
+    pthread_mutex_lock(&apply_mutex);
+    if (t->apply && t->apply((int)value) < 0) {
+        pthread_mutex_unlock(&apply_mutex);
+        return append(out, size, 0, "ERROR: no se pudo aplicar %s = %ld\n", t->name, value);
+    }
+    __atomic_store_n(t->value, (int)value, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&apply_mutex);
+    
+    return append(out, size, 0, "%s = %ld\nOK\n", t->name, value);
+}
+
+// Procesa lo que llegó de un cliente. Retorna -1 si hay que cerrarlo.
+static int serve_client(AdminClient *c) {
+    char reply[ADMIN_REPLY_SIZE];
+    ssize_t n = read(c->fd, c->line + c->len, sizeof(c->line) - 1 - c->len);
+    if (n <= 0) return -1;
+    c->len += (size_t)n;
+    
+    char *newline;
+    while ((newline = memchr(c->line, '\n', c->len)) != NULL) {
+        *newline = '\0';
+        size_t line_len = (size_t)(newline - c->line) + 1;
+        
+        size_t len = admin_execute(c->line, reply, sizeof(reply));
+        if (len > 0 && write(c->fd, reply, len) < 0) return -1;
+        
+        memmove(c->line, newline + 1, c->len - line_len);
+        c->len -= line_len;
+    }
+    
+    // Una línea más larga que el buffer no es un comando válido
+    if (c->len == sizeof(c->line) - 1) return -1;
+    return 0;
+}
+
+// Solo el usuario del servidor (o root) puede cambiar sus ajustes, aunque
+// alguien alcance el socket por un directorio con otros permisos
+static int peer_allowed(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) return 0;
+    return cred.uid == 0 || cred.uid == geteuid();
+}
+
+static void *admin_thread(void *arg) {
+    (void)arg;
+    AdminClient clients[ADMIN_MAX_CLIENTS];
+    int client_count = 0;
+    
+    while (1) {
+        struct pollfd pfds[2 + ADMIN_MAX_CLIENTS];
+        pfds[0] = (struct pollfd){ .fd = admin.stop_pipe[0], .events = POLLIN };
+        pfds[1] = (struct pollfd){ .fd = admin.listen_fd, .events = POLLIN };
+        for (int i = 0; i < client_count; i++) {
+            pfds[2 + i] = (struct pollfd){ .fd = clients[i].fd, .events = POLLIN };
+        }
+        
+        if (poll(pfds, 2 + client_count, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfds[0].revents) break;
+        
+        // Atender primero a los conectados: sus posiciones no cambian hasta acá
+        for (int i = client_count - 1; i >= 0; i--) {
+            if (pfds[2 + i].revents && serve_client(&clients[i]) < 0) {
+                close(clients[i].fd);
+                clients[i] = clients[--client_count];
+            }
+        }
+        
+        if (pfds[1].revents & POLLIN) {
+            int fd = accept4(admin.listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd >= 0 && !peer_allowed(fd)) {
+                const char *denied = "ERROR: el socket de administración es del usuario del servidor\n";
+                if (write(fd, denied, strlen(denied)) < 0) {
+                    // Se cierra igual
+                }
+                close(fd);
+            } else if (fd >= 0 && client_count < ADMIN_MAX_CLIENTS) {
+                clients[client_count].fd = fd;
+                clients[client_count].len = 0;
+                client_count++;
+            } else if (fd >= 0) {
+                const char *busy = "ERROR: demasiadas sesiones de administración\n";
+                if (write(fd, busy, strlen(busy)) < 0) {
+                    // Se cierra igual
+                }
+                close(fd);
+            }
+        }
+    }
+    
+    for (int i = 0; i < client_count; i++) close(clients[i].fd);
+    return NULL;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int admin_register(const AdminTunable *tunable) {
+    if (tunable_count >= ADMIN_MAX_TUNABLES) return -1;
+    tunables[tunable_count++] = *tunable;
+    return 0;
+}
+
+int admin_register_command(const char *name, const char *usage, AdminCommandFn fn) {
+    if (command_count >= ADMIN_MAX_COMMANDS) return -1;
+    commands[command_count++] = (AdminCommand){ .name = name, .usage = usage, .fn = fn };
+    return 0;
+}
+
+size_t admin_execute(const char *line, char *out, size_t size) {
+    char cmd[ADMIN_LINE_SIZE];
+    char name[ADMIN_LINE_SIZE];
+    size_t used = 0;
+    
+    // Separar el comando del resto (sin '\r' de clientes tipo telnet)
+    while (*line == ' ') line++;
+    size_t cmd_len = strcspn(line, " \r");
+    if (cmd_len == 0) return 0;
+    if (cmd_len >= sizeof(cmd)) cmd_len = sizeof(cmd) - 1;
+    memcpy(cmd, line, cmd_len);
+    cmd[cmd_len] = '\0';
+    
+    const char *args = line + cmd_len;
+    while (*args == ' ') args++;
+    char rest[ADMIN_LINE_SIZE];
+    snprintf(rest, sizeof(rest), "%s", args);
+    rest[strcspn(rest, "\r")] = '\0';
+    
+    if (strcmp(cmd, "show") == 0) {
+        for (int i = 0; i < tunable_count; i++) {
+            AdminTunable *t = &tunables[i];
+            used = append(out, size, used, "%-22s = %-8d [%d..%d] %s\n", t->name,
+                          __atomic_load_n(t->value, __ATOMIC_ACQUIRE), t->min, t->max, t->help);
+        }
+        return append(out, size, used, "OK\n");
+    }
+    
+    if (strcmp(cmd, "get") == 0) {
+        AdminTunable *t = find_tunable(rest);
+        if (!t) return append(out, size, 0, "ERROR: ajuste desconocido '%s'\n", rest);
+        return append(out, size, 0, "%s = %d\nOK\n", t->name, __atomic_load_n(t->value, __ATOMIC_ACQUIRE));
+    }
+    
+    if (strcmp(cmd, "set") == 0) {
+        size_t name_len = strcspn(rest, " ");
+        if (name_len == 0 || rest[name_len] == '\0' || name_len >= sizeof(name)) {
+            return append(out, size, 0, "ERROR: uso: set <nombre> <valor>\n");
+        }
+        memcpy(name, rest, name_len);
+        name[name_len] = '\0';
+        const char *value = rest + name_len;
+        while (*value == ' ') value++;
+        return set_tunable(name, value, out, size);
+    }
+    
+    if (strcmp(cmd, "help") == 0) {
+        used = append(out, size, used, "show                  Ajustes con su valor y su rango\n");
+        used = append(out, size, used, "get <nombre>          Valor de un ajuste\n");
+        used = append(out, size, used, "set <nombre> <valor>  Cambiar un ajuste en caliente\n");
+        for (int i = 0; i < command_count; i++) {
+            used = append(out, size, used, "%s\n", commands[i].usage);
+        }
+        return append(out, size, used, "OK\n");
+    }
+    
+    for (int i = 0; i < command_count; i++) {
+        if (strcmp(cmd, commands[i].name) == 0) {
+            char result[ADMIN_REPLY_SIZE / 2];
+            result[0] = '\0';
+            int rc = commands[i].fn(rest, result, sizeof(result));
+            if (rc < 0) return append(out, size, 0, "ERROR: %s\n", result[0] ? result : commands[i].usage);
+            return append(out, size, 0, "%s%s", result, "OK\n");
+        }
+    }
+    
+    return append(out, size, 0, "ERROR: comando desconocido '%s' (probar help)\n", cmd);
+}
+
+int admin_start(const char *path) {
+    struct sockaddr_un addr;
+    
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    
+    // Modo 0600 antes de listen(): nadie se conecta mientras el socket
+    // todavía tiene los permisos del umask
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (chmod(path, S_IRUSR | S_IWUSR) < 0 || listen(fd, ADMIN_MAX_CLIENTS) < 0) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    
+    if (pipe2(admin.stop_pipe, O_CLOEXEC) < 0) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    
+    admin.listen_fd = fd;
+    strcpy(admin.path, path);
+    if (pthread_create(&admin.thread, NULL, admin_thread, NULL) != 0) {
+        admin_stop();
+        return -1;
+    }
+    admin.running = 1;
+    return 0;
+}
+
+void admin_stop(void) {
+    if (admin.running) {
+        char c = 's';
+        if (write(admin.stop_pipe[1], &c, 1) < 0) {
+            perror("admin");
+        }
+        pthread_join(admin.thread, NULL);
+        admin.running = 0;
+    }
+    
+    if (admin.listen_fd >= 0) {
+        close(admin.listen_fd);
+        admin.listen_fd = -1;
+        unlink(admin.path);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (admin.stop_pipe[i] >= 0) close(admin.stop_pipe[i]);
+        admin.stop_pipe[i] = -1;
+    }
+}
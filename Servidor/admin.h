@@ -0,0 +1,84 @@
+// ============================================================================
+// admin.h - Socket de administración para ajustar límites en caliente
+// ============================================================================
+// Con --admin-socket el servidor escucha en un socket UNIX local comandos de
+// texto, una línea por comando:
+//   show                   Lista los ajustes con su valor y su rango
+//   get <nombre>           Valor de un ajuste
+//   set <nombre> <valor>   Cambia un ajuste sin cortar el tráfico
+//   help                   Comandos disponibles (incluidos los registrados)
+// Cada respuesta termina con una línea "OK" o "ERROR: <motivo>".
+// El socket se crea con modo 0600 y solo atiende al usuario del servidor
+// (o a root), según las credenciales del que se conecta.
+// Los ajustes son enteros que el resto del servidor vuelve a leer en cada
+// uso: un cambio se ve en el próximo, sin locks ni pausas.
+// ============================================================================
+
+#ifndef ADMIN_H
+#define ADMIN_H
+
+#include <stddef.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define ADMIN_MAX_TUNABLES 32
+#define ADMIN_MAX_COMMANDS 8
+#define ADMIN_MAX_CLIENTS 8
+#define ADMIN_LINE_SIZE 256
+#define ADMIN_REPLY_SIZE 8192
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct {
+    const char *name;
+    const char *help;
+    int *value;         // Lo lee el servidor; el socket lo escribe
+    int min;
+    int max;
+    // Aplica el valor nuevo antes de publicarlo (NULL = solo guardarlo).
+    // Retorna -1 para rechazarlo.
+    int (*apply)(int value);
+} AdminTunable;
+
+// Comando extra: escribe su respuesta en out (sin la línea OK/ERROR)
+// y retorna 0 si tuvo éxito o -1 si hubo un error
+typedef int (*AdminCommandFn)(const char *args, char *out, size_t size);
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Registra un ajuste (antes de admin_start)
+ * @return 0 si tiene éxito, -1 si no hay lugar
+ */
+int admin_register(const AdminTunable *tunable);
+
+/**
+ * Registra un comando extra (antes de admin_start)
+ * @return 0 si tiene éxito, -1 si no hay lugar
+ */
+int admin_register_command(const char *name, const char *usage, AdminCommandFn fn);
+
+/**
+ * Crea el socket en path y lanza el thread que lo atiende
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int admin_start(const char *path);
+
+/**
+ * Cierra el socket (y borra el archivo) y espera al thread
+ */
+void admin_stop(void);
+
+/**
+ * Ejecuta una línea de comando (la usa el thread; sirve también para pruebas)
+ * @return Largo de la respuesta escrita en out
+ */
+size_t admin_execute(const char *line, char *out, size_t size);
+
+#endif // ADMIN_H
@@ -0,0 +1,254 @@
+// ============================================================================
+// affinity.c - Implementación de la afinidad de CPU y la ubicación NUMA
+// ============================================================================
+
+#define _GNU_SOURCE  // pthread_setaffinity_np(), CPU_*
+
+#include "affinity.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+// Lee la primera línea de un archivo de /sys o /proc (sin el '\n')
+static int read_line(const char *path, char *out, size_t size) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    
+    if (!fgets(out, (int)size, f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    out[strcspn(out, "\n")] = '\0';
+    return 0;
+}
+
+// Máscara hexadecimal en el formato de rps_cpus ("ffffffff,0000000f")
+static void format_mask(const cpu_set_t *set, char *out, size_t size) {
+    int highest = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, set)) highest = cpu;
+    }
+    
+    size_t used = 0;
+    out[0] = '\0';
+    for (int word = highest / 32; word >= 0 && used < size; word--) {
+        uint32_t bits = 0;
+        for (int b = 0; b < 32; b++) {
+            if (CPU_ISSET(word * 32 + b, set)) bits |= 1u << b;
+        }
+        used += snprintf(out + used, size - used, word > 0 ? "%08x," : "%08x", bits);
+    }
+}
+
+// Compara dos máscaras de sysfs sin importar comas ni ceros a la izquierda
+// (el kernel las imprime con el ancho de las CPUs posibles)
+static int same_mask(const char *a, const char *b) {
+    char clean[2][256];
+    const char *src[2] = { a, b };
+    
+    for (int k = 0; k < 2; k++) {
+        size_t n = 0;
+        for (const char *p = src[k]; *p && n < sizeof(clean[k]) - 1; p++) {
+            if (*p == ',' || (*p == '0' && n == 0)) continue;
+            clean[k][n++] = *p;
+        }
+        clean[k][n] = '\0';
+    }
+    return strcmp(clean[0], clean[1]) == 0;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int affinity_parse_list(const char *list, int *out, int max) {
+    int count = 0;
+    const char *p = list;
+    
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= CPU_SETSIZE) return -1;
+        long last = first;
+        p = end;
+        
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first || last >= CPU_SETSIZE) return -1;
+            p = end;
+        }
+        
+        for (long n = first; n <= last; n++) {
+            if (count >= max) return -1;
+            out[count++] = (int)n;
+        }
+        
+        if (*p == ',') p++;
+        else if (*p != '\0') return -1;
+    }
+    
+    return count > 0 ? count : -1;
+}
+
+void affinity_format_list(const cpu_set_t *set, char *out, size_t size) {
+    size_t used = 0;
+    out[0] = '\0';
+    
+    for (int cpu = 0; cpu < CPU_SETSIZE && used < size; cpu++) {
+        if (!CPU_ISSET(cpu, set)) continue;
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set)) last++;
+        
+        const char *sep = used > 0 ? "," : "";
+        if (last > cpu) {
+            used += snprintf(out + used, size - used, "%s%d-%d", sep, cpu, last);
+        } else {
+            used += snprintf(out + used, size - used, "%s%d", sep, cpu);
+        }
+        cpu = last;
+    }
+}
+
+int affinity_cpu_node(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    
+    DIR *dir = opendir(path);
+    if (!dir) return 0;
+    
+    int node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    
+    closedir(dir);
+    return node;
+}
+
+int affinity_node_cpus(int node, cpu_set_t *set) {
+    char path[64];
+    char line[1024];
+    int cpus[CPU_SETSIZE];
+    
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    if (read_line(path, line, sizeof(line)) < 0) return -1;
+    
+    int count = affinity_parse_list(line, cpus, CPU_SETSIZE);
+    if (count < 0) return -1;
+    
+    CPU_ZERO(set);
+    for (int i = 0; i < count; i++) CPU_SET(cpus[i], set);
+    return 0;
+}
+
+int affinity_pin_self(const cpu_set_t *set) {
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), set) != 0) return -1;
+    
+    // Reservar en el nodo de la CPU que corre el thread, aunque el proceso
+    // se haya lanzado con otra política (por ejemplo numactl --interleave).
+    // Sin permiso o sin NUMA falla y queda la política por defecto, que es
+    // la misma.
+    syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0);
+    return 0;
+}
+
+int affinity_move_to_node(void *addr, size_t len, int node) {
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~((uintptr_t)page - 1);
+    uintptr_t end = ((uintptr_t)addr + len + page - 1) & ~((uintptr_t)page - 1);
+    unsigned long mask[CPU_SETSIZE / (8 * sizeof(unsigned long))];
+    
+    if (node < 0 || node >= CPU_SETSIZE) return -1;
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    
+    if (syscall(SYS_mbind, (void *)start, end - start, MPOL_PREFERRED, mask,
+                (unsigned long)CPU_SETSIZE, MPOL_MF_MOVE) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void affinity_report_steering(FILE *out, const cpu_set_t *sets, int count) {
+    DIR *dir = opendir("/sys/class/net");
+    if (!dir || count <= 0) {
+        if (dir) closedir(dir);
+        return;
+    }
+    
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *iface = entry->d_name;
+        if (iface[0] == '.' || strcmp(iface, "lo") == 0) continue;
+        
+        fprintf(out, "\n  %s\n", iface);
+        
+        // RPS: la cola rx-N la procesa el worker N % count
+        for (int q = 0; ; q++) {
+            char path[320];
+            char current[256];
+            char expected[256];
+            char cpus[256];
+            
+            snprintf(path, sizeof(path), "/sys/class/net/%s/queues/rx-%d/rps_cpus", iface, q);
+            if (read_line(path, current, sizeof(current)) < 0) break;
+            
+            format_mask(&sets[q % count], expected, sizeof(expected));
+            affinity_format_list(&sets[q % count], cpus, sizeof(cpus));
+            // Máscara en cero: RPS apagado, la cola la procesa la CPU de su IRQ
+            const char *mark = same_mask(current, expected) ? ""
+                             : same_mask(current, "0") ? "  (RPS apagado: manda la IRQ)" : "  <-";
+            fprintf(out, "    rx-%-3d RPS actual %-20s esperado %-20s (worker-%d, CPUs %s)%s\n",
+                    q, current, expected, q % count, cpus, mark);
+        }
+        
+        // IRQs de la interfaz: las que llevan su nombre en /proc/interrupts
+        FILE *f = fopen("/proc/interrupts", "r");
+        if (!f) continue;
+        
+        char line[4096];
+        int found = 0;
+        while (fgets(line, sizeof(line), f)) {
+            char *colon = strchr(line, ':');
+            line[strcspn(line, "\n")] = '\0';
+            char *name = strrchr(line, ' ');
+            if (!colon || !name || !strstr(name + 1, iface)) continue;
+            
+            int irq = atoi(line);
+            char path[64];
+            char current[256];
+            char expected[256];
+            snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", irq);
+            if (read_line(path, current, sizeof(current)) < 0) continue;
+            
+            affinity_format_list(&sets[found % count], expected, sizeof(expected));
+            fprintf(out, "    IRQ %-4d %-20s CPUs actual %-12s esperado %-12s (worker-%d)%s\n",
+                    irq, name + 1, current, expected, found % count,
+                    strcmp(current, expected) == 0 ? "" : "  <-");
+            found++;
+        }
+        fclose(f);
+        
+        if (!found) {
+            fprintf(out, "    Sin IRQs con el nombre %s en /proc/interrupts: revisar a mano\n"
+                         "    /proc/irq/*/smp_affinity_list de las colas de la placa\n", iface);
+        }
+    }
+    
+    closedir(dir);
+}
@@ -0,0 +1,65 @@
+// ============================================================================
+// affinity.h - Afinidad de CPU y ubicación NUMA de los threads del servidor
+// ============================================================================
+// Con --cpus o --numa-nodes cada worker queda fijo en una CPU (o en las CPUs
+// de un nodo) y reserva su memoria en el nodo local. El acceptor reparte cada
+// conexión al worker de la CPU que atendió su interrupción (SO_INCOMING_CPU),
+// así que conviene que las colas de la placa apunten a las mismas CPUs:
+// affinity_report_steering() muestra lo configurado y lo esperado.
+// ============================================================================
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <sched.h>      // cpu_set_t (requiere _GNU_SOURCE)
+#include <stdio.h>
+#include <stddef.h>
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Interpreta una lista tipo "0-3,8,10-11"
+ * @param out Números de la lista, en orden
+ * @return Cantidad de números, -1 si la lista no es válida o no entra en max
+ */
+int affinity_parse_list(const char *list, int *out, int max);
+
+/**
+ * Escribe un conjunto de CPUs como lista ("0-3,8")
+ */
+void affinity_format_list(const cpu_set_t *set, char *out, size_t size);
+
+/**
+ * Nodo NUMA de una CPU (0 si el sistema no expone nodos)
+ */
+int affinity_cpu_node(int cpu);
+
+/**
+ * CPUs de un nodo NUMA
+ * @return 0 si tiene éxito, -1 si el nodo no existe
+ */
+int affinity_node_cpus(int node, cpu_set_t *set);
+
+/**
+ * Fija el thread actual a set y le pide memoria del nodo local
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int affinity_pin_self(const cpu_set_t *set);
+
+/**
+ * Mueve al nodo indicado las páginas de [addr, addr + len) (addr alineado
+ * a página). Sirve para la memoria que otro thread tocó primero.
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int affinity_move_to_node(void *addr, size_t len, int node);
+
+/**
+ * Muestra, para cada cola de recepción de cada interfaz, las CPUs que
+ * tiene asignadas (IRQ y RPS) y las que espera el worker que le toca
+ * @param sets CPUs de cada worker
+ */
+void affinity_report_steering(FILE *out, const cpu_set_t *sets, int count);
+
+#endif // AFFINITY_H
@@ -0,0 +1,251 @@
+// ============================================================================
+// capture.c - Implementación de la traza de tráfico entrante
+// ============================================================================
+
+#include "capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static struct {
+    pthread_mutex_t mutex;
+    int fd;
+    uint32_t next_id;
+    uint64_t last_us;        // Instante del último registro (monotónico)
+    uint64_t last_flush_us;
+    uint64_t origin_us;      // Instante monotónico del inicio
+    unsigned char buffer[CAPTURE_BUFFER_SIZE];
+    size_t used;
+} capture = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .fd = -1
+};
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint64_t clock_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static size_t put_varint(unsigned char *out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+static int get_varint(const unsigned char **p, const unsigned char *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*p >= end) return -1;
+        unsigned char byte = *(*p)++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Escribe el buffer en el archivo (con el mutex tomado)
+static void flush_locked(uint64_t now) {
+    size_t done = 0;
+    while (done < capture.used) {
+        ssize_t n = write(capture.fd, capture.buffer + done, capture.used - done);
+        if (n <= 0) break;  // Disco lleno: se pierde este tramo, no el servicio
+        done += n;
+    }
+    capture.used = 0;
+    capture.last_flush_us = now;
+}
+
+static void append_record(uint32_t conn_id, uint8_t type, const char *line, size_t len) {
+    unsigned char head[32];
+    size_t head_len = 0;
+    
+    pthread_mutex_lock(&capture.mutex);
+    if (capture.fd < 0) {
+        pthread_mutex_unlock(&capture.mutex);
+        return;
+    }
+    
+    uint64_t now = clock_us(CLOCK_MONOTONIC) - capture.origin_us;
+    head_len += put_varint(head + head_len, now - capture.last_us);
+    head_len += put_varint(head + head_len, conn_id);
+    head[head_len++] = type;
+    if (type == CAPTURE_LINE) head_len += put_varint(head + head_len, len);
+    capture.last_us = now;
+    
+    if (capture.used + head_len + len > CAPTURE_BUFFER_SIZE) flush_locked(now);
+    if (head_len + len <= CAPTURE_BUFFER_SIZE) {
+        memcpy(capture.buffer + capture.used, head, head_len);
+        capture.used += head_len;
+        if (len > 0) memcpy(capture.buffer + capture.used, line, len);
+        capture.used += len;
+    }
+    if (now - capture.last_flush_us >= CAPTURE_FLUSH_US) flush_locked(now);
+    
+    pthread_mutex_unlock(&capture.mutex);
+}
+
+// ============================================================================
+// Implementación de funciones públicas: escritura
+// ============================================================================
+
+int capture_start(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    
+    CaptureHeader header = {
+        .magic = CAPTURE_MAGIC,
+        .version = CAPTURE_VERSION,
+        .start_us = clock_us(CLOCK_REALTIME)
+    };
+    if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+        close(fd);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&capture.mutex);
+    capture.fd = fd;
+    capture.next_id = 1;
+    capture.origin_us = clock_us(CLOCK_MONOTONIC);
+    capture.last_us = 0;
+    capture.last_flush_us = 0;
+    capture.used = 0;
+    pthread_mutex_unlock(&capture.mutex);
+    return 0;
+}
+
+void capture_stop(void) {
+    pthread_mutex_lock(&capture.mutex);
+    if (capture.fd >= 0) {
+        flush_locked(capture.last_us);
+        close(capture.fd);
+        capture.fd = -1;
+    }
+    pthread_mutex_unlock(&capture.mutex);
+}
+
+int capture_enabled(void) {
+    pthread_mutex_lock(&capture.mutex);
+    int enabled = capture.fd >= 0;
+    pthread_mutex_unlock(&capture.mutex);
+    return enabled;
+}
+
+uint32_t capture_open(void) {
+    pthread_mutex_lock(&capture.mutex);
+    uint32_t id = capture.fd >= 0 ? capture.next_id++ : 0;
+    pthread_mutex_unlock(&capture.mutex);
+    
+    if (id) append_record(id, CAPTURE_OPEN, NULL, 0);
+    return id;
+}
+
+void capture_line(uint32_t conn_id, const char *line, size_t len) {
+    if (conn_id) append_record(conn_id, CAPTURE_LINE, line, len);
+}
+
+void capture_close(uint32_t conn_id) {
+    if (conn_id) append_record(conn_id, CAPTURE_CLOSE, NULL, 0);
+}
+
+// ============================================================================
+// Implementación de funciones públicas: lectura
+// ============================================================================
+
+int capture_load(const char *path, CaptureTrace *trace) {
+    memset(trace, 0, sizeof(*trace));
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(CaptureHeader)) {
+        close(fd);
+        return -1;
+    }
+    
+    trace->size = (size_t)st.st_size;
+    trace->data = malloc(trace->size);
+    size_t done = 0;
+    while (trace->data && done < trace->size) {
+        ssize_t n = read(fd, trace->data + done, trace->size - done);
+        if (n <= 0) break;
+        done += n;
+    }
+    close(fd);
+    if (!trace->data || done != trace->size) {
+        capture_free(trace);
+        return -1;
+    }
+    
+    memcpy(&trace->header, trace->data, sizeof(CaptureHeader));
+    if (trace->header.magic != CAPTURE_MAGIC || trace->header.version != CAPTURE_VERSION) {
+        capture_free(trace);
+        return -1;
+    }
+    
+    const unsigned char *p = (const unsigned char *)trace->data + sizeof(CaptureHeader);
+    const unsigned char *end = (const unsigned char *)trace->data + trace->size;
+    size_t capacity = 0;
+    uint64_t time_us = 0;
+    
+    while (p < end) {
+        uint64_t delta, conn_id, len = 0;
+        if (get_varint(&p, end, &delta) < 0 || get_varint(&p, end, &conn_id) < 0 || p >= end) break;
+        uint8_t type = *p++;
+        if (type == CAPTURE_LINE) {
+            if (get_varint(&p, end, &len) < 0 || len > (uint64_t)(end - p)) break;
+        } else if (type != CAPTURE_OPEN && type != CAPTURE_CLOSE) {
+            break;
+        }
+        
+        if (trace->count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            CaptureEvent *events = realloc(trace->events, capacity * sizeof(CaptureEvent));
+            if (!events) {
+                capture_free(trace);
+                return -1;
+            }
+            trace->events = events;
+        }
+        
+        time_us += delta;
+        CaptureEvent *e = &trace->events[trace->count++];
+        e->time_us = time_us;
+        e->conn_id = (uint32_t)conn_id;
+        e->type = type;
+        e->len = (uint32_t)len;
+        e->line = (const char *)p;
+        p += len;
+        if (e->conn_id > trace->max_conn_id) trace->max_conn_id = e->conn_id;
+    }
+    
+    // Un final cortado (el servidor murió a mitad de un registro) se ignora
+    return 0;
+}
+
+void capture_free(CaptureTrace *trace) {
+    free(trace->data);
+    free(trace->events);
+    memset(trace, 0, sizeof(*trace));
+}
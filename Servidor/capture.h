@@ -0,0 +1,114 @@
+// ============================================================================
+// capture.h - Captura del tráfico entrante en una traza binaria compacta
+// ============================================================================
+// Con --capture el servidor registra cada conexión, cada línea recibida y
+// cada cierre, con su instante y un id de conexión. bench/replay vuelve a
+// ejecutar la traza contra otro servidor (a la misma velocidad, más rápido o
+// sin esperas) para comparar builds con la forma de carga real.
+//
+// Formato: un CaptureHeader y luego registros de largo variable
+//   varint  microsegundos desde el registro anterior
+//   varint  id de conexión
+//   byte    tipo (CAPTURE_OPEN, CAPTURE_LINE, CAPTURE_CLOSE)
+//   varint  largo + bytes de la línea (solo CAPTURE_LINE, sin '\n')
+// Los varint son LEB128 sin signo: la mayoría de los registros ocupan pocos
+// bytes más que la línea.
+// ============================================================================
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define CAPTURE_MAGIC 0x52544843u  // "CHTR"
+#define CAPTURE_VERSION 1
+#define CAPTURE_BUFFER_SIZE (64 * 1024)
+#define CAPTURE_FLUSH_US 1000000   // Bajar a disco al menos una vez por segundo
+
+enum {
+    CAPTURE_OPEN = 1,
+    CAPTURE_LINE = 2,
+    CAPTURE_CLOSE = 3
+};
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint64_t start_us;  // Hora de inicio (CLOCK_REALTIME, microsegundos)
+} CaptureHeader;
+
+typedef struct {
+    uint64_t time_us;   // Desde el inicio de la captura
+    uint32_t conn_id;
+    uint8_t type;
+    uint32_t len;       // Largo de la línea (CAPTURE_LINE)
+    const char *line;   // Apunta a la traza cargada (sin '\0')
+} CaptureEvent;
+
+typedef struct {
+    CaptureHeader header;
+    char *data;               // Archivo completo
+    size_t size;
+    CaptureEvent *events;
+    size_t count;
+    uint32_t max_conn_id;
+} CaptureTrace;
+
+// ============================================================================
+// Funciones públicas: escritura (servidor)
+// ============================================================================
+
+/**
+ * Empieza a capturar en path (lo reemplaza si existe)
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int capture_start(const char *path);
+
+/**
+ * Baja a disco lo pendiente y cierra la traza
+ */
+void capture_stop(void);
+
+/**
+ * Indica si hay una captura en curso
+ */
+int capture_enabled(void);
+
+/**
+ * Registra una conexión nueva
+ * @return Id de la conexión en la traza (0 si no hay captura)
+ */
+uint32_t capture_open(void);
+
+/**
+ * Registra una línea recibida (sin el '\n') y el cierre de una conexión
+ */
+void capture_line(uint32_t conn_id, const char *line, size_t len);
+void capture_close(uint32_t conn_id);
+
+// ============================================================================
+// Funciones públicas: lectura (bench/replay)
+// ============================================================================
+
+/**
+ * Carga una traza completa en memoria
+ * @return 0 si tiene éxito, -1 si no se pudo leer o está corrupta
+ */
+int capture_load(const char *path, CaptureTrace *trace);
+
+/**
+ * Libera una traza cargada con capture_load()
+ */
+void capture_free(CaptureTrace *trace);
+
+#endif // CAPTURE_H
@@ -0,0 +1,329 @@
+// ============================================================================
+// coalesce.c - Implementación del agrupado por destinatario
+// ============================================================================
+
+#include "coalesce.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+#define SPARE_MAX 256             // Colas vacías que se guardan para reutilizar
+
+struct CoalesceMsg {
+    int refs;                 // Atómico: lo sueltan el que lo crea y cada cola
+    size_t len;
+    char data[];
+};
+
+// Mensajes pendientes de un destinatario
+typedef struct Outbox {
+    CoalesceMsg *msgs[COALESCE_MAX_BATCH];
+    int count;
+    size_t bytes;
+    uint64_t first_us;        // Llegada del primero: el plazo corre desde acá
+    int listed;               // Está en la cola de pendientes
+    int next;                 // Siguiente fd de la cola (-1 = último)
+    struct Outbox *spare_next;
+} Outbox;
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int running;
+    int budget_us;
+    CoalesceSendFn send;
+    
+    Outbox **outboxes;        // Indexada por fd; solo los que tienen mensajes en camino
+    int size;
+    Outbox *spare;            // Colas vacías para el próximo destinatario
+    int spare_count;
+    int head;                 // fds con mensajes, en orden de llegada
+    int tail;
+    CoalesceStats stats;
+} coalesce = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .head = -1,
+    .tail = -1
+};
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// Envía lo encolado de un fd en un solo writev (con el mutex tomado: así
+// nadie cierra el fd ni lo reutiliza en el medio)
+static void flush_outbox(int sockfd, Outbox *o, int full) {
+    struct iovec iov[COALESCE_MAX_BATCH];
+    
+    if (o->count == 0) return;
+    
+    for (int i = 0; i < o->count; i++) {
+        iov[i].iov_base = o->msgs[i]->data;
+        iov[i].iov_len = o->msgs[i]->len;
+    }
+    coalesce.send(sockfd, iov, o->count, o->bytes);
+    
+    coalesce.stats.msgs += (uint64_t)o->count;
+    coalesce.stats.flushes++;
+    coalesce.stats.bytes += o->bytes;
+    coalesce.stats.full_flushes += full ? 1 : 0;
+    coalesce.stats.wait_us += now_us() - o->first_us;
+    if ((uint64_t)o->count > coalesce.stats.max_batch) coalesce.stats.max_batch = (uint64_t)o->count;
+    
+    for (int i = 0; i < o->count; i++) coalesce_msg_release(o->msgs[i]);
+    o->count = 0;
+    o->bytes = 0;
+}
+
+// Toma una cola vacía (con el mutex tomado)
+static Outbox *outbox_get(void) {
+    Outbox *o = coalesce.spare;
+    if (o) {
+        coalesce.spare = o->spare_next;
+        coalesce.spare_count--;
+    } else {
+        o = malloc(sizeof(Outbox));
+        if (!o) return NULL;
+    }
+    memset(o, 0, sizeof(*o));
+    o->next = -1;
+    coalesce.stats.outboxes++;
+    return o;
+}
+
+// Devuelve la cola vacía de sockfd: un destinatario inactivo no ocupa ninguna
+// (con el mutex tomado)
+static void outbox_put(int sockfd) {
+    Outbox *o = coalesce.outboxes[sockfd];
+    coalesce.outboxes[sockfd] = NULL;
+    coalesce.stats.outboxes--;
+    
+    if (coalesce.spare_count >= SPARE_MAX) {
+        free(o);
+        return;
+    }
+    o->spare_next = coalesce.spare;
+    coalesce.spare = o;
+    coalesce.spare_count++;
+}
+
+// Saca el primero de la cola de pendientes (con el mutex tomado)
+static void unlink_head(void) {
+    Outbox *o = coalesce.outboxes[coalesce.head];
+    coalesce.head = o->next;
+    if (coalesce.head < 0) coalesce.tail = -1;
+    o->listed = 0;
+    o->next = -1;
+}
+
+static void *coalesce_thread(void *arg) {
+    (void)arg;
+    stats_register_thread("agrupador");
+    pthread_mutex_lock(&coalesce.mutex);
+    
+    while (coalesce.running) {
+        if (coalesce.head < 0) {
+            pthread_cond_wait(&coalesce.cond, &coalesce.mutex);
+            continue;
+        }
+        
+        // Los plazos vencen en el orden en que llegaron los primeros
+        Outbox *o = coalesce.outboxes[coalesce.head];
+        uint64_t deadline = o->first_us + (uint64_t)coalesce.budget_us;
+        uint64_t now = now_us();
+        if (o->count > 0 && now < deadline) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            uint64_t wait_ns = (deadline - now) * 1000 + (uint64_t)ts.tv_nsec;
+            ts.tv_sec += (time_t)(wait_ns / 1000000000ull);
+            ts.tv_nsec = (long)(wait_ns % 1000000000ull);
+            pthread_cond_timedwait(&coalesce.cond, &coalesce.mutex, &ts);
+            continue;
+        }
+        
+        int sockfd = coalesce.head;
+        unlink_head();
+        flush_outbox(sockfd, o, 0);
+        outbox_put(sockfd);
+    }
+    
+    // Al detenerse sale todo lo que quedó
+    while (coalesce.head >= 0) {
+        int sockfd = coalesce.head;
+        Outbox *o = coalesce.outboxes[sockfd];
+        unlink_head();
+        flush_outbox(sockfd, o, 0);
+        outbox_put(sockfd);
+    }
+    
+    pthread_mutex_unlock(&coalesce.mutex);
+    return NULL;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int coalesce_start(int budget_ms, CoalesceSendFn send) {
+    struct rlimit rl;
+    
+    pthread_mutex_lock(&coalesce.mutex);
+    if (!coalesce.outboxes) {
+        if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+            pthread_mutex_unlock(&coalesce.mutex);
+            return -1;
+        }
+        coalesce.size = rl.rlim_cur == RLIM_INFINITY ? 65536 : (int)rl.rlim_cur;
+        coalesce.outboxes = calloc((size_t)coalesce.size, sizeof(Outbox *));
+        if (!coalesce.outboxes) {
+            pthread_mutex_unlock(&coalesce.mutex);
+            return -1;
+        }
+    }
+    coalesce.send = send;
+    __atomic_store_n(&coalesce.budget_us, (budget_ms > 0 ? budget_ms : 0) * 1000, __ATOMIC_RELAXED);
+    coalesce.stats.budget_ms = budget_ms > 0 ? budget_ms : 0;
+    __atomic_store_n(&coalesce.running, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&coalesce.mutex);
+    
+    if (pthread_create(&coalesce.thread, NULL, coalesce_thread, NULL) != 0) {
+        coalesce.running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void coalesce_stop(void) {
+    pthread_mutex_lock(&coalesce.mutex);
+    if (!coalesce.running) {
+        pthread_mutex_unlock(&coalesce.mutex);
+        return;
+    }
+    __atomic_store_n(&coalesce.running, 0, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&coalesce.cond);
+    pthread_mutex_unlock(&coalesce.mutex);
+    
+    pthread_join(coalesce.thread, NULL);
+}
+
+void coalesce_set_budget(int budget_ms) {
+    pthread_mutex_lock(&coalesce.mutex);
+    __atomic_store_n(&coalesce.budget_us, (budget_ms > 0 ? budget_ms : 0) * 1000, __ATOMIC_RELAXED);
+    coalesce.stats.budget_ms = budget_ms > 0 ? budget_ms : 0;
+    pthread_cond_broadcast(&coalesce.cond);
+    pthread_mutex_unlock(&coalesce.mutex);
+}
+
+int coalesce_enabled(void) {
+    return __atomic_load_n(&coalesce.budget_us, __ATOMIC_RELAXED) > 0 &&
+           __atomic_load_n(&coalesce.running, __ATOMIC_RELAXED);
+}
+
+CoalesceMsg *coalesce_msg_new(const struct iovec *iov, int count) {
+    size_t len = 0;
+    for (int i = 0; i < count; i++) len += iov[i].iov_len;
+    
+    CoalesceMsg *msg = malloc(sizeof(CoalesceMsg) + len);
+    if (!msg) return NULL;
+    
+    msg->refs = 1;
+    msg->len = len;
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(msg->data + offset, iov[i].iov_base, iov[i].iov_len);
+        offset += iov[i].iov_len;
+    }
+    return msg;
+}
+
+void coalesce_msg_release(CoalesceMsg *msg) {
+    if (msg && __atomic_sub_fetch(&msg->refs, 1, __ATOMIC_ACQ_REL) == 0) free(msg);
+}
+
+int coalesce_queue(int sockfd, CoalesceMsg *msg) {
+    if (sockfd < 0 || sockfd >= coalesce.size) return -1;
+    
+    pthread_mutex_lock(&coalesce.mutex);
+    if (!coalesce.running) {
+        pthread_mutex_unlock(&coalesce.mutex);
+        return -1;
+    }
+    
+    Outbox *o = coalesce.outboxes[sockfd];
+    if (!o) {
+        o = outbox_get();
+        if (!o) {
+            pthread_mutex_unlock(&coalesce.mutex);
+            return -1;
+        }
+        coalesce.outboxes[sockfd] = o;
+    }
+    
+    // Cola llena: vaciarla ya, sin esperar el plazo
+    if (o->count == COALESCE_MAX_BATCH || o->bytes + msg->len > COALESCE_MAX_BYTES) {
+        flush_outbox(sockfd, o, 1);
+    }
+    
+    __atomic_add_fetch(&msg->refs, 1, __ATOMIC_RELAXED);
+    o->msgs[o->count++] = msg;
+    o->bytes += msg->len;
+    
+    // Si ya está en la cola de pendientes conserva su lugar y su plazo
+    // (aunque se haya vaciado antes: sale antes, nunca después)
+    if (!o->listed) {
+        o->first_us = now_us();
+        o->listed = 1;
+        o->next = -1;
+        if (coalesce.tail >= 0) coalesce.outboxes[coalesce.tail]->next = sockfd;
+        else coalesce.head = sockfd;
+        coalesce.tail = sockfd;
+        if (coalesce.head == sockfd) pthread_cond_signal(&coalesce.cond);
+    }
+    
+    pthread_mutex_unlock(&coalesce.mutex);
+    return 0;
+}
+
+void coalesce_forget(int sockfd) {
+    if (sockfd < 0 || sockfd >= coalesce.size) return;
+    
+    pthread_mutex_lock(&coalesce.mutex);
+    Outbox *o = coalesce.outboxes[sockfd];
+    if (o && o->count > 0) {
+        coalesce.stats.discarded += (uint64_t)o->count;
+        for (int i = 0; i < o->count; i++) coalesce_msg_release(o->msgs[i]);
+        o->count = 0;
+        o->bytes = 0;
+    }
+    // Si está en la cola de pendientes la devuelve el thread al llegar a ella
+    if (o && !o->listed) outbox_put(sockfd);
+    pthread_mutex_unlock(&coalesce.mutex);
+}
+
+void coalesce_get_stats(CoalesceStats *out) {
+    pthread_mutex_lock(&coalesce.mutex);
+    *out = coalesce.stats;
+    out->outbox_bytes = coalesce.stats.outboxes * sizeof(Outbox);
+    out->table_bytes = coalesce.outboxes ? (uint64_t)coalesce.size * sizeof(Outbox *) : 0;
+    pthread_mutex_unlock(&coalesce.mutex);
+}
@@ -0,0 +1,107 @@
+// ============================================================================
+// coalesce.h - Agrupado de los mensajes de cada destinatario por plazo
+// ============================================================================
+// En una ráfaga cada /broadcast hace un send() por cliente: N mensajes a M
+// clientes son N×M llamadas y segmentos TCP chicos. Con --coalesce-ms los
+// broadcasts y los avisos de /watch no se envían en el momento: se encolan
+// por destinatario y un thread los vacía con un solo writev cuando el
+// primero cumple el plazo (o antes, si se juntan COALESCE_MAX_BATCH). Un
+// broadcast se copia una vez y lo comparten todas las colas.
+//
+// Las respuestas a los comandos y los privados no pasan por acá: salen en
+// el momento por su carril (ver lanes.h), y lo agrupado por el de masivos.
+// ============================================================================
+
+#ifndef COALESCE_H
+#define COALESCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define COALESCE_MAX_BATCH 64            // Mensajes por writev (muy por debajo de IOV_MAX)
+#define COALESCE_MAX_BYTES (64 * 1024)   // Bytes encolados por destinatario antes de vaciar
+#define COALESCE_MAX_MS 1000
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct CoalesceMsg CoalesceMsg;
+
+// Envía fragmentos al cliente por su transporte (client_sendiov del servidor)
+typedef ssize_t (*CoalesceSendFn)(int sockfd, const struct iovec *iov, int count, size_t len);
+
+typedef struct {
+    int budget_ms;            // Plazo actual (0 = desactivado)
+    uint64_t msgs;            // Mensajes enviados agrupados
+    uint64_t flushes;         // writev hechos (msgs - flushes = envíos ahorrados)
+    uint64_t bytes;
+    uint64_t full_flushes;    // Vaciados antes del plazo por tamaño
+    uint64_t discarded;       // Encolados para una conexión que se cerró
+    uint64_t wait_us;         // Suma de lo que esperó el primero de cada writev
+    uint64_t max_batch;
+    uint64_t outboxes;        // Colas reservadas ahora (destinatarios con mensajes en camino)
+    uint64_t outbox_bytes;    // Memoria de esas colas
+    uint64_t table_bytes;     // Tabla de colas (un puntero por fd posible)
+} CoalesceStats;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Reserva la tabla de colas (una por fd posible) y arranca el thread que
+ * las vacía
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int coalesce_start(int budget_ms, CoalesceSendFn send);
+
+/**
+ * Envía todo lo encolado y detiene el thread
+ */
+void coalesce_stop(void);
+
+/**
+ * Cambia el plazo (0 = enviar en el momento; lo encolado sale enseguida)
+ */
+void coalesce_set_budget(int budget_ms);
+
+/**
+ * Retorna 1 si hay que encolar en lugar de enviar
+ */
+int coalesce_enabled(void);
+
+/**
+ * Copia un mensaje para encolarlo en uno o más destinatarios
+ * @return El mensaje (con una referencia de quien lo crea) o NULL sin memoria
+ */
+CoalesceMsg *coalesce_msg_new(const struct iovec *iov, int count);
+
+/**
+ * Suelta una referencia (NULL no hace nada)
+ */
+void coalesce_msg_release(CoalesceMsg *msg);
+
+/**
+ * Encola el mensaje para sockfd (toma su propia referencia)
+ * @return 0 si quedó encolado, -1 si hay que enviarlo directamente
+ */
+int coalesce_queue(int sockfd, CoalesceMsg *msg);
+
+/**
+ * Descarta lo encolado para sockfd (antes de cerrarlo: el fd se reutiliza)
+ */
+void coalesce_forget(int sockfd);
+
+/**
+ * Totales desde el arranque
+ */
+void coalesce_get_stats(CoalesceStats *out);
+
+#endif // COALESCE_H
@@ -3,9 +3,13 @@
 // ============================================================================
 
 #include "dashboard.h"
+#include "dashboard_shm.h"
+#include "timer_wheel.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
 #include <unistd.h>
 #include <termios.h>
 #include <sys/ioctl.h>
@@ -15,12 +19,49 @@
 // ============================================================================
 
 static struct termios orig_termios;
+static int raw_enabled = 0;
+
+// Fila del top de clientes (tasas calculadas entre dos refrescos)
+typedef struct {
+    char nick[NICK_SIZE];
+    int sockfd;
+    time_t connected_at;
+    double msgs_in_rate;
+    double msgs_out_rate;
+    double bytes_rate;      // Entrada + salida
+    uint64_t drops;
+    uint64_t idle_ms;
+} ClientRow;
+
+// Muestra anterior de cada lugar del registro y de cada thread
+typedef struct {
+    int sockfd;
+    time_t connected_at;
+    uint64_t bytes;
+    uint64_t msgs_in;
+    uint64_t msgs_out;
+} ClientSample;
+
+static DashboardSnapshot snapshot;  // Lo que se junta (o se lee con --attach)
+static ClientRow rows_buf[MAX_CLIENTS];
+static ClientSample client_prev[MAX_CLIENTS];
+static ThreadStats thread_prev[STATS_MAX_THREADS + 1];
+static int thread_prev_count = 0;
+static CoalesceStats coalesce_prev;
+static TransferStats transfer_prev;
+static LaneStats lanes_prev;
+static uint64_t prev_sample_ms = 0;
+static char sort_key = 'm';
+static int refresh_ms = DEFAULT_DASHBOARD_REFRESH_MS;
+static int busy_poll_us = 0;
 
 // ============================================================================
 // Implementación de funciones de terminal
 // ============================================================================
 
 void disable_raw_mode(void) {
+    if (!raw_enabled) return;  // Sin dashboard interactivo no hay nada que restaurar
+    raw_enabled = 0;
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
     printf(SHOW_CURSOR);
     fflush(stdout);
@@ -36,6 +77,7 @@ void enable_raw_mode(void) {
     raw.c_cc[VTIME] = 1;
     
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+    raw_enabled = 1;
     printf(HIDE_CURSOR);
     fflush(stdout);
 }
@@ -60,14 +102,11 @@ void log_message(MessageLog *message_log, const char *from_nick, const char *to_
     pthread_mutex_lock(&message_log->mutex);
     
     // Calcular el índice donde insertar el nuevo mensaje (buffer circular)
-    int insert_idx;
-    if (message_log->count < MAX_MESSAGE_LOG) {
-        // Aún hay espacio, insertar al final
-        insert_idx = message_log->count;
-    } else {
-        // Buffer lleno, sobrescribir el más antiguo
-        insert_idx = message_log->start;
+    int insert_idx = (message_log->start + message_log->count) % MAX_MESSAGE_LOG;
+    if (message_log->count >= message_log->depth) {
+        // Ya hay depth mensajes: el más antiguo deja de mostrarse
         message_log->start = (message_log->start + 1) % MAX_MESSAGE_LOG;
+        message_log->count--;
     }
     
     // Copiar datos del mensaje
@@ -81,11 +120,22 @@ void log_message(MessageLog *message_log, const char *from_nick, const char *to_
     message_log->messages[insert_idx].message[MAX_MESSAGE_CONTENT - 1] = '\0';
     
     message_log->messages[insert_idx].timestamp = time(NULL);
+    message_log->count++;
     
-    if (message_log->count < MAX_MESSAGE_LOG) {
-        message_log->count++;
-    }
+    pthread_mutex_unlock(&message_log->mutex);
+}
+
+void message_log_set_depth(MessageLog *message_log, int depth) {
+    if (depth < 1) depth = 1;
+    if (depth > MAX_MESSAGE_LOG) depth = MAX_MESSAGE_LOG;
     
+    pthread_mutex_lock(&message_log->mutex);
+    if (message_log->count > depth) {
+        // Conservar los más recientes
+        message_log->start = (message_log->start + message_log->count - depth) % MAX_MESSAGE_LOG;
+        message_log->count = depth;
+    }
+    message_log->depth = depth;
     pthread_mutex_unlock(&message_log->mutex);
 }
 
@@ -93,11 +143,120 @@ void log_message(MessageLog *message_log, const char *from_nick, const char *to_
 // Implementación del dashboard
 // ============================================================================
 
-void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int server_running) {
-    int rows, cols;
-    get_terminal_size(&rows, &cols);
+static const char *sort_name(void) {
+    switch (sort_key) {
+        case 'b': return "BYTES/S";
+        case 'd': return "DESCARTES";
+        case 'c': return "TIEMPO CONECTADO";
+        default: return "MENSAJES/S";
+    }
+}
+
+// Orden descendente según la columna elegida
+static int compare_rows(const void *a, const void *b) {
+    const ClientRow *ra = a;
+    const ClientRow *rb = b;
+    double ka, kb;
+    
+    switch (sort_key) {
+        case 'b':
+            ka = ra->bytes_rate;
+            kb = rb->bytes_rate;
+            break;
+        case 'd':
+            ka = (double)ra->drops;
+            kb = (double)rb->drops;
+            break;
+        case 'c':
+            ka = -(double)ra->connected_at;
+            kb = -(double)rb->connected_at;
+            break;
+        default:
+            ka = ra->msgs_in_rate + ra->msgs_out_rate;
+            kb = rb->msgs_in_rate + rb->msgs_out_rate;
+            break;
+    }
     
+    if (ka != kb) return ka < kb ? 1 : -1;
+    return ra->sockfd - rb->sockfd;
+}
+
+static void format_elapsed(char *out, size_t size, int elapsed) {
+    if (elapsed < 0) elapsed = 0;
+    snprintf(out, size, "%02d:%02d:%02d", elapsed / 3600, (elapsed % 3600) / 60, elapsed % 60);
+}
+
+void dashboard_set_refresh_ms(int ms) {
+    __atomic_store_n(&refresh_ms, ms > 0 ? ms : DEFAULT_DASHBOARD_REFRESH_MS, __ATOMIC_RELAXED);
+}
+
+void dashboard_set_busy_poll_us(int us) {
+    __atomic_store_n(&busy_poll_us, us, __ATOMIC_RELAXED);
+}
+
+int dashboard_set_sort(char key) {
+    if (key >= 'A' && key <= 'Z') key = key - 'A' + 'a';
+    if (key != 'm' && key != 'b' && key != 'd' && key != 'c') return 0;
+    sort_key = key;
+    return 1;
+}
+
+void dashboard_collect(DashboardSnapshot *snap, ClientList *client_list, MessageLog *message_log,
+                       int server_running) {
+    snap->sampled_ms = monotonic_ms();
+    snap->now = time(NULL);
+    snap->running = server_running;
+    snap->refresh_ms = __atomic_load_n(&refresh_ms, __ATOMIC_RELAXED);
+    snap->busy_poll_us = __atomic_load_n(&busy_poll_us, __ATOMIC_RELAXED);
+    
+    // Registro: solo se copian los contadores, sin imprimir con el mutex tomado
     pthread_mutex_lock(&client_list->mutex);
+    snap->client_count = client_list->count;
+    snap->client_limit = client_list->limit;
+    snap->row_count = 0;
+    
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientInfo *client = &client_list->clients[i];
+        if (!client->active) continue;
+        
+        DashboardClient *row = &snap->rows[snap->row_count++];
+        memset(row, 0, sizeof(*row));
+        memcpy(row->nick, client->nick, NICK_SIZE);
+        row->slot = i;
+        row->sockfd = client->sockfd;
+        row->connected_at = client->connected_at;
+        
+        const ConnStats *cs = stats_conn(client->sockfd);
+        if (!cs) continue;
+        
+        row->bytes = __atomic_load_n(&cs->in.bytes_in, __ATOMIC_RELAXED) +
+                     __atomic_load_n(&cs->out.bytes_out, __ATOMIC_RELAXED);
+        row->msgs_in = __atomic_load_n(&cs->in.msgs_in, __ATOMIC_RELAXED);
+        row->msgs_out = __atomic_load_n(&cs->out.msgs_out, __ATOMIC_RELAXED);
+        row->drops = __atomic_load_n(&cs->out.drops, __ATOMIC_RELAXED);
+        row->last_activity_ms = __atomic_load_n(&cs->in.last_activity_ms, __ATOMIC_RELAXED);
+    }
+    
+    pthread_mutex_unlock(&client_list->mutex);
+    
+    // Totales por thread, agrupado, transferencias y carriles (sin locks del registro)
+    snap->thread_count = stats_threads(snap->threads, STATS_MAX_THREADS + 1);
+    coalesce_get_stats(&snap->coalesce);
+    transfer_get_stats(&snap->transfers);
+    lanes_get_stats(&snap->lanes);
+    
+    // Log de mensajes, del más viejo al más reciente
+    pthread_mutex_lock(&message_log->mutex);
+    snap->log_count = message_log->count;
+    for (int i = 0; i < message_log->count; i++) {
+        snap->log[i] = message_log->messages[(message_log->start + i) % MAX_MESSAGE_LOG];
+    }
+    pthread_mutex_unlock(&message_log->mutex);
+}
+
+void dashboard_render(const DashboardSnapshot *snap, int attached) {
+    int rows, cols;
+    get_terminal_size(&rows, &cols);
     
     // Limpiar pantalla y mover cursor al inicio
     printf(CLEAR_SCREEN CURSOR_HOME);
@@ -108,7 +267,8 @@ void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int ser
     
     // Título
     printf(COLOR_GREEN BOLD);
-    printf("%-*s\n", cols, "    SERVIDOR MULTI-CLIENTE - DASHBOARD");
+    printf("%-*s\n", cols, attached ? "    SERVIDOR MULTI-CLIENTE - DASHBOARD (--attach)"
+                                    : "    SERVIDOR MULTI-CLIENTE - DASHBOARD");
     printf(RESET_COLOR);
     
     for (int i = 0; i < cols; i++) putchar('-');
@@ -116,58 +276,229 @@ void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int ser
     
     // Información del servidor
     printf(COLOR_YELLOW);
-    printf("  Clientes conectados: %d / %d\n", client_list->count, MAX_CLIENTS);
-    time_t now = time(NULL);
+    printf("  Clientes conectados: %d / %d\n", snap->client_count, snap->client_limit);
+    time_t now = snap->now;
     char time_str[64];
     strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&now));
     printf("  Hora actual: %s\n", time_str);
     printf(RESET_COLOR);
     
+    // Desde --attach: avisar si el servidor dejó de publicar
+    uint64_t age_ms = monotonic_ms() - snap->sampled_ms;
+    if (attached && snap->running && age_ms > 3 * (uint64_t)snap->refresh_ms) {
+        printf(COLOR_RED);
+        printf("  Sin datos nuevos hace %llu s\n", (unsigned long long)(age_ms / 1000));
+        printf(RESET_COLOR);
+    }
+    
     for (int i = 0; i < cols; i++) putchar('=');
     putchar('\n');
     
+    // Tasas desde la muestra anterior (la primera vez, desde la conexión)
+    uint64_t now_ms = snap->sampled_ms;
+    double dt = prev_sample_ms && now_ms > prev_sample_ms ? (now_ms - prev_sample_ms) / 1000.0 : 1.0;
+    
+    int row_count = 0;
+    for (int i = 0; i < snap->row_count; i++) {
+        const DashboardClient *client = &snap->rows[i];
+        if (client->slot < 0 || client->slot >= MAX_CLIENTS) continue;
+        ClientSample *prev = &client_prev[client->slot];
+        
+        // Un lugar reutilizado por otro cliente empieza de cero
+        if (prev->sockfd != client->sockfd || prev->connected_at != client->connected_at) {
+            memset(prev, 0, sizeof(*prev));
+            prev->sockfd = client->sockfd;
+            prev->connected_at = client->connected_at;
+        }
+        
+        ClientRow *row = &rows_buf[row_count++];
+        memset(row, 0, sizeof(*row));
+        memcpy(row->nick, client->nick, NICK_SIZE);
+        row->nick[NICK_SIZE - 1] = '\0';
+        row->sockfd = client->sockfd;
+        row->connected_at = client->connected_at;
+        
+        row->bytes_rate = (client->bytes - prev->bytes) / dt;
+        row->msgs_in_rate = (client->msgs_in - prev->msgs_in) / dt;
+        row->msgs_out_rate = (client->msgs_out - prev->msgs_out) / dt;
+        row->drops = client->drops;
+        row->idle_ms = client->last_activity_ms && now_ms > client->last_activity_ms
+                       ? now_ms - client->last_activity_ms : 0;
+        
+        prev->bytes = client->bytes;
+        prev->msgs_in = client->msgs_in;
+        prev->msgs_out = client->msgs_out;
+    }
+    
+    qsort(rows_buf, row_count, sizeof(ClientRow), compare_rows);
+    
     // Headers de la tabla
     printf(COLOR_CYAN BOLD);
-    printf("  %-4s  %-20s  %-10s  %-15s\n", 
-           "ID", "NICK", "SOCKET", "TIEMPO CONECTADO");
+    printf("  TOP %d POR %s  (orden: [m] mensajes/s  [b] bytes/s  [d] descartes  [c] conectado)\n",
+           DASHBOARD_TOP_N, sort_name());
+    printf("  %-20s  %-7s  %-10s  %9s  %9s  %9s  %9s  %-9s\n",
+           "NICK", "SOCKET", "CONECTADO", "ENTRA/s", "SALE/s", "KB/s", "DESCART.", "INACTIVO");
     printf(RESET_COLOR);
     
     for (int i = 0; i < cols; i++) putchar('-');
     putchar('\n');
     
     // Lista de clientes
-    if (client_list->count == 0) {
+    if (row_count == 0) {
         printf(COLOR_YELLOW);
         printf("  No hay clientes conectados\n");
         printf(RESET_COLOR);
     } else {
-        int client_num = 0;
+        int shown = row_count < DASHBOARD_TOP_N ? row_count : DASHBOARD_TOP_N;
+        
+        for (int i = 0; i < shown; i++) {
+            ClientRow *row = &rows_buf[i];
+            char conn_time[20];
+            char idle[20];
+            format_elapsed(conn_time, sizeof(conn_time), (int)difftime(now, row->connected_at));
+            format_elapsed(idle, sizeof(idle), (int)(row->idle_ms / 1000));
+            
+            printf(row->drops ? COLOR_RED : COLOR_WHITE);
+            printf("  %-20s  %-7d  %-10s  %9.1f  %9.1f  %9.1f  %9llu  %-9s\n",
+                   row->nick,
+                   row->sockfd,
+                   conn_time,
+                   row->msgs_in_rate,
+                   row->msgs_out_rate,
+                   row->bytes_rate / 1024.0,
+                   (unsigned long long)row->drops,
+                   idle);
+            printf(RESET_COLOR);
+        }
         
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (client_list->clients[i].active) {
-                client_num++;
-                
-                // Calcular tiempo conectado
-                int elapsed = (int)difftime(now, client_list->clients[i].connected_at);
-                int hours = elapsed / 3600;
-                int minutes = (elapsed % 3600) / 60;
-                int seconds = elapsed % 60;
-                
-                char conn_time[20];
-                snprintf(conn_time, sizeof(conn_time), "%02d:%02d:%02d", 
-                         hours, minutes, seconds);
-                
-                printf(COLOR_WHITE);
-                printf("  %-4d  %-20s  %-10d  %-15s\n", 
-                       client_num,
-                       client_list->clients[i].nick,
-                       client_list->clients[i].sockfd,
-                       conn_time);
-                printf(RESET_COLOR);
+        if (row_count > shown) {
+            printf(COLOR_YELLOW);
+            printf("  ... y %d clientes más\n", row_count - shown);
+            printf(RESET_COLOR);
+        }
+    }
+    
+    // Totales por thread (workers, acceptor y el resto juntos en "otros")
+    int thread_count = snap->thread_count;
+    ThreadStats total;
+    memset(&total, 0, sizeof(total));
+    
+    for (int i = 0; i < cols; i++) putchar('-');
+    putchar('\n');
+    printf(COLOR_CYAN BOLD);
+    printf("  %-20s  %9s  %9s  %9s  %9s  %9s\n",
+           "THREAD", "ENTRA/s", "SALE/s", "KB/s ENT.", "KB/s SAL.", "DESCART.");
+    printf(RESET_COLOR);
+    
+    for (int i = 0; i <= thread_count; i++) {
+        const ThreadStats *t = i < thread_count ? &snap->threads[i] : &total;
+        ThreadStats zero;
+        ThreadStats *prev = &zero;
+        memset(&zero, 0, sizeof(zero));
+        
+        if (i < thread_count) {
+            // "otros" siempre va al final: su lugar cambia al registrarse threads
+            if (i < thread_prev_count && strcmp(thread_prev[i].name, t->name) == 0) {
+                prev = &thread_prev[i];
             }
+            total.bytes_in += t->bytes_in;
+            total.msgs_in += t->msgs_in;
+            total.bytes_out += t->bytes_out;
+            total.msgs_out += t->msgs_out;
+            total.drops += t->drops;
+            total.spin_ns += t->spin_ns;
+            total.spin_hits += t->spin_hits;
+            total.sleeps += t->sleeps;
+            if (t->msgs_in == 0 && t->msgs_out == 0 && t->drops == 0) continue;
+        } else {
+            if (thread_count == 0) break;
+            strcpy(total.name, "TOTAL");
+            prev = &thread_prev[STATS_MAX_THREADS];
         }
+        
+        printf(i < thread_count ? COLOR_WHITE : BOLD);
+        printf("  %-20.*s  %9.1f  %9.1f  %9.1f  %9.1f  %9llu\n",
+               STATS_THREAD_NAME - 1, t->name,
+               (t->msgs_in - prev->msgs_in) / dt,
+               (t->msgs_out - prev->msgs_out) / dt,
+               (t->bytes_in - prev->bytes_in) / dt / 1024.0,
+               (t->bytes_out - prev->bytes_out) / dt / 1024.0,
+               (unsigned long long)t->drops);
+        printf(RESET_COLOR);
     }
     
+    // Giro de los workers (--busy-poll-us), solo si está o estuvo activo
+    const ThreadStats *tprev = &thread_prev[STATS_MAX_THREADS];
+    if (snap->busy_poll_us > 0 || total.spin_hits + total.sleeps > 0) {
+        uint64_t hits = total.spin_hits - tprev->spin_hits;
+        uint64_t waits = hits + (total.sleeps - tprev->sleeps);
+        printf(COLOR_CYAN);
+        printf("  BUSY-POLL (%d µs): %.0f%% de las esperas sin dormir · %.1f despertares evitados/s · "
+               "%.2f CPUs girando en vacío\n",
+               snap->busy_poll_us,
+               waits ? 100.0 * hits / waits : 0.0,
+               hits / dt,
+               (total.spin_ns - tprev->spin_ns) / dt / 1e9);
+        printf(RESET_COLOR);
+    }
+    
+    // Agrupado por destinatario (--coalesce-ms), solo si está o estuvo activo
+    const CoalesceStats *cst = &snap->coalesce;
+    if (cst->budget_ms > 0 || cst->flushes > 0) {
+        uint64_t msgs = cst->msgs - coalesce_prev.msgs;
+        uint64_t flushes = cst->flushes - coalesce_prev.flushes;
+        printf(COLOR_CYAN);
+        printf("  AGRUPADO (%d ms): %.1f mensajes por writev · %.1f envíos ahorrados/s · espera media %.2f ms\n",
+               cst->budget_ms,
+               flushes ? (double)msgs / flushes : 0.0,
+               (msgs - flushes) / dt,
+               flushes ? (cst->wait_us - coalesce_prev.wait_us) / 1000.0 / flushes : 0.0);
+        printf(RESET_COLOR);
+    }
+    coalesce_prev = *cst;
+    
+    // Archivos entre clientes (/send), solo si hubo alguno
+    const TransferStats *xst = &snap->transfers;
+    if (xst->offered > 0) {
+        printf(COLOR_CYAN);
+        printf("  ARCHIVOS: %d en curso (%.1f de %.1f MB, %.0f%%) · %.1f MB/s · %d esperando · "
+               "%llu completos · %llu cortados · %llu pausas del emisor\n",
+               xst->active,
+               xst->active_bytes / 1048576.0,
+               xst->active_size / 1048576.0,
+               xst->active_size ? 100.0 * xst->active_bytes / xst->active_size : 0.0,
+               (xst->bytes - transfer_prev.bytes) / dt / 1048576.0,
+               xst->waiting,
+               (unsigned long long)xst->completed,
+               (unsigned long long)xst->failed,
+               (unsigned long long)xst->throttled);
+        printf(RESET_COLOR);
+    }
+    transfer_prev = *xst;
+    
+    // Colas de salida, solo si algún cliente no dio abasto
+    const LaneStats *lst = &snap->lanes;
+    if (lst->queued[LANE_CONTROL] + lst->queued[LANE_PRIVATE] + lst->queued[LANE_BULK] > 0) {
+        uint64_t replies = lst->sent[LANE_CONTROL] - lanes_prev.sent[LANE_CONTROL];
+        uint64_t privates = lst->sent[LANE_PRIVATE] - lanes_prev.sent[LANE_PRIVATE];
+        printf(COLOR_CYAN);
+        printf("  CARRILES: %llu conexiones con cola (%.1f KB) · respuestas esperan %.2f ms · "
+               "privados %.2f ms · %.1f masivos descartados/s · %llu cortadas\n",
+               (unsigned long long)lst->congested,
+               lst->queued_bytes / 1024.0,
+               replies ? (lst->wait_us[LANE_CONTROL] - lanes_prev.wait_us[LANE_CONTROL]) / 1000.0 / replies : 0.0,
+               privates ? (lst->wait_us[LANE_PRIVATE] - lanes_prev.wait_us[LANE_PRIVATE]) / 1000.0 / privates : 0.0,
+               (lst->dropped - lanes_prev.dropped) / dt,
+               (unsigned long long)lst->cut);
+        printf(RESET_COLOR);
+    }
+    lanes_prev = *lst;
+    
+    memcpy(thread_prev, snap->threads, thread_count * sizeof(ThreadStats));
+    thread_prev[STATS_MAX_THREADS] = total;
+    thread_prev_count = thread_count;
+    prev_sample_ms = now_ms;
+    
     // Separador
     for (int i = 0; i < cols; i++) putchar('=');
     putchar('\n');
@@ -180,31 +511,14 @@ void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int ser
     for (int i = 0; i < cols; i++) putchar('-');
     putchar('\n');
     
-    pthread_mutex_unlock(&client_list->mutex);
-    
-    // Mostrar mensajes del log
-    pthread_mutex_lock(&message_log->mutex);
-    
-    if (message_log->count == 0) {
+    if (snap->log_count == 0) {
         printf(COLOR_YELLOW);
         printf("  No hay mensajes registrados\n");
         printf(RESET_COLOR);
     } else {
-        // Mostrar los mensajes más recientes primero
-        int num_messages = message_log->count < MAX_MESSAGE_LOG ? message_log->count : MAX_MESSAGE_LOG;
-        
         // Recorrer desde el más reciente al más antiguo
-        for (int i = num_messages - 1; i >= 0; i--) {
-            int idx;
-            if (message_log->count < MAX_MESSAGE_LOG) {
-                // Buffer no lleno aún
-                idx = i;
-            } else {
-                // Buffer circular lleno
-                idx = (message_log->start + i) % MAX_MESSAGE_LOG;
-            }
-            
-            MessageLogEntry *msg = &message_log->messages[idx];
+        for (int i = snap->log_count - 1; i >= 0; i--) {
+            const MessageLogEntry *msg = &snap->log[i];
             
             // Formatear timestamp
             char time_str[32];
@@ -212,7 +526,7 @@ void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int ser
             
             // Truncar mensaje si es muy largo
             char msg_preview[80];
-            if (strlen(msg->message) > 70) {
+            if (strnlen(msg->message, MAX_MESSAGE_CONTENT) > 70) {
                 strncpy(msg_preview, msg->message, 67);
                 msg_preview[67] = '.';
                 msg_preview[68] = '.';
@@ -224,25 +538,25 @@ void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int ser
             }
             
             printf(COLOR_WHITE);
-            printf("  [%s] %s > %s: %s\n", 
+            printf("  [%s] %.*s > %.*s: %s\n", 
                    time_str,
-                   msg->from_nick, 
-                   msg->to_nick, 
+                   NICK_SIZE, msg->from_nick, 
+                   NICK_SIZE, msg->to_nick, 
                    msg_preview);
             printf(RESET_COLOR);
         }
     }
     
-    pthread_mutex_unlock(&message_log->mutex);
-    
     // Separador inferior
     for (int i = 0; i < cols; i++) putchar('=');
     putchar('\n');
     
     // Mensaje de ayuda
-    if (server_running) {
+    if (snap->running) {
         printf(COLOR_YELLOW);
-        printf("  Presiona 'q' para salir | Actualización automática cada segundo\n");
+        int every = snap->refresh_ms;
+        printf("  Presiona 'q' para %s | m/b/d/c cambian el orden | Actualización cada %d.%d s\n",
+               attached ? "dejar de mirar" : "salir", every / 1000, (every % 1000) / 100);
         printf(RESET_COLOR);
     } else {
         printf(COLOR_RED BOLD);
@@ -256,6 +570,35 @@ void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int ser
     fflush(stdout);
 }
 
+// ============================================================================
+// Vista desde otro proceso (--attach)
+// ============================================================================
+
+int dashboard_attach(const char *name) {
+    DashboardShm shm;
+    if (dashboard_shm_open(&shm, name) < 0) return -1;
+    
+    enable_raw_mode();
+    
+    // Un upgrade conserva el PID: mientras viva se sigue mirando, aunque la
+    // última muestra diga que estaba cerrando
+    while (kill(dashboard_shm_pid(&shm), 0) == 0 || errno != ESRCH) {
+        if (dashboard_shm_read(&shm, &snapshot) == 0) dashboard_render(&snapshot, 1);
+        
+        char c;
+        if (read(STDIN_FILENO, &c, 1) == 1) {
+            if (c == 'q' || c == 'Q') break;
+            dashboard_set_sort(c);  // Se aplica en el próximo refresco
+        }
+        
+        int every = snapshot.refresh_ms > 0 ? snapshot.refresh_ms : DEFAULT_DASHBOARD_REFRESH_MS;
+        usleep((useconds_t)every * 1000);
+    }
+    
+    dashboard_shm_close(&shm, 1);
+    return 0;
+}
+
 // ============================================================================
 // Thread del dashboard
 // ============================================================================
@@ -263,27 +606,36 @@ void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int ser
 void* dashboard_thread(void* arg) {
     DashboardThreadArgs *args = (DashboardThreadArgs*)arg;
     
-    enable_raw_mode();
+    if (args->interactive) enable_raw_mode();
     
     while (*args->server_running) {
-        refresh_dashboard(args->client_list, args->message_log, *args->server_running);
+        dashboard_collect(&snapshot, args->client_list, args->message_log, *args->server_running);
+        if (args->shm) dashboard_shm_publish(args->shm, &snapshot);
         
-        // Verificar si se presionó 'q'
-        char c;
-        if (read(STDIN_FILENO, &c, 1) == 1) {
-            if (c == 'q' || c == 'Q') {
-                args->shutdown_callback();
-                break;
+        if (args->interactive) {
+            dashboard_render(&snapshot, 0);
+            
+            // Verificar si se presionó 'q' o una tecla de orden
+            char c;
+            if (read(STDIN_FILENO, &c, 1) == 1) {
+                if (c == 'q' || c == 'Q') {
+                    args->shutdown_callback();
+                    break;
+                }
+                dashboard_set_sort(c);  // Se aplica en el próximo refresco
             }
         }
         
-        sleep(1);
+        usleep((useconds_t)__atomic_load_n(&refresh_ms, __ATOMIC_RELAXED) * 1000);
     }
     
     // Mostrar una última actualización indicando que está cerrando
-    refresh_dashboard(args->client_list, args->message_log, *args->server_running);
-    sleep(1);
+    dashboard_collect(&snapshot, args->client_list, args->message_log, *args->server_running);
+    if (args->shm) dashboard_shm_publish(args->shm, &snapshot);
+    if (args->interactive) {
+        dashboard_render(&snapshot, 0);
+        sleep(1);
+    }
     
     return NULL;
 }
-
@@ -7,15 +7,24 @@
 
 #include <time.h>
 #include <pthread.h>
+#include "stats.h"
+#include "coalesce.h"
+#include "transfer.h"
+#include "lanes.h"
 
 // ============================================================================
 // Constantes
 // ============================================================================
 
-#define MAX_CLIENTS 100
+#ifndef MAX_CLIENTS
+#define MAX_CLIENTS 100  // make microbench lo cambia para medir registros grandes
+#endif
 #define NICK_SIZE 32
-#define MAX_MESSAGE_LOG 10
+#define MAX_MESSAGE_LOG 100         // Capacidad del log; se muestran message_log.depth
+#define DEFAULT_MESSAGE_LOG_DEPTH 10
+#define DEFAULT_DASHBOARD_REFRESH_MS 1000
 #define MAX_MESSAGE_CONTENT 256
+#define DASHBOARD_TOP_N 10  // Clientes más activos que muestra la tabla
 
 // ============================================================================
 // Códigos ANSI para control de terminal
@@ -41,12 +50,16 @@ typedef struct {
     int sockfd;
     char nick[NICK_SIZE];
     int active;
+    int watching;          // Suscripto a los avisos de presencia (/watch)
     time_t connected_at;
+    struct Session *session;  // Sesión reanudable (/session); con sockfd -1 está desconectada
 } ClientInfo;
 
 typedef struct {
     ClientInfo clients[MAX_CLIENTS];
     int count;
+    int limit;             // Cupo actual (hasta MAX_CLIENTS), ajustable en caliente
+    int free_hint;         // No hay slots libres antes de este (add_client busca desde acá)
     pthread_mutex_t mutex;
 } ClientList;
 
@@ -59,11 +72,45 @@ typedef struct {
 
 typedef struct {
     MessageLogEntry messages[MAX_MESSAGE_LOG];
-    int count;  // Número total de mensajes registrados (puede ser > MAX_MESSAGE_LOG)
+    int count;  // Mensajes guardados (hasta depth)
     int start;  // Índice del mensaje más antiguo en el buffer circular
+    int depth;  // Mensajes que se conservan (hasta MAX_MESSAGE_LOG)
     pthread_mutex_t mutex;
 } MessageLog;
 
+// Contadores acumulados de un cliente (las tasas se calculan al dibujar)
+typedef struct {
+    char nick[NICK_SIZE];
+    int slot;              // Lugar en el registro: sigue al cliente entre muestras
+    int sockfd;
+    time_t connected_at;
+    uint64_t bytes;        // Entrada + salida
+    uint64_t msgs_in;
+    uint64_t msgs_out;
+    uint64_t drops;
+    uint64_t last_activity_ms;
+} DashboardClient;
+
+// Todo lo que dibuja el dashboard, copiado de una vez (ver dashboard_shm.h)
+typedef struct {
+    uint64_t sampled_ms;   // monotonic_ms() de la muestra
+    time_t now;
+    int running;
+    int refresh_ms;
+    int busy_poll_us;      // Giro de los workers antes de bloquearse (0 = no)
+    int client_count;
+    int client_limit;
+    int thread_count;
+    ThreadStats threads[STATS_MAX_THREADS + 1];
+    CoalesceStats coalesce;
+    TransferStats transfers;
+    LaneStats lanes;
+    int log_count;
+    MessageLogEntry log[MAX_MESSAGE_LOG];  // Del más viejo al más reciente
+    int row_count;
+    DashboardClient rows[MAX_CLIENTS];     // Al final: solo se publican las usadas
+} DashboardSnapshot;
+
 // ============================================================================
 // Funciones públicas
 // ============================================================================
@@ -89,12 +136,28 @@ void disable_raw_mode(void);
 int get_terminal_size(int *rows, int *cols);
 
 /**
- * Refresca y muestra el dashboard con información del servidor
+ * Copia los contadores del servidor en un snapshot (toma los mutex del
+ * registro y del log solo mientras copia)
+ * @param snap Snapshot a completar
  * @param client_list Puntero a la lista de clientes
  * @param message_log Puntero al log de mensajes
  * @param server_running Flag que indica si el servidor está corriendo
  */
-void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int server_running);
+void dashboard_collect(DashboardSnapshot *snap, ClientList *client_list, MessageLog *message_log,
+                       int server_running);
+
+/**
+ * Dibuja un snapshot; las tasas salen de la diferencia con el anterior
+ * @param attached 1 si se dibuja desde --attach ('q' cierra solo la vista)
+ */
+void dashboard_render(const DashboardSnapshot *snap, int attached);
+
+/**
+ * Cambia la columna por la que se ordena el top de clientes
+ * @param key 'm' mensajes/s, 'b' bytes/s, 'd' descartes, 'c' tiempo conectado
+ * @return 1 si la tecla corresponde a un orden, 0 si no
+ */
+int dashboard_set_sort(char key);
 
 /**
  * Registra un mensaje en el log del dashboard
@@ -105,9 +168,34 @@ void refresh_dashboard(ClientList *client_list, MessageLog *message_log, int ser
  */
 void log_message(MessageLog *message_log, const char *from_nick, const char *to_nick, const char *message);
 
+/**
+ * Cambia cuántos mensajes conserva el log (descarta los más viejos si sobran)
+ * @param depth Entre 1 y MAX_MESSAGE_LOG
+ */
+void message_log_set_depth(MessageLog *message_log, int depth);
+
+/**
+ * Cambia cada cuántos milisegundos se redibuja el dashboard
+ */
+void dashboard_set_refresh_ms(int ms);
+
+/**
+ * Informa el giro de los workers (--busy-poll-us) para la línea BUSY-POLL
+ */
+void dashboard_set_busy_poll_us(int us);
+
+/**
+ * Dibuja desde otro proceso el dashboard de un servidor que publica en el
+ * segmento name, hasta que se presiona 'q' o el servidor termina
+ * @return 0 al salir, -1 si el segmento no existe o es de otra versión
+ */
+int dashboard_attach(const char *name);
+
 /**
  * Thread principal del dashboard
- * Actualiza el dashboard cada segundo y detecta cuando se presiona 'q'
+ * Junta un snapshot por refresco y lo publica en el segmento compartido; si
+ * es interactivo además lo dibuja, detecta cuando se presiona 'q' y
+ * cambia el orden del top con las teclas de dashboard_set_sort()
  * @param arg Puntero a una estructura DashboardThreadArgs
  * @return NULL
  */
@@ -122,6 +210,8 @@ typedef struct {
     MessageLog *message_log;
     int *server_running;
     void (*shutdown_callback)(void);
+    struct DashboardShm *shm;  // Segmento donde publicar (NULL = no se publica)
+    int interactive;           // Dibujar en la terminal y leer teclas (0 con --no-dashboard)
 } DashboardThreadArgs;
 
 #endif // DASHBOARD_H
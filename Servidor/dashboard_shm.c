@@ -0,0 +1,178 @@
+// ============================================================================
+// dashboard_shm.c - Implementación del segmento compartido del dashboard
+// ============================================================================
+
+#include "dashboard_shm.h"
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+struct DashboardShmHeader {
+    uint32_t magic;
+    uint32_t seq;             // Seqlock: impar mientras el servidor escribe
+    pid_t pid;                // Proceso que publica (se conserva en un upgrade)
+    uint32_t snapshot_size;   // sizeof(DashboardSnapshot) del que publica
+    uint32_t max_clients;     // Cambia el tamaño de las filas (make microbench)
+};
+
+// El snapshot empieza en su propia línea de cache (ThreadStats está alineado)
+#define SNAPSHOT_OFFSET ((sizeof(DashboardShmHeader) + STATS_CACHE_LINE - 1) & ~(size_t)(STATS_CACHE_LINE - 1))
+#define SEGMENT_SIZE (SNAPSHOT_OFFSET + sizeof(DashboardSnapshot))
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+// Bytes usados de un snapshot: todo hasta las filas más las filas ocupadas
+static size_t used_size(int row_count) {
+    if (row_count < 0) row_count = 0;
+    if (row_count > MAX_CLIENTS) row_count = MAX_CLIENTS;
+    return offsetof(DashboardSnapshot, rows) + (size_t)row_count * sizeof(DashboardClient);
+}
+
+static int map_segment(DashboardShm *shm, const char *name, int writable) {
+    memset(shm, 0, sizeof(*shm));
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+    
+    int fd = shm_open(name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+    if (fd < 0) return -1;
+    
+    // El log lleva texto de los clientes: el segmento es solo del usuario del
+    // servidor. Uno de otro usuario (que ya existía o puesto a propósito) no
+    // se usa, y uno propio con otros permisos vuelve a 0600
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_uid != geteuid() ||
+        (writable && (st.st_mode & 0777) != 0600 && fchmod(fd, 0600) < 0)) {
+        close(fd);
+        errno = EACCES;
+        return -1;
+    }
+    
+    if (writable) {
+        if (ftruncate(fd, (off_t)SEGMENT_SIZE) < 0) {
+            close(fd);
+            return -1;
+        }
+    } else if ((size_t)st.st_size < SEGMENT_SIZE) {
+        close(fd);  // De otra versión o con otro MAX_CLIENTS
+        return -1;
+    }
+    
+    void *base = mmap(NULL, SEGMENT_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+    
+    shm->header = base;
+    shm->snapshot = (DashboardSnapshot *)((char *)base + SNAPSHOT_OFFSET);
+    shm->map_size = SEGMENT_SIZE;
+    return 0;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+void dashboard_shm_default_name(char *out, size_t size, int port) {
+    snprintf(out, size, "/servidor-%d", port);
+}
+
+int dashboard_shm_create(DashboardShm *shm, const char *name) {
+    if (map_segment(shm, name, 1) < 0) return -1;
+    
+    // Tras un upgrade el segmento ya existe: el seqlock sigue donde quedó
+    DashboardShmHeader *h = shm->header;
+    uint32_t seq = __atomic_load_n(&h->seq, __ATOMIC_RELAXED);
+    if (h->magic != DASHBOARD_SHM_MAGIC || (seq & 1)) {
+        __atomic_store_n(&h->seq, seq + (seq & 1), __ATOMIC_RELAXED);
+    }
+    h->pid = getpid();
+    h->snapshot_size = (uint32_t)sizeof(DashboardSnapshot);
+    h->max_clients = MAX_CLIENTS;
+    __atomic_store_n(&h->magic, DASHBOARD_SHM_MAGIC, __ATOMIC_RELEASE);
+    
+    shm->owner = 1;
+    return 0;
+}
+
+void dashboard_shm_publish(DashboardShm *shm, const DashboardSnapshot *snap) {
+    DashboardShmHeader *h = shm->header;
+    uint32_t seq = __atomic_load_n(&h->seq, __ATOMIC_RELAXED);
+    
+    __atomic_store_n(&h->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);  // Impar antes que cualquier dato
+    memcpy(shm->snapshot, snap, used_size(snap->row_count));
+    
+    // Los privados salen sin el texto: solo el dashboard propio lo muestra
+    for (int i = 0; i < snap->log_count && i < MAX_MESSAGE_LOG; i++) {
+        if (strcmp(snap->log[i].to_nick, "broadcast") != 0) {
+            snprintf(shm->snapshot->log[i].message, MAX_MESSAGE_CONTENT, "(privado)");
+        }
+    }
+    __atomic_store_n(&h->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+int dashboard_shm_open(DashboardShm *shm, const char *name) {
+    if (map_segment(shm, name, 0) < 0) return -1;
+    
+    DashboardShmHeader *h = shm->header;
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != DASHBOARD_SHM_MAGIC ||
+        h->snapshot_size != sizeof(DashboardSnapshot) || h->max_clients != MAX_CLIENTS) {
+        munmap(shm->header, shm->map_size);
+        shm->header = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int dashboard_shm_read(DashboardShm *shm, DashboardSnapshot *out) {
+    DashboardShmHeader *h = shm->header;
+    
+    for (int attempt = 0; attempt < DASHBOARD_SHM_RETRIES; attempt++) {
+        uint32_t seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            sched_yield();  // El servidor está copiando
+            continue;
+        }
+        
+        // Primero todo hasta las filas; la cantidad de filas viene ahí
+        memcpy(out, shm->snapshot, offsetof(DashboardSnapshot, rows));
+        size_t used = used_size(out->row_count);
+        memcpy((char *)out + offsetof(DashboardSnapshot, rows),
+               (const char *)shm->snapshot + offsetof(DashboardSnapshot, rows),
+               used - offsetof(DashboardSnapshot, rows));
+        
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);  // Los datos antes de releer seq
+        if (__atomic_load_n(&h->seq, __ATOMIC_RELAXED) != seq) continue;
+        
+        if (out->row_count < 0 || out->row_count > MAX_CLIENTS ||
+            out->thread_count < 0 || out->thread_count > STATS_MAX_THREADS + 1 ||
+            out->log_count < 0 || out->log_count > MAX_MESSAGE_LOG) {
+            return -1;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+pid_t dashboard_shm_pid(const DashboardShm *shm) {
+    return __atomic_load_n(&shm->header->pid, __ATOMIC_RELAXED);
+}
+
+void dashboard_shm_close(DashboardShm *shm, int keep) {
+    if (!shm->header) return;
+    
+    munmap(shm->header, shm->map_size);
+    shm->header = NULL;
+    shm->snapshot = NULL;
+    if (shm->owner && !keep) shm_unlink(shm->name);
+}
@@ -0,0 +1,91 @@
+// ============================================================================
+// dashboard_shm.h - Snapshot del dashboard publicado en memoria compartida
+// ============================================================================
+// El thread del dashboard junta una vez por refresco los contadores del
+// servidor (DashboardSnapshot) y los copia en un segmento POSIX
+// (/servidor-<puerto> por defecto) protegido por un seqlock: el contador
+// queda impar mientras se escribe y el lector repite la copia si cambió.
+// "servidor <puerto> --attach" mapea el segmento en solo lectura y dibuja
+// el mismo dashboard desde otro proceso: el servidor puede correr sin
+// terminal y cualquier cantidad de operadores lo miran sin tomar sus locks.
+// El segmento tiene modo 0600 y solo se usa si es del mismo usuario; los
+// /msg se publican sin el texto.
+//
+// Un upgrade (SIGUSR2) conserva el PID, así que el proceso nuevo publica
+// en el mismo segmento y los que están mirando no se enteran.
+// ============================================================================
+
+#ifndef DASHBOARD_SHM_H
+#define DASHBOARD_SHM_H
+
+#include "dashboard.h"
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define DASHBOARD_SHM_MAGIC 0x44534831   // "DSH1"
+#define DASHBOARD_SHM_NAME_SIZE 64
+#define DASHBOARD_SHM_RETRIES 100        // Copias que intenta el lector antes de rendirse
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct DashboardShmHeader DashboardShmHeader;  // Vive en el segmento
+
+// Vista local del segmento (cada proceso tiene la suya)
+typedef struct DashboardShm {
+    char name[DASHBOARD_SHM_NAME_SIZE];
+    DashboardShmHeader *header;
+    DashboardSnapshot *snapshot;  // Justo después del encabezado
+    size_t map_size;
+    int owner;                    // Lo creó este proceso (lo borra al cerrar)
+} DashboardShm;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Nombre por defecto del segmento del servidor que escucha en port
+ */
+void dashboard_shm_default_name(char *out, size_t size, int port);
+
+/**
+ * Servidor: crea el segmento (o reusa el de un proceso anterior tras un
+ * upgrade) y lo mapea para escribir
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int dashboard_shm_create(DashboardShm *shm, const char *name);
+
+/**
+ * Servidor: copia el snapshot bajo el seqlock (solo las filas usadas)
+ */
+void dashboard_shm_publish(DashboardShm *shm, const DashboardSnapshot *snap);
+
+/**
+ * Lector: mapea en solo lectura el segmento que publica otro proceso
+ * @return 0 si tiene éxito, -1 si no existe o es de otra versión
+ */
+int dashboard_shm_open(DashboardShm *shm, const char *name);
+
+/**
+ * Lector: copia un snapshot consistente sin bloquear al servidor
+ * @return 0 si tiene éxito, -1 si el escritor no lo dejó quieto tras
+ *         DASHBOARD_SHM_RETRIES intentos o el contenido es inválido
+ */
+int dashboard_shm_read(DashboardShm *shm, DashboardSnapshot *out);
+
+/**
+ * PID del proceso que publica (sirve para saber si sigue vivo)
+ */
+pid_t dashboard_shm_pid(const DashboardShm *shm);
+
+/**
+ * Desmapea; el servidor además borra el nombre si keep es 0 (un upgrade
+ * lo conserva para el proceso nuevo)
+ */
+void dashboard_shm_close(DashboardShm *shm, int keep);
+
+#endif // DASHBOARD_SHM_H
@@ -0,0 +1,854 @@
+// ============================================================================
+// federation.c - Implementación del modo federado
+// ============================================================================
+// Un único thread atiende todos los enlaces con epoll: acepta enlaces
+// entrantes, reintenta los salientes caídos, lee tramas y vacía los lotes.
+// Los workers solo encolan tramas en el buffer del enlace (con fed.mutex).
+// Los sockets no bloquean: lo que un nodo lento no acepta queda en el enlace
+// y sale con EPOLLOUT, sin frenar a los demás.
+// ============================================================================
+
+#define _GNU_SOURCE  // accept4(), pipe2()
+
+#include "federation.h"
+#include "timer_wheel.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#define FED_FRAME_SIZE (MAX_MSG_LENGTH + 128)  // "MSG <de> <para> " y el texto entero
+#define FED_RX_SIZE (2 * FED_FRAME_SIZE)
+#define FED_MAX_EVENTS 32
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+typedef struct {
+    int sockfd;
+    int outbound;                    // Lo inició este nodo
+    int connecting;                  // connect() no bloqueante en curso
+    int established;                 // Ya recibimos su HELLO
+    int peer_index;                  // Índice en config.peers o -1 si es entrante
+    char node_id[FED_NODE_ID_SIZE];
+    char rx[FED_RX_SIZE];            // Tramas a medio llegar (solo el thread)
+    size_t rx_len;
+    char *tx;                        // Lote pendiente (con fed.mutex)
+    size_t tx_len;
+    size_t tx_cap;
+    uint64_t tx_since;               // Cuándo se encoló la primera trama del lote
+    int overflow;                    // Pasó FED_LINK_MAX_BYTES: el thread lo corta
+    char *out;                       // Lote a medio enviar (solo el thread)
+    size_t out_len;
+    size_t out_off;
+    int want_out;                    // EPOLLOUT pedido en el epoll
+    int closed;
+    void *next_closed;               // Pendiente de liberar al final del ciclo
+} FederationLink;
+
+typedef struct {
+    char nick[NICK_SIZE];
+    time_t connected_at;
+} LocalClient;
+
+static struct {
+    int enabled;
+    volatile int running;
+    FederationConfig config;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    int epfd;
+    int listen_fd;
+    int wake_pipe[2];
+    FederationLink *links[FED_MAX_LINKS];
+    char peer_node_id[FED_MAX_PEERS][FED_NODE_ID_SIZE];  // Aprendido por HELLO
+    LocalClient *locals;
+    size_t local_count;
+    size_t local_cap;
+    RemoteClient *remotes;
+    size_t remote_count;
+    size_t remote_cap;
+    uint64_t presence_version;       // Cambia con cada alta o baja remota
+    FederationLink *closed_links;    // Pueden tener eventos pendientes en el lote
+} fed = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .epfd = -1,
+    .listen_fd = -1,
+    .wake_pipe = {-1, -1}
+};
+
+static char listen_tag;  // data.ptr del socket de escucha en el epoll
+
+// ============================================================================
+// Funciones auxiliares (llamar con fed.mutex tomado)
+// ============================================================================
+
+static void wake_thread(void) {
+    char c = 'w';
+    if (write(fed.wake_pipe[1], &c, 1) < 0) {
+        // El pipe lleno ya garantiza que el thread se va a despertar
+    }
+}
+
+// Agrega una trama al lote del enlace
+static void queue_frame(FederationLink *link, const char *fmt, ...) {
+    char frame[FED_FRAME_SIZE];
+    va_list ap;
+    
+    va_start(ap, fmt);
+    int len = vsnprintf(frame, sizeof(frame) - 1, fmt, ap);
+    va_end(ap);
+    if (len < 0) return;
+    if (len > (int)sizeof(frame) - 2) len = sizeof(frame) - 2;
+    frame[len++] = '\n';
+    
+    // Un nodo que no lee no acumula memoria sin límite: se corta el enlace y
+    // al reconectarse recibe el estado completo de nuevo
+    if (link->overflow) return;
+    if (link->tx_len + len > FED_LINK_MAX_BYTES) {
+        link->overflow = 1;
+        wake_thread();
+        return;
+    }
+    
+    if (link->tx_len + len > link->tx_cap) {
+        size_t cap = link->tx_cap ? link->tx_cap : 4096;
+        while (cap < link->tx_len + len) cap *= 2;
+        char *tx = realloc(link->tx, cap);
+        if (!tx) return;
+        link->tx = tx;
+        link->tx_cap = cap;
+    }
+    
+    int was_empty = link->tx_len == 0;
+    memcpy(link->tx + link->tx_len, frame, len);
+    link->tx_len += len;
+    
+    // Despertar al thread solo al abrir un lote o al completarlo
+    if (was_empty) {
+        link->tx_since = monotonic_ms();
+        wake_thread();
+    } else if (link->tx_len >= FED_BATCH_BYTES && link->tx_len - len < FED_BATCH_BYTES) {
+        wake_thread();
+    }
+}
+
+static FederationLink *find_link_by_node(const char *node_id) {
+    for (int i = 0; i < FED_MAX_LINKS; i++) {
+        FederationLink *l = fed.links[i];
+        if (l && l->established && strcmp(l->node_id, node_id) == 0) return l;
+    }
+    return NULL;
+}
+
+static void notify_presence(const RemoteClient *client, int joined) {
+    if (fed.config.presence_changed) {
+        fed.config.presence_changed(client->nick, client->node_id, joined);
+    }
+}
+
+static void remove_remotes_of(const char *node_id) {
+    size_t j = 0;
+    for (size_t i = 0; i < fed.remote_count; i++) {
+        if (strcmp(fed.remotes[i].node_id, node_id) != 0) {
+            fed.remotes[j++] = fed.remotes[i];
+        } else {
+            notify_presence(&fed.remotes[i], 0);
+        }
+    }
+    if (j != fed.remote_count) fed.presence_version++;
+    fed.remote_count = j;
+}
+
+static void add_remote(const char *nick, const char *node_id, time_t connected_at) {
+    for (size_t i = 0; i < fed.remote_count; i++) {
+        if (strcmp(fed.remotes[i].nick, nick) == 0 &&
+            strcmp(fed.remotes[i].node_id, node_id) == 0) {
+            return;  // Ya llegó por otro enlace
+        }
+    }
+    
+    if (fed.remote_count == fed.remote_cap) {
+        size_t cap = fed.remote_cap ? fed.remote_cap * 2 : 64;
+        RemoteClient *remotes = realloc(fed.remotes, cap * sizeof(RemoteClient));
+        if (!remotes) return;
+        fed.remotes = remotes;
+        fed.remote_cap = cap;
+    }
+    
+    RemoteClient *r = &fed.remotes[fed.remote_count++];
+    strncpy(r->nick, nick, NICK_SIZE - 1);
+    r->nick[NICK_SIZE - 1] = '\0';
+    strncpy(r->node_id, node_id, FED_NODE_ID_SIZE - 1);
+    r->node_id[FED_NODE_ID_SIZE - 1] = '\0';
+    r->connected_at = connected_at;
+    fed.presence_version++;
+    notify_presence(r, 1);
+}
+
+static void remove_remote(const char *nick, const char *node_id) {
+    for (size_t i = 0; i < fed.remote_count; i++) {
+        if (strcmp(fed.remotes[i].nick, nick) == 0 &&
+            strcmp(fed.remotes[i].node_id, node_id) == 0) {
+            notify_presence(&fed.remotes[i], 0);
+            fed.remotes[i] = fed.remotes[--fed.remote_count];
+            fed.presence_version++;
+            return;
+        }
+    }
+}
+
+// Compara la clave recibida sin cortar en el primer byte distinto
+static int secret_matches(const char *given) {
+    const char *want = fed.config.secret;
+    if (!want) return 1;
+    if (!given) return 0;
+    
+    size_t want_len = strlen(want);
+    size_t given_len = strlen(given);
+    unsigned char diff = want_len != given_len;
+    for (size_t i = 0; i < want_len; i++) {
+        diff |= (unsigned char)want[i] ^ (unsigned char)given[i < given_len ? i : 0];
+    }
+    return diff == 0;
+}
+
+// Encola el HELLO de este nodo (lleva la clave)
+static void queue_hello(FederationLink *link) {
+    if (fed.config.secret) queue_frame(link, "HELLO %s %s", fed.config.node_id, fed.config.secret);
+    else queue_frame(link, "HELLO %s", fed.config.node_id);
+}
+
+// Registra un enlace nuevo. Un saliente abre con su HELLO; uno entrante no
+// envía nada (ni la clave) hasta que el otro nodo se identifica (handle_hello)
+static FederationLink *add_link(int sockfd, int outbound, int connecting, int peer_index) {
+    int slot = -1;
+    for (int i = 0; i < FED_MAX_LINKS; i++) {
+        if (!fed.links[i]) {
+            slot = i;
+            break;
+        }
+    }
+    
+    FederationLink *link = slot >= 0 ? calloc(1, sizeof(FederationLink)) : NULL;
+    if (!link) {
+        close(sockfd);
+        return NULL;
+    }
+    
+    link->sockfd = sockfd;
+    link->outbound = outbound;
+    link->connecting = connecting;
+    link->peer_index = peer_index;
+    
+    struct epoll_event ev = {
+        .events = connecting ? (EPOLLIN | EPOLLOUT) : EPOLLIN,
+        .data.ptr = link
+    };
+    if (epoll_ctl(fed.epfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        close(sockfd);
+        free(link);
+        return NULL;
+    }
+    
+    fed.links[slot] = link;
+    
+    if (outbound) queue_hello(link);
+    
+    return link;
+}
+
+static void close_link(FederationLink *link) {
+    for (int i = 0; i < FED_MAX_LINKS; i++) {
+        if (fed.links[i] == link) fed.links[i] = NULL;
+    }
+    
+    // La presencia del nodo se borra solo si no queda otro enlace con él
+    if (link->established && !find_link_by_node(link->node_id)) {
+        remove_remotes_of(link->node_id);
+    }
+    
+    epoll_ctl(fed.epfd, EPOLL_CTL_DEL, link->sockfd, NULL);
+    close(link->sockfd);
+    free(link->tx);
+    link->tx = NULL;
+    link->tx_len = 0;
+    free(link->out);
+    link->out = NULL;
+    link->out_len = link->out_off = 0;
+    link->closed = 1;
+    link->next_closed = fed.closed_links;
+    fed.closed_links = link;
+}
+
+static void free_closed_links(void) {
+    pthread_mutex_lock(&fed.mutex);
+    while (fed.closed_links) {
+        FederationLink *link = fed.closed_links;
+        fed.closed_links = link->next_closed;
+        free(link);
+    }
+    pthread_mutex_unlock(&fed.mutex);
+}
+
+// ============================================================================
+// Enlaces: conexión, lectura y envío (thread de la federación)
+// ============================================================================
+
+static void dial_peer(int peer_index) {
+    char host[256];
+    const char *addr = fed.config.peers[peer_index];
+    const char *colon = strrchr(addr, ':');
+    if (!colon || colon == addr) return;
+    
+    size_t host_len = (size_t)(colon - addr);
+    if (host_len >= sizeof(host)) return;
+    memcpy(host, addr, host_len);
+    host[host_len] = '\0';
+    
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, colon + 1, &hints, &res) != 0) return;
+    
+    int sockfd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sockfd < 0) {
+        freeaddrinfo(res);
+        return;
+    }
+    
+    int rc = connect(sockfd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc < 0 && errno != EINPROGRESS) {
+        close(sockfd);
+        return;
+    }
+    
+    pthread_mutex_lock(&fed.mutex);
+    add_link(sockfd, 1, 1, peer_index);
+    pthread_mutex_unlock(&fed.mutex);
+}
+
+static void try_listen(void) {
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int yes = 1;
+    struct sockaddr_in addr;
+    
+    if (sockfd < 0) return;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(fed.config.listen_port);
+    // Sin clave cualquiera que llegue al puerto podría hacerse pasar por un
+    // nodo: solo se aceptan enlaces del mismo host
+    addr.sin_addr.s_addr = fed.config.secret ? htonl(INADDR_ANY) : htonl(INADDR_LOOPBACK);
+    
+    // Durante un upgrade el proceso anterior todavía tiene el puerto: reintentar
+    if (bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sockfd, 16) < 0) {
+        close(sockfd);
+        return;
+    }
+    
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &listen_tag };
+    epoll_ctl(fed.epfd, EPOLL_CTL_ADD, sockfd, &ev);
+    fed.listen_fd = sockfd;
+}
+
+// Reintenta los peers configurados que no tienen un enlace activo
+static void reconnect_peers(void) {
+    for (int i = 0; i < fed.config.peer_count; i++) {
+        int linked = 0;
+        
+        pthread_mutex_lock(&fed.mutex);
+        for (int j = 0; j < FED_MAX_LINKS && !linked; j++) {
+            FederationLink *l = fed.links[j];
+            if (!l) continue;
+            if (l->peer_index == i) linked = 1;
+            // El nodo puede estar enlazado por una conexión que inició él
+            if (fed.peer_node_id[i][0] && l->established &&
+                strcmp(l->node_id, fed.peer_node_id[i]) == 0) linked = 1;
+        }
+        pthread_mutex_unlock(&fed.mutex);
+        
+        if (!linked) dial_peer(i);
+    }
+}
+
+// HELLO: autentica e identifica el enlace y resuelve enlaces duplicados con
+// el mismo nodo (ambos se conectaron a la vez). Se conserva el que inició el
+// nodo de id menor, el mismo criterio en las dos puntas. Al enlace que queda
+// se le responde el HELLO (si es entrante) y se le envía la lista de nicks
+// locales.
+// Retorna 0 si el enlace actual se cerró.
+static int handle_hello(FederationLink *link, const char *node_id, const char *secret) {
+    pthread_mutex_lock(&fed.mutex);
+    
+    if (link->established) {
+        pthread_mutex_unlock(&fed.mutex);
+        return 1;
+    }
+    
+    // Clave incorrecta, o enlace consigo mismo (peer mal configurado)
+    if (!secret_matches(secret) || strcmp(node_id, fed.config.node_id) == 0) {
+        close_link(link);
+        pthread_mutex_unlock(&fed.mutex);
+        return 0;
+    }
+    
+    strncpy(link->node_id, node_id, FED_NODE_ID_SIZE - 1);
+    if (link->peer_index >= 0) {
+        strncpy(fed.peer_node_id[link->peer_index], node_id, FED_NODE_ID_SIZE - 1);
+    }
+    
+    FederationLink *other = find_link_by_node(node_id);
+    link->established = 1;
+    
+    if (other) {
+        const char *self = fed.config.node_id;
+        const char *winner = strcmp(self, node_id) < 0 ? self : node_id;
+        const char *link_initiator = link->outbound ? self : node_id;
+        const char *other_initiator = other->outbound ? self : node_id;
+        FederationLink *loser;
+        
+        if (strcmp(link_initiator, other_initiator) == 0) {
+            loser = other;  // Reconexión: el enlace viejo está muerto
+        } else {
+            loser = strcmp(link_initiator, winner) == 0 ? other : link;
+        }
+        
+        close_link(loser);
+        if (loser == link) {
+            pthread_mutex_unlock(&fed.mutex);
+            return 0;
+        }
+    }
+    
+    if (!link->outbound) queue_hello(link);
+    for (size_t i = 0; i < fed.local_count; i++) {
+        queue_frame(link, "JOIN %s %ld", fed.locals[i].nick, (long)fed.locals[i].connected_at);
+    }
+    
+    pthread_mutex_unlock(&fed.mutex);
+    return 1;
+}
+
+// Procesa una trama recibida. Retorna 0 si el enlace se cerró.
+static int handle_frame(FederationLink *link, char *frame) {
+    char *saveptr = NULL;
+    char *type = strtok_r(frame, " ", &saveptr);
+    if (!type) return 1;
+    
+    if (strcmp(type, "HELLO") == 0) {
+        char *node_id = strtok_r(NULL, " ", &saveptr);
+        char *secret = strtok_r(NULL, " ", &saveptr);
+        return node_id ? handle_hello(link, node_id, secret) : 1;
+    }
+    
+    if (!link->established) return 1;  // Nada antes del HELLO
+    
+    if (strcmp(type, "JOIN") == 0) {
+        char *nick = strtok_r(NULL, " ", &saveptr);
+        char *since = strtok_r(NULL, " ", &saveptr);
+        if (nick) {
+            pthread_mutex_lock(&fed.mutex);
+            add_remote(nick, link->node_id, since ? (time_t)atol(since) : time(NULL));
+            pthread_mutex_unlock(&fed.mutex);
+        }
+    } else if (strcmp(type, "PART") == 0) {
+        char *nick = strtok_r(NULL, " ", &saveptr);
+        if (nick) {
+            pthread_mutex_lock(&fed.mutex);
+            remove_remote(nick, link->node_id);
+            pthread_mutex_unlock(&fed.mutex);
+        }
+    } else if (strcmp(type, "MSG") == 0) {
+        char *from = strtok_r(NULL, " ", &saveptr);
+        char *to = strtok_r(NULL, " ", &saveptr);
+        if (from && to && saveptr && fed.config.deliver_private) {
+            fed.config.deliver_private(from, to, saveptr);
+        }
+    } else if (strcmp(type, "BCAST") == 0) {
+        char *from = strtok_r(NULL, " ", &saveptr);
+        if (from && saveptr && fed.config.deliver_broadcast) {
+            fed.config.deliver_broadcast(from, saveptr);
+        }
+    }
+    
+    return 1;
+}
+
+static void handle_link_readable(FederationLink *link) {
+    ssize_t bytes = recv(link->sockfd, link->rx + link->rx_len,
+                         sizeof(link->rx) - link->rx_len - 1, 0);
+    if (bytes <= 0) {
+        if (bytes < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        pthread_mutex_lock(&fed.mutex);
+        close_link(link);
+        pthread_mutex_unlock(&fed.mutex);
+        return;
+    }
+    
+    link->rx_len += (size_t)bytes;
+    
+    char *start = link->rx;
+    char *end = link->rx + link->rx_len;
+    char *newline;
+    while ((newline = memchr(start, '\n', end - start)) != NULL) {
+        *newline = '\0';
+        if (!handle_frame(link, start)) return;
+        start = newline + 1;
+    }
+    
+    // Conservar la trama incompleta; si no entra en el buffer, descartarla
+    link->rx_len = (size_t)(end - start);
+    if (link->rx_len >= sizeof(link->rx) - 1) {
+        link->rx_len = 0;
+    } else {
+        memmove(link->rx, start, link->rx_len);
+    }
+}
+
+// El connect() no bloqueante terminó
+static void handle_link_connected(FederationLink *link) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    
+    getsockopt(link->sockfd, SOL_SOCKET, SO_ERROR, &err, &len);
+    
+    pthread_mutex_lock(&fed.mutex);
+    if (err != 0) {
+        close_link(link);
+    } else {
+        link->connecting = 0;
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = link };
+        epoll_ctl(fed.epfd, EPOLL_CTL_MOD, link->sockfd, &ev);
+    }
+    pthread_mutex_unlock(&fed.mutex);
+}
+
+// Pide EPOLLOUT solo mientras quede un lote a medio enviar
+static void watch_output(FederationLink *link, int want) {
+    if (link->want_out == want) return;
+    
+    struct epoll_event ev = { .events = want ? (EPOLLIN | EPOLLOUT) : EPOLLIN, .data.ptr = link };
+    epoll_ctl(fed.epfd, EPOLL_CTL_MOD, link->sockfd, &ev);
+    link->want_out = want;
+}
+
+// Escribe lo que el socket acepte del lote en curso, sin bloquear.
+// Retorna -1 si el enlace se cayó.
+static int send_pending(FederationLink *link) {
+    while (link->out_off < link->out_len) {
+        ssize_t n = send(link->sockfd, link->out + link->out_off, link->out_len - link->out_off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) return -1;
+        link->out_off += (size_t)n;
+    }
+    
+    if (link->out_off == link->out_len) {
+        free(link->out);
+        link->out = NULL;
+        link->out_len = link->out_off = 0;
+    }
+    watch_output(link, link->out != NULL);
+    return 0;
+}
+
+// Envía los lotes vencidos o completos. Retorna los ms hasta el próximo vencimiento.
+static int flush_links(uint64_t now) {
+    int next = -1;
+    
+    for (int i = 0; i < FED_MAX_LINKS; i++) {
+        pthread_mutex_lock(&fed.mutex);
+        FederationLink *link = fed.links[i];
+        if (link && link->overflow) {
+            close_link(link);
+            pthread_mutex_unlock(&fed.mutex);
+            continue;
+        }
+        // Con un lote a medio enviar, el resto se junta hasta que salga (EPOLLOUT)
+        if (!link || link->connecting || link->out || link->tx_len == 0) {
+            pthread_mutex_unlock(&fed.mutex);
+            continue;
+        }
+        
+        uint64_t due = link->tx_since + FED_BATCH_DELAY_MS;
+        if (link->tx_len < FED_BATCH_BYTES && now < due) {
+            int wait = (int)(due - now);
+            if (next < 0 || wait < next) next = wait;
+            pthread_mutex_unlock(&fed.mutex);
+            continue;
+        }
+        
+        // Tomar el lote y escribirlo sin el lock: los workers siguen encolando
+        link->out = link->tx;
+        link->out_len = link->tx_len;
+        link->out_off = 0;
+        link->tx = NULL;
+        link->tx_len = 0;
+        link->tx_cap = 0;
+        pthread_mutex_unlock(&fed.mutex);
+        
+        if (send_pending(link) < 0) {
+            pthread_mutex_lock(&fed.mutex);
+            close_link(link);
+            pthread_mutex_unlock(&fed.mutex);
+        }
+    }
+    
+    return next;
+}
+
+static void *federation_thread(void *arg) {
+    (void)arg;
+    struct epoll_event events[FED_MAX_EVENTS];
+    uint64_t next_reconnect = 0;
+    
+    while (fed.running) {
+        uint64_t now = monotonic_ms();
+        
+        if (now >= next_reconnect) {
+            if (fed.listen_fd < 0 && fed.config.listen_port > 0) try_listen();
+            reconnect_peers();
+            next_reconnect = now + FED_RECONNECT_MS;
+        }
+        
+        int timeout = flush_links(now);
+        int until_reconnect = (int)(next_reconnect - now);
+        if (timeout < 0 || until_reconnect < timeout) timeout = until_reconnect;
+        
+        int n = epoll_wait(fed.epfd, events, FED_MAX_EVENTS, timeout);
+        for (int i = 0; i < n && fed.running; i++) {
+            void *ptr = events[i].data.ptr;
+            
+            if (ptr == NULL) {
+                char drain[64];
+                while (read(fed.wake_pipe[0], drain, sizeof(drain)) > 0) {}
+            } else if (ptr == &listen_tag) {
+                int sockfd = accept4(fed.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (sockfd >= 0) {
+                    pthread_mutex_lock(&fed.mutex);
+                    add_link(sockfd, 0, 0, -1);
+                    pthread_mutex_unlock(&fed.mutex);
+                }
+            } else {
+                FederationLink *link = (FederationLink *)ptr;
+                if (link->closed) continue;
+                if (link->connecting) {
+                    handle_link_connected(link);
+                    continue;
+                }
+                
+                if ((events[i].events & EPOLLOUT) && link->out && send_pending(link) < 0) {
+                    pthread_mutex_lock(&fed.mutex);
+                    close_link(link);
+                    pthread_mutex_unlock(&fed.mutex);
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) handle_link_readable(link);
+            }
+        }
+        
+        free_closed_links();
+    }
+    
+    return NULL;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int federation_start(const FederationConfig *config) {
+    fed.config = *config;
+    
+    fed.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (fed.epfd < 0 || pipe2(fed.wake_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        perror("federación");
+        return -1;
+    }
+    
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(fed.epfd, EPOLL_CTL_ADD, fed.wake_pipe[0], &ev);
+    
+    fed.enabled = 1;
+    fed.running = 1;
+    if (pthread_create(&fed.thread, NULL, federation_thread, NULL) != 0) {
+        fed.enabled = 0;
+        fed.running = 0;
+        return -1;
+    }
+    
+    return 0;
+}
+
+void federation_stop(void) {
+    if (!fed.enabled) return;
+    
+    fed.running = 0;
+    wake_thread();
+    pthread_join(fed.thread, NULL);
+    
+    pthread_mutex_lock(&fed.mutex);
+    for (int i = 0; i < FED_MAX_LINKS; i++) {
+        if (fed.links[i]) close_link(fed.links[i]);
+    }
+    fed.enabled = 0;
+    pthread_mutex_unlock(&fed.mutex);
+    free_closed_links();
+    
+    if (fed.listen_fd >= 0) close(fed.listen_fd);
+    close(fed.wake_pipe[0]);
+    close(fed.wake_pipe[1]);
+    close(fed.epfd);
+    free(fed.locals);
+    free(fed.remotes);
+    
+    // Dejar el módulo listo para otro federation_start() (upgrade fallido)
+    fed.listen_fd = -1;
+    fed.epfd = -1;
+    fed.wake_pipe[0] = fed.wake_pipe[1] = -1;
+    fed.locals = NULL;
+    fed.local_count = fed.local_cap = 0;
+    fed.remotes = NULL;
+    fed.remote_count = fed.remote_cap = 0;
+    fed.presence_version++;
+    memset(fed.peer_node_id, 0, sizeof(fed.peer_node_id));
+}
+
+int federation_enabled(void) {
+    return fed.enabled;
+}
+
+void federation_local_join(const char *nick, time_t connected_at) {
+    if (!fed.enabled) return;
+    
+    pthread_mutex_lock(&fed.mutex);
+    
+    if (fed.local_count == fed.local_cap) {
+        size_t cap = fed.local_cap ? fed.local_cap * 2 : 64;
+        LocalClient *locals = realloc(fed.locals, cap * sizeof(LocalClient));
+        if (!locals) {
+            pthread_mutex_unlock(&fed.mutex);
+            return;
+        }
+        fed.locals = locals;
+        fed.local_cap = cap;
+    }
+    
+    LocalClient *c = &fed.locals[fed.local_count++];
+    strncpy(c->nick, nick, NICK_SIZE - 1);
+    c->nick[NICK_SIZE - 1] = '\0';
+    c->connected_at = connected_at;
+    
+    // Delta a los enlaces identificados (los demás lo reciben en el estado
+    // inicial cuando llegue su HELLO)
+    for (int i = 0; i < FED_MAX_LINKS; i++) {
+        if (fed.links[i] && fed.links[i]->established) {
+            queue_frame(fed.links[i], "JOIN %s %ld", c->nick, (long)connected_at);
+        }
+    }
+    
+    pthread_mutex_unlock(&fed.mutex);
+}
+
+void federation_local_part(const char *nick) {
+    if (!fed.enabled) return;
+    
+    pthread_mutex_lock(&fed.mutex);
+    
+    for (size_t i = 0; i < fed.local_count; i++) {
+        if (strcmp(fed.locals[i].nick, nick) == 0) {
+            fed.locals[i] = fed.locals[--fed.local_count];
+            for (int j = 0; j < FED_MAX_LINKS; j++) {
+                if (fed.links[j] && fed.links[j]->established) queue_frame(fed.links[j], "PART %s", nick);
+            }
+            break;
+        }
+    }
+    
+    pthread_mutex_unlock(&fed.mutex);
+}
+
+int federation_send_private(const char *from, const char *to, const char *text) {
+    int routed = -1;
+    
+    if (!fed.enabled) return -1;
+    
+    pthread_mutex_lock(&fed.mutex);
+    for (size_t i = 0; i < fed.remote_count; i++) {
+        if (strcmp(fed.remotes[i].nick, to) == 0) {
+            FederationLink *link = find_link_by_node(fed.remotes[i].node_id);
+            if (link) {
+                queue_frame(link, "MSG %s %s %s", from, to, text);
+                routed = 0;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&fed.mutex);
+    
+    return routed;
+}
+
+int federation_broadcast(const char *from, const char *text) {
+    int recipients;
+    
+    if (!fed.enabled) return 0;
+    
+    pthread_mutex_lock(&fed.mutex);
+    for (int i = 0; i < FED_MAX_LINKS; i++) {
+        if (fed.links[i] && fed.links[i]->established) {
+            queue_frame(fed.links[i], "BCAST %s %s", from, text);
+        }
+    }
+    recipients = (int)fed.remote_count;
+    pthread_mutex_unlock(&fed.mutex);
+    
+    return recipients;
+}
+
+int federation_remote_count(void) {
+    int count;
+    
+    if (!fed.enabled) return 0;
+    
+    pthread_mutex_lock(&fed.mutex);
+    count = (int)fed.remote_count;
+    pthread_mutex_unlock(&fed.mutex);
+    
+    return count;
+}
+
+void federation_for_each_remote(void (*fn)(const RemoteClient *client, void *ctx), void *ctx) {
+    if (!fed.enabled) return;
+    
+    pthread_mutex_lock(&fed.mutex);
+    for (size_t i = 0; i < fed.remote_count; i++) {
+        fn(&fed.remotes[i], ctx);
+    }
+    pthread_mutex_unlock(&fed.mutex);
+}
+
+uint64_t federation_presence_version(void) {
+    uint64_t version;
+    
+    pthread_mutex_lock(&fed.mutex);
+    version = fed.presence_version;
+    pthread_mutex_unlock(&fed.mutex);
+    
+    return version;
+}
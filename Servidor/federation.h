@@ -0,0 +1,119 @@
+// ============================================================================
+// federation.h - Modo federado: varios servidores enlazados en malla
+// ============================================================================
+// Cada nodo mantiene conexiones TCP persistentes con los demás (malla
+// completa). Por los enlaces viajan tramas de texto terminadas en '\n':
+//
+//   HELLO <nodo> [clave]             Identificación al abrir el enlace
+//   JOIN <nick> <conectado_desde>    Delta de presencia: alta
+//   PART <nick>                      Delta de presencia: baja
+//   MSG <de> <para> <texto>          /msg para un nick de ese nodo
+//   BCAST <de> <texto>               /broadcast, una vez por nodo
+//
+// Las tramas se acumulan por enlace y se envían en lotes. Hasta recibir un
+// HELLO válido no se envía ni se acepta nada más por el enlace.
+// ============================================================================
+
+#ifndef FEDERATION_H
+#define FEDERATION_H
+
+#include <time.h>
+#include <stdint.h>
+#include "dashboard.h"
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define FED_MAX_PEERS 32            // Nodos configurados con --peer
+#define FED_MAX_LINKS 64            // Enlaces simultáneos (entrantes + salientes)
+#define FED_NODE_ID_SIZE 32
+#define FED_BATCH_BYTES 16384       // Un lote se envía al llegar a este tamaño...
+#define FED_BATCH_DELAY_MS 2        // ...o cuando pasó este tiempo
+#define FED_RECONNECT_MS 2000       // Reintento de enlaces caídos
+#define FED_LINK_MAX_BYTES (4 * 1024 * 1024)  // Tramas sin enviar antes de cortar un enlace
+#define FED_SECRET_SIZE 128
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+// Cliente conectado a otro nodo de la malla
+typedef struct {
+    char nick[NICK_SIZE];
+    char node_id[FED_NODE_ID_SIZE];
+    time_t connected_at;
+} RemoteClient;
+
+typedef struct {
+    const char *node_id;
+    int listen_port;                      // 0 = no aceptar enlaces entrantes
+    const char *secret;                   // Clave del HELLO (NULL = enlaces entrantes solo por loopback)
+    const char *peers[FED_MAX_PEERS];     // "host:puerto" a los que se conecta
+    int peer_count;
+    
+    // Entrega local de lo que llega por los enlaces (sin locks del módulo tomados)
+    void (*deliver_private)(const char *from, const char *to, const char *text);
+    void (*deliver_broadcast)(const char *from, const char *text);
+    
+    // Alta (joined = 1) o baja de un cliente remoto (con el lock del módulo
+    // tomado: no debe llamar a otras funciones de la federación)
+    void (*presence_changed)(const char *nick, const char *node_id, int joined);
+} FederationConfig;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Arranca el thread de la federación (enlaces, presencia y lotes)
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int federation_start(const FederationConfig *config);
+
+/**
+ * Detiene el thread y cierra todos los enlaces
+ */
+void federation_stop(void);
+
+/**
+ * Indica si el servidor corre en modo federado
+ */
+int federation_enabled(void);
+
+/**
+ * Informa a la malla que un nick se conectó / desconectó en este nodo
+ */
+void federation_local_join(const char *nick, time_t connected_at);
+void federation_local_part(const char *nick);
+
+/**
+ * Reenvía un /msg al nodo dueño del nick
+ * @return 0 si se encaminó, -1 si el nick no está en ningún otro nodo
+ */
+int federation_send_private(const char *from, const char *to, const char *text);
+
+/**
+ * Replica un /broadcast una vez por nodo enlazado
+ * @return Cantidad de clientes remotos que lo recibirán
+ */
+int federation_broadcast(const char *from, const char *text);
+
+/**
+ * Cantidad de clientes conectados a otros nodos
+ */
+int federation_remote_count(void);
+
+/**
+ * Contador que cambia con cada alta o baja de un cliente remoto
+ * (para saber si una vista cacheada de la presencia quedó vieja)
+ */
+uint64_t federation_presence_version(void);
+
+/**
+ * Recorre los clientes remotos (con el lock del módulo tomado: fn no debe
+ * llamar a otras funciones de la federación)
+ */
+void federation_for_each_remote(void (*fn)(const RemoteClient *client, void *ctx), void *ctx);
+
+#endif // FEDERATION_H
@@ -0,0 +1,697 @@
+// ============================================================================
+// lanes.c - Implementación de los carriles de salida
+// ============================================================================
+
+#include "lanes.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+#define STOP_FLUSH_MS 1000        // Lo que espera lanes_stop() a los que tienen cola
+#define FILE_SLICE (256 * 1024)   // Bytes de un tramo de archivo por turno: no acapara el thread
+
+typedef struct LaneMsg {
+    struct LaneMsg *next;
+    uint64_t queued_us;
+    size_t len;
+    size_t sent;              // Ya escritos (solo el primero de su carril)
+    int file_fd;              // Tramo de archivo por sendfile() en vez de data (-1 = datos)
+    uint64_t file_offset;
+    char data[];
+} LaneMsg;
+
+typedef struct {
+    LaneMsg *head;
+    LaneMsg *tail;
+    size_t bytes;
+} Lane;
+
+// Cola de una conexión: solo existe mientras el socket no da abasto
+typedef struct {
+    Lane lanes[LANE_COUNT];
+    int partial;              // Carril cuyo primero salió a medias (-1 = ninguno): va antes que todo
+} LaneQueue;
+
+// Una por fd posible
+typedef struct {
+    pthread_mutex_t lock;
+    LaneQueue *queue;         // NULL = nada encolado
+    int direct;               // Reservado por lanes_direct_begin()
+} LaneSlot;
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static struct {
+    pthread_t thread;
+    int running;
+    int epfd;
+    LaneSlot *slots;
+    int size;
+    size_t bulk_limit;        // Bytes (atómico)
+    LaneStats stats;          // Atómicos
+} lanes = { .epfd = -1 };
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+#define STAT_ADD(field, n) __atomic_add_fetch(&lanes.stats.field, (n), __ATOMIC_RELAXED)
+#define STAT_SUB(field, n) __atomic_sub_fetch(&lanes.stats.field, (n), __ATOMIC_RELAXED)
+
+static void stat_max(uint64_t *field, uint64_t value) {
+    uint64_t cur = __atomic_load_n(field, __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(field, &cur, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static LaneSlot *slot_get(int sockfd) {
+    if (!lanes.slots || sockfd < 0 || sockfd >= lanes.size) return NULL;
+    return &lanes.slots[sockfd];
+}
+
+// Copia el mensaje desde el byte skip (lo anterior ya salió)
+static LaneMsg *msg_new(const struct iovec *iov, int count, size_t len, size_t skip) {
+    LaneMsg *m = malloc(sizeof(LaneMsg) + (len - skip));
+    if (!m) return NULL;
+    
+    m->next = NULL;
+    m->queued_us = now_us();
+    m->len = len - skip;
+    m->sent = 0;
+    m->file_fd = -1;
+    
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        size_t n = iov[i].iov_len;
+        const char *base = iov[i].iov_base;
+        if (skip >= n) {
+            skip -= n;
+            continue;
+        }
+        memcpy(m->data + offset, base + skip, n - skip);
+        offset += n - skip;
+        skip = 0;
+    }
+    return m;
+}
+
+static LaneMsg *msg_file(int file_fd, uint64_t offset, size_t len) {
+    LaneMsg *m = malloc(sizeof(LaneMsg));
+    if (!m) return NULL;
+    
+    m->next = NULL;
+    m->queued_us = now_us();
+    m->len = len;
+    m->sent = 0;
+    m->file_fd = file_fd;
+    m->file_offset = offset;
+    return m;
+}
+
+// Memoria que ocupa: un tramo de archivo no guarda sus bytes
+static size_t msg_held(const LaneMsg *m) {
+    return m->file_fd >= 0 ? sizeof(LaneMsg) : m->len;
+}
+
+static void lane_push(Lane *l, LaneMsg *m) {
+    if (l->tail) l->tail->next = m;
+    else l->head = m;
+    l->tail = m;
+    l->bytes += msg_held(m);
+    STAT_ADD(queued_bytes, msg_held(m));
+}
+
+static LaneMsg *lane_pop(Lane *l) {
+    LaneMsg *m = l->head;
+    l->head = m->next;
+    if (!l->head) l->tail = NULL;
+    l->bytes -= msg_held(m);
+    STAT_SUB(queued_bytes, msg_held(m));
+    return m;
+}
+
+static int queue_empty(const LaneQueue *q) {
+    for (int i = 0; i < LANE_COUNT; i++) {
+        if (q->lanes[i].head) return 0;
+    }
+    return 1;
+}
+
+static LaneQueue *queue_new(void) {
+    LaneQueue *q = calloc(1, sizeof(LaneQueue));
+    if (!q) return NULL;
+    q->partial = -1;
+    STAT_ADD(congested, 1);
+    return q;
+}
+
+// Suelta todos los mensajes (el socket ya no sirve o se está cerrando)
+static void queue_discard(LaneQueue *q) {
+    for (int i = 0; i < LANE_COUNT; i++) {
+        while (q->lanes[i].head) free(lane_pop(&q->lanes[i]));
+    }
+    q->partial = -1;
+}
+
+// Libera la cola de un slot si quedó vacía (con el lock del slot)
+static void queue_release(LaneSlot *slot) {
+    LaneQueue *q = slot->queue;
+    if (!q || !queue_empty(q)) return;
+    
+    slot->queue = NULL;
+    free(q);
+    STAT_SUB(congested, 1);
+}
+
+// Pide al thread un aviso cuando el socket tenga lugar
+static void arm(int sockfd) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT | EPOLLONESHOT;
+    ev.data.fd = sockfd;
+    if (epoll_ctl(lanes.epfd, EPOLL_CTL_MOD, sockfd, &ev) < 0 && errno == ENOENT) {
+        epoll_ctl(lanes.epfd, EPOLL_CTL_ADD, sockfd, &ev);
+    }
+}
+
+// El cliente no lee: se corta (el worker ve el cierre y libera la conexión)
+static void cut(int sockfd, LaneQueue *q) {
+    shutdown(sockfd, SHUT_RDWR);
+    queue_discard(q);
+    STAT_ADD(cut, 1);
+}
+
+// Saca masivos, los más viejos primero, hasta que entren len bytes más
+static int make_bulk_room(int sockfd, LaneQueue *q, size_t len) {
+    Lane *l = &q->lanes[LANE_BULK];
+    size_t limit = __atomic_load_n(&lanes.bulk_limit, __ATOMIC_RELAXED);
+    
+    // El que salió a medias no se puede sacar: rompería el flujo
+    LaneMsg *keep = q->partial == LANE_BULK ? l->head : NULL;
+    while (l->bytes + len > limit) {
+        LaneMsg *m = keep ? keep->next : l->head;
+        if (!m) break;
+        
+        if (keep) keep->next = m->next;
+        else l->head = m->next;
+        if (l->tail == m) l->tail = keep;
+        l->bytes -= msg_held(m);
+        STAT_SUB(queued_bytes, msg_held(m));
+        STAT_ADD(dropped, 1);
+        STAT_ADD(dropped_bytes, m->len);
+        stats_unsent(sockfd, m->len);
+        free(m);
+    }
+    return l->bytes + len <= limit;
+}
+
+// Encola m, que ya tiene lo que falta de un mensaje (con el lock del slot)
+// Retorna -1 si se descartó o se cortó la conexión (m se libera)
+static int enqueue(int sockfd, LaneSlot *slot, LaneClass lane, LaneMsg *m, int partial) {
+    LaneQueue *q = slot->queue;
+    int created = 0;
+    
+    if (!q) {
+        q = queue_new();
+        if (!q) {
+            free(m);
+            return -1;
+        }
+        slot->queue = q;
+        created = 1;
+    }
+    
+    size_t held = msg_held(m);
+    if (lane == LANE_BULK && !partial && !make_bulk_room(sockfd, q, held)) {
+        STAT_ADD(dropped, 1);
+        STAT_ADD(dropped_bytes, m->len);
+        free(m);
+        queue_release(slot);
+        return -1;
+    }
+    if (lane != LANE_BULK &&
+        q->lanes[LANE_CONTROL].bytes + q->lanes[LANE_PRIVATE].bytes + held > LANES_MAX_BYTES) {
+        free(m);
+        cut(sockfd, q);
+        queue_release(slot);
+        return -1;
+    }
+    
+    lane_push(&q->lanes[lane], m);
+    STAT_ADD(queued[lane], 1);
+    
+    // Ya salió una parte: lo que falta va antes que cualquier otra cosa
+    if (partial) q->partial = lane;
+    
+    if (created && !slot->direct) arm(sockfd);
+    return 0;
+}
+
+// Saca el primero de su carril, que ya salió entero
+static void msg_done(LaneQueue *q, int lane, uint64_t now) {
+    LaneMsg *m = lane_pop(&q->lanes[lane]);
+    if (q->partial == lane) q->partial = -1;
+    STAT_ADD(sent[lane], 1);
+    STAT_ADD(wait_us[lane], now - m->queued_us);
+    stat_max(&lanes.stats.max_wait_us[lane], now - m->queued_us);
+    free(m);
+}
+
+// Descuenta n bytes escritos de los mensajes del writev, en el mismo orden
+static void consume(LaneQueue *q, const int *order, int count, size_t n) {
+    uint64_t now = now_us();
+    
+    for (int i = 0; i < count; i++) {
+        int lane = order[i];
+        LaneMsg *m = q->lanes[lane].head;
+        size_t rest = m->len - m->sent;
+        
+        if (n < rest) {
+            if (n > 0) {
+                m->sent += n;
+                q->partial = lane;
+            }
+            return;
+        }
+        n -= rest;
+        msg_done(q, lane, now);
+    }
+}
+
+// Envía hasta FILE_SLICE bytes del tramo de archivo que encabeza lane. El
+// socket es bloqueante para los demás: solo durante el sendfile() se lo
+// pone sin bloqueo (todos los que escriben en él pasan por el lock del slot
+// o ya usan MSG_DONTWAIT)
+// Retorna 1 si quedó algo del tramo, 0 si terminó o se cortó la conexión
+static int send_file(int sockfd, LaneQueue *q, int lane) {
+    LaneMsg *m = q->lanes[lane].head;
+    size_t budget = FILE_SLICE;
+    int failed = 0;
+    
+    int flags = fcntl(sockfd, F_GETFL);
+    if (flags >= 0 && !(flags & O_NONBLOCK)) fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+    
+    while (m->sent < m->len && budget > 0) {
+        off_t offset = (off_t)(m->file_offset + m->sent);
+        size_t want = m->len - m->sent < budget ? m->len - m->sent : budget;
+        ssize_t n = sendfile(sockfd, m->file_fd, &offset, want);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            failed = 1;
+            break;
+        }
+        m->sent += (size_t)n;
+        budget -= (size_t)n;
+        q->partial = lane;
+    }
+    
+    if (flags >= 0 && !(flags & O_NONBLOCK)) fcntl(sockfd, F_SETFL, flags);
+    
+    // Un tramo que no se puede terminar deja un registro cortado: mejor
+    // cortar la conexión que pegarle lo que venía detrás
+    if (failed) {
+        cut(sockfd, q);
+        return 0;
+    }
+    if (m->sent < m->len) return 1;
+    
+    msg_done(q, lane, now_us());
+    return 0;
+}
+
+// Escribe lo encolado sin bloquear, por prioridad (con el lock del slot)
+// Retorna 1 si queda algo esperando lugar en el socket
+static int drain(int sockfd, LaneQueue *q) {
+    for (;;) {
+        struct iovec iov[LANES_BATCH];
+        int order[LANES_BATCH];
+        int count = 0;
+        size_t total = 0;
+        
+        // Un tramo de archivo sale solo, con sendfile()
+        int first = q->partial;
+        for (int lane = 0; first < 0 && lane < LANE_COUNT; lane++) {
+            if (q->lanes[lane].head) first = lane;
+        }
+        if (first < 0) return 0;
+        if (q->lanes[first].head->file_fd >= 0) {
+            if (send_file(sockfd, q, first)) return 1;
+            continue;
+        }
+        
+        if (q->partial >= 0) {
+            LaneMsg *m = q->lanes[q->partial].head;
+            iov[count].iov_base = m->data + m->sent;
+            iov[count].iov_len = m->len - m->sent;
+            order[count++] = q->partial;
+            total += m->len - m->sent;
+        }
+        int stop = 0;
+        for (int lane = 0; lane < LANE_COUNT && count < LANES_BATCH && !stop; lane++) {
+            LaneMsg *m = q->lanes[lane].head;
+            if (lane == q->partial) m = m->next;
+            for (; m && count < LANES_BATCH; m = m->next) {
+                // Lo que sigue espera a que salga el tramo de archivo
+                if (m->file_fd >= 0) {
+                    stop = 1;
+                    break;
+                }
+                iov[count].iov_base = m->data;
+                iov[count].iov_len = m->len;
+                order[count++] = lane;
+                total += m->len;
+            }
+        }
+        
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t n = sendmsg(sockfd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 1;
+        if (n < 0) {
+            // El socket se cerró: el worker lo ve y cierra la conexión
+            queue_discard(q);
+            return 0;
+        }
+        
+        consume(q, order, count, (size_t)n);
+        if ((size_t)n < total) return 1;
+    }
+}
+
+static void *lanes_thread(void *arg) {
+    struct epoll_event events[LANES_BATCH];
+    (void)arg;
+    stats_register_thread("despachador");
+    
+    while (__atomic_load_n(&lanes.running, __ATOMIC_RELAXED)) {
+        int n = epoll_wait(lanes.epfd, events, LANES_BATCH, 100);
+        
+        for (int i = 0; i < n; i++) {
+            int sockfd = events[i].data.fd;
+            LaneSlot *slot = slot_get(sockfd);
+            if (!slot) continue;
+            
+            pthread_mutex_lock(&slot->lock);
+            LaneQueue *q = slot->queue;
+            // Con el socket reservado, lanes_direct_end() vuelve a pedir el aviso
+            if (q && !slot->direct) {
+                if (drain(sockfd, q)) arm(sockfd);
+                queue_release(slot);
+            }
+            pthread_mutex_unlock(&slot->lock);
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int lanes_start(int bulk_limit_kb) {
+    struct rlimit rl;
+    
+    if (!lanes.slots) {
+        if (getrlimit(RLIMIT_NOFILE, &rl) < 0) return -1;
+        lanes.size = rl.rlim_cur == RLIM_INFINITY ? 65536 : (int)rl.rlim_cur;
+        lanes.slots = calloc((size_t)lanes.size, sizeof(LaneSlot));
+        if (!lanes.slots) return -1;
+        for (int i = 0; i < lanes.size; i++) pthread_mutex_init(&lanes.slots[i].lock, NULL);
+    }
+    
+    lanes.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (lanes.epfd < 0) return -1;
+    
+    lanes_set_bulk_limit(bulk_limit_kb);
+    __atomic_store_n(&lanes.running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&lanes.thread, NULL, lanes_thread, NULL) != 0) {
+        lanes.running = 0;
+        close(lanes.epfd);
+        lanes.epfd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Termina la cola de fd al vencer el plazo de lanes_stop(). Los masivos se
+// pueden perder; un mensaje a medias o una respuesta sin enviar no: el
+// cliente quedaría con una línea cortada (pegada a lo que envíe el proceso
+// nuevo tras un upgrade) o esperando para siempre, así que se corta
+static void stop_discard(int fd, LaneQueue *q) {
+    if (q->partial >= 0 || q->lanes[LANE_CONTROL].head || q->lanes[LANE_PRIVATE].head) {
+        cut(fd, q);
+        return;
+    }
+    while (q->lanes[LANE_BULK].head) {
+        LaneMsg *m = lane_pop(&q->lanes[LANE_BULK]);
+        STAT_ADD(dropped, 1);
+        STAT_ADD(dropped_bytes, m->len);
+        stats_unsent(fd, m->len);
+        free(m);
+    }
+}
+
+void lanes_stop(void) {
+    if (!__atomic_load_n(&lanes.running, __ATOMIC_RELAXED)) return;
+    __atomic_store_n(&lanes.running, 0, __ATOMIC_RELEASE);
+    pthread_join(lanes.thread, NULL);
+    
+    // Todas las colas se vacían a la vez, cada una con el plazo entero: un
+    // cliente que no lee no le quita tiempo a los demás
+    int pending = 0;
+    for (int fd = 0; fd < lanes.size; fd++) {
+        if (lanes.slots[fd].queue) pending++;
+    }
+    struct pollfd *pfds = pending > 0 ? calloc((size_t)pending, sizeof(struct pollfd)) : NULL;
+    int count = 0;
+    for (int fd = 0; pfds && fd < lanes.size && count < pending; fd++) {
+        if (lanes.slots[fd].queue) pfds[count++].fd = fd;
+    }
+    
+    uint64_t deadline = now_us() + STOP_FLUSH_MS * 1000ull;
+    while (count > 0) {
+        int waiting = 0;
+        for (int i = 0; i < count; i++) {
+            LaneSlot *slot = &lanes.slots[pfds[i].fd];
+            pthread_mutex_lock(&slot->lock);
+            int left = slot->queue && drain(pfds[i].fd, slot->queue);
+            if (slot->queue && !left) queue_release(slot);
+            pthread_mutex_unlock(&slot->lock);
+            if (left) {
+                pfds[waiting].fd = pfds[i].fd;
+                pfds[waiting].events = POLLOUT;
+                pfds[waiting].revents = 0;
+                waiting++;
+            }
+        }
+        count = waiting;
+        
+        uint64_t now = now_us();
+        if (count == 0 || now >= deadline) break;
+        if (poll(pfds, (nfds_t)count, (int)((deadline - now) / 1000) + 1) < 0 && errno != EINTR) break;
+    }
+    free(pfds);
+    
+    // Lo que no salió en el plazo (o si no hubo memoria para esperarlo)
+    for (int fd = 0; fd < lanes.size; fd++) {
+        LaneSlot *slot = &lanes.slots[fd];
+        pthread_mutex_lock(&slot->lock);
+        if (slot->queue) {
+            stop_discard(fd, slot->queue);
+            queue_release(slot);
+        }
+        pthread_mutex_unlock(&slot->lock);
+    }
+    
+    close(lanes.epfd);
+    lanes.epfd = -1;
+}
+
+void lanes_set_bulk_limit(int kb) {
+    if (kb < 1) kb = 1;
+    if (kb > LANES_BULK_MAX_KB) kb = LANES_BULK_MAX_KB;
+    __atomic_store_n(&lanes.bulk_limit, (size_t)kb * 1024, __ATOMIC_RELAXED);
+    __atomic_store_n(&lanes.stats.bulk_limit_kb, kb, __ATOMIC_RELAXED);
+}
+
+ssize_t lanes_send(int sockfd, const struct iovec *iov, int count, size_t len, LaneClass lane) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = count;
+    
+    // Sin el thread (arranque, cierre) se envía como siempre, bloqueando
+    LaneSlot *slot = slot_get(sockfd);
+    if (!slot || !__atomic_load_n(&lanes.running, __ATOMIC_ACQUIRE)) {
+        return sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    }
+    
+    pthread_mutex_lock(&slot->lock);
+    size_t skip = 0;
+    if (!slot->queue && !slot->direct) {
+        ssize_t n = sendmsg(sockfd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n == (ssize_t)len) {
+            pthread_mutex_unlock(&slot->lock);
+            return n;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            pthread_mutex_unlock(&slot->lock);
+            return -1;
+        }
+        if (n > 0) skip = (size_t)n;
+    }
+    
+    LaneMsg *m = msg_new(iov, count, len, skip);
+    int queued = m ? enqueue(sockfd, slot, lane, m, skip > 0) : -1;
+    pthread_mutex_unlock(&slot->lock);
+    return queued < 0 ? -1 : (ssize_t)len;
+}
+
+ssize_t lanes_send_file(int sockfd, int file_fd, uint64_t offset, size_t len, LaneClass lane) {
+    if (len == 0) return 0;
+    
+    // Sin el thread se envía como siempre, bloqueando
+    LaneSlot *slot = slot_get(sockfd);
+    if (!slot || !__atomic_load_n(&lanes.running, __ATOMIC_ACQUIRE)) {
+        off_t pos = (off_t)offset;
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = sendfile(sockfd, file_fd, &pos, len - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                shutdown(sockfd, SHUT_RDWR);  // Ver send_file()
+                return -1;
+            }
+            done += (size_t)n;
+        }
+        return (ssize_t)len;
+    }
+    
+    // Siempre a la cola: el thread lo envía por partes sin bloquear
+    pthread_mutex_lock(&slot->lock);
+    LaneMsg *m = msg_file(file_fd, offset, len);
+    int queued = m ? enqueue(sockfd, slot, lane, m, 0) : -1;
+    pthread_mutex_unlock(&slot->lock);
+    return queued < 0 ? -1 : (ssize_t)len;
+}
+
+int lanes_direct_begin(int sockfd) {
+    LaneSlot *slot = slot_get(sockfd);
+    if (!slot || !__atomic_load_n(&lanes.running, __ATOMIC_ACQUIRE)) return 0;
+    
+    // Nunca espera: con algo encolado el envío va a la cola como los demás
+    pthread_mutex_lock(&slot->lock);
+    int busy = slot->direct || slot->queue;
+    if (!busy) slot->direct = 1;
+    pthread_mutex_unlock(&slot->lock);
+    return busy ? -1 : 0;
+}
+
+ssize_t lanes_direct_rest(int sockfd, const struct iovec *iov, int count, size_t len, LaneClass lane) {
+    LaneSlot *slot = slot_get(sockfd);
+    if (!slot || !__atomic_load_n(&lanes.running, __ATOMIC_ACQUIRE)) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (struct iovec *)iov;
+        msg.msg_iovlen = count;
+        return sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    }
+    
+    pthread_mutex_lock(&slot->lock);
+    LaneQueue *q = slot->queue;
+    if (!slot->direct || (q && q->partial >= 0) || (!q && !(q = queue_new()))) {
+        pthread_mutex_unlock(&slot->lock);
+        return -1;
+    }
+    slot->queue = q;
+    
+    LaneMsg *m = msg_new(iov, count, len, 0);
+    if (!m) {
+        queue_release(slot);
+        pthread_mutex_unlock(&slot->lock);
+        return -1;
+    }
+    
+    // Primero en su carril aunque se haya encolado algo mientras tanto:
+    // lo que ya salió es su principio y no puede quedar cortado
+    Lane *l = &q->lanes[lane];
+    m->next = l->head;
+    l->head = m;
+    if (!l->tail) l->tail = m;
+    l->bytes += m->len;
+    STAT_ADD(queued_bytes, m->len);
+    STAT_ADD(queued[lane], 1);
+    q->partial = lane;
+    
+    pthread_mutex_unlock(&slot->lock);
+    return (ssize_t)len;
+}
+
+void lanes_direct_end(int sockfd) {
+    LaneSlot *slot = slot_get(sockfd);
+    if (!slot) return;
+    
+    pthread_mutex_lock(&slot->lock);
+    if (slot->direct) {
+        slot->direct = 0;
+        if (slot->queue && !queue_empty(slot->queue) && lanes.epfd >= 0) arm(sockfd);
+        queue_release(slot);
+    }
+    pthread_mutex_unlock(&slot->lock);
+}
+
+void lanes_forget(int sockfd) {
+    LaneSlot *slot = slot_get(sockfd);
+    if (!slot) return;
+    
+    pthread_mutex_lock(&slot->lock);
+    if (slot->queue) {
+        queue_discard(slot->queue);
+        queue_release(slot);
+    }
+    pthread_mutex_unlock(&slot->lock);
+}
+
+void lanes_get_stats(LaneStats *out) {
+    out->bulk_limit_kb = __atomic_load_n(&lanes.stats.bulk_limit_kb, __ATOMIC_RELAXED);
+    for (int i = 0; i < LANE_COUNT; i++) {
+        out->queued[i] = __atomic_load_n(&lanes.stats.queued[i], __ATOMIC_RELAXED);
+        out->sent[i] = __atomic_load_n(&lanes.stats.sent[i], __ATOMIC_RELAXED);
+        out->wait_us[i] = __atomic_load_n(&lanes.stats.wait_us[i], __ATOMIC_RELAXED);
+        out->max_wait_us[i] = __atomic_load_n(&lanes.stats.max_wait_us[i], __ATOMIC_RELAXED);
+    }
+    out->dropped = __atomic_load_n(&lanes.stats.dropped, __ATOMIC_RELAXED);
+    out->dropped_bytes = __atomic_load_n(&lanes.stats.dropped_bytes, __ATOMIC_RELAXED);
+    out->cut = __atomic_load_n(&lanes.stats.cut, __ATOMIC_RELAXED);
+    out->congested = __atomic_load_n(&lanes.stats.congested, __ATOMIC_RELAXED);
+    out->queued_bytes = __atomic_load_n(&lanes.stats.queued_bytes, __ATOMIC_RELAXED);
+    out->table_bytes = (uint64_t)lanes.size * sizeof(LaneSlot) + out->congested * sizeof(LaneQueue);
+}
@@ -0,0 +1,139 @@
+// ============================================================================
+// lanes.h - Carriles de salida por conexión: respuestas antes que broadcasts
+// ============================================================================
+// Todo lo que se envía a un cliente TCP pasa por acá con una clase:
+//
+//   LANE_CONTROL   respuestas a sus comandos y errores (/list, /msg OK, ...)
+//   LANE_PRIVATE   privados, avisos de archivos y mensajes de su /session
+//   LANE_BULK      broadcasts, avisos de /watch y lo agrupado por --coalesce-ms
+//
+// Mientras el socket acepta todo, cada envío sale en el momento (send sin
+// bloquear) y el módulo no guarda nada. Cuando el buffer del socket se llena
+// lo que falta queda en la cola de su clase y un thread propio la vacía al
+// haber lugar (EPOLLOUT): primero termina el mensaje que quedó a medias,
+// después control, privados y por último masivos, varios en un writev. Así
+// una respuesta a /list espera a lo sumo un mensaje, no la ráfaga entera de
+// broadcasts que la precedía.
+//
+// Un tramo de archivo (/history) se encola sin copiarlo y el thread lo envía
+// con sendfile() de a partes, en su lugar de la cola: el worker nunca espera
+// a que el cliente lo lea.
+//
+// Bajo presión los masivos se descartan (los más viejos primero) si pasan
+// el tope de la conexión; control y privados nunca se descartan. Un cliente
+// que deja de leer y acumula LANES_MAX_BYTES de esas clases se corta.
+// ============================================================================
+
+#ifndef LANES_H
+#define LANES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define LANES_BULK_DEFAULT_KB 256          // Tope de masivos encolados por conexión
+#define LANES_BULK_MAX_KB 65536
+#define LANES_MAX_BYTES (16 * 1024 * 1024) // Control + privados encolados: más y se corta
+#define LANES_BATCH 64                     // Mensajes por writev del thread
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef enum {
+    LANE_CONTROL,
+    LANE_PRIVATE,
+    LANE_BULK,
+    LANE_COUNT
+} LaneClass;
+
+typedef struct {
+    int bulk_limit_kb;                  // Tope actual de masivos por conexión
+    uint64_t queued[LANE_COUNT];        // Mensajes que tuvieron que esperar en una cola
+    uint64_t sent[LANE_COUNT];          // De esos, los que ya salieron
+    uint64_t wait_us[LANE_COUNT];       // Suma de lo que esperaron
+    uint64_t max_wait_us[LANE_COUNT];
+    uint64_t dropped;                   // Masivos descartados por el tope
+    uint64_t dropped_bytes;
+    uint64_t cut;                       // Conexiones cortadas por no leer
+    uint64_t congested;                 // Conexiones con cola ahora
+    uint64_t queued_bytes;              // Bytes en las colas ahora
+    uint64_t table_bytes;               // Slots (uno por fd posible) y colas reservadas
+} LaneStats;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Reserva la tabla de conexiones (una por fd posible) y arranca el thread
+ * que vacía las colas
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int lanes_start(int bulk_limit_kb);
+
+/**
+ * Detiene el thread y envía lo encolado que se pueda en un segundo, todas
+ * las conexiones a la vez. Después los masivos que quedan se descartan y
+ * las conexiones con un mensaje a medias o respuestas sin enviar se cortan;
+ * desde ahí los envíos vuelven a ser bloqueantes
+ */
+void lanes_stop(void);
+
+/**
+ * Cambia el tope de masivos encolados por conexión
+ */
+void lanes_set_bulk_limit(int kb);
+
+/**
+ * Envía len bytes a un socket TCP con la clase lane
+ * @return len si salió o quedó encolado, -1 si el socket falló
+ */
+ssize_t lanes_send(int sockfd, const struct iovec *iov, int count, size_t len, LaneClass lane);
+
+/**
+ * Encola len bytes de file_fd desde offset para enviarlos con sendfile()
+ * con la clase lane. El archivo tiene que seguir abierto (y ese tramo sin
+ * cambiar) hasta lanes_stop(). Si el tramo no se puede terminar de enviar
+ * la conexión se corta: lo que venía detrás no sale pegado a medio registro.
+ * @return len si quedó encolado (o salió), -1 si no
+ */
+ssize_t lanes_send_file(int sockfd, int file_fd, uint64_t offset, size_t len, LaneClass lane);
+
+/**
+ * Reserva el socket para escribirle por fuera del módulo (MSG_ZEROCOPY)
+ * sin que nada se intercale; mientras tanto lo demás se encola. No espera:
+ * falla si hay algo encolado, y el que llama envía por lanes_send().
+ * @return 0 si quedó reservado (liberarlo con lanes_direct_end), -1 si no
+ */
+int lanes_direct_begin(int sockfd);
+
+/**
+ * Encola lo que un envío directo no llegó a escribir (el socket se llenó):
+ * sale antes que todo lo demás, como el mensaje que quedó a medias.
+ * Llamarla con el socket todavía reservado.
+ * @return len si quedó encolado, -1 si no
+ */
+ssize_t lanes_direct_rest(int sockfd, const struct iovec *iov, int count, size_t len, LaneClass lane);
+
+/**
+ * Libera el socket y retoma lo que se encoló mientras tanto
+ */
+void lanes_direct_end(int sockfd);
+
+/**
+ * Descarta lo encolado para sockfd (antes de cerrarlo: el fd se reutiliza)
+ */
+void lanes_forget(int sockfd);
+
+/**
+ * Totales desde el arranque y colas actuales
+ */
+void lanes_get_stats(LaneStats *out);
+
+#endif // LANES_H
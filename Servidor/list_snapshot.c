@@ -0,0 +1,223 @@
+// ============================================================================
+// list_snapshot.c - Implementación de la vista compartida de /list
+// ============================================================================
+
+#include "list_snapshot.h"
+#include "federation.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ListSnapshot *current = NULL;
+static _Atomic uint64_t local_version = 1;
+
+// Clientes copiados del registro (el formateo se hace sin su lock)
+typedef struct {
+    char nick[NICK_SIZE];
+    char node_id[FED_NODE_ID_SIZE];  // Vacío = cliente de este nodo
+    time_t connected_at;
+} ListEntry;
+
+typedef struct {
+    ListEntry *entries;
+    int count;
+    int capacity;
+} EntryArray;
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static void collect_remote(const RemoteClient *client, void *ctx) {
+    EntryArray *array = (EntryArray *)ctx;
+    
+    if (array->count == array->capacity) {
+        int capacity = array->capacity ? array->capacity * 2 : 64;
+        ListEntry *entries = realloc(array->entries, capacity * sizeof(ListEntry));
+        if (!entries) return;
+        array->entries = entries;
+        array->capacity = capacity;
+    }
+    
+    ListEntry *e = &array->entries[array->count++];
+    memcpy(e->nick, client->nick, NICK_SIZE);
+    memcpy(e->node_id, client->node_id, FED_NODE_ID_SIZE);
+    e->connected_at = client->connected_at;
+}
+
+static void free_snapshot(ListSnapshot *snapshot) {
+    free(snapshot->items);
+    free(snapshot->offsets);
+    free(snapshot);
+}
+
+// "hoy a las 10:15:02" se muestra como hora; días anteriores con la fecha
+static void format_since(time_t since, const struct tm *today, char *out, size_t size) {
+    struct tm tm_since;
+    localtime_r(&since, &tm_since);
+    
+    if (tm_since.tm_yday == today->tm_yday && tm_since.tm_year == today->tm_year) {
+        strftime(out, size, "%H:%M:%S", &tm_since);
+    } else {
+        strftime(out, size, "%d/%m %H:%M", &tm_since);
+    }
+}
+
+static ListSnapshot *build_snapshot(ClientList *list, const char *node_id,
+                                    uint64_t local_ver, uint64_t remote_ver) {
+    EntryArray array = { NULL, 0, 0 };
+    int local_count = 0;
+    int limit = __atomic_load_n(&list->limit, __ATOMIC_RELAXED);
+    
+    // Copiar el registro local con su lock tomado el menor tiempo posible
+    array.entries = malloc(MAX_CLIENTS * sizeof(ListEntry));
+    if (!array.entries) return NULL;
+    array.capacity = MAX_CLIENTS;
+    
+    pthread_mutex_lock(&list->mutex);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (list->clients[i].active) {
+            ListEntry *e = &array.entries[array.count++];
+            memcpy(e->nick, list->clients[i].nick, NICK_SIZE);
+            e->node_id[0] = '\0';
+            e->connected_at = list->clients[i].connected_at;
+        }
+    }
+    pthread_mutex_unlock(&list->mutex);
+    local_count = array.count;
+    
+    federation_for_each_remote(collect_remote, &array);
+    
+    ListSnapshot *snapshot = calloc(1, sizeof(ListSnapshot));
+    if (snapshot) {
+        snapshot->items = malloc((size_t)array.count * LIST_ITEM_MAX + 1);
+        snapshot->offsets = malloc(((size_t)array.count + 1) * sizeof(size_t));
+    }
+    if (!snapshot || !snapshot->items || !snapshot->offsets) {
+        if (snapshot) free_snapshot(snapshot);
+        free(array.entries);
+        return NULL;
+    }
+    
+    snapshot->local_version = local_ver;
+    snapshot->remote_version = remote_ver;
+    snapshot->local_count = local_count;
+    snapshot->remote_count = array.count - local_count;
+    snapshot->item_count = array.count;
+    
+    time_t now = time(NULL);
+    struct tm today;
+    localtime_r(&now, &today);
+    
+    struct tm midnight = today;
+    midnight.tm_mday++;
+    midnight.tm_hour = midnight.tm_min = midnight.tm_sec = 0;
+    midnight.tm_isdst = -1;
+    snapshot->expires = mktime(&midnight);
+    
+    size_t offset = 0;
+    for (int i = 0; i < array.count; i++) {
+        ListEntry *e = &array.entries[i];
+        char since[32];
+        format_since(e->connected_at, &today, since, sizeof(since));
+        
+        snapshot->offsets[i] = offset;
+        int len;
+        if (e->node_id[0]) {
+            len = snprintf(snapshot->items + offset, LIST_ITEM_MAX, "%s %s @%s (conectado desde %s)\n",
+                           RESP_LIST_ITEM, e->nick, e->node_id, since);
+        } else {
+            len = snprintf(snapshot->items + offset, LIST_ITEM_MAX, "%s %s (conectado desde %s)\n",
+                           RESP_LIST_ITEM, e->nick, since);
+        }
+        offset += len < LIST_ITEM_MAX ? (size_t)len : LIST_ITEM_MAX - 1;
+    }
+    snapshot->offsets[array.count] = offset;
+    free(array.entries);
+    
+    int len;
+    if (node_id) {
+        len = snprintf(snapshot->summary, sizeof(snapshot->summary),
+                       "%s Clientes conectados: %d/%d en %s, %d en otros nodos\n",
+                       RESP_INFO, snapshot->local_count, limit, node_id, snapshot->remote_count);
+    } else {
+        len = snprintf(snapshot->summary, sizeof(snapshot->summary),
+                       "%s Clientes conectados: %d/%d\n",
+                       RESP_INFO, snapshot->local_count, limit);
+    }
+    if (snapshot->item_count == 0) {
+        len += snprintf(snapshot->summary + len, sizeof(snapshot->summary) - len,
+                        "%s No hay clientes conectados\n", RESP_INFO);
+    }
+    snapshot->summary_len = (size_t)len;
+    
+    return snapshot;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+void list_snapshot_invalidate(void) {
+    atomic_fetch_add(&local_version, 1);
+}
+
+ListSnapshot *list_snapshot_acquire(ClientList *list, const char *node_id) {
+    uint64_t local_ver = atomic_load(&local_version);
+    uint64_t remote_ver = federation_presence_version();
+    
+    pthread_mutex_lock(&snapshot_mutex);
+    
+    // Los que llegan mientras otro reconstruye esperan el mutex y encuentran
+    // la vista nueva: una sola reconstrucción por cambio (o por día, porque
+    // las horas de "hoy" se muestran sin fecha)
+    if (!current || current->local_version != local_ver || current->remote_version != remote_ver ||
+        time(NULL) >= current->expires) {
+        ListSnapshot *fresh = build_snapshot(list, node_id, local_ver, remote_ver);
+        if (fresh) {
+            if (current && --current->refs == 0) free_snapshot(current);
+            fresh->refs = 1;  // La referencia de "actual"
+            current = fresh;
+        }
+    }
+    
+    ListSnapshot *snapshot = current;
+    if (snapshot) snapshot->refs++;
+    
+    pthread_mutex_unlock(&snapshot_mutex);
+    return snapshot;
+}
+
+void list_snapshot_release(ListSnapshot *snapshot) {
+    pthread_mutex_lock(&snapshot_mutex);
+    int refs = --snapshot->refs;
+    pthread_mutex_unlock(&snapshot_mutex);
+    
+    if (refs == 0) free_snapshot(snapshot);
+}
+
+int list_snapshot_pages(const ListSnapshot *snapshot) {
+    int pages = (snapshot->item_count + LIST_PAGE_SIZE - 1) / LIST_PAGE_SIZE;
+    return pages > 0 ? pages : 1;
+}
+
+int list_snapshot_page(const ListSnapshot *snapshot, int page, const char **data, size_t *len) {
+    if (page < 1 || page > list_snapshot_pages(snapshot)) return -1;
+    
+    int first = (page - 1) * LIST_PAGE_SIZE;
+    int last = first + LIST_PAGE_SIZE;
+    if (last > snapshot->item_count) last = snapshot->item_count;
+    if (first > last) first = last;
+    
+    *data = snapshot->items + snapshot->offsets[first];
+    *len = snapshot->offsets[last] - snapshot->offsets[first];
+    return 0;
+}
@@ -0,0 +1,76 @@
+// ============================================================================
+// list_snapshot.h - Vista compartida y versionada de la lista de clientes
+// ============================================================================
+// /list no recorre ni formatea el registro en cada pedido: usa una vista ya
+// formateada que se reconstruye solo cuando alguien entra o sale. Todos los
+// que piden /list comparten la misma vista (con contador de referencias) y
+// la envían directamente desde su buffer, completa o por páginas.
+// ============================================================================
+
+#ifndef LIST_SNAPSHOT_H
+#define LIST_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "dashboard.h"
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define LIST_PAGE_SIZE 50      // Clientes por página en /list <página>
+#define LIST_ITEM_MAX 128      // Largo máximo de una línea LIST_ITEM
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct {
+    int refs;                  // Lectores que la están enviando (+1 si es la actual)
+    uint64_t local_version;    // Versiones del registro con las que se armó
+    uint64_t remote_version;
+    time_t expires;            // Medianoche local: "hoy" deja de serlo y se rearma
+    int local_count;
+    int remote_count;
+    char summary[192];         // Línea(s) INFO con los totales
+    size_t summary_len;
+    char *items;               // Líneas LIST_ITEM, una detrás de otra
+    size_t *offsets;           // Inicio de cada ítem; offsets[item_count] = fin
+    int item_count;
+} ListSnapshot;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Marca la vista como vieja (un cliente local entró o salió)
+ */
+void list_snapshot_invalidate(void);
+
+/**
+ * Devuelve la vista actual, reconstruyéndola si quedó vieja. Si muchos la
+ * piden a la vez se reconstruye una sola vez.
+ * @param node_id Nombre del nodo en la malla (NULL = sin federación)
+ * @return Vista con una referencia tomada (liberar con list_snapshot_release)
+ */
+ListSnapshot *list_snapshot_acquire(ClientList *list, const char *node_id);
+
+/**
+ * Suelta la referencia tomada por list_snapshot_acquire()
+ */
+void list_snapshot_release(ListSnapshot *snapshot);
+
+/**
+ * Cantidad de páginas de LIST_PAGE_SIZE ítems (al menos 1)
+ */
+int list_snapshot_pages(const ListSnapshot *snapshot);
+
+/**
+ * Tramo contiguo de ítems de una página (1 = primera)
+ * @return 0 si la página existe, -1 si no
+ */
+int list_snapshot_page(const ListSnapshot *snapshot, int page, const char **data, size_t *len);
+
+#endif // LIST_SNAPSHOT_H
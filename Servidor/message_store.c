@@ -0,0 +1,224 @@
+// ============================================================================
+// message_store.c - Implementación del historial persistente
+// ============================================================================
+
+#include "message_store.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static int ensure_capacity(MessageStore *store, size_t needed) {
+    if (needed <= store->capacity) return 0;
+
+    size_t capacity = store->capacity ? store->capacity : 1024;
+    while (capacity < needed) capacity *= 2;
+
+    HistoryIndexEntry *entries = realloc(store->entries, capacity * sizeof(HistoryIndexEntry));
+    if (!entries) return -1;
+
+    store->entries = entries;
+    store->capacity = capacity;
+    return 0;
+}
+
+// Carga el índice y lo recorta al último registro completo del segmento
+static int load_index(MessageStore *store) {
+    struct stat st_data, st_index;
+
+    if (fstat(store->data_fd, &st_data) < 0 || fstat(store->index_fd, &st_index) < 0) {
+        return -1;
+    }
+
+    size_t count = (size_t)st_index.st_size / sizeof(HistoryIndexEntry);
+    if (ensure_capacity(store, count) < 0) return -1;
+
+    size_t bytes = count * sizeof(HistoryIndexEntry);
+    if (bytes > 0 && pread(store->index_fd, store->entries, bytes, 0) != (ssize_t)bytes) {
+        return -1;
+    }
+
+    // Descartar entradas que apunten fuera del segmento
+    while (count > 0) {
+        HistoryIndexEntry *last = &store->entries[count - 1];
+        if (last->offset + last->length <= (uint64_t)st_data.st_size) break;
+        count--;
+    }
+
+    store->count = count;
+    store->data_size = count > 0 ?
+        store->entries[count - 1].offset + store->entries[count - 1].length : 0;
+
+    // Dejar ambos archivos exactamente con los registros válidos
+    if (ftruncate(store->index_fd, (off_t)(count * sizeof(HistoryIndexEntry))) < 0 ||
+        ftruncate(store->data_fd, (off_t)store->data_size) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Primer registro con timestamp >= since (los timestamps son crecientes)
+static size_t first_since_locked(MessageStore *store, time_t since) {
+    size_t lo = 0, hi = store->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (store->entries[mid].timestamp < (int64_t)since) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int message_store_open(MessageStore *store, const char *path) {
+    char filename[512];
+
+    memset(store, 0, sizeof(*store));
+    store->data_fd = -1;
+    store->index_fd = -1;
+    pthread_mutex_init(&store->mutex, NULL);
+
+    snprintf(filename, sizeof(filename), "%s.dat", path);
+    store->data_fd = open(filename, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    snprintf(filename, sizeof(filename), "%s.idx", path);
+    store->index_fd = open(filename, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (store->data_fd < 0 || store->index_fd < 0 || load_index(store) < 0) {
+        perror("historial");
+        message_store_close(store);
+        return -1;
+    }
+
+    return 0;
+}
+
+void message_store_close(MessageStore *store) {
+    if (store->data_fd >= 0) close(store->data_fd);
+    if (store->index_fd >= 0) close(store->index_fd);
+    free(store->entries);
+    store->entries = NULL;
+    store->data_fd = -1;
+    store->index_fd = -1;
+    store->count = 0;
+    store->capacity = 0;
+}
+
+int message_store_append(MessageStore *store, const char *from_nick, const char *message) {
+    char record[HISTORY_RECORD_MAX];
+    char time_str[32];
+    time_t now = time(NULL);
+    struct tm tm_now;
+
+    if (store->data_fd < 0) return -1;
+
+    // Formatear una sola vez: el replay envía estos bytes tal cual
+    localtime_r(&now, &tm_now);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm_now);
+    int len = snprintf(record, sizeof(record), "%s [%s] %s: %s\n",
+                       RESP_HISTORY, time_str, from_nick, message);
+    if (len >= (int)sizeof(record)) {
+        len = sizeof(record) - 1;
+        record[len - 1] = '\n';
+    }
+
+    pthread_mutex_lock(&store->mutex);
+
+    if (ensure_capacity(store, store->count + 1) < 0) {
+        pthread_mutex_unlock(&store->mutex);
+        return -1;
+    }
+
+    HistoryIndexEntry entry = {
+        .offset = store->data_size,
+        .length = (uint32_t)len,
+        .reserved = 0,
+        .timestamp = (int64_t)now
+    };
+
+    // Primero el dato y después el índice: un corte a mitad se detecta al abrir
+    if (write(store->data_fd, record, len) != len ||
+        write(store->index_fd, &entry, sizeof(entry)) != (ssize_t)sizeof(entry)) {
+        perror("historial: write");
+        pthread_mutex_unlock(&store->mutex);
+        return -1;
+    }
+
+    store->entries[store->count++] = entry;
+    store->data_size += len;
+
+    pthread_mutex_unlock(&store->mutex);
+    return 0;
+}
+
+void message_store_range_last(MessageStore *store, size_t n, HistoryRange *range) {
+    pthread_mutex_lock(&store->mutex);
+
+    if (n > store->count) n = store->count;
+    range->count = n;
+    range->offset = n > 0 ? store->entries[store->count - n].offset : store->data_size;
+    range->length = store->data_size - range->offset;
+
+    pthread_mutex_unlock(&store->mutex);
+}
+
+void message_store_range_since(MessageStore *store, time_t since, HistoryRange *range) {
+    pthread_mutex_lock(&store->mutex);
+
+    size_t lo = first_since_locked(store, since);
+    size_t n = store->count - lo;
+    if (n > HISTORY_MAX_REPLAY) {
+        lo = store->count - HISTORY_MAX_REPLAY;
+        n = HISTORY_MAX_REPLAY;
+    }
+
+    range->count = n;
+    range->offset = n > 0 ? store->entries[lo].offset : store->data_size;
+    range->length = store->data_size - range->offset;
+
+    pthread_mutex_unlock(&store->mutex);
+}
+
+size_t message_store_count(MessageStore *store) {
+    pthread_mutex_lock(&store->mutex);
+    size_t count = store->count;
+    pthread_mutex_unlock(&store->mutex);
+    return count;
+}
+
+size_t message_store_find_since(MessageStore *store, time_t since) {
+    pthread_mutex_lock(&store->mutex);
+    size_t first = first_since_locked(store, since);
+    pthread_mutex_unlock(&store->mutex);
+    return first;
+}
+
+size_t message_store_entries(MessageStore *store, size_t first, HistoryIndexEntry *out, size_t n) {
+    pthread_mutex_lock(&store->mutex);
+    if (first >= store->count) n = 0;
+    else if (n > store->count - first) n = store->count - first;
+    if (n > 0) memcpy(out, store->entries + first, n * sizeof(HistoryIndexEntry));
+    pthread_mutex_unlock(&store->mutex);
+    return n;
+}
+
+ssize_t message_store_read(MessageStore *store, uint64_t offset, void *buf, size_t len) {
+    ssize_t bytes;
+
+    do {
+        bytes = pread(store->data_fd, buf, len, (off_t)offset);
+    } while (bytes < 0 && errno == EINTR);
+
+    return bytes;
+}
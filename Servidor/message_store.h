@@ -0,0 +1,115 @@
+// ============================================================================
+// message_store.h - Historial persistente de mensajes con índice
+// ============================================================================
+// Cada mensaje se formatea una sola vez, al guardarse, con el formato exacto
+// que recibe el cliente. El segmento de datos (.dat) es append-only y el
+// índice (.idx) guarda offset, largo y timestamp de cada registro, así que
+// cualquier rango de /history es un tramo contiguo del archivo que se envía
+// al socket con sendfile() sin pasar por buffers de usuario.
+// ============================================================================
+
+#ifndef MESSAGE_STORE_H
+#define MESSAGE_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "protocol.h"
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define HISTORY_DEFAULT_PATH "historial"   // Genera historial.dat e historial.idx
+#define HISTORY_DEFAULT_COUNT 20           // /history sin argumentos
+#define HISTORY_MAX_REPLAY 100000          // Tope de mensajes por pedido
+#define HISTORY_RECORD_MAX (MAX_MSG_LENGTH + 128)  // Registro formateado: prefijo, fecha, nick y el texto entero
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+// Entrada del índice (formato en disco)
+typedef struct {
+    uint64_t offset;     // Posición del registro en el segmento de datos
+    uint32_t length;     // Largo en bytes (incluye el '\n')
+    uint32_t reserved;
+    int64_t timestamp;   // time_t del mensaje
+} HistoryIndexEntry;
+
+// Tramo contiguo del segmento de datos listo para enviar
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+    size_t count;        // Cantidad de mensajes en el tramo
+} HistoryRange;
+
+typedef struct {
+    int data_fd;
+    int index_fd;
+    HistoryIndexEntry *entries;  // Copia en memoria del índice
+    size_t count;
+    size_t capacity;
+    uint64_t data_size;
+    pthread_mutex_t mutex;
+} MessageStore;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Abre (o crea) el historial en <path>.dat y <path>.idx
+ * Descarta registros incompletos que hayan quedado de un cierre abrupto
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int message_store_open(MessageStore *store, const char *path);
+
+/**
+ * Cierra los archivos y libera el índice en memoria
+ */
+void message_store_close(MessageStore *store);
+
+/**
+ * Agrega un mensaje al historial (thread-safe)
+ * @param from_nick Nick del remitente
+ * @param message Contenido del mensaje
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int message_store_append(MessageStore *store, const char *from_nick, const char *message);
+
+/**
+ * Calcula el tramo con los últimos n mensajes
+ */
+void message_store_range_last(MessageStore *store, size_t n, HistoryRange *range);
+
+/**
+ * Calcula el tramo con los mensajes desde el instante since (búsqueda binaria)
+ */
+void message_store_range_since(MessageStore *store, time_t since, HistoryRange *range);
+
+/**
+ * Cantidad de mensajes guardados
+ */
+size_t message_store_count(MessageStore *store);
+
+/**
+ * Posición del primer mensaje con timestamp >= since (búsqueda binaria)
+ */
+size_t message_store_find_since(MessageStore *store, time_t since);
+
+/**
+ * Copia hasta n entradas del índice desde la posición first
+ * @return Entradas copiadas
+ */
+size_t message_store_entries(MessageStore *store, size_t first, HistoryIndexEntry *out, size_t n);
+
+/**
+ * Copia bytes del segmento a buf (para destinos que no admiten sendfile)
+ * @return Bytes leídos o -1 en caso de error
+ */
+ssize_t message_store_read(MessageStore *store, uint64_t offset, void *buf, size_t len);
+
+#endif // MESSAGE_STORE_H
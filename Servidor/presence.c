@@ -0,0 +1,272 @@
+// ============================================================================
+// presence.c - Implementación de los avisos de presencia agrupados
+// ============================================================================
+
+#include "presence.h"
+#include "dashboard.h"
+#include "federation.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+#define PRESENCE_INDEX_INITIAL 256  // Potencia de 2
+
+// Cambio pendiente de un nick dentro de la ventana actual
+typedef struct {
+    char nick[NICK_SIZE];
+    char node_id[FED_NODE_ID_SIZE];  // Vacío = este nodo
+    int first;                       // Primer evento (1 = entró, 0 = salió)
+    int last;                        // Último evento
+} PresenceEntry;
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int running;
+    int window_ms;
+    int subscribers;
+    void (*deliver)(const char *frame, size_t len);
+    
+    PresenceEntry *entries;  // Pendientes, en orden de llegada
+    size_t count;
+    size_t capacity;
+    uint32_t *index;         // Tabla hash: posición + 1 en entries (0 = libre)
+    size_t index_size;
+} presence = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER
+};
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint32_t hash_key(const char *nick, const char *node_id) {
+    uint32_t h = 2166136261u;  // FNV-1a
+    for (const char *p = nick; *p; p++) h = (h ^ (unsigned char)*p) * 16777619u;
+    h = (h ^ '@') * 16777619u;
+    for (const char *p = node_id; *p; p++) h = (h ^ (unsigned char)*p) * 16777619u;
+    return h;
+}
+
+static int rebuild_index(size_t size) {
+    uint32_t *index = calloc(size, sizeof(uint32_t));
+    if (!index) return -1;
+    
+    for (size_t i = 0; i < presence.count; i++) {
+        size_t slot = hash_key(presence.entries[i].nick, presence.entries[i].node_id) & (size_t)(size - 1);
+        while (index[slot]) slot = (slot + 1) & (size - 1);
+        index[slot] = (uint32_t)(i + 1);
+    }
+    
+    free(presence.index);
+    presence.index = index;
+    presence.index_size = size;
+    return 0;
+}
+
+// Busca el cambio pendiente del nick o agrega uno nuevo (con el mutex tomado)
+static PresenceEntry *find_or_add(const char *nick, const char *node_id, int *added) {
+    if ((presence.count + 1) * 2 > presence.index_size) {
+        size_t size = presence.index_size ? presence.index_size * 2 : PRESENCE_INDEX_INITIAL;
+        if (rebuild_index(size) < 0) return NULL;
+    }
+    
+    size_t mask = presence.index_size - 1;
+    size_t slot = hash_key(nick, node_id) & mask;
+    while (presence.index[slot]) {
+        PresenceEntry *e = &presence.entries[presence.index[slot] - 1];
+        if (strcmp(e->nick, nick) == 0 && strcmp(e->node_id, node_id) == 0) {
+            *added = 0;
+            return e;
+        }
+        slot = (slot + 1) & mask;
+    }
+    
+    if (presence.count == presence.capacity) {
+        size_t capacity = presence.capacity ? presence.capacity * 2 : 64;
+        PresenceEntry *entries = realloc(presence.entries, capacity * sizeof(PresenceEntry));
+        if (!entries) return NULL;
+        presence.entries = entries;
+        presence.capacity = capacity;
+    }
+    
+    PresenceEntry *e = &presence.entries[presence.count++];
+    strncpy(e->nick, nick, NICK_SIZE - 1);
+    e->nick[NICK_SIZE - 1] = '\0';
+    strncpy(e->node_id, node_id, FED_NODE_ID_SIZE - 1);
+    e->node_id[FED_NODE_ID_SIZE - 1] = '\0';
+    presence.index[slot] = (uint32_t)presence.count;
+    *added = 1;
+    return e;
+}
+
+// Arma el bloque de una ventana: líneas "PRESENCE: +nick -nick@nodo ..."
+static char *build_frame(const PresenceEntry *entries, size_t count, size_t *len) {
+    size_t token_max = 3 + NICK_SIZE + FED_NODE_ID_SIZE;
+    size_t line_extra = strlen(RESP_PRESENCE) + 1;
+    char *frame = malloc(count * (token_max + line_extra) + 1);
+    if (!frame) return NULL;
+    
+    size_t offset = 0;
+    size_t line_start = 0;
+    int line_open = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        const PresenceEntry *e = &entries[i];
+        if (e->first != e->last) continue;  // Entró y salió (o al revés): sin cambio neto
+        
+        char token[3 + NICK_SIZE + FED_NODE_ID_SIZE];
+        int token_len = snprintf(token, sizeof(token), " %c%s%s%s", e->last ? '+' : '-',
+                                 e->nick, e->node_id[0] ? "@" : "", e->node_id);
+        
+        if (line_open && offset - line_start + token_len > PRESENCE_LINE_MAX) {
+            frame[offset++] = '\n';
+            line_open = 0;
+        }
+        if (!line_open) {
+            line_start = offset;
+            memcpy(frame + offset, RESP_PRESENCE, strlen(RESP_PRESENCE));
+            offset += strlen(RESP_PRESENCE);
+            line_open = 1;
+        }
+        memcpy(frame + offset, token, token_len);
+        offset += token_len;
+    }
+    
+    if (line_open) frame[offset++] = '\n';
+    *len = offset;
+    return frame;
+}
+
+// Saca los pendientes y los envía (se llama con el mutex tomado y lo devuelve tomado)
+static void flush_pending(void) {
+    PresenceEntry *entries = presence.entries;
+    size_t count = presence.count;
+    
+    presence.entries = NULL;
+    presence.count = 0;
+    presence.capacity = 0;
+    if (presence.index) memset(presence.index, 0, presence.index_size * sizeof(uint32_t));
+    
+    pthread_mutex_unlock(&presence.mutex);
+    
+    size_t len = 0;
+    char *frame = build_frame(entries, count, &len);
+    if (frame && len > 0) presence.deliver(frame, len);
+    free(frame);
+    free(entries);
+    
+    pthread_mutex_lock(&presence.mutex);
+}
+
+static void *presence_thread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&presence.mutex);
+    
+    while (presence.running) {
+        while (presence.running && presence.count == 0) {
+            pthread_cond_wait(&presence.cond, &presence.mutex);
+        }
+        if (!presence.running) break;
+        
+        // El primer evento abre la ventana: esperar a que se junten los demás
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += presence.window_ms / 1000;
+        deadline.tv_nsec += (long)(presence.window_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (presence.running &&
+               pthread_cond_timedwait(&presence.cond, &presence.mutex, &deadline) == 0) {
+        }
+        
+        flush_pending();
+    }
+    
+    if (presence.count > 0) flush_pending();
+    pthread_mutex_unlock(&presence.mutex);
+    return NULL;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int presence_start(int window_ms, void (*deliver)(const char *frame, size_t len)) {
+    pthread_mutex_lock(&presence.mutex);
+    presence.window_ms = window_ms > 0 ? window_ms : 0;
+    presence.deliver = deliver;
+    presence.running = 1;
+    pthread_mutex_unlock(&presence.mutex);
+    
+    if (pthread_create(&presence.thread, NULL, presence_thread, NULL) != 0) {
+        presence.running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void presence_stop(void) {
+    pthread_mutex_lock(&presence.mutex);
+    if (!presence.running) {
+        pthread_mutex_unlock(&presence.mutex);
+        return;
+    }
+    presence.running = 0;
+    pthread_cond_broadcast(&presence.cond);
+    pthread_mutex_unlock(&presence.mutex);
+    
+    pthread_join(presence.thread, NULL);
+    
+    free(presence.entries);
+    free(presence.index);
+    presence.entries = NULL;
+    presence.index = NULL;
+    presence.count = presence.capacity = presence.index_size = 0;
+}
+
+void presence_set_window(int window_ms) {
+    pthread_mutex_lock(&presence.mutex);
+    presence.window_ms = window_ms > 0 ? window_ms : 0;
+    pthread_mutex_unlock(&presence.mutex);
+}
+
+void presence_subscribe(void) {
+    pthread_mutex_lock(&presence.mutex);
+    presence.subscribers++;
+    pthread_mutex_unlock(&presence.mutex);
+}
+
+void presence_unsubscribe(void) {
+    pthread_mutex_lock(&presence.mutex);
+    if (presence.subscribers > 0) presence.subscribers--;
+    pthread_mutex_unlock(&presence.mutex);
+}
+
+void presence_event(const char *nick, const char *node_id, int joined) {
+    pthread_mutex_lock(&presence.mutex);
+    
+    if (presence.running && presence.subscribers > 0) {
+        int added;
+        PresenceEntry *e = find_or_add(nick, node_id ? node_id : "", &added);
+        if (e) {
+            if (added) e->first = joined;
+            e->last = joined;
+            if (added && presence.count == 1) pthread_cond_signal(&presence.cond);
+        }
+    }
+    
+    pthread_mutex_unlock(&presence.mutex);
+}
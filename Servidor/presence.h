@@ -0,0 +1,56 @@
+// ============================================================================
+// presence.h - Avisos de entradas y salidas agrupados por ventana de tiempo
+// ============================================================================
+// Los clientes suscriptos con /watch reciben las altas y bajas sin tener que
+// pedir /list. Los eventos se juntan durante una ventana (50 ms por defecto)
+// y se envían en un solo bloque por suscriptor; dentro de la ventana un nick
+// que entra y sale (o sale y vuelve) se cancela. Una ola de reconexiones se
+// convierte así en unos pocos envíos por suscriptor.
+// ============================================================================
+
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+#include <stddef.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define PRESENCE_DEFAULT_WINDOW_MS 50
+#define PRESENCE_LINE_MAX 960  // Largo de cada línea PRESENCE: del bloque
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Arranca el thread que vacía los eventos al final de cada ventana
+ * @param deliver Envía un bloque a todos los suscriptores (sin locks del módulo tomados)
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int presence_start(int window_ms, void (*deliver)(const char *frame, size_t len));
+
+/**
+ * Envía lo pendiente y detiene el thread
+ */
+void presence_stop(void);
+
+/**
+ * Cambia la ventana en la que se juntan los avisos (desde la próxima)
+ */
+void presence_set_window(int window_ms);
+
+/**
+ * Cuenta un suscriptor más / menos (sin suscriptores los eventos se descartan)
+ */
+void presence_subscribe(void);
+void presence_unsubscribe(void);
+
+/**
+ * Registra que un nick entró (joined = 1) o salió (joined = 0)
+ * @param node_id Nodo del cliente (NULL = este nodo)
+ */
+void presence_event(const char *nick, const char *node_id, int joined);
+
+#endif // PRESENCE_H
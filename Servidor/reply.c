@@ -0,0 +1,46 @@
+// ============================================================================
+// reply.c - Implementación del armado de respuestas por fragmentos
+// ============================================================================
+
+#include "reply.h"
+#include <string.h>
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+void reply_init(Reply *reply) {
+    reply->count = 0;
+    reply->len = 0;
+    reply->scratch_used = 0;
+}
+
+void reply_add(Reply *reply, const void *data, size_t len) {
+    if (len == 0 || reply->count >= REPLY_MAX_IOV) return;
+    
+    reply->iov[reply->count].iov_base = (void *)data;
+    reply->iov[reply->count].iov_len = len;
+    reply->count++;
+    reply->len += len;
+}
+
+void reply_add_str(Reply *reply, const char *text) {
+    reply_add(reply, text, strlen(text));
+}
+
+void reply_add_uint(Reply *reply, unsigned long value) {
+    char digits[24];
+    size_t n = 0;
+    
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    
+    if (reply->scratch_used + n > REPLY_SCRATCH) return;
+    
+    char *out = reply->scratch + reply->scratch_used;
+    for (size_t i = 0; i < n; i++) out[i] = digits[n - 1 - i];
+    reply->scratch_used += n;
+    reply_add(reply, out, n);
+}
@@ -0,0 +1,111 @@
+// ============================================================================
+// reply.h - Respuestas del servidor sin formateo en el camino caliente
+// ============================================================================
+// Las respuestas constantes son literales que arma el compilador (no se
+// formatean en cada pedido). Las variables se arman como una lista de
+// fragmentos (prefijo, nick, texto del usuario, ...) que apuntan a los datos
+// originales y se envían con un solo writev/sendmsg, sin copiar el texto.
+// ============================================================================
+
+#ifndef REPLY_H
+#define REPLY_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include "protocol.h"
+
+// ============================================================================
+// Respuestas constantes
+// ============================================================================
+
+#define REPLY_HELP \
+    RESP_INFO " === COMANDOS DISPONIBLES ===\n" \
+    RESP_INFO " /list [página] - Ver clientes conectados\n" \
+    RESP_INFO " /msg <nick> <mensaje> - Enviar mensaje privado a un cliente\n" \
+    RESP_INFO " /broadcast <mensaje> - Enviar mensaje a todos los clientes\n" \
+    RESP_INFO " /history [n|HH:MM|30m] - Ver mensajes anteriores\n" \
+    RESP_INFO " /search <palabras> [from:nick] [since:30m] - Buscar en el historial\n" \
+    RESP_INFO " /watch     - Recibir avisos de entradas y salidas (/unwatch para cortar)\n" \
+    RESP_INFO " /session   - Token para retomar la sesión sin perder mensajes si se corta\n" \
+    RESP_INFO " /send <nick> <bytes> [nombre] - Ofrecer un archivo\n" \
+    RESP_INFO " /accept <id> - Aceptar un archivo (/reject <id> para rechazarlo)\n" \
+    RESP_INFO " /help      - Mostrar esta ayuda\n" \
+    RESP_INFO " /quit      - Desconectarse del servidor\n" \
+    RESP_HELP_END "\n"
+
+#define REPLY_PING RESP_PING "\n"
+#define REPLY_SERVER_FULL "Servidor lleno\n"
+#define REPLY_HANDSHAKE_TIMEOUT RESP_ERROR " Tiempo agotado esperando el nick\n"
+#define REPLY_IDLE_TIMEOUT RESP_ERROR " Desconectado por inactividad\n"
+#define REPLY_MSG_USAGE RESP_ERROR " Uso: /msg <nick> <mensaje>\n"
+#define REPLY_BROADCAST_USAGE RESP_ERROR " Uso: /broadcast <mensaje>\n"
+#define REPLY_MSG_TOO_LONG RESP_ERROR " Mensaje demasiado largo (hasta 32 KB, MAX_MSG_LENGTH)\n"
+#define REPLY_LIST_USAGE RESP_ERROR " Uso: /list [página]\n"
+#define REPLY_LIST_NO_PAGE RESP_ERROR " Esa página no existe\n"
+#define REPLY_LIST_UNAVAILABLE RESP_ERROR " No se pudo armar la lista de clientes\n"
+#define REPLY_HISTORY_USAGE RESP_ERROR " Uso: /history [n|HH:MM|30m|2h|1d]\n"
+#define REPLY_HISTORY_DISABLED RESP_ERROR " El historial está desactivado\n"
+#define REPLY_HISTORY_END RESP_HISTORY_END "\n"
+#define REPLY_SEARCH_USAGE RESP_ERROR " Uso: /search <palabras> [from:nick] [since:HH:MM|30m|2h|1d]\n"
+#define REPLY_SEARCH_END RESP_SEARCH_END "\n"
+#define REPLY_WATCH_ON RESP_INFO " Vas a recibir las entradas y salidas (/unwatch para cortar)\n"
+#define REPLY_WATCH_OFF RESP_INFO " Ya no vas a recibir entradas y salidas\n"
+#define REPLY_SESSION_DISABLED RESP_INFO " Este servidor no guarda sesiones (no se puede usar /resume)\n"
+#define REPLY_RESUME_USAGE RESP_ERROR " Uso: /resume <token> <secuencia>\n"
+#define REPLY_RESUME_UNKNOWN RESP_ERROR " Sesión desconocida o vencida: envía el nick para entrar de nuevo\n"
+#define REPLY_SEND_USAGE RESP_ERROR " Uso: /send <nick> <bytes> [nombre]\n"
+#define REPLY_SEND_SELF RESP_ERROR " No puedes enviarte un archivo a ti mismo\n"
+#define REPLY_SEND_BUSY RESP_ERROR " Hay demasiadas transferencias en curso, reintenta en un rato\n"
+#define REPLY_ACCEPT_USAGE RESP_ERROR " Uso: /accept <id>\n"
+#define REPLY_REJECT_USAGE RESP_ERROR " Uso: /reject <id>\n"
+#define REPLY_TRANSFER_UNKNOWN RESP_ERROR " No hay una oferta pendiente con ese id para ti\n"
+#define REPLY_XFER_UNKNOWN RESP_ERROR " Token de transferencia desconocido o vencido\n"
+#define REPLY_XFER_EARLY RESP_ERROR " Los datos llegaron antes de FILE_START\n"
+#define REPLY_XFER_LOCAL RESP_ERROR " Las transferencias van por TCP, no por el socket local\n"
+#define REPLY_RATE_LIMITED RESP_ERROR " Demasiados comandos: se descartan hasta que bajes el ritmo\n"
+#define REPLY_RATE_DROPPED RESP_ERROR " Descartado\n"
+#define REPLY_UNKNOWN RESP_ERROR " Comando no reconocido. Usa /help para ver comandos.\n"
+#define REPLY_GOODBYE "\nServidor cerrando. Desconectando...\n"
+
+// Largo de una respuesta constante (sin el '\0')
+#define REPLY_LEN(literal) (sizeof(literal) - 1)
+
+// ============================================================================
+// Respuestas armadas por fragmentos
+// ============================================================================
+
+#define REPLY_MAX_IOV 8
+#define REPLY_SCRATCH 32  // Para los números que hay que pasar a texto
+
+typedef struct {
+    struct iovec iov[REPLY_MAX_IOV];
+    int count;
+    size_t len;                   // Bytes totales
+    char scratch[REPLY_SCRATCH];  // Los fragmentos numéricos viven acá
+    size_t scratch_used;
+} Reply;
+
+/**
+ * Deja la respuesta vacía
+ */
+void reply_init(Reply *reply);
+
+/**
+ * Agrega un fragmento sin copiarlo (debe seguir vivo hasta el envío)
+ */
+void reply_add(Reply *reply, const void *data, size_t len);
+
+/**
+ * Agrega una cadena terminada en '\0'
+ */
+void reply_add_str(Reply *reply, const char *text);
+
+/**
+ * Agrega un número en decimal (se escribe en el scratch de la respuesta)
+ */
+void reply_add_uint(Reply *reply, unsigned long value);
+
+// Agrega un literal sin recorrerlo con strlen()
+#define reply_add_lit(reply, literal) reply_add((reply), (literal), REPLY_LEN(literal))
+
+#endif // REPLY_H
@@ -0,0 +1,537 @@
+// ============================================================================
+// search.c - Implementación del índice invertido del historial
+// ============================================================================
+
+#include "search.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+#define DICT_INITIAL 4096         // Casilleros iniciales de la tabla (potencia de 2)
+#define POSTINGS_INITIAL 8        // Bytes de una lista nueva
+#define VARINT_MAX 5              // Bytes de una distancia de 32 bits
+#define SKIP_EVERY 128            // Entradas por bloque de la lista
+
+// Comienzo de un bloque: desde acá se puede decodificar sin leer lo anterior
+typedef struct {
+    uint32_t before;          // Mensaje anterior al primero del bloque (0 en el primero)
+    uint32_t offset;          // Byte de postings donde empieza
+} Skip;
+
+// Una palabra (o "@nick") y la lista comprimida de los mensajes que la tienen
+typedef struct {
+    uint32_t hash;
+    uint32_t count;           // Mensajes en la lista
+    uint32_t last;            // El último agregado: las entradas son distancias
+    uint32_t size;            // Bytes usados de postings
+    uint32_t cap;
+    uint8_t *postings;        // Varints: distancia al anterior (el primero, desde 0)
+    Skip *skips;              // Uno cada SKIP_EVERY entradas
+    uint32_t skip_cap;
+    char text[SEARCH_TERM_MAX + 1];
+} Term;
+
+// Recorrido de una lista durante una búsqueda
+typedef struct {
+    const Term *t;
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t doc;             // Mensaje actual
+    uint32_t next;            // Número de la próxima entrada a decodificar
+} Cursor;
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static struct {
+    pthread_rwlock_t lock;    // El índice: lo escribe el thread, lo leen las búsquedas
+    pthread_mutex_t mutex;    // Para dormir al thread entre tandas
+    pthread_cond_t cond;
+    pthread_t thread;
+    int running;
+    MessageStore *store;
+    
+    Term *terms;              // En orden de aparición
+    uint32_t term_count;
+    uint32_t term_cap;
+    uint32_t *slots;          // Tabla hash: posición en terms + 1 (0 = libre)
+    uint32_t slot_count;
+    
+    uint64_t indexed;         // Atómico: mensajes ya indexados
+    uint64_t postings;
+    uint64_t postings_bytes;
+    uint64_t postings_cap;
+    uint64_t queries;         // Los tres de las búsquedas son atómicos
+    uint64_t query_us;
+    uint64_t max_query_us;
+} search = {
+    .lock = PTHREAD_RWLOCK_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER
+};
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// FNV-1a
+static uint32_t hash_term(const char *text) {
+    uint32_t h = 2166136261u;
+    for (; *text; text++) h = (h ^ (uint8_t)*text) * 16777619u;
+    return h;
+}
+
+// Letras, dígitos y cualquier byte de UTF-8 (acentos, ñ) forman palabras
+static int is_word_byte(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+static char lower(char c) {
+    return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
+
+// Próxima palabra de [*p, end) en minúsculas; retorna su largo (0 = no hay más)
+static size_t next_word(const char **p, const char *end, char *out) {
+    const char *s = *p;
+    size_t len = 0;
+    
+    while (s < end && !is_word_byte((unsigned char)*s)) s++;
+    for (; s < end && is_word_byte((unsigned char)*s); s++) {
+        if (len < SEARCH_TERM_MAX) out[len++] = lower(*s);
+    }
+    out[len] = '\0';
+    *p = s;
+    return len;
+}
+
+// El remitente como término: '@' no forma palabras, así que no se confunde
+static void nick_term(const char *nick, size_t len, char *out) {
+    size_t n = 0;
+    out[n++] = '@';
+    for (size_t i = 0; i < len && n < SEARCH_TERM_MAX; i++) out[n++] = lower(nick[i]);
+    out[n] = '\0';
+}
+
+// Con el lock tomado (lectura o escritura); NULL si no está
+static Term *find_term(const char *text, uint32_t hash) {
+    if (!search.slots) return NULL;
+    
+    uint32_t mask = search.slot_count - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        uint32_t slot = search.slots[i];
+        if (slot == 0) return NULL;
+        Term *t = &search.terms[slot - 1];
+        if (t->hash == hash && strcmp(t->text, text) == 0) return t;
+    }
+}
+
+// Duplica la tabla y vuelve a ubicar los términos (con el lock de escritura)
+static int grow_slots(void) {
+    uint32_t count = search.slot_count ? search.slot_count * 2 : DICT_INITIAL;
+    uint32_t *slots = calloc(count, sizeof(uint32_t));
+    if (!slots) return -1;
+    
+    for (uint32_t t = 0; t < search.term_count; t++) {
+        uint32_t i = search.terms[t].hash & (count - 1);
+        while (slots[i]) i = (i + 1) & (count - 1);
+        slots[i] = t + 1;
+    }
+    free(search.slots);
+    search.slots = slots;
+    search.slot_count = count;
+    return 0;
+}
+
+// Con el lock de escritura; el puntero vale hasta el próximo add_term()
+static Term *add_term(const char *text, uint32_t hash) {
+    if ((uint64_t)(search.term_count + 1) * 4 > (uint64_t)search.slot_count * 3 && grow_slots() < 0) {
+        return NULL;
+    }
+    if (search.term_count == search.term_cap) {
+        uint32_t cap = search.term_cap ? search.term_cap * 2 : DICT_INITIAL;
+        Term *terms = realloc(search.terms, cap * sizeof(Term));
+        if (!terms) return NULL;
+        search.terms = terms;
+        search.term_cap = cap;
+    }
+    
+    Term *t = &search.terms[search.term_count];
+    memset(t, 0, sizeof(*t));
+    t->hash = hash;
+    snprintf(t->text, sizeof(t->text), "%s", text);
+    
+    uint32_t mask = search.slot_count - 1;
+    uint32_t i = hash & mask;
+    while (search.slots[i]) i = (i + 1) & mask;
+    search.slots[i] = ++search.term_count;
+    return t;
+}
+
+// Agrega el mensaje doc a la lista (una vez aunque la palabra se repita)
+static void add_posting(Term *t, uint32_t doc) {
+    if (t->count > 0 && t->last == doc) return;
+    
+    if (t->count % SKIP_EVERY == 0) {
+        uint32_t block = t->count / SKIP_EVERY;
+        if (block == t->skip_cap) {
+            uint32_t cap = t->skip_cap ? t->skip_cap * 2 : 1;
+            Skip *skips = realloc(t->skips, cap * sizeof(Skip));
+            if (!skips) return;
+            search.postings_cap += (cap - t->skip_cap) * sizeof(Skip);
+            t->skips = skips;
+            t->skip_cap = cap;
+        }
+        t->skips[block].before = t->count > 0 ? t->last : 0;
+        t->skips[block].offset = t->size;
+    }
+    
+    if (t->size + VARINT_MAX > t->cap) {
+        uint32_t cap = t->cap ? t->cap * 2 : POSTINGS_INITIAL;
+        uint8_t *postings = realloc(t->postings, cap);
+        if (!postings) return;
+        search.postings_cap += cap - t->cap;
+        t->postings = postings;
+        t->cap = cap;
+    }
+    
+    uint32_t delta = doc - (t->count > 0 ? t->last : 0);
+    uint32_t before = t->size;
+    while (delta >= 0x80) {
+        t->postings[t->size++] = (uint8_t)(delta | 0x80);
+        delta >>= 7;
+    }
+    t->postings[t->size++] = (uint8_t)delta;
+    
+    t->last = doc;
+    t->count++;
+    search.postings++;
+    search.postings_bytes += t->size - before;
+}
+
+static void index_term(uint32_t doc, const char *text) {
+    uint32_t hash = hash_term(text);
+    Term *t = find_term(text, hash);
+    if (!t) t = add_term(text, hash);
+    if (t) add_posting(t, doc);
+}
+
+// "HISTORY: [fecha hora] nick: texto\n" (con el lock de escritura tomado)
+static void index_record(uint32_t doc, const char *record, size_t len) {
+    const char *end = record + len;
+    char word[SEARCH_TERM_MAX + 1];
+    
+    const char *nick = memchr(record, ']', len);
+    if (!nick || end - nick < 2) return;
+    nick += 2;
+    const char *colon = nick;
+    while (colon + 1 < end && !(colon[0] == ':' && colon[1] == ' ')) colon++;
+    if (colon + 1 >= end) return;
+    
+    nick_term(nick, (size_t)(colon - nick), word);
+    index_term(doc, word);
+    
+    const char *p = colon + 2;
+    while (next_word(&p, end, word) > 0) index_term(doc, word);
+}
+
+static void cursor_init(Cursor *c, const Term *t) {
+    c->t = t;
+    c->p = t->postings;
+    c->end = t->postings + t->size;
+    c->doc = 0;
+    c->next = 0;
+}
+
+// Deja el cursor al comienzo del bloque (la próxima entrada es su primera)
+static void cursor_jump(Cursor *c, uint32_t block) {
+    c->p = c->t->postings + c->t->skips[block].offset;
+    c->doc = c->t->skips[block].before;
+    c->next = block * SKIP_EVERY;
+}
+
+// Avanza al próximo mensaje de la lista; retorna 0 si se terminó
+static int cursor_next(Cursor *c) {
+    uint32_t delta = 0;
+    int shift = 0;
+    
+    for (;;) {
+        if (c->p >= c->end) return 0;
+        uint8_t b = *c->p++;
+        delta |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+        shift += 7;
+    }
+    c->doc += delta;
+    c->next++;
+    return 1;
+}
+
+// Avanza hasta el primer mensaje >= target salteando los bloques que
+// terminan antes (búsqueda binaria en los saltos); retorna 0 si no hay
+static int cursor_seek(Cursor *c, uint32_t target) {
+    if (c->next > 0 && c->doc >= target) return 1;
+    
+    // Último bloque que empieza antes de target, si está más adelante
+    uint32_t lo = c->next / SKIP_EVERY + 1;
+    uint32_t hi = (c->t->count + SKIP_EVERY - 1) / SKIP_EVERY;
+    if (lo < hi && c->t->skips[lo].before < target) {
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (c->t->skips[mid].before < target) lo = mid;
+            else hi = mid;
+        }
+        cursor_jump(c, lo);
+    }
+    
+    do {
+        if (!cursor_next(c)) return 0;
+    } while (c->doc < target);
+    return 1;
+}
+
+// Una sola lista: el total sale de las posiciones y solo se decodifica el
+// final (los últimos SEARCH_MAX_RESULTS)
+static void scan_single(Cursor *c, uint32_t first, SearchResult *out) {
+    if (!cursor_seek(c, first)) return;
+    uint32_t from = c->next - 1;  // Primera entrada >= first
+    out->total = c->t->count - from;
+    
+    uint32_t tail = c->t->count - (uint32_t)(out->total < SEARCH_MAX_RESULTS ? out->total : SEARCH_MAX_RESULTS);
+    if (tail / SKIP_EVERY > from / SKIP_EVERY) {
+        cursor_jump(c, tail / SKIP_EVERY);
+        if (!cursor_next(c)) return;
+    }
+    
+    // En el anillo, cada una en la posición que le toca por su número
+    do {
+        uint32_t entry = c->next - 1;
+        if (entry >= tail) out->ids[(entry - from) % SEARCH_MAX_RESULTS] = c->doc;
+    } while (cursor_next(c));
+}
+
+// Mensajes desde first que están en todas las listas; guarda los últimos
+// SEARCH_MAX_RESULTS en un anillo. La lista más corta propone y las demás
+// saltan hasta su candidato.
+static void intersect(Cursor *cursors, int count, uint32_t first, SearchResult *out) {
+    if (count == 1) {
+        scan_single(&cursors[0], first, out);
+        return;
+    }
+    
+    uint32_t target = first;
+    for (;;) {
+        int i;
+        for (i = 0; i < count; i++) {
+            if (!cursor_seek(&cursors[i], target)) return;
+            if (cursors[i].doc > target) break;
+        }
+        if (i < count) {
+            target = cursors[i].doc;
+            continue;
+        }
+        out->ids[out->total % SEARCH_MAX_RESULTS] = target;
+        out->total++;
+        target++;
+    }
+}
+
+static void wait_poll(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += SEARCH_POLL_MS * 1000000L;
+    ts.tv_sec += ts.tv_nsec / 1000000000L;
+    ts.tv_nsec %= 1000000000L;
+    
+    pthread_mutex_lock(&search.mutex);
+    if (search.running) pthread_cond_timedwait(&search.cond, &search.mutex, &ts);
+    pthread_mutex_unlock(&search.mutex);
+}
+
+// Lee del segmento el tramo de una tanda (los registros son contiguos)
+static int read_span(uint64_t offset, char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t got = message_store_read(search.store, offset, buf, len);
+        if (got <= 0) return -1;
+        offset += (uint64_t)got;
+        buf += got;
+        len -= (size_t)got;
+    }
+    return 0;
+}
+
+static void *search_thread(void *arg) {
+    HistoryIndexEntry *batch = malloc(SEARCH_BATCH * sizeof(HistoryIndexEntry));
+    char *data = NULL;
+    size_t data_cap = 0;
+    (void)arg;
+    stats_register_thread("buscador");
+    
+    while (__atomic_load_n(&search.running, __ATOMIC_RELAXED)) {
+        uint64_t indexed = search.indexed;
+        size_t n = batch ? message_store_entries(search.store, (size_t)indexed, batch, SEARCH_BATCH) : 0;
+        if (n == 0 || indexed + n > UINT32_MAX) {
+            wait_poll();
+            continue;
+        }
+        
+        uint64_t offset = batch[0].offset;
+        size_t bytes = (size_t)(batch[n - 1].offset + batch[n - 1].length - offset);
+        if (bytes > data_cap) {
+            char *grown = realloc(data, bytes);
+            if (!grown) {
+                wait_poll();
+                continue;
+            }
+            data = grown;
+            data_cap = bytes;
+        }
+        if (read_span(offset, data, bytes) < 0) {
+            wait_poll();
+            continue;
+        }
+        
+        // Una tanda por vez: las búsquedas esperan a lo sumo una tanda
+        pthread_rwlock_wrlock(&search.lock);
+        for (size_t i = 0; i < n; i++) {
+            index_record((uint32_t)(indexed + i), data + (batch[i].offset - offset), batch[i].length);
+        }
+        __atomic_store_n(&search.indexed, indexed + n, __ATOMIC_RELAXED);
+        pthread_rwlock_unlock(&search.lock);
+    }
+    
+    free(data);
+    free(batch);
+    return NULL;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int search_start(MessageStore *store) {
+    search.store = store;
+    __atomic_store_n(&search.running, 1, __ATOMIC_RELAXED);
+    
+    if (pthread_create(&search.thread, NULL, search_thread, NULL) != 0) {
+        search.running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void search_stop(void) {
+    pthread_mutex_lock(&search.mutex);
+    if (!search.running) {
+        pthread_mutex_unlock(&search.mutex);
+        return;
+    }
+    __atomic_store_n(&search.running, 0, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&search.cond);
+    pthread_mutex_unlock(&search.mutex);
+    
+    pthread_join(search.thread, NULL);
+    
+    pthread_rwlock_wrlock(&search.lock);
+    for (uint32_t t = 0; t < search.term_count; t++) {
+        free(search.terms[t].postings);
+        free(search.terms[t].skips);
+    }
+    free(search.terms);
+    free(search.slots);
+    search.terms = NULL;
+    search.slots = NULL;
+    search.term_count = search.term_cap = search.slot_count = 0;
+    search.postings = search.postings_bytes = search.postings_cap = 0;
+    __atomic_store_n(&search.indexed, 0, __ATOMIC_RELAXED);
+    search.store = NULL;
+    pthread_rwlock_unlock(&search.lock);
+}
+
+int search_run(const char *terms, const char *from, size_t first, SearchResult *out) {
+    char words[SEARCH_MAX_TERMS + 1][SEARCH_TERM_MAX + 1];
+    Cursor cursors[SEARCH_MAX_TERMS + 1];
+    int count = 0;
+    
+    const char *p = terms;
+    const char *end = terms + strlen(terms);
+    while (count < SEARCH_MAX_TERMS && next_word(&p, end, words[count]) > 0) count++;
+    if (from[0]) nick_term(from, strlen(from), words[count++]);
+    if (count == 0) return -1;
+    
+    out->total = 0;
+    out->count = 0;
+    uint64_t t0 = now_us();
+    
+    pthread_rwlock_rdlock(&search.lock);
+    int found = 1;
+    for (int i = 0; i < count; i++) {
+        Term *t = find_term(words[i], hash_term(words[i]));
+        if (!t) {
+            found = 0;
+            break;
+        }
+        
+        // Ordenadas de la más corta a la más larga: la primera marca el paso
+        Cursor c;
+        cursor_init(&c, t);
+        int j = i;
+        while (j > 0 && cursors[j - 1].t->count > c.t->count) {
+            cursors[j] = cursors[j - 1];
+            j--;
+        }
+        cursors[j] = c;
+    }
+    if (found) intersect(cursors, count, first > UINT32_MAX ? UINT32_MAX : (uint32_t)first, out);
+    pthread_rwlock_unlock(&search.lock);
+    
+    // Del anillo al orden cronológico
+    out->count = out->total < SEARCH_MAX_RESULTS ? out->total : SEARCH_MAX_RESULTS;
+    if (out->total > SEARCH_MAX_RESULTS) {
+        uint32_t ordered[SEARCH_MAX_RESULTS];
+        size_t start = out->total % SEARCH_MAX_RESULTS;
+        for (size_t i = 0; i < SEARCH_MAX_RESULTS; i++) {
+            ordered[i] = out->ids[(start + i) % SEARCH_MAX_RESULTS];
+        }
+        memcpy(out->ids, ordered, sizeof(ordered));
+    }
+    
+    uint64_t elapsed = now_us() - t0;
+    __atomic_add_fetch(&search.queries, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&search.query_us, elapsed, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&search.max_query_us, __ATOMIC_RELAXED);
+    while (elapsed > max && !__atomic_compare_exchange_n(&search.max_query_us, &max, elapsed, 0,
+                                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    return 0;
+}
+
+void search_get_stats(SearchStats *out) {
+    pthread_rwlock_rdlock(&search.lock);
+    out->indexed = __atomic_load_n(&search.indexed, __ATOMIC_RELAXED);
+    out->terms = search.term_count;
+    out->postings = search.postings;
+    out->postings_bytes = search.postings_bytes;
+    out->memory = (uint64_t)search.term_cap * sizeof(Term) + (uint64_t)search.slot_count * sizeof(uint32_t) +
+                  search.postings_cap;
+    MessageStore *store = search.store;
+    pthread_rwlock_unlock(&search.lock);
+    
+    out->stored = store ? message_store_count(store) : 0;
+    out->queries = __atomic_load_n(&search.queries, __ATOMIC_RELAXED);
+    out->query_us = __atomic_load_n(&search.query_us, __ATOMIC_RELAXED);
+    out->max_query_us = __atomic_load_n(&search.max_query_us, __ATOMIC_RELAXED);
+}
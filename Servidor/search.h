@@ -0,0 +1,85 @@
+// ============================================================================
+// search.h - Búsqueda de texto en el historial con un índice invertido
+// ============================================================================
+// /search no recorre el historial: cada palabra (en minúsculas) tiene la
+// lista de los mensajes que la contienen, ordenada, y una búsqueda intersecta
+// las listas de sus palabras. El remitente se indexa como un término más
+// ("@nick"), así que from:nick es otra lista; since: empieza a intersectar
+// desde el primer mensaje de ese instante (búsqueda binaria en el índice del
+// historial).
+//
+// Las listas se guardan comprimidas: la distancia al mensaje anterior en un
+// varint (1 byte para la mayoría de las palabras frecuentes). Un thread
+// propio lee el historial por tandas y agrega lo nuevo; los workers nunca
+// indexan. Al arrancar se reconstruye en segundo plano desde historial.dat:
+// mientras tanto las búsquedas cubren lo ya indexado.
+// ============================================================================
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "message_store.h"
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define SEARCH_MAX_RESULTS 50       // Las más recientes que se devuelven
+#define SEARCH_MAX_TERMS 8          // Palabras por búsqueda (las demás se ignoran)
+#define SEARCH_TERM_MAX 32          // Bytes de una palabra (las más largas se cortan)
+#define SEARCH_BATCH 1024           // Mensajes que el thread indexa por tanda
+#define SEARCH_POLL_MS 200          // Cada cuánto mira si hay mensajes nuevos
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct {
+    size_t total;                       // Mensajes que coinciden
+    size_t count;                       // Devueltos: los más recientes
+    uint32_t ids[SEARCH_MAX_RESULTS];   // Posición en el historial, del más viejo al más nuevo
+} SearchResult;
+
+typedef struct {
+    uint64_t indexed;         // Mensajes indexados
+    uint64_t stored;          // Mensajes en el historial
+    uint64_t terms;           // Palabras distintas (y remitentes)
+    uint64_t postings;        // Entradas en todas las listas
+    uint64_t postings_bytes;  // Lo que ocupan comprimidas
+    uint64_t memory;          // Diccionario y listas reservados
+    uint64_t queries;
+    uint64_t query_us;        // Tiempo total de las búsquedas
+    uint64_t max_query_us;
+} SearchStats;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Arranca el thread que indexa el historial (lo ya guardado y lo que llegue)
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int search_start(MessageStore *store);
+
+/**
+ * Detiene el thread y libera el índice
+ */
+void search_stop(void);
+
+/**
+ * Busca los mensajes que contienen todas las palabras de terms
+ * @param from Nick del remitente ("" = cualquiera)
+ * @param first Posición del primer mensaje a considerar (since:)
+ * @return 0 si tiene éxito, -1 si no hay ni palabras ni remitente
+ */
+int search_run(const char *terms, const char *from, size_t first, SearchResult *out);
+
+/**
+ * Tamaño del índice y tiempos de las búsquedas
+ */
+void search_get_stats(SearchStats *out);
+
+#endif // SEARCH_H
@@ -1,10 +1,12 @@
 // ============================================================================
 // servidor.c - Servidor multi-cliente con dashboard tipo htop
 // ============================================================================
-// Compilar: gcc servidor.c dashboard.c ../util/network.c -o servidor -I../util -pthread
+// Compilar: gcc servidor.c dashboard.c dashboard_shm.c timer_wheel.c upgrade.c message_store.c federation.c reply.c list_snapshot.c presence.c capture.c stats.c tracer.c affinity.c admin.c session.c coalesce.c zerocopy.c transfer.c search.c lanes.c ../util/network.c ../util/shm_channel.c -o servidor -I../util -pthread
 // Ejecutar: ./servidor 5000
 // ============================================================================
 
+#define _GNU_SOURCE  // pipe2(), cpu_set_t
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,11 +14,157 @@
 #include <unistd.h>
 #include <signal.h>
 #include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <malloc.h>
+#include <poll.h>
+#include <sched.h>
 #include "network.h"
 #include "dashboard.h"
+#include "dashboard_shm.h"
 #include "protocol.h"
+#include "timer_wheel.h"
+#include "upgrade.h"
+#include "message_store.h"
+#include "federation.h"
+#include "shm_channel.h"
+#include "reply.h"
+#include "list_snapshot.h"
+#include "presence.h"
+#include "capture.h"
+#include "stats.h"
+#include "tracer.h"
+#include "affinity.h"
+#include "admin.h"
+#include "session.h"
+#include "coalesce.h"
+#include "zerocopy.h"
+#include "transfer.h"
+#include "search.h"
+#include "lanes.h"
 
 #define BUF_SIZE 1024
+#define MAX_LINE (MAX_MSG_LENGTH + 128)  // Comando más largo: "/msg <nick> " o "/broadcast " y el texto
+#define MAX_WORKERS 64
+#define MAX_EVENTS 64
+#define DEFAULT_BACKLOG 10          // El que usa CreateServerSocket() (util/network.c)
+#define LOCAL_SEND_TIMEOUT_MS 1000  // Espera máxima si el anillo de un cliente local está lleno
+#define DEFAULT_RESUME_WINDOW 128   // Mensajes que guarda cada sesión de /session
+#define READ_POOL_MAX 256           // Buffers de líneas incompletas que guarda cada worker
+#define FD_RESERVED 256             // Descriptores propios (epoll, pipes, historial, enlaces) además de los clientes
+#define BUSY_POLL_MAX_US 100000     // Tope de --busy-poll-us y --busy-poll-sock
+
+// ============================================================================
+// Estructuras internas del servidor
+// ============================================================================
+
+// Configuración de arranque (ver usage())
+typedef struct {
+    int port;
+    int workers;
+    int handshake_timeout;  // Segundos para enviar el nick (0 = sin límite)
+    int idle_timeout;       // Segundos sin comandos antes de desconectar (0 = sin límite)
+    int ping_interval;      // Segundos de silencio antes de enviar PING (0 = desactivado)
+    int pong_timeout;       // Segundos para responder un PING
+    const char* history_path;  // Prefijo de los archivos del historial (NULL = desactivado)
+    const char* node_id;       // Nombre del nodo en la malla (NULL = sin federación)
+    int peer_port;             // Puerto para enlaces de otros nodos (0 = solo salientes)
+    const char* peers[FED_MAX_PEERS];  // Nodos a los que se enlaza (host:puerto)
+    int peer_count;
+    const char* peer_secret;   // Clave del HELLO entre nodos (NULL = enlaces entrantes solo por loopback)
+    const char* local_socket;  // Socket UNIX para clientes por memoria compartida (NULL = no)
+    int presence_window;       // Milisegundos en los que se juntan los avisos de /watch
+    const char* capture_path;  // Traza del tráfico entrante (NULL = sin captura)
+    const char* trace_path;    // Volcado del trazado (NULL = traza-<pid>.json)
+    const char* cpu_list;      // CPUs de los workers, uno por CPU (NULL = sin fijar)
+    const char* numa_list;     // Nodos NUMA de los workers (NULL = sin fijar)
+    int show_placement;        // Mostrar la ubicación y el steering, y salir
+    const char* admin_socket;  // Socket UNIX de administración (NULL = no)
+    const char* stats_shm;     // Segmento del dashboard (NULL = /servidor-<puerto>)
+    int no_dashboard;          // Sin dashboard en la terminal (solo se publica)
+    int attach;                // Dibujar el dashboard de otro proceso y salir
+    // Ajustables en caliente por el socket de administración
+    int backlog;               // Cola de conexiones sin aceptar del listen()
+    int rate_limit;            // Comandos por segundo por conexión (0 = sin límite)
+    int rate_burst;            // Comandos seguidos antes de aplicar el límite
+    int sndbuf_kb;             // Buffer de envío de cada conexión nueva (0 = el del kernel)
+    int local_send_timeout;    // Milisegundos de espera si el anillo de un cliente local está lleno
+    int dashboard_refresh;     // Milisegundos entre refrescos del dashboard
+    int resume_window;         // Mensajes guardados por sesión (0 = sin /session)
+    int resume_grace;          // Segundos que se guarda una sesión desconectada
+    int coalesce_ms;           // Plazo para agrupar los mensajes de cada destinatario (0 = no)
+    int zerocopy_min;          // Broadcasts desde este tamaño salen con MSG_ZEROCOPY (0 = no)
+    int busy_poll_us;          // Microsegundos que gira cada worker antes de bloquearse (0 = no)
+    int busy_poll_sock_us;     // SO_BUSY_POLL de cada conexión nueva (0 = no)
+    int bulk_queue_kb;         // Broadcasts encolados por conexión antes de descartar (ver lanes.h)
+} ServerConfig;
+
+typedef enum {
+    CONN_HANDSHAKE,  // Esperando el nick
+    CONN_ACTIVE,     // Registrado en client_list
+    CONN_TRANSFER    // Conexión de datos (/xfer): pasa a transfer.c
+} ConnState;
+
+struct Worker;
+
+// Parte de la conexión que solo se usa al procesar un comando
+typedef struct {
+    char nick[NICK_SIZE];
+    Session* session;         // Sesión reanudable (NULL = sin /session)
+    uint32_t capture_id;      // Id en la traza de --capture (0 = sin captura)
+    int rate_limited;         // Ya se avisó que se descartan comandos
+    uint64_t rate_tokens;     // Comandos disponibles, en milésimas (límite de ritmo)
+    uint64_t rate_last_ms;
+} ConnCold;
+
+// Estado de una conexión, propiedad exclusiva de un worker. Solo lleva lo
+// que tocan los eventos y los timers; lo demás queda en cold, así una
+// conexión inactiva ocupa unos cientos de bytes (comando "memory")
+typedef struct Connection {
+    int sockfd;
+    ConnState state;
+    uint8_t awaiting_pong;
+    uint8_t line_mode;        // El cliente termina sus comandos con '\n'
+    uint8_t closed;           // Ya cerrada; se libera al final del ciclo del worker
+    uint16_t partial_len;
+    char* partial;            // Línea incompleta: del pool del worker (o propio si pasa BUF_SIZE), solo mientras dura
+    uint64_t last_activity;   // monotonic_ms() del último comando
+    ShmChannel* shm;          // Cliente local por memoria compartida (NULL = TCP)
+    ConnCold* cold;
+    TimerNode timer;          // Handshake, inactividad o PING/PONG
+    struct Worker *worker;
+    struct Connection *prev;
+    struct Connection *next;
+} Connection;
+
+// Buffers de BUF_SIZE para las líneas incompletas (solo los usa su worker)
+typedef struct {
+    char* free_list;          // Enlazados por su primer puntero
+    int free_count;
+    int in_use;               // Prestados a conexiones (lo lee el comando "memory")
+} ReadPool;
+
+// Cada worker atiende sus conexiones con su propio epoll y su rueda de timers.
+// Alineado a página: con --cpus/--numa-nodes el worker mueve su estructura a
+// su nodo sin arrastrar la de otro worker.
+typedef struct Worker {
+    int id;
+    int pinned;               // Fijado con --cpus o --numa-nodes
+    int node;                 // Nodo NUMA de sus CPUs
+    cpu_set_t cpus;
+    pthread_t thread;
+    int epfd;
+    int notify_pipe[2];       // El acceptor escribe acá los sockets nuevos
+    TimerWheel wheel;
+    Connection *connections;  // Lista de conexiones del worker
+    Connection *closed;       // Cerradas en este ciclo: pueden tener eventos pendientes
+    ReadPool read_pool;
+} __attribute__((aligned(4096))) Worker;
 
 // ============================================================================
 // Variables globales
@@ -24,18 +172,60 @@
 
 ClientList client_list = {
     .count = 0,
+    .limit = MAX_CLIENTS,
     .mutex = PTHREAD_MUTEX_INITIALIZER
 };
 
 MessageLog message_log = {
     .count = 0,
     .start = 0,
+    .depth = DEFAULT_MESSAGE_LOG_DEPTH,
     .mutex = PTHREAD_MUTEX_INITIALIZER
 };
 
 int server_running = 1;
 int server_sockfd = -1;  // Socket del servidor (global para poder cerrarlo desde cualquier thread)
 
+ServerConfig config = {
+    .port = 0,
+    .workers = 0,            // 0 = un worker por CPU
+    .handshake_timeout = 10,
+    .idle_timeout = 600,
+    .ping_interval = 0,
+    .pong_timeout = 15,
+    .history_path = HISTORY_DEFAULT_PATH,
+    .presence_window = PRESENCE_DEFAULT_WINDOW_MS,
+    .backlog = DEFAULT_BACKLOG,
+    .rate_burst = 20,
+    .local_send_timeout = LOCAL_SEND_TIMEOUT_MS,
+    .dashboard_refresh = DEFAULT_DASHBOARD_REFRESH_MS,
+    .resume_window = DEFAULT_RESUME_WINDOW,
+    .resume_grace = SESSION_DEFAULT_GRACE,
+    .bulk_queue_kb = LANES_BULK_DEFAULT_KB
+};
+
+MessageStore message_store = { .data_fd = -1, .index_fd = -1 };
+
+static Worker workers[MAX_WORKERS];
+static int launched_workers = 0;                     // Threads lanzados (config.workers reciben conexiones nuevas)
+static int placement_enabled = 0;                    // Workers fijados a CPUs o nodos
+static cpu_set_t placement_all;                      // Unión de las CPUs de los workers
+static int incoming_cpu_worker[CPU_SETSIZE];         // SO_INCOMING_CPU -> worker (-1 = ninguno)
+
+static int spare_fd = -1;                            // Reservado para rechazar clientes sin descriptores libres
+static unsigned long fd_rejections = 0;              // Clientes rechazados por falta de descriptores
+static unsigned long busy_poll_sock_errors = 0;      // Conexiones a las que no se pudo poner SO_BUSY_POLL
+
+static volatile sig_atomic_t upgrade_requested = 0;  // SIGUSR2 recibido
+static volatile sig_atomic_t trace_requested = 0;    // SIGUSR1 recibido
+static int upgrade_in_progress = 0;                  // Los workers no liberan sus conexiones
+static int wake_pipe[2] = {-1, -1};                  // Despierta al acceptor desde una señal
+
+static int local_sockfd = -1;                        // Escucha de clientes locales
+static ShmChannel** local_channels = NULL;           // Canal de cada socket local, indexado por fd
+static int local_channels_size = 0;
+static pthread_rwlock_t local_channels_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 // ============================================================================
 // Funciones de cierre del servidor
 // ============================================================================
@@ -51,6 +241,158 @@ void shutdown_server() {
     }
 }
 
+// ============================================================================
+// Transporte local (memoria compartida)
+// ============================================================================
+
+#define LOCAL_READ_BATCH 16         // Lecturas del anillo por evento antes de ceder
+
+// Tabla fd -> canal: todo el envío a clientes pasa por client_send() sin
+// saber qué transporte usa cada uno
+static int init_local_channels(void) {
+    struct rlimit rl;
+    
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) return -1;
+    local_channels_size = rl.rlim_cur == RLIM_INFINITY ? 65536 : (int)rl.rlim_cur;
+    local_channels = calloc(local_channels_size, sizeof(ShmChannel*));
+    return local_channels ? 0 : -1;
+}
+
+static void register_local_channel(int sockfd, ShmChannel* ch) {
+    pthread_rwlock_wrlock(&local_channels_lock);
+    if (sockfd < local_channels_size) local_channels[sockfd] = ch;
+    pthread_rwlock_unlock(&local_channels_lock);
+}
+
+// Desregistra el canal: al volver, ningún thread lo está usando
+static void unregister_local_channel(int sockfd) {
+    pthread_rwlock_wrlock(&local_channels_lock);
+    if (sockfd < local_channels_size) local_channels[sockfd] = NULL;
+    pthread_rwlock_unlock(&local_channels_lock);
+}
+
+// Envía fragmentos (len bytes en total) en una sola operación. Por TCP sale
+// por el carril de su clase (ver lanes.h): si el socket está lleno, una
+// respuesta no espera detrás de los broadcasts encolados. Un cliente local
+// no tiene colas: si su anillo está lleno solo se espera (hasta
+// --local_send_timeout_ms) con wait, que es para las respuestas del worker
+// sin locks tomados; lo demás prueba una vez. Un masivo que no entra se
+// descarta; cualquier otra cosa corta la conexión, igual que en los carriles.
+static ssize_t client_sendiov_lane(int sockfd, const struct iovec* iov, int count, size_t len,
+                                   LaneClass lane, int wait) {
+    uint64_t t0 = trace_begin();
+    
+    if (local_channels && sockfd >= 0 && sockfd < local_channels_size) {
+        pthread_rwlock_rdlock(&local_channels_lock);
+        ShmChannel* ch = local_channels[sockfd];
+        if (ch) {
+            int timeout = wait ? __atomic_load_n(&config.local_send_timeout, __ATOMIC_RELAXED) : 0;
+            ssize_t sent = shm_channel_writev(ch, iov, count, timeout);
+            // El worker ve el cierre del socket y libera la conexión
+            if (sent < 0 && (lane != LANE_BULK || errno != EAGAIN)) shutdown(sockfd, SHUT_RDWR);
+            pthread_rwlock_unlock(&local_channels_lock);
+            stats_sent(sockfd, sent, len);
+            trace_end(t0, TRACE_SEND, sockfd, len);
+            return sent;
+        }
+        pthread_rwlock_unlock(&local_channels_lock);
+    }
+    
+    ssize_t sent = lanes_send(sockfd, iov, count, len, lane);
+    stats_sent(sockfd, sent, len);
+    trace_end(t0, TRACE_SEND, sockfd, len);
+    return sent;
+}
+
+// Envía al cliente por su transporte (TCP o anillo compartido): respuestas
+// y errores, por el carril de control (siempre con MSG_NOSIGNAL)
+ssize_t client_send(int sockfd, const void* data, size_t len, int flags) {
+    struct iovec iov = { .iov_base = (void*)data, .iov_len = len };
+    (void)flags;
+    return client_sendiov_lane(sockfd, &iov, 1, len, LANE_CONTROL, 1);
+}
+
+ssize_t client_sendiov(int sockfd, const struct iovec* iov, int count, size_t len) {
+    return client_sendiov_lane(sockfd, iov, count, len, LANE_CONTROL, 1);
+}
+
+// Envía una respuesta armada por fragmentos en una sola operación
+ssize_t client_sendv(int sockfd, const Reply* reply) {
+    return client_sendiov(sockfd, reply->iov, reply->count, reply->len);
+}
+
+// Privados y mensajes de una /session: van antes que los broadcasts y no se
+// agrupan (la sesión numera todo lo que recibe, así que comparte carril).
+// Los de una sesión salen con client_list.mutex tomado: nunca esperan
+static ssize_t push_sendiov(int sockfd, const struct iovec* iov, int count, size_t len) {
+    return client_sendiov_lane(sockfd, iov, count, len, LANE_PRIVATE, 0);
+}
+
+// Respuesta a /resume con lo que se perdió: sale con client_list.mutex tomado
+static ssize_t resume_sendiov(int sockfd, const struct iovec* iov, int count, size_t len) {
+    return client_sendiov_lane(sockfd, iov, count, len, LANE_CONTROL, 0);
+}
+
+// Broadcasts, avisos de /watch y lo agrupado por --coalesce-ms: lo primero
+// que se descarta si el cliente no da abasto (salen con locks tomados)
+static ssize_t bulk_sendiov(int sockfd, const struct iovec* iov, int count, size_t len) {
+    return client_sendiov_lane(sockfd, iov, count, len, LANE_BULK, 0);
+}
+
+// Envía una respuesta constante (literal de reply.h)
+#define client_send_const(sockfd, literal) \
+    client_send((sockfd), (literal), REPLY_LEN(literal), MSG_NOSIGNAL)
+
+static int is_local_client(int sockfd) {
+    int local = 0;
+    
+    if (!local_channels || sockfd < 0 || sockfd >= local_channels_size) return 0;
+    
+    pthread_rwlock_rdlock(&local_channels_lock);
+    local = local_channels[sockfd] != NULL;
+    pthread_rwlock_unlock(&local_channels_lock);
+    return local;
+}
+
+// Envía un broadcast grande sin copiarlo (ver zerocopy.h); los clientes
+// locales no tienen socket al que pasarle las páginas. Sin lugar en el
+// socket no espera: lo que falta va a su cola de masivos como copia.
+// Retorna -1 si hay que enviarlo por bulk_sendiov()
+static int client_send_zerocopy(int sockfd, ZcPayload* payload, const Reply* message) {
+    if (is_local_client(sockfd)) return -1;
+    
+    // Con algo encolado en sus carriles, el mensaje va a la cola como copia
+    if (lanes_direct_begin(sockfd) < 0) return -1;
+    uint64_t t0 = trace_begin();
+    ssize_t sent;
+    if (zerocopy_send(sockfd, payload, 1, &sent) < 0 || sent == 0) {
+        lanes_direct_end(sockfd);
+        return -1;
+    }
+    
+    if (sent > 0 && (size_t)sent < message->len) {
+        struct iovec rest[REPLY_MAX_IOV];
+        size_t skip = (size_t)sent;
+        int count = 0;
+        for (int i = 0; i < message->count; i++) {
+            if (skip >= message->iov[i].iov_len) {
+                skip -= message->iov[i].iov_len;
+                continue;
+            }
+            rest[count].iov_base = (char*)message->iov[i].iov_base + skip;
+            rest[count].iov_len = message->iov[i].iov_len - skip;
+            skip = 0;
+            count++;
+        }
+        sent = lanes_direct_rest(sockfd, rest, count, message->len - (size_t)sent, LANE_BULK) < 0 ?
+               -1 : (ssize_t)message->len;
+    }
+    lanes_direct_end(sockfd);
+    stats_sent(sockfd, sent, message->len);
+    trace_end(t0, TRACE_SEND, sockfd, message->len);
+    return 0;
+}
+
 // ============================================================================
 // Funciones de gestión de clientes
 // ============================================================================
@@ -59,20 +401,26 @@ void shutdown_server() {
 int add_client(int sockfd, const char* nick) {
     pthread_mutex_lock(&client_list.mutex);
     
-    if (client_list.count >= MAX_CLIENTS) {
+    if (client_list.count >= __atomic_load_n(&client_list.limit, __ATOMIC_RELAXED)) {
         pthread_mutex_unlock(&client_list.mutex);
         return -1;
     }
     
-    // Buscar un slot libre
-    for (int i = 0; i < MAX_CLIENTS; i++) {
+    // Buscar un slot libre desde el primero que puede estarlo (con miles de
+    // clientes recorrer desde 0 hacía cuadrática la llegada de todos)
+    for (int i = client_list.free_hint; i < MAX_CLIENTS; i++) {
         if (!client_list.clients[i].active) {
             client_list.clients[i].sockfd = sockfd;
             strncpy(client_list.clients[i].nick, nick, NICK_SIZE - 1);
             client_list.clients[i].nick[NICK_SIZE - 1] = '\0';
             client_list.clients[i].active = 1;
+            client_list.clients[i].watching = 0;
             client_list.clients[i].connected_at = time(NULL);
+            client_list.clients[i].session = NULL;
             client_list.count++;
+            client_list.free_hint = i + 1;
+            list_snapshot_invalidate();
+            presence_event(nick, NULL, 1);
             pthread_mutex_unlock(&client_list.mutex);
             return i;
         }
@@ -82,6 +430,19 @@ int add_client(int sockfd, const char* nick) {
     return -1;
 }
 
+// Libera el slot de un cliente (con client_list.mutex tomado)
+static void release_client(ClientInfo* client) {
+    int idx = (int)(client - client_list.clients);
+    client->active = 0;
+    client_list.count--;
+    if (idx < client_list.free_hint) client_list.free_hint = idx;
+    list_snapshot_invalidate();
+    if (client->watching) presence_unsubscribe();
+    presence_event(client->nick, NULL, 0);
+    session_destroy(client->session);
+    client->session = NULL;
+}
+
 // Elimina un cliente de la lista
 void remove_client(int sockfd) {
     pthread_mutex_lock(&client_list.mutex);
@@ -89,9 +450,11 @@ void remove_client(int sockfd) {
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (client_list.clients[i].active && 
             client_list.clients[i].sockfd == sockfd) {
-            client_list.clients[i].active = 0;
+            coalesce_forget(sockfd);  // Lo encolado no debe llegar a quien herede el fd
+            zerocopy_forget(sockfd);
+            lanes_forget(sockfd);
             close(client_list.clients[i].sockfd);
-            client_list.count--;
+            release_client(&client_list.clients[i]);
             break;
         }
     }
@@ -99,337 +462,2707 @@ void remove_client(int sockfd) {
     pthread_mutex_unlock(&client_list.mutex);
 }
 
+// La conexión de un cliente con sesión se cortó: el nick queda registrado
+// (sin aviso de salida) y sus mensajes se guardan hasta --resume-grace.
+// Si un /resume ya pasó la sesión a otra conexión no hay nada que hacer.
+static void detach_client(int sockfd) {
+    pthread_mutex_lock(&client_list.mutex);
+    
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (client_list.clients[i].active && client_list.clients[i].sockfd == sockfd) {
+            client_list.clients[i].sockfd = -1;
+            session_detach(client_list.clients[i].session);
+            break;
+        }
+    }
+    
+    pthread_mutex_unlock(&client_list.mutex);
+    coalesce_forget(sockfd);
+    zerocopy_forget(sockfd);
+    lanes_forget(sockfd);
+    close(sockfd);
+}
+
+// Vence las sesiones desconectadas hace más de --resume-grace: recién ahí
+// el nick sale de la lista y los demás ven la salida (thread de sesiones)
+static void expire_sessions(void) {
+    uint64_t grace_ms = (uint64_t)__atomic_load_n(&config.resume_grace, __ATOMIC_RELAXED) * 1000;
+    pthread_mutex_lock(&client_list.mutex);
+    
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientInfo* client = &client_list.clients[i];
+        if (client->active && client->session && client->sockfd < 0 &&
+            session_expired(client->session, grace_ms)) {
+            federation_local_part(client->nick);
+            release_client(client);
+        }
+    }
+    
+    pthread_mutex_unlock(&client_list.mutex);
+}
+
 // Busca un cliente por nick
 // Retorna el socket del cliente o -1 si no se encuentra
 int find_client_by_nick(const char* nick) {
+    uint64_t t0 = trace_begin();
+    int sockfd = -1;
     pthread_mutex_lock(&client_list.mutex);
     
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (client_list.clients[i].active && 
             strcmp(client_list.clients[i].nick, nick) == 0) {
-            int sockfd = client_list.clients[i].sockfd;
-            pthread_mutex_unlock(&client_list.mutex);
-            return sockfd;
+            sockfd = client_list.clients[i].sockfd;
+            break;
         }
     }
     
     pthread_mutex_unlock(&client_list.mutex);
-    return -1;
+    trace_end(t0, TRACE_LOOKUP, sockfd, 0);
+    return sockfd;
 }
 
-// Envía un mensaje a todos los clientes conectados (excepto al remitente)
-void broadcast_to_all(int sender_sockfd, const char* message) {
+// Entrega un mensaje a un cliente de este nodo. Con sesión se numera y se
+// guarda bajo el lock (puede estar desconectado); sin sesión se envía
+// afuera, como antes. Retorna -1 si el nick no está registrado acá.
+static int send_to_nick(const char* nick, const Reply* message) {
+    uint64_t t0 = trace_begin();
+    int sockfd = -1;
+    int found = 0;
     pthread_mutex_lock(&client_list.mutex);
     
     for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_list.clients[i].active && 
-            client_list.clients[i].sockfd != sender_sockfd) {
-            send(client_list.clients[i].sockfd, message, strlen(message), MSG_NOSIGNAL);
+        ClientInfo* client = &client_list.clients[i];
+        if (client->active && strcmp(client->nick, nick) == 0) {
+            found = 1;
+            if (client->session) session_push(client->session, message->iov, message->count);
+            else sockfd = client->sockfd;
+            break;
         }
     }
     
     pthread_mutex_unlock(&client_list.mutex);
+    trace_end(t0, TRACE_LOOKUP, sockfd, 0);
+    
+    if (sockfd >= 0) push_sendiov(sockfd, message->iov, message->count, message->len);
+    return found ? 0 : -1;
 }
 
-// Envía la lista de clientes conectados al cliente especificado
-void send_client_list(int client_sockfd) {
-    char response[BUF_SIZE * 2];  // Buffer grande para toda la respuesta
-    int offset = 0;
-    
+// Activa o desactiva los avisos de presencia de un cliente
+// Retorna 1 si cambió, 0 si ya estaba así
+int set_watching(int sockfd, int watching) {
+    int changed = 0;
     pthread_mutex_lock(&client_list.mutex);
     
-    // Construir toda la respuesta en un solo buffer
-    offset += snprintf(response + offset, sizeof(response) - offset, "%s\n", RESP_LIST_START);
-    offset += snprintf(response + offset, sizeof(response) - offset, 
-                      "%s Clientes conectados: %d/%d\n", 
-                      RESP_INFO, client_list.count, MAX_CLIENTS);
-    
-    // Agregar cada cliente
-    if (client_list.count == 0) {
-        offset += snprintf(response + offset, sizeof(response) - offset, 
-                          "%s No hay clientes conectados\n", RESP_INFO);
-    } else {
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (client_list.clients[i].active) {
-                time_t now = time(NULL);
-                int elapsed = (int)difftime(now, client_list.clients[i].connected_at);
-                int hours = elapsed / 3600;
-                int minutes = (elapsed % 3600) / 60;
-                int seconds = elapsed % 60;
-                
-                offset += snprintf(response + offset, sizeof(response) - offset,
-                                  "%s %s (conectado hace %02d:%02d:%02d)\n", 
-                                  RESP_LIST_ITEM, 
-                                  client_list.clients[i].nick,
-                                  hours, minutes, seconds);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (client_list.clients[i].active && client_list.clients[i].sockfd == sockfd) {
+            if (client_list.clients[i].watching != watching) {
+                client_list.clients[i].watching = watching;
+                if (watching) presence_subscribe();
+                else presence_unsubscribe();
+                changed = 1;
             }
+            break;
         }
     }
     
-    // Agregar fin de lista
-    offset += snprintf(response + offset, sizeof(response) - offset, "%s\n", RESP_LIST_END);
+    pthread_mutex_unlock(&client_list.mutex);
+    return changed;
+}
+
+// Envía un mensaje a todos los clientes conectados (excepto al remitente).
+// Con --coalesce-ms se copia una vez y todas las colas comparten la copia;
+// si no, los de al menos --zerocopy-min bytes se copian una vez y salen
+// sin volver a copiarse en cada socket.
+void broadcast_to_all(int sender_sockfd, const Reply* message) {
+    CoalesceMsg* batch = coalesce_enabled() ? coalesce_msg_new(message->iov, message->count) : NULL;
+    ZcPayload* payload = !batch && zerocopy_wanted(message->len) ?
+                         zerocopy_payload_new(message->iov, message->count) : NULL;
+    uint64_t t0 = trace_begin();
+    pthread_mutex_lock(&client_list.mutex);
+    trace_end(t0, TRACE_LOCK, -1, 0);
     
-    // Enviar TODO de una sola vez
-    send(client_sockfd, response, strlen(response), MSG_NOSIGNAL);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientInfo* client = &client_list.clients[i];
+        if (!client->active || (sender_sockfd >= 0 && client->sockfd == sender_sockfd)) continue;
+        
+        if (client->session) session_push(client->session, message->iov, message->count);
+        else if (batch && coalesce_queue(client->sockfd, batch) == 0) continue;
+        else if (!payload || client_send_zerocopy(client->sockfd, payload, message) < 0) {
+            bulk_sendiov(client->sockfd, message->iov, message->count, message->len);
+        }
+    }
     
     pthread_mutex_unlock(&client_list.mutex);
+    coalesce_msg_release(batch);
+    zerocopy_payload_release(payload);
 }
 
-// ============================================================================
-// Manejo de clientes
-// ============================================================================
-
-void* client_handler(void* arg) {
-    int client_sockfd = *((int*)arg);
-    free(arg);
-    
-    char buffer[BUF_SIZE] = {0};
-    char nick[NICK_SIZE] = {0};
+// Envía un bloque de avisos de presencia a los suscriptos a /watch
+static void deliver_presence(const char* frame, size_t len) {
+    struct iovec iov = { .iov_base = (void*)frame, .iov_len = len };
+    CoalesceMsg* batch = coalesce_enabled() ? coalesce_msg_new(&iov, 1) : NULL;
+    pthread_mutex_lock(&client_list.mutex);
     
-    // Recibir el nick del cliente
-    int bytes = recv(client_sockfd, nick, NICK_SIZE - 1, 0);
-    if (bytes <= 0) {
-        close(client_sockfd);
-        return NULL;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientInfo* client = &client_list.clients[i];
+        if (!client->active || !client->watching) continue;
+        
+        if (client->session) session_push(client->session, &iov, 1);
+        else if (!batch || coalesce_queue(client->sockfd, batch) < 0) bulk_sendiov(client->sockfd, &iov, 1, len);
     }
     
-    nick[bytes] = '\0';
+    pthread_mutex_unlock(&client_list.mutex);
+    coalesce_msg_release(batch);
+}
+
+// Envía la lista de clientes conectados al cliente especificado.
+// args vacío = lista completa; "<n>" = solo la página n.
+void send_client_list(int client_sockfd, const char* args) {
+    while (*args == ' ') args++;
+    
+    int page = 0;
+    if (*args) {
+        char* end;
+        long n = strtol(args, &end, 10);
+        while (*end == ' ' || *end == '\r') end++;
+        if (*end != '\0' || n < 1 || n > INT_MAX) {
+            client_send_const(client_sockfd, REPLY_LIST_USAGE);
+            return;
+        }
+        page = (int)n;
+    }
     
-    // Agregar cliente a la lista
-    int client_idx = add_client(client_sockfd, nick);
-    if (client_idx < 0) {
-        // Servidor lleno
-        const char* msg = "Servidor lleno\n";
-        send(client_sockfd, msg, strlen(msg), 0);
-        close(client_sockfd);
-        return NULL;
+    ListSnapshot* snapshot = list_snapshot_acquire(&client_list,
+                                                  federation_enabled() ? config.node_id : NULL);
+    if (!snapshot) {
+        client_send_const(client_sockfd, REPLY_LIST_UNAVAILABLE);
+        return;
     }
     
-    // Mensaje de bienvenida
-    snprintf(buffer, BUF_SIZE, 
-             "%s Bienvenido al servidor, %s! Escribe /help para ver comandos disponibles.\n", 
-             RESP_INFO, nick);
-    send(client_sockfd, buffer, strlen(buffer), MSG_NOSIGNAL);
+    // Los ítems salen directo del buffer compartido de la vista, sin copiarlos
+    Reply reply;
+    reply_init(&reply);
+    reply_add_lit(&reply, RESP_LIST_START "\n");
+    reply_add(&reply, snapshot->summary, snapshot->summary_len);
     
-    // Loop de recepción de mensajes
-    while (server_running) {
-        memset(buffer, 0, BUF_SIZE);
-        bytes = recv(client_sockfd, buffer, BUF_SIZE - 1, 0);
-        
-        if (bytes <= 0 || !server_running) {
-            break;  // Cliente desconectado o servidor cerrando
-        }
-        
-        buffer[bytes] = '\0';
+    if (page == 0) {
+        reply_add(&reply, snapshot->items, snapshot->offsets[snapshot->item_count]);
+    } else {
+        const char* items;
+        size_t items_len;
+        int pages = list_snapshot_pages(snapshot);
         
-        // Eliminar salto de línea al final
-        if (buffer[bytes-1] == '\n') {
-            buffer[bytes-1] = '\0';
+        if (list_snapshot_page(snapshot, page, &items, &items_len) < 0) {
+            list_snapshot_release(snapshot);
+            client_send_const(client_sockfd, REPLY_LIST_NO_PAGE);
+            return;
         }
         
-        // Procesar comandos
-        if (strncmp(buffer, CMD_QUIT, strlen(CMD_QUIT)) == 0) {
-            // Comando /quit
-            break;
-            
-        } else if (strncmp(buffer, CMD_LIST, strlen(CMD_LIST)) == 0) {
-            // Comando /list - enviar lista de clientes
-            send_client_list(client_sockfd);
-            
-        } else if (strncmp(buffer, CMD_HELP, strlen(CMD_HELP)) == 0) {
-            // Comando /help - mostrar ayuda
-            snprintf(buffer, BUF_SIZE, 
-                     "%s === COMANDOS DISPONIBLES ===\n"
-                     "%s /list      - Ver clientes conectados\n"
-                     "%s /msg <nick> <mensaje> - Enviar mensaje privado a un cliente\n"
-                     "%s /broadcast <mensaje> - Enviar mensaje a todos los clientes\n"
-                     "%s /help      - Mostrar esta ayuda\n"
-                     "%s /quit      - Desconectarse del servidor\n",
-                     RESP_INFO, RESP_INFO, RESP_INFO, RESP_INFO, RESP_INFO, RESP_INFO);
-            send(client_sockfd, buffer, strlen(buffer), MSG_NOSIGNAL);
-            
-        } else if (strncmp(buffer, CMD_MSG, strlen(CMD_MSG)) == 0) {
-            // Comando /msg <nick> <mensaje> - enviar mensaje privado
-            char* cmd_line = buffer + strlen(CMD_MSG);
-            
-            // Saltar espacios
-            while (*cmd_line == ' ') cmd_line++;
-            
-            // Extraer nick destino
-            char dest_nick[NICK_SIZE];
-            int i = 0;
-            while (*cmd_line != ' ' && *cmd_line != '\0' && i < NICK_SIZE - 1) {
-                dest_nick[i++] = *cmd_line++;
-            }
-            dest_nick[i] = '\0';
-            
-            // Saltar espacios
-            while (*cmd_line == ' ') cmd_line++;
-            
-            if (strlen(dest_nick) == 0 || strlen(cmd_line) == 0) {
-                snprintf(buffer, BUF_SIZE, "%s Uso: /msg <nick> <mensaje>\n", RESP_ERROR);
-                send(client_sockfd, buffer, strlen(buffer), MSG_NOSIGNAL);
-            } else {
-                // Buscar cliente destino
-                int dest_sockfd = find_client_by_nick(dest_nick);
-                if (dest_sockfd < 0) {
-                    snprintf(buffer, BUF_SIZE, "%s Cliente '%s' no encontrado\n", 
-                             RESP_ERROR, dest_nick);
-                    send(client_sockfd, buffer, strlen(buffer), MSG_NOSIGNAL);
-                } else {
-                    // Enviar mensaje al destinatario
-                    char msg_to_dest[BUF_SIZE];
-                    snprintf(msg_to_dest, BUF_SIZE, "%s %s: %s\n", 
-                             RESP_MSG_FROM, nick, cmd_line);
-                    send(dest_sockfd, msg_to_dest, strlen(msg_to_dest), MSG_NOSIGNAL);
-                    
-                    // Registrar el mensaje en el log del dashboard
-                    log_message(&message_log, nick, dest_nick, cmd_line);
-                    
-                    // Confirmar al remitente
-                    snprintf(buffer, BUF_SIZE, "%s Mensaje enviado a %s\n", 
-                             RESP_INFO, dest_nick);
-                    send(client_sockfd, buffer, strlen(buffer), MSG_NOSIGNAL);
-                }
-            }
-            
-        } else if (strncmp(buffer, CMD_BROADCAST, strlen(CMD_BROADCAST)) == 0) {
-            // Comando /broadcast <mensaje> - enviar mensaje a todos
-            char* cmd_line = buffer + strlen(CMD_BROADCAST);
-            
-            // Saltar espacios
-            while (*cmd_line == ' ') cmd_line++;
-            
-            if (strlen(cmd_line) == 0) {
-                snprintf(buffer, BUF_SIZE, "%s Uso: /broadcast <mensaje>\n", RESP_ERROR);
-                send(client_sockfd, buffer, strlen(buffer), MSG_NOSIGNAL);
-            } else {
-                // Enviar mensaje a todos los demás clientes
-                char broadcast_msg[BUF_SIZE];
-                snprintf(broadcast_msg, BUF_SIZE, "%s %s: %s\n", 
-                         RESP_BROADCAST, nick, cmd_line);
-                broadcast_to_all(client_sockfd, broadcast_msg);
-                
-                // Registrar en el log del dashboard
-                log_message(&message_log, nick, "broadcast", cmd_line);
-                
-                // Confirmar al remitente
-                snprintf(buffer, BUF_SIZE, "%s Mensaje enviado a todos (%d clientes)\n", 
-                         RESP_INFO, client_list.count - 1);
-                send(client_sockfd, buffer, strlen(buffer), MSG_NOSIGNAL);
-            }
-            
-        } else {
-            // Comando desconocido o mensaje normal - hacer eco
-            snprintf(buffer, BUF_SIZE, "%s Comando no reconocido. Usa /help para ver comandos.\n", 
-                     RESP_ERROR);
-            send(client_sockfd, buffer, strlen(buffer), MSG_NOSIGNAL);
-        }
+        reply_add_lit(&reply, RESP_INFO " Página ");
+        reply_add_uint(&reply, (unsigned long)page);
+        reply_add_lit(&reply, " de ");
+        reply_add_uint(&reply, (unsigned long)pages);
+        reply_add_lit(&reply, "\n");
+        reply_add(&reply, items, items_len);
     }
     
-    // Remover cliente de la lista
-    remove_client(client_sockfd);
+    reply_add_lit(&reply, RESP_LIST_END "\n");
+    client_sendv(client_sockfd, &reply);
     
-    return NULL;
+    list_snapshot_release(snapshot);
 }
 
 // ============================================================================
-// Manejador de señales
+// Manejo de conexiones
 // ============================================================================
 
-void signal_handler(int signum) {
-    (void)signum;
-    shutdown_server();
+// Conexiones con registro reservado, de todos los workers (comando "memory")
+static int live_connections = 0;
+
+// Reserva los dos registros de una conexión
+static Connection* conn_new(void) {
+    Connection* conn = calloc(1, sizeof(Connection));
+    if (!conn) return NULL;
+    conn->cold = calloc(1, sizeof(ConnCold));
+    if (!conn->cold) {
+        free(conn);
+        return NULL;
+    }
+    __atomic_add_fetch(&live_connections, 1, __ATOMIC_RELAXED);
+    return conn;
 }
 
-// ============================================================================
-// Función principal
-// ============================================================================
+static void conn_free(Connection* conn) {
+    __atomic_sub_fetch(&live_connections, 1, __ATOMIC_RELAXED);
+    free(conn->cold);
+    free(conn);
+}
 
-int main(int argc, char* argv[]) {
-    // Verificar argumentos
-    if (argc != 2) {
-        printf("Uso: %s <puerto>\n", argv[0]);
-        printf("Ejemplo: %s 5000\n", argv[0]);
-        return EXIT_FAILURE;
+// Presta un buffer de BUF_SIZE para guardar una línea incompleta
+static char* read_pool_get(ReadPool* pool) {
+    char* buf = pool->free_list;
+    if (buf) {
+        pool->free_list = *(char**)buf;
+        __atomic_store_n(&pool->free_count, pool->free_count - 1, __ATOMIC_RELAXED);
+    } else {
+        buf = malloc(BUF_SIZE);
+        if (!buf) return NULL;
+    }
+    __atomic_store_n(&pool->in_use, pool->in_use + 1, __ATOMIC_RELAXED);
+    return buf;
+}
+
+// Devuelve el buffer al pool (NULL no hace nada); pasado READ_POOL_MAX se libera
+static void read_pool_put(ReadPool* pool, char* buf) {
+    if (!buf) return;
+    __atomic_store_n(&pool->in_use, pool->in_use - 1, __ATOMIC_RELAXED);
+    if (pool->free_count >= READ_POOL_MAX) {
+        free(buf);
+        return;
     }
+    *(char**)buf = pool->free_list;
+    pool->free_list = buf;
+    __atomic_store_n(&pool->free_count, pool->free_count + 1, __ATOMIC_RELAXED);
+}
+
+// Suelta la línea incompleta de la conexión: las cortas vuelven al pool,
+// las más largas que BUF_SIZE tienen buffer propio y se liberan
+static void partial_release(Connection* conn) {
+    if (conn->partial_len >= BUF_SIZE) free(conn->partial);
+    else read_pool_put(&conn->worker->read_pool, conn->partial);
+    conn->partial = NULL;
+    conn->partial_len = 0;
+}
 
-    int port = atoi(argv[1]);
+// Cierra la conexión y libera su estado. Solo la llama el worker dueño.
+static void close_connection(Connection* conn) {
+    Worker* w = conn->worker;
     
-    // Configurar manejador de señales
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    timer_cancel(&w->wheel, &conn->timer);
+    capture_close(conn->cold->capture_id);
     
-    // Crear socket del servidor
-    server_sockfd = CreateServerSocket(port);
-    if (server_sockfd < 0) {
-        printf("Error: No se pudo iniciar el servidor en el puerto %d\n", port);
-        return EXIT_FAILURE;
+    // Sacar el canal local de la tabla antes de que el fd se pueda reutilizar
+    if (conn->shm) unregister_local_channel(conn->sockfd);
+    
+    if (conn->state == CONN_ACTIVE && conn->cold->session) {
+        detach_client(conn->sockfd);  // Cierra el socket; el nick espera el /resume
+    } else if (conn->state == CONN_ACTIVE) {
+        federation_local_part(conn->cold->nick);
+        remove_client(conn->sockfd);  // Cierra el socket
+    } else if (conn->state == CONN_TRANSFER) {
+        epoll_ctl(w->epfd, EPOLL_CTL_DEL, conn->sockfd, NULL);  // El socket sigue en transfer.c
+        lanes_forget(conn->sockfd);
+    } else {
+        lanes_forget(conn->sockfd);
+        close(conn->sockfd);
     }
     
-    // Configurar argumentos para el thread del dashboard
-    DashboardThreadArgs dash_args = {
-        .client_list = &client_list,
-        .message_log = &message_log,
-        .server_running = &server_running,
-        .shutdown_callback = shutdown_server
-    };
+    if (conn->shm) {
+        shm_channel_destroy(conn->shm);  // Cierra los eventfd (salen del epoll)
+        free(conn->shm);
+        conn->shm = NULL;
+    }
     
-    // Crear thread para el dashboard
-    pthread_t dash_thread;
-    pthread_create(&dash_thread, NULL, dashboard_thread, &dash_args);
+    partial_release(conn);
     
-    // Loop principal: aceptar clientes
-    while (server_running) {
-        int* client_sockfd = malloc(sizeof(int));
-        *client_sockfd = AcceptClient(server_sockfd);
-        
-        if (*client_sockfd < 0) {
-            free(client_sockfd);
-            // Si server_running es 0, significa que estamos cerrando
-            if (!server_running) {
-                break;
-            }
-            // Si todavía estamos corriendo pero accept falló, reintentar
-            usleep(100000);  // Esperar 100ms antes de reintentar
-            continue;
-        }
-        
-        // Si estamos cerrando, no aceptar más clientes
-        if (!server_running) {
-            close(*client_sockfd);
-            free(client_sockfd);
-            break;
+    // Desenlazar de la lista del worker
+    if (conn->prev) conn->prev->next = conn->next;
+    else w->connections = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    
+    // Un cliente local tiene dos fds en el epoll: puede quedar otro evento
+    // suyo en el lote actual, así que se libera al terminar el ciclo
+    conn->closed = 1;
+    conn->next = w->closed;
+    w->closed = conn;
+}
+
+// Programa el próximo vencimiento según la configuración de inactividad
+static void schedule_idle_timer(Connection* conn) {
+    Worker* w = conn->worker;
+    uint64_t now = monotonic_ms();
+    uint64_t delay = 0;
+    
+    if (config.ping_interval > 0) {
+        delay = (uint64_t)config.ping_interval * 1000;
+    }
+    
+    if (config.idle_timeout > 0) {
+        uint64_t idle_ms = (uint64_t)config.idle_timeout * 1000;
+        uint64_t elapsed = now - conn->last_activity;
+        uint64_t remaining = elapsed < idle_ms ? idle_ms - elapsed : 0;
+        if (delay == 0 || remaining < delay) delay = remaining;
+    }
+    
+    if (delay == 0 && config.ping_interval <= 0 && config.idle_timeout <= 0) {
+        timer_cancel(&w->wheel, &conn->timer);
+    } else {
+        timer_arm(&w->wheel, &conn->timer, delay);
+    }
+}
+
+// Callback de la rueda: venció el plazo de handshake, de inactividad o de PONG
+static void connection_timeout(TimerNode* node, void* arg) {
+    (void)node;
+    Connection* conn = (Connection*)arg;
+    
+    if (conn->state == CONN_HANDSHAKE) {
+        client_send_const(conn->sockfd, REPLY_HANDSHAKE_TIMEOUT);
+        close_connection(conn);
+        return;
+    }
+    
+    if (conn->awaiting_pong) {
+        // No respondió al PING: la conexión está muerta
+        close_connection(conn);
+        return;
+    }
+    
+    uint64_t now = monotonic_ms();
+    if (config.idle_timeout > 0 &&
+        now - conn->last_activity >= (uint64_t)config.idle_timeout * 1000) {
+        client_send_const(conn->sockfd, REPLY_IDLE_TIMEOUT);
+        close_connection(conn);
+        return;
+    }
+    
+    if (config.ping_interval > 0) {
+        client_send_const(conn->sockfd, REPLY_PING);
+        conn->awaiting_pong = 1;
+        timer_arm(&conn->worker->wheel, &conn->timer, (uint64_t)config.pong_timeout * 1000);
+        return;
+    }
+    
+    schedule_idle_timer(conn);
+}
+
+// Interpreta el argumento "desde" de /history: HH:MM[:SS] de hoy o una
+// antigüedad relativa (30s, 15m, 2h, 1d). Retorna 0 si es válido.
+static int parse_history_since(const char* arg, time_t* since) {
+    time_t now = time(NULL);
+    int h, m, sec = 0;
+    long amount;
+    char unit;
+    
+    if (sscanf(arg, "%d:%d:%d", &h, &m, &sec) >= 2) {
+        struct tm tm_since;
+        localtime_r(&now, &tm_since);
+        tm_since.tm_hour = h;
+        tm_since.tm_min = m;
+        tm_since.tm_sec = sec;
+        *since = mktime(&tm_since);
+        if (*since > now) *since -= 24 * 3600;  // Hora de ayer
+        return 0;
+    }
+    
+    if (sscanf(arg, "%ld%c", &amount, &unit) == 2 && amount >= 0) {
+        switch (unit) {
+            case 's': *since = now - amount; return 0;
+            case 'm': *since = now - amount * 60; return 0;
+            case 'h': *since = now - amount * 3600; return 0;
+            case 'd': *since = now - amount * 86400; return 0;
         }
-        
-        // Crear thread para manejar el cliente
-        pthread_t client_thread;
-        pthread_create(&client_thread, NULL, client_handler, client_sockfd);
-        pthread_detach(client_thread);
     }
     
-    // Esperar a que termine el thread del dashboard
-    pthread_join(dash_thread, NULL);
+    return -1;
+}
+
+// Comando /history [n|desde]: reenvía el tramo pedido desde el historial
+static void send_history(int client_sockfd, const char* arg) {
+    HistoryRange range;
+    Reply reply;
     
-    // Notificar y cerrar todas las conexiones de clientes
-    pthread_mutex_lock(&client_list.mutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_list.clients[i].active) {
-            // Enviar mensaje de despedida al cliente
-            const char* goodbye_msg = "\nServidor cerrando. Desconectando...\n";
-            send(client_list.clients[i].sockfd, goodbye_msg, strlen(goodbye_msg), MSG_NOSIGNAL);
-            
-            // Cerrar la conexión
-            shutdown(client_list.clients[i].sockfd, SHUT_RDWR);
-            close(client_list.clients[i].sockfd);
-            client_list.clients[i].active = 0;
+    if (message_store.data_fd < 0) {
+        client_send_const(client_sockfd, REPLY_HISTORY_DISABLED);
+        return;
+    }
+    
+    while (*arg == ' ') arg++;
+    
+    if (*arg == '\0') {
+        message_store_range_last(&message_store, HISTORY_DEFAULT_COUNT, &range);
+    } else if (strspn(arg, "0123456789") == strlen(arg)) {
+        long n = atol(arg);
+        if (n > HISTORY_MAX_REPLAY) n = HISTORY_MAX_REPLAY;
+        message_store_range_last(&message_store, (size_t)n, &range);
+    } else {
+        time_t since;
+        if (parse_history_since(arg, &since) < 0) {
+            client_send_const(client_sockfd, REPLY_HISTORY_USAGE);
+            return;
         }
+        message_store_range_since(&message_store, since, &range);
+    }
+    
+    // Encabezado + tramo del segmento (sin copias) + cierre
+    reply_init(&reply);
+    reply_add_lit(&reply, RESP_HISTORY_START " ");
+    reply_add_uint(&reply, range.count);
+    reply_add_lit(&reply, "\n");
+    client_sendv(client_sockfd, &reply);
+    if (!is_local_client(client_sockfd)) {
+        // El tramo va a la cola de control detrás del encabezado y lo envía
+        // el thread de los carriles: el worker no espera a que el cliente lea
+        uint64_t t0 = trace_begin();
+        ssize_t sent = lanes_send_file(client_sockfd, message_store.data_fd, range.offset,
+                                       (size_t)range.length, LANE_CONTROL);
+        stats_sent(client_sockfd, sent, (size_t)range.length);
+        trace_end(t0, TRACE_SEND, client_sockfd, sent > 0 ? (size_t)sent : 0);
+        if (sent < 0) return;  // Conexión cortada: sin HISTORY_END tras un registro a medias
+    } else {
+        // El anillo compartido no admite sendfile(): copiar por tramos
+        char chunk[16384];
+        uint64_t offset = range.offset;
+        uint64_t remaining = range.length;
+        while (remaining > 0) {
+            size_t want = remaining < sizeof(chunk) ? (size_t)remaining : sizeof(chunk);
+            ssize_t got = message_store_read(&message_store, offset, chunk, want);
+            if (got <= 0 || client_send(client_sockfd, chunk, got, 0) < 0) {
+                // Sin HISTORY_END tras un registro a medias: el worker ve
+                // el cierre y libera la conexión
+                shutdown(client_sockfd, SHUT_RDWR);
+                return;
+            }
+            offset += got;
+            remaining -= got;
+        }
+    }
+    client_send_const(client_sockfd, REPLY_HISTORY_END);
+}
+
+// Comando /search <palabras> [from:nick] [since:desde]: las coincidencias
+// más recientes según el índice de search.c, sin recorrer el historial
+static void send_search(int client_sockfd, const char* args) {
+    char terms[1024];
+    char from[NICK_SIZE * 2] = "";
+    size_t used = 0;
+    size_t first = 0;
+    SearchResult result;
+    
+    if (message_store.data_fd < 0) {
+        client_send_const(client_sockfd, REPLY_HISTORY_DISABLED);
+        return;
     }
-    client_list.count = 0;
-    pthread_mutex_unlock(&client_list.mutex);
     
-    // Dar tiempo para que los threads de cliente terminen
-    usleep(500000);  // 500ms
+    // Los filtros se separan; el resto son las palabras
+    const char* p = args;
+    for (;;) {
+        while (*p == ' ') p++;
+        size_t len = strcspn(p, " ");
+        if (len == 0) break;
+        
+        if (strncmp(p, "from:", 5) == 0) {
+            snprintf(from, sizeof(from), "%.*s", (int)(len - 5), p + 5);
+        } else if (strncmp(p, "since:", 6) == 0) {
+            char arg[32];
+            time_t since;
+            snprintf(arg, sizeof(arg), "%.*s", (int)(len - 6), p + 6);
+            if (parse_history_since(arg, &since) < 0) {
+                client_send_const(client_sockfd, REPLY_SEARCH_USAGE);
+                return;
+            }
+            first = message_store_find_since(&message_store, since);
+        } else if (used + len + 1 < sizeof(terms)) {
+            memcpy(terms + used, p, len);
+            used += len;
+            terms[used++] = ' ';
+        }
+        p += len;
+    }
+    terms[used] = '\0';
+    
+    if (search_run(terms, from, first, &result) < 0) {
+        client_send_const(client_sockfd, REPLY_SEARCH_USAGE);
+        return;
+    }
+    
+    // Encabezado, los registros guardados con el prefijo de /search y el
+    // cierre, en un solo envío
+    size_t size = 64 + result.count * HISTORY_RECORD_MAX + REPLY_LEN(REPLY_SEARCH_END);
+    char* out = malloc(size);
+    if (!out) {
+        client_send_const(client_sockfd, REPLY_SEARCH_END);
+        return;
+    }
+    size_t len = (size_t)snprintf(out, size, RESP_SEARCH_START " %zu %zu\n", result.count, result.total);
+    for (size_t i = 0; i < result.count; i++) {
+        HistoryIndexEntry entry;
+        char record[HISTORY_RECORD_MAX];
+        size_t skip = REPLY_LEN(RESP_HISTORY);
+        if (message_store_entries(&message_store, result.ids[i], &entry, 1) != 1 ||
+            entry.length <= skip || entry.length > sizeof(record) ||
+            message_store_read(&message_store, entry.offset, record, entry.length) != (ssize_t)entry.length) {
+            continue;
+        }
+        memcpy(out + len, RESP_SEARCH, REPLY_LEN(RESP_SEARCH));
+        len += REPLY_LEN(RESP_SEARCH);
+        memcpy(out + len, record + skip, entry.length - skip);
+        len += entry.length - skip;
+    }
+    memcpy(out + len, REPLY_SEARCH_END, REPLY_LEN(REPLY_SEARCH_END));
+    len += REPLY_LEN(REPLY_SEARCH_END);
+    
+    client_send(client_sockfd, out, len, MSG_NOSIGNAL);
+    free(out);
+}
+
+// Arma "<prefijo> <nick>: <texto>\n" apuntando al texto original (sin copiarlo)
+static void build_chat_reply(Reply* reply, const char* prefix, size_t prefix_len,
+                             const char* from, const char* text) {
+    reply_init(reply);
+    reply_add(reply, prefix, prefix_len);
+    reply_add_str(reply, from);
+    reply_add_lit(reply, ": ");
+    reply_add_str(reply, text);
+    reply_add_lit(reply, "\n");
+}
+
+// "/resume <token> <última secuencia>" en lugar del nick: retoma la sesión
+// y reenvía lo que se perdió. Si el token no sirve, la conexión sigue
+// esperando el nick.
+static void handle_resume(Connection* conn, const char* args) {
+    char token[SESSION_TOKEN_SIZE];
+    unsigned long long last_seq;
+    int old_sockfd = -1;
+    int found = 0;
+    
+    if (sscanf(args, " %16s %llu", token, &last_seq) != 2) {
+        client_send_const(conn->sockfd, REPLY_RESUME_USAGE);
+        return;
+    }
+    
+    pthread_mutex_lock(&client_list.mutex);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientInfo* client = &client_list.clients[i];
+        if (client->active && client->session && strcmp(session_token(client->session), token) == 0) {
+            // Si la conexión vieja todavía no se cayó, se la corta: su
+            // worker la cierra sin tocar la sesión (ya no es su socket)
+            old_sockfd = client->sockfd;
+            if (old_sockfd >= 0) shutdown(old_sockfd, SHUT_RDWR);
+            client->sockfd = conn->sockfd;
+            memcpy(conn->cold->nick, client->nick, NICK_SIZE);
+            conn->cold->session = client->session;
+            conn->state = CONN_ACTIVE;
+            // Un cliente local recibe el reenvío en su anillo, sin esperar
+            session_attach(client->session, conn->sockfd, last_seq,
+                           is_local_client(conn->sockfd) ? SHM_RING_SIZE : SESSION_REPLAY_MAX_BYTES);
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&client_list.mutex);
+    
+    if (!found) client_send_const(conn->sockfd, REPLY_RESUME_UNKNOWN);
+}
+
+// Primer mensaje de la conexión: registra el nick
+// Retorna 0 si la conexión debe cerrarse
+static int handle_handshake(Connection* conn, const char* line) {
+    Reply reply;
+    int client_sockfd = conn->sockfd;
+    
+    if (strncmp(line, CMD_RESUME " ", strlen(CMD_RESUME " ")) == 0) {
+        handle_resume(conn, line + strlen(CMD_RESUME));
+        return 1;
+    }
+    
+    // Conexión de datos de una transferencia: handle_readable la entrega
+    if (strncmp(line, CMD_XFER " ", strlen(CMD_XFER " ")) == 0) {
+        if (conn->shm) {
+            client_send_const(client_sockfd, REPLY_XFER_LOCAL);
+            return 0;
+        }
+        conn->state = CONN_TRANSFER;
+        return 1;
+    }
+    
+    strncpy(conn->cold->nick, line, NICK_SIZE - 1);
+    conn->cold->nick[NICK_SIZE - 1] = '\0';
+    
+    // Agregar cliente a la lista
+    int client_idx = add_client(client_sockfd, conn->cold->nick);
+    if (client_idx < 0) {
+        // Servidor lleno
+        client_send_const(client_sockfd, REPLY_SERVER_FULL);
+        return 0;
+    }
+    
+    conn->state = CONN_ACTIVE;
+    federation_local_join(conn->cold->nick, time(NULL));
+    
+    // Mensaje de bienvenida
+    reply_init(&reply);
+    reply_add_lit(&reply, RESP_INFO " Bienvenido al servidor, ");
+    reply_add_str(&reply, conn->cold->nick);
+    reply_add_lit(&reply, "! Escribe /help para ver comandos disponibles.\n");
+    client_sendv(client_sockfd, &reply);
+    
+    return 1;
+}
+
+// Comando /session: desde acá los mensajes que recibe se numeran y se
+// guardan en la ventana de la sesión (pedirlo de nuevo repite el token)
+static void start_session(Connection* conn) {
+    char token[SESSION_TOKEN_SIZE] = "";
+    Reply reply;
+    int window = __atomic_load_n(&config.resume_window, __ATOMIC_RELAXED);
+    
+    if (window <= 0) {
+        client_send_const(conn->sockfd, REPLY_SESSION_DISABLED);
+        return;
+    }
+    
+    pthread_mutex_lock(&client_list.mutex);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ClientInfo* client = &client_list.clients[i];
+        if (client->active && client->sockfd == conn->sockfd) {
+            if (!client->session) client->session = session_create(conn->sockfd, window);
+            if (client->session) {
+                conn->cold->session = client->session;
+                memcpy(token, session_token(client->session), SESSION_TOKEN_SIZE);
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&client_list.mutex);
+    
+    if (token[0] == '\0') {
+        client_send_const(conn->sockfd, REPLY_SESSION_DISABLED);
+        return;
+    }
+    
+    reply_init(&reply);
+    reply_add_lit(&reply, RESP_SESSION " ");
+    reply_add_str(&reply, token);
+    reply_add_lit(&reply, "\n");
+    client_sendv(conn->sockfd, &reply);
+}
+
+// Arma "<prefijo> <id> <campo> <bytes> [nombre]\n" (FILE_OFFER, FILE_SEND, FILE_RECV)
+static size_t format_file_line(char* out, size_t size, const char* prefix,
+                               const TransferTicket* ticket, const char* field) {
+    int len = snprintf(out, size, "%s %u %s %llu%s%s\n", prefix, ticket->id, field,
+                       (unsigned long long)ticket->size, ticket->name[0] ? " " : "", ticket->name);
+    if (len < 0) return 0;
+    return (size_t)len < size ? (size_t)len : size - 1;
+}
+
+// Envía una línea ya armada a un nick como mensaje que llega sin pedirlo
+// (también es el aviso FILE_END de transfer.c)
+static int notify_nick(const char* nick, const char* line, size_t len) {
+    Reply reply;
+    reply_init(&reply);
+    reply_add(&reply, line, len);
+    return send_to_nick(nick, &reply);
+}
+
+static void transfer_notify(const char* nick, const char* line, size_t len) {
+    notify_nick(nick, line, len);
+}
+
+// Comando /send <nick> <bytes> [nombre]: ofrece un archivo a un cliente de
+// este nodo; los bytes van después por conexiones de datos (ver transfer.h)
+static void handle_send(Connection* conn, const char* args) {
+    char dest[NICK_SIZE];
+    unsigned long long size;
+    int consumed = 0;
+    TransferTicket ticket;
+    char line[256];
+    
+    if (sscanf(args, " %31s %llu %n", dest, &size, &consumed) < 2 ||
+        size == 0 || size > TRANSFER_MAX_BYTES) {
+        client_send_const(conn->sockfd, REPLY_SEND_USAGE);
+        return;
+    }
+    if (strcmp(dest, conn->cold->nick) == 0) {
+        client_send_const(conn->sockfd, REPLY_SEND_SELF);
+        return;
+    }
+    
+    const char* name = consumed > 0 ? args + consumed : "";
+    if (transfer_offer(conn->cold->nick, dest, size, name, &ticket) < 0) {
+        client_send_const(conn->sockfd, REPLY_SEND_BUSY);
+        return;
+    }
+    
+    size_t len = format_file_line(line, sizeof(line), RESP_FILE_OFFER, &ticket, ticket.from);
+    if (notify_nick(dest, line, len) < 0) {
+        // Las conexiones de datos se unen en este servidor: solo clientes locales
+        transfer_reject(ticket.id, ticket.from, &ticket);
+        Reply reply;
+        reply_init(&reply);
+        reply_add_lit(&reply, RESP_ERROR " Cliente '");
+        reply_add_str(&reply, dest);
+        reply_add_lit(&reply, "' no encontrado en este servidor\n");
+        client_sendv(conn->sockfd, &reply);
+        return;
+    }
+    
+    snprintf(line, sizeof(line), "[archivo] %s (%llu bytes)", ticket.name[0] ? ticket.name : "sin nombre", size);
+    log_message(&message_log, ticket.from, dest, line);
+    
+    Reply reply;
+    reply_init(&reply);
+    reply_add_lit(&reply, RESP_INFO " Oferta #");
+    reply_add_uint(&reply, ticket.id);
+    reply_add_lit(&reply, " enviada a ");
+    reply_add_str(&reply, dest);
+    reply_add_lit(&reply, ", espera que la acepte\n");
+    client_sendv(conn->sockfd, &reply);
+}
+
+// Comando /accept <id>: el destinatario recibe su token y el emisor el suyo
+static void handle_accept(Connection* conn, const char* args) {
+    unsigned id;
+    TransferTicket ticket;
+    char line[256];
+    
+    if (sscanf(args, " %u", &id) != 1) {
+        client_send_const(conn->sockfd, REPLY_ACCEPT_USAGE);
+        return;
+    }
+    if (transfer_accept(id, conn->cold->nick, &ticket) < 0) {
+        client_send_const(conn->sockfd, REPLY_TRANSFER_UNKNOWN);
+        return;
+    }
+    
+    size_t len = format_file_line(line, sizeof(line), RESP_FILE_RECV, &ticket, ticket.recv_token);
+    client_send(conn->sockfd, line, len, MSG_NOSIGNAL);
+    
+    // Si el emisor ya no está, la oferta vence sola
+    len = format_file_line(line, sizeof(line), RESP_FILE_SEND, &ticket, ticket.send_token);
+    notify_nick(ticket.from, line, len);
+}
+
+// Comando /reject <id>: el destinatario la rechaza o el emisor la cancela
+static void handle_reject(Connection* conn, const char* args) {
+    unsigned id;
+    TransferTicket ticket;
+    char line[64];
+    
+    if (sscanf(args, " %u", &id) != 1) {
+        client_send_const(conn->sockfd, REPLY_REJECT_USAGE);
+        return;
+    }
+    if (transfer_reject(id, conn->cold->nick, &ticket) < 0) {
+        client_send_const(conn->sockfd, REPLY_TRANSFER_UNKNOWN);
+        return;
+    }
+    
+    int len = snprintf(line, sizeof(line), RESP_FILE_END " %u rechazada 0\n", ticket.id);
+    const char* other = strcmp(ticket.to, conn->cold->nick) == 0 ? ticket.from : ticket.to;
+    notify_nick(other, line, (size_t)len);
+    
+    Reply reply;
+    reply_init(&reply);
+    reply_add_lit(&reply, RESP_INFO " Transferencia #");
+    reply_add_uint(&reply, ticket.id);
+    reply_add_lit(&reply, " cancelada\n");
+    client_sendv(conn->sockfd, &reply);
+}
+
+// Procesa un comando de un cliente registrado
+// Retorna 0 si la conexión debe cerrarse
+static int handle_command(Connection* conn, char* line) {
+    int client_sockfd = conn->sockfd;
+    const char* nick = conn->cold->nick;
+    Reply reply;
+    
+    // Procesar comandos
+    if (strncmp(line, CMD_QUIT, strlen(CMD_QUIT)) == 0) {
+        // Comando /quit: con sesión también se termina (no espera un /resume)
+        conn->cold->session = NULL;
+        return 0;
+        
+    } else if (strncmp(line, CMD_PONG, strlen(CMD_PONG)) == 0) {
+        // Respuesta a un PING: la actividad ya se registró
+        
+    } else if (strncmp(line, CMD_LIST, strlen(CMD_LIST)) == 0) {
+        // Comando /list - enviar lista de clientes
+        send_client_list(client_sockfd, line + strlen(CMD_LIST));
+        
+    } else if (strncmp(line, CMD_WATCH, strlen(CMD_WATCH)) == 0) {
+        // Comando /watch - recibir entradas y salidas sin pedir /list
+        set_watching(client_sockfd, 1);
+        client_send_const(client_sockfd, REPLY_WATCH_ON);
+        
+    } else if (strncmp(line, CMD_UNWATCH, strlen(CMD_UNWATCH)) == 0) {
+        // Comando /unwatch - dejar de recibirlas
+        set_watching(client_sockfd, 0);
+        client_send_const(client_sockfd, REPLY_WATCH_OFF);
+        
+    } else if (strncmp(line, CMD_SESSION, strlen(CMD_SESSION)) == 0) {
+        // Comando /session - token para retomar la sesión si se corta
+        start_session(conn);
+        
+    } else if (strncmp(line, CMD_HISTORY, strlen(CMD_HISTORY)) == 0) {
+        // Comando /history [n|desde] - mensajes anteriores
+        send_history(client_sockfd, line + strlen(CMD_HISTORY));
+        
+    } else if (strncmp(line, CMD_SEARCH, strlen(CMD_SEARCH)) == 0) {
+        // Comando /search <palabras> [from:nick] [since:desde] - buscar en el historial
+        send_search(client_sockfd, line + strlen(CMD_SEARCH));
+        
+    } else if (strncmp(line, CMD_SEND, strlen(CMD_SEND)) == 0) {
+        // Comando /send <nick> <bytes> [nombre] - ofrecer un archivo
+        handle_send(conn, line + strlen(CMD_SEND));
+        
+    } else if (strncmp(line, CMD_ACCEPT, strlen(CMD_ACCEPT)) == 0) {
+        // Comando /accept <id> - aceptar una oferta
+        handle_accept(conn, line + strlen(CMD_ACCEPT));
+        
+    } else if (strncmp(line, CMD_REJECT, strlen(CMD_REJECT)) == 0) {
+        // Comando /reject <id> - rechazar o cancelar una oferta
+        handle_reject(conn, line + strlen(CMD_REJECT));
+        
+    } else if (strncmp(line, CMD_HELP, strlen(CMD_HELP)) == 0) {
+        // Comando /help - mostrar ayuda
+        client_send_const(client_sockfd, REPLY_HELP);
+        
+    } else if (strncmp(line, CMD_MSG, strlen(CMD_MSG)) == 0) {
+        // Comando /msg <nick> <mensaje> - enviar mensaje privado
+        char* cmd_line = line + strlen(CMD_MSG);
+        
+        // Saltar espacios
+        while (*cmd_line == ' ') cmd_line++;
+        
+        // Extraer nick destino
+        char dest_nick[NICK_SIZE];
+        int i = 0;
+        while (*cmd_line != ' ' && *cmd_line != '\0' && i < NICK_SIZE - 1) {
+            dest_nick[i++] = *cmd_line++;
+        }
+        dest_nick[i] = '\0';
+        
+        // Saltar espacios
+        while (*cmd_line == ' ') cmd_line++;
+        
+        if (strlen(dest_nick) == 0 || strlen(cmd_line) == 0) {
+            client_send_const(client_sockfd, REPLY_MSG_USAGE);
+        } else if (strlen(cmd_line) > MAX_MSG_LENGTH) {
+            // El historial y los enlaces guardan hasta MAX_MSG_LENGTH: no se corta
+            client_send_const(client_sockfd, REPLY_MSG_TOO_LONG);
+        } else {
+            // Entregarlo si el destino está en este nodo
+            build_chat_reply(&reply, RESP_MSG_FROM " ", REPLY_LEN(RESP_MSG_FROM " "),
+                             nick, cmd_line);
+            int delivered = send_to_nick(dest_nick, &reply) == 0;
+            uint64_t t0 = !delivered ? trace_begin() : 0;
+            int forwarded = !delivered && federation_send_private(nick, dest_nick, cmd_line) == 0;
+            trace_end(t0, TRACE_ENQUEUE, -1, 0);
+            if (forwarded) {
+                // Está en otro nodo: lo entrega ese nodo
+                t0 = trace_begin();
+                log_message(&message_log, nick, dest_nick, cmd_line);
+                trace_end(t0, TRACE_LOG, -1, 0);
+                reply_init(&reply);
+                reply_add_lit(&reply, RESP_INFO " Mensaje enviado a ");
+                reply_add_str(&reply, dest_nick);
+                reply_add_lit(&reply, "\n");
+                client_sendv(client_sockfd, &reply);
+            } else if (!delivered) {
+                reply_init(&reply);
+                reply_add_lit(&reply, RESP_ERROR " Cliente '");
+                reply_add_str(&reply, dest_nick);
+                reply_add_lit(&reply, "' no encontrado\n");
+                client_sendv(client_sockfd, &reply);
+            } else {
+                // Registrar el mensaje en el log del dashboard
+                t0 = trace_begin();
+                log_message(&message_log, nick, dest_nick, cmd_line);
+                trace_end(t0, TRACE_LOG, -1, 0);
+                
+                // Confirmar al remitente
+                reply_init(&reply);
+                reply_add_lit(&reply, RESP_INFO " Mensaje enviado a ");
+                reply_add_str(&reply, dest_nick);
+                reply_add_lit(&reply, "\n");
+                client_sendv(client_sockfd, &reply);
+            }
+        }
+        
+    } else if (strncmp(line, CMD_BROADCAST, strlen(CMD_BROADCAST)) == 0) {
+        // Comando /broadcast <mensaje> - enviar mensaje a todos
+        char* cmd_line = line + strlen(CMD_BROADCAST);
+        
+        // Saltar espacios
+        while (*cmd_line == ' ') cmd_line++;
+        
+        if (strlen(cmd_line) == 0) {
+            client_send_const(client_sockfd, REPLY_BROADCAST_USAGE);
+        } else if (strlen(cmd_line) > MAX_MSG_LENGTH) {
+            client_send_const(client_sockfd, REPLY_MSG_TOO_LONG);
+        } else {
+            // Enviar mensaje a todos los demás clientes (los mismos fragmentos para todos)
+            build_chat_reply(&reply, RESP_BROADCAST " ", REPLY_LEN(RESP_BROADCAST " "),
+                             nick, cmd_line);
+            broadcast_to_all(client_sockfd, &reply);
+            uint64_t t0 = trace_begin();
+            int remote_count = federation_broadcast(nick, cmd_line);
+            trace_end(t0, TRACE_ENQUEUE, -1, 0);
+            
+            // Registrar en el log del dashboard y en el historial
+            t0 = trace_begin();
+            log_message(&message_log, nick, "broadcast", cmd_line);
+            message_store_append(&message_store, nick, cmd_line);
+            trace_end(t0, TRACE_LOG, -1, 0);
+            
+            // Confirmar al remitente
+            int recipients = client_list.count - 1 + remote_count;
+            reply_init(&reply);
+            reply_add_lit(&reply, RESP_INFO " Mensaje enviado a todos (");
+            reply_add_uint(&reply, recipients > 0 ? (unsigned long)recipients : 0);
+            reply_add_lit(&reply, " clientes)\n");
+            client_sendv(client_sockfd, &reply);
+        }
+        
+    } else {
+        // Comando desconocido o mensaje normal - hacer eco
+        client_send_const(client_sockfd, REPLY_UNKNOWN);
+    }
+    
+    return 1;
+}
+
+// Límite de ritmo por conexión (cubeta de fichas): retorna 0 si el comando
+// se descarta. Los cambios de rate_limit/rate_burst valen desde el próximo.
+static int rate_allow(Connection* conn) {
+    int limit = __atomic_load_n(&config.rate_limit, __ATOMIC_RELAXED);
+    if (limit <= 0) return 1;
+    
+    uint64_t now = monotonic_ms();
+    uint64_t capacity = (uint64_t)__atomic_load_n(&config.rate_burst, __ATOMIC_RELAXED) * 1000;
+    if (conn->cold->rate_last_ms == 0) {
+        conn->cold->rate_tokens = capacity;
+    } else {
+        conn->cold->rate_tokens += (now - conn->cold->rate_last_ms) * (uint64_t)limit;  // limit fichas/s = limit milésimas/ms
+        if (conn->cold->rate_tokens > capacity) conn->cold->rate_tokens = capacity;
+    }
+    conn->cold->rate_last_ms = now;
+    
+    if (conn->cold->rate_tokens < 1000) return 0;
+    conn->cold->rate_tokens -= 1000;
+    return 1;
+}
+
+// Procesa una línea completa. Retorna 0 si la conexión debe cerrarse.
+static int process_line(Connection* conn, char* line) {
+    // Eliminar '\r' de clientes tipo telnet
+    size_t len = strlen(line);
+    if (len > 0 && line[len - 1] == '\r') line[len - 1] = '\0';
+    
+    if (line[0] == '\0') return 1;
+    
+    int sockfd = conn->sockfd;
+    uint64_t t_line = trace_begin();
+    trace_message_begin();
+    
+    capture_line(conn->cold->capture_id, line, strlen(line));
+    stats_message_in(sockfd, monotonic_ms());
+    
+    // Cualquier línea demuestra que el cliente sigue vivo; el PONG
+    // no cuenta como actividad a efectos del timeout de inactividad
+    conn->awaiting_pong = 0;
+    if (strncmp(line, CMD_PONG, strlen(CMD_PONG)) != 0) {
+        conn->last_activity = monotonic_ms();
+    }
+    trace_end(t_line, TRACE_PARSE, sockfd, len);
+    
+    int result = 1;
+    if (conn->state == CONN_HANDSHAKE) {
+        result = handle_handshake(conn, line);
+    } else if (rate_allow(conn)) {
+        conn->cold->rate_limited = 0;
+        result = handle_command(conn, line);
+    } else if (!conn->cold->rate_limited) {
+        // Cada comando descartado recibe una línea, así el cliente no pierde
+        // la cuenta de sus respuestas; el aviso largo va una vez por ráfaga
+        conn->cold->rate_limited = 1;
+        client_send_const(conn->sockfd, REPLY_RATE_LIMITED);
+    } else {
+        client_send_const(conn->sockfd, REPLY_RATE_DROPPED);
+    }
+    
+    trace_end(t_line, TRACE_LINE, sockfd, len);
+    trace_message_end();
+    return result;
+}
+
+// La conexión envió "/xfer <token>": sale del epoll del worker y transfer.c
+// la une con su par. Los bytes del archivo no pueden llegar antes de
+// FILE_START: si llegaron junto con la línea, se corta.
+static int hand_off_transfer(Connection* conn, const char* line, size_t early) {
+    int sockfd = conn->sockfd;
+    const char* token = line + strlen(CMD_XFER);
+    while (*token == ' ') token++;
+    
+    if (early > 0) {
+        client_send_const(sockfd, REPLY_XFER_EARLY);
+        conn->state = CONN_HANDSHAKE;  // close_connection() cierra el socket
+        close_connection(conn);
+        return -1;
+    }
+    
+    close_connection(conn);
+    if (transfer_join(token, sockfd) < 0) {
+        client_send_const(sockfd, REPLY_XFER_UNKNOWN);
+        close(sockfd);
+    }
+    return -1;
+}
+
+// El socket tiene datos: leer y procesar cada línea recibida
+static int handle_readable(Connection* conn) {
+    char buffer[MAX_LINE + BUF_SIZE];
+    size_t len = conn->partial_len;
+    int bytes;
+    
+    // Anteponer la línea que quedó incompleta en la lectura anterior; si es
+    // larga se lee de una vez todo lo que entra, no de a BUF_SIZE
+    if (len > 0) memcpy(buffer, conn->partial, len);
+    size_t room = len >= BUF_SIZE ? sizeof(buffer) - len - 1 : BUF_SIZE - 1;
+    
+    uint64_t t0 = trace_begin();
+    if (conn->shm) {
+        bytes = (int)shm_channel_read(conn->shm, buffer + len, room);
+        if (bytes == 0 && server_running) return 0;  // Anillo vacío: aviso armado
+    } else {
+        // Sin esperar: un EPOLLERR cuyos avisos de MSG_ZEROCOPY ya leyó otro
+        // thread llega acá sin nada que leer, y el worker no puede bloquearse
+        bytes = recv(conn->sockfd, buffer + len, room, MSG_DONTWAIT);
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && server_running) {
+            trace_end(t0, TRACE_RECV, conn->sockfd, 0);
+            return 0;
+        }
+    }
+    trace_end(t0, TRACE_RECV, conn->sockfd, bytes > 0 ? (size_t)bytes : 0);
+    
+    if (bytes <= 0 || !server_running) {
+        close_connection(conn);  // Cliente desconectado o servidor cerrando
+        return -1;
+    }
+    stats_bytes_in(conn->sockfd, (size_t)bytes);
+    
+    if (len > 0) partial_release(conn);
+    
+    if (memchr(buffer + len, '\n', bytes)) conn->line_mode = 1;
+    len += bytes;
+    buffer[len] = '\0';
+    
+    // Un mismo recv puede traer varios comandos separados por '\n'
+    char* start = buffer;
+    char* end = buffer + len;
+    char* newline;
+    while ((newline = memchr(start, '\n', end - start)) != NULL) {
+        *newline = '\0';
+        if (!process_line(conn, start)) {
+            close_connection(conn);
+            return -1;
+        }
+        if (conn->state == CONN_TRANSFER) return hand_off_transfer(conn, start, end - newline - 1);
+        start = newline + 1;
+    }
+    
+    // Resto sin '\n': si el cliente separa por líneas es un comando a medio
+    // llegar; los clientes que envían un comando por client_send() no usan '\n'
+    size_t rest = end - start;
+    if (rest > 0) {
+        if (conn->line_mode && rest < MAX_LINE) {
+            conn->partial = rest < BUF_SIZE ? read_pool_get(&conn->worker->read_pool) : malloc(rest);
+            if (conn->partial) {
+                memcpy(conn->partial, start, rest);
+                conn->partial_len = (uint16_t)rest;
+            }
+        } else if (!process_line(conn, start)) {
+            close_connection(conn);
+            return -1;
+        } else if (conn->state == CONN_TRANSFER) {
+            return hand_off_transfer(conn, start, 0);
+        }
+    }
+    
+    if (conn->state == CONN_ACTIVE) {
+        schedule_idle_timer(conn);
+    }
+    
+    return 1;
+}
+
+// Hay datos en el anillo de un cliente local (o el aviso quedó pendiente)
+static void handle_local_readable(Connection* conn) {
+    shm_channel_ack(conn->shm);
+    
+    for (int i = 0; i < LOCAL_READ_BATCH; i++) {
+        if (handle_readable(conn) <= 0) return;
+    }
+    
+    // Quedan datos: volver a avisarse para no acaparar el worker
+    uint64_t one = 1;
+    if (write(conn->shm->rx_data_efd, &one, sizeof(one)) < 0) {
+        perror("eventfd");
+    }
+}
+
+// Negocia el anillo compartido con un cliente conectado por el socket UNIX
+static int attach_local_channel(Worker* w, Connection* conn) {
+    conn->shm = calloc(1, sizeof(ShmChannel));
+    if (!conn->shm || shm_channel_create(conn->shm, conn->sockfd) < 0) {
+        free(conn->shm);
+        conn->shm = NULL;
+        return -1;
+    }
+    
+    // El puntero etiquetado distingue el eventfd del socket en el epoll
+    struct epoll_event ev = {
+        .events = EPOLLIN,
+        .data.ptr = (void*)((uintptr_t)conn | 1)
+    };
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, conn->shm->rx_data_efd, &ev) < 0) {
+        shm_channel_destroy(conn->shm);
+        free(conn->shm);
+        conn->shm = NULL;
+        return -1;
+    }
+    
+    register_local_channel(conn->sockfd, conn->shm);
+    return 0;
+}
+
+// Registra en el worker un socket recién aceptado
+static Connection* attach_connection(Worker* w, int sockfd) {
+    Connection* conn = conn_new();
+    if (!conn) {
+        close(sockfd);
+        return NULL;
+    }
+    
+    // Los sockets no se heredan en un exec: en un upgrade viajan por SCM_RIGHTS
+    fcntl(sockfd, F_SETFD, FD_CLOEXEC);
+    
+    conn->sockfd = sockfd;
+    conn->state = CONN_HANDSHAKE;
+    conn->last_activity = monotonic_ms();
+    conn->worker = w;
+    timer_init(&conn->timer, connection_timeout, conn);
+    stats_reset_conn(sockfd);
+    
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = conn };
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        perror("epoll_ctl");
+        close(sockfd);
+        conn_free(conn);
+        return NULL;
+    }
+    
+    conn->next = w->connections;
+    if (w->connections) w->connections->prev = conn;
+    w->connections = conn;
+    conn->cold->capture_id = capture_open();
+    
+    int sndbuf_kb = __atomic_load_n(&config.sndbuf_kb, __ATOMIC_RELAXED);
+    if (sndbuf_kb > 0) {
+        int bytes = sndbuf_kb * 1024;
+        setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+    }
+    
+    // Por encima de net.core.busy_read hace falta CAP_NET_ADMIN
+    int busy_poll_sock_us = __atomic_load_n(&config.busy_poll_sock_us, __ATOMIC_RELAXED);
+    if (busy_poll_sock_us > 0 &&
+        setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_sock_us, sizeof(busy_poll_sock_us)) < 0) {
+        __atomic_fetch_add(&busy_poll_sock_errors, 1, __ATOMIC_RELAXED);
+    }
+    
+    if (config.handshake_timeout > 0) {
+        timer_arm(&w->wheel, &conn->timer, (uint64_t)config.handshake_timeout * 1000);
+    }
+    
+    // Los clientes del socket UNIX pasan a memoria compartida
+    int domain = AF_INET;
+    socklen_t domain_len = sizeof(domain);
+    getsockopt(sockfd, SOL_SOCKET, SO_DOMAIN, &domain, &domain_len);
+    if (domain == AF_UNIX && attach_local_channel(w, conn) < 0) {
+        close_connection(conn);
+        return NULL;
+    }
+    
+    return conn;
+}
+
+// ============================================================================
+// Workers
+// ============================================================================
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// Espera de eventos del worker. Con --busy-poll-us primero consulta el epoll
+// sin bloquearse durante ese plazo: lo que llega mientras gira se atiende sin
+// pagar el despertar del thread, a cambio de quemar la CPU mientras no llega
+// nada. Vencido el plazo se bloquea como siempre. Entre vuelta y vuelta cede
+// la CPU: si la comparte con el cliente o con otro worker, los deja correr
+// (con una CPU propia sched_yield vuelve enseguida).
+static int worker_wait(Worker* w, struct epoll_event* events, int timeout) {
+    int spin_us = __atomic_load_n(&config.busy_poll_us, __ATOMIC_RELAXED);
+    if (spin_us <= 0 || timeout == 0) return epoll_wait(w->epfd, events, MAX_EVENTS, timeout);
+    
+    // Un timer que vence antes corta el giro
+    uint64_t budget_ns = (uint64_t)spin_us * 1000;
+    if (timeout > 0 && (uint64_t)timeout * 1000000 < budget_ns) budget_ns = (uint64_t)timeout * 1000000;
+    
+    // El plazo corre en tiempo real; lo que se reporta es la CPU que gastó el giro
+    uint64_t start = clock_ns(CLOCK_MONOTONIC);
+    uint64_t cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t spun;
+    do {
+        int n = epoll_wait(w->epfd, events, MAX_EVENTS, 0);
+        if (n < 0) return n;
+        if (n > 0) {
+            stats_poll(clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start, 1);
+            return n;
+        }
+        sched_yield();
+        spun = clock_ns(CLOCK_MONOTONIC) - start;
+    } while (spun < budget_ns && server_running);
+    
+    stats_poll(clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start, 0);
+    if (timeout > 0) {
+        timeout -= (int)(spun / 1000000);
+        if (timeout < 0) timeout = 0;
+    }
+    return epoll_wait(w->epfd, events, MAX_EVENTS, timeout);
+}
+
+void* worker_thread(void* arg) {
+    Worker* w = (Worker*)arg;
+    struct epoll_event events[MAX_EVENTS];
+    char name[STATS_THREAD_NAME];
+    
+    // Fijarse a sus CPUs antes de reservar nada: lo que reserve de acá en
+    // más (conexiones, líneas parciales) queda en su nodo
+    if (w->pinned) {
+        if (affinity_pin_self(&w->cpus) < 0) perror("pthread_setaffinity_np");
+        affinity_move_to_node(w, sizeof(*w), w->node);
+    }
+    
+    snprintf(name, sizeof(name), "worker-%d", w->id);
+    stats_register_thread(name);
+    trace_register_thread(name);
+    
+    while (server_running) {
+        int timeout = timer_wheel_next_timeout(&w->wheel, monotonic_ms());
+        int n = worker_wait(w, events, timeout);
+        
+        for (int i = 0; i < n && server_running; i++) {
+            if (events[i].data.ptr == NULL) {
+                // Sockets nuevos desde el acceptor (-1 = despertar para cerrar)
+                int sockfd;
+                while (read(w->notify_pipe[0], &sockfd, sizeof(sockfd)) == sizeof(sockfd)) {
+                    if (sockfd >= 0) attach_connection(w, sockfd);
+                }
+            } else {
+                uintptr_t tag = (uintptr_t)events[i].data.ptr;
+                Connection* conn = (Connection*)(tag & ~(uintptr_t)1);
+                if (conn->closed) continue;
+                
+                if (tag & 1) {
+                    handle_local_readable(conn);
+                } else if ((events[i].events & EPOLLERR) && !conn->shm &&
+                           zerocopy_reap(conn->sockfd) > 0 && !(events[i].events & (EPOLLIN | EPOLLHUP))) {
+                    // Solo avisos de MSG_ZEROCOPY en la cola de errores: no hay nada que leer.
+                    // Si otro thread ya los leyó (zerocopy_send() a ZEROCOPY_REAP_PENDING)
+                    // sigue a handle_readable(), que no espera: cierra si hay un error real
+                } else if (conn->shm) {
+                    // Un cliente local no escribe en el socket: es el cierre
+                    close_connection(conn);
+                } else {
+                    handle_readable(conn);
+                }
+            }
+        }
+        
+        timer_wheel_advance(&w->wheel, monotonic_ms());
+        
+        while (w->closed) {
+            Connection* conn = w->closed;
+            w->closed = conn->next;
+            conn_free(conn);
+        }
+    }
+    
+    // Durante un upgrade las conexiones se conservan para traspasarlas
+    if (upgrade_in_progress) return NULL;
+    
+    // Liberar el estado propio; los sockets de clientes registrados los
+    // cierra main() después de despedirse de ellos
+    while (w->connections) {
+        Connection* conn = w->connections;
+        w->connections = conn->next;
+        if (conn->shm) {
+            unregister_local_channel(conn->sockfd);
+            shm_channel_destroy(conn->shm);
+            free(conn->shm);
+        }
+        if (conn->state == CONN_HANDSHAKE) close(conn->sockfd);
+        partial_release(conn);
+        conn_free(conn);
+    }
+    while (w->closed) {
+        Connection* conn = w->closed;
+        w->closed = conn->next;
+        conn_free(conn);
+    }
+    while (w->read_pool.free_list) {
+        char* buf = w->read_pool.free_list;
+        w->read_pool.free_list = *(char**)buf;
+        free(buf);
+    }
+    w->read_pool.free_count = 0;
+    
+    return NULL;
+}
+
+// Crea el epoll y el pipe de un worker (sin lanzar el thread)
+static int init_worker(int i) {
+    Worker* w = &workers[i];
+    w->id = i;
+    w->connections = NULL;
+    w->closed = NULL;
+    timer_wheel_init(&w->wheel, TW_DEFAULT_TICK_MS);
+    
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (w->epfd < 0 || pipe2(w->notify_pipe, O_CLOEXEC) < 0) {
+        perror("worker");
+        return -1;
+    }
+    
+    // Lectura no bloqueante para vaciar el pipe sin quedarse colgado
+    fcntl(w->notify_pipe[0], F_SETFL, O_NONBLOCK);
+    
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->notify_pipe[0], &ev);
+    return 0;
+}
+
+static int init_workers(int count) {
+    for (int i = 0; i < count; i++) {
+        if (init_worker(i) < 0) return -1;
+    }
+    return 0;
+}
+
+// Reparte los workers first..count-1 entre las CPUs de --cpus o los nodos de
+// --numa-nodes; los anteriores ya corren y conservan sus CPUs. La tabla de
+// SO_INCOMING_CPU se arma aparte y se publica entrada por entrada: el
+// acceptor la lee sin lock y nunca ve una CPU a medio asignar
+static int plan_placement(int first, int count) {
+    int items[CPU_SETSIZE];
+    int map[CPU_SETSIZE];
+    cpu_set_t allowed;
+    
+    if (!config.cpu_list && !config.numa_list) return 0;
+    
+    int n = affinity_parse_list(config.cpu_list ? config.cpu_list : config.numa_list, items, CPU_SETSIZE);
+    if (n < 0 || sched_getaffinity(0, sizeof(allowed), &allowed) < 0) return -1;
+    
+    if (first == 0) CPU_ZERO(&placement_all);
+    for (int i = first; i < count; i++) {
+        Worker* w = &workers[i];
+        CPU_ZERO(&w->cpus);
+        
+        if (config.cpu_list) {
+            if (!CPU_ISSET(items[i % n], &allowed)) return -1;
+            CPU_SET(items[i % n], &w->cpus);
+            w->node = affinity_cpu_node(items[i % n]);
+        } else {
+            if (affinity_node_cpus(items[i % n], &w->cpus) < 0) return -1;
+            CPU_AND(&w->cpus, &w->cpus, &allowed);
+            if (CPU_COUNT(&w->cpus) == 0) return -1;
+            w->node = items[i % n];
+        }
+        
+        w->pinned = 1;
+        CPU_OR(&placement_all, &placement_all, &w->cpus);
+    }
+    
+    // Cada CPU se asigna a uno de los workers que la usan (alternando si
+    // varios workers comparten un nodo)
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        int candidates = 0;
+        map[cpu] = -1;
+        for (int i = 0; i < count; i++) {
+            if (CPU_ISSET(cpu, &workers[i].cpus)) candidates++;
+        }
+        if (candidates == 0) continue;
+        
+        int pick = cpu % candidates;
+        for (int i = 0; i < count; i++) {
+            if (CPU_ISSET(cpu, &workers[i].cpus) && pick-- == 0) {
+                map[cpu] = i;
+                break;
+            }
+        }
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        __atomic_store_n(&incoming_cpu_worker[cpu], map[cpu], __ATOMIC_RELAXED);
+    }
+    
+    placement_enabled = 1;
+    return 0;
+}
+
+// --placement: CPUs y nodo de cada thread y steering esperado de la placa
+static void print_placement(int count) {
+    char list[256];
+    cpu_set_t sets[MAX_WORKERS];
+    
+    if (!placement_enabled) {
+        printf("Sin --cpus ni --numa-nodes: el kernel reparte los threads libremente\n");
+        return;
+    }
+    
+    printf("Ubicación de los threads\n");
+    affinity_format_list(&placement_all, list, sizeof(list));
+    printf("  %-12s CPUs %s (también dashboard, presencia y federación)\n", "acceptor", list);
+    for (int i = 0; i < count; i++) {
+        affinity_format_list(&workers[i].cpus, list, sizeof(list));
+        printf("  worker-%-5d CPUs %-12s nodo %d\n", i, list, workers[i].node);
+        sets[i] = workers[i].cpus;
+    }
+    
+    printf("\nSteering esperado: el acceptor entrega cada conexión al worker de la CPU\n");
+    printf("que procesó sus paquetes (SO_INCOMING_CPU); las marcadas con <- no coinciden\n");
+    affinity_report_steering(stdout, sets, count);
+}
+
+// Worker de la CPU por la que entró la conexión (NULL = repartir en orden)
+static Worker* worker_for_incoming_cpu(int sockfd) {
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    
+    if (getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0) return NULL;
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return NULL;
+    
+    // Un worker fuera de los activos (admin bajó "workers", o todavía no
+    // terminó de subirlos) no recibe nuevas
+    int idx = __atomic_load_n(&incoming_cpu_worker[cpu], __ATOMIC_RELAXED);
+    if (idx < 0 || idx >= __atomic_load_n(&config.workers, __ATOMIC_ACQUIRE)) return NULL;
+    return &workers[idx];
+}
+
+static void launch_workers(int count) {
+    for (int i = 0; i < count; i++) {
+        pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]);
+    }
+    launched_workers = count;
+}
+
+// Despierta a cada worker para que vea server_running == 0 y lo espera
+static void join_workers(int count) {
+    for (int i = 0; i < count; i++) {
+        int wake = -1;
+        if (write(workers[i].notify_pipe[1], &wake, sizeof(wake)) < 0) {
+            perror("write");
+        }
+    }
+    
+    for (int i = 0; i < count; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+}
+
+static void destroy_workers(int count) {
+    for (int i = 0; i < count; i++) {
+        close(workers[i].notify_pipe[0]);
+        close(workers[i].notify_pipe[1]);
+        close(workers[i].epfd);
+    }
+}
+
+// ============================================================================
+// Federación
+// ============================================================================
+
+// Un /msg de otro nodo para un cliente de este nodo
+static void deliver_remote_private(const char* from, const char* to, const char* text) {
+    Reply reply;
+    
+    build_chat_reply(&reply, RESP_MSG_FROM " ", REPLY_LEN(RESP_MSG_FROM " "), from, text);
+    if (send_to_nick(to, &reply) < 0) return;  // Se desconectó mientras viajaba
+    log_message(&message_log, from, to, text);
+}
+
+// Un /broadcast de otro nodo: llega una vez y se reparte a los locales
+static void deliver_remote_broadcast(const char* from, const char* text) {
+    Reply reply;
+    
+    build_chat_reply(&reply, RESP_BROADCAST " ", REPLY_LEN(RESP_BROADCAST " "), from, text);
+    broadcast_to_all(-1, &reply);
+    log_message(&message_log, from, "broadcast", text);
+    message_store_append(&message_store, from, text);
+}
+
+// Arranca la federación y anuncia los clientes ya registrados
+static void start_federation(void) {
+    FederationConfig fed_config = {
+        .node_id = config.node_id,
+        .listen_port = config.peer_port,
+        .secret = config.peer_secret,
+        .peer_count = config.peer_count,
+        .deliver_private = deliver_remote_private,
+        .deliver_broadcast = deliver_remote_broadcast,
+        .presence_changed = presence_event
+    };
+    
+    if (!config.node_id) return;
+    
+    memcpy(fed_config.peers, config.peers, sizeof(config.peers));
+    if (federation_start(&fed_config) < 0) {
+        fprintf(stderr, "Error: No se pudo iniciar la federación\n");
+        return;
+    }
+    
+    pthread_mutex_lock(&client_list.mutex);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (client_list.clients[i].active) {
+            federation_local_join(client_list.clients[i].nick, client_list.clients[i].connected_at);
+        }
+    }
+    pthread_mutex_unlock(&client_list.mutex);
+}
+
+// ============================================================================
+// Reinicio sin cortes (upgrade)
+// ============================================================================
+
+// Reconstruye en un worker una conexión recibida del proceso anterior,
+// con la línea que el cliente dejó a medio enviar (partial).
+// Se llama antes de lanzar los threads de los workers.
+static void restore_connection(Worker* w, int sockfd, const UpgradeRecord* record, const char* partial) {
+    Connection* conn = attach_connection(w, sockfd);
+    if (!conn) return;
+    
+    conn->last_activity = monotonic_ms() - record->idle_ms;
+    conn->line_mode = record->line_mode != 0;
+    size_t rest = record->partial_len;
+    if (rest > 0 && rest < MAX_LINE) {
+        conn->partial = rest < BUF_SIZE ? read_pool_get(&w->read_pool) : malloc(rest);
+        if (conn->partial) {
+            memcpy(conn->partial, partial, rest);
+            conn->partial_len = (uint16_t)rest;
+        }
+    }
+    if (record->state != CONN_ACTIVE) return;  // Sigue esperando el nick
+    
+    memcpy(conn->cold->nick, record->nick, NICK_SIZE - 1);
+    conn->cold->nick[NICK_SIZE - 1] = '\0';
+    
+    int idx = add_client(sockfd, conn->cold->nick);
+    if (idx < 0) {
+        close_connection(conn);
+        return;
+    }
+    client_list.clients[idx].connected_at = (time_t)record->connected_at;
+    if (record->watching) set_watching(sockfd, 1);
+    conn->state = CONN_ACTIVE;
+    schedule_idle_timer(conn);
+}
+
+// Recibe el socket de escucha y los clientes del proceso anterior
+static int resume_from_upgrade(int upgrade_fd) {
+    UpgradeRecord* records = NULL;
+    int* fds = NULL;
+    char* partials = NULL;
+    int count = 0;
+    
+    if (upgrade_recv_state(upgrade_fd, &server_sockfd, &records, &fds, &count, &partials) < 0) {
+        return -1;
+    }
+    
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        restore_connection(&workers[i % config.workers], fds[i], &records[i], partials + offset);
+        offset += records[i].partial_len;
+    }
+    
+    free(records);
+    free(fds);
+    free(partials);
+    return count;
+}
+
+// Traspasa el servidor a un binario nuevo. Retorna 0 si el proceso nuevo
+// tomó el control (este debe terminar) o -1 si hay que seguir sirviendo.
+static int perform_upgrade(char* argv[], pthread_t* dash_thread, DashboardThreadArgs* dash_args) {
+    // Detener workers y dashboard sin cerrar ningún socket; el socket de
+    // administración se libera para que lo cree el proceso nuevo
+    admin_stop();
+    upgrade_in_progress = 1;
+    server_running = 0;
+    join_workers(launched_workers);
+    pthread_join(*dash_thread, NULL);
+    disable_raw_mode();  // El proceso nuevo toma la terminal
+    
+    // Los enlaces no se traspasan: el proceso nuevo los vuelve a abrir
+    federation_stop();
+    presence_stop();
+    transfer_stop();  // Las transferencias en curso se cortan
+    session_stop();  // Las sesiones no se traspasan (ver session.h)
+    coalesce_stop();  // Lo encolado sale antes de pasar los sockets
+    lanes_stop();
+    
+    // El proceso nuevo crea su propio socket local en la misma ruta
+    if (local_sockfd >= 0) {
+        close(local_sockfd);
+        local_sockfd = -1;
+    }
+    
+    // Serializar el registro de conexiones de todos los workers
+    int count = 0;
+    for (int i = 0; i < launched_workers; i++) {
+        for (Connection* c = workers[i].connections; c; c = c->next) {
+            if (!c->shm) count++;
+        }
+    }
+    
+    // Las líneas a medias van una tras otra, en el orden de los registros
+    size_t partials_len = 0;
+    for (int i = 0; i < launched_workers; i++) {
+        for (Connection* c = workers[i].connections; c; c = c->next) {
+            if (!c->shm) partials_len += c->partial_len;
+        }
+    }
+    
+    UpgradeRecord* records = calloc(count + 1, sizeof(UpgradeRecord));
+    int* fds = calloc(count + 1, sizeof(int));
+    char* partials = malloc(partials_len + 1);
+    int result = -1;
+    int sock = -1;
+    pid_t child = -1;
+    
+    if (records && fds && partials) {
+        uint64_t now = monotonic_ms();
+        size_t offset = 0;
+        int n = 0;
+        
+        pthread_mutex_lock(&client_list.mutex);
+        for (int i = 0; i < launched_workers; i++) {
+            for (Connection* c = workers[i].connections; c; c = c->next) {
+                // Los clientes locales no se traspasan: al terminar este
+                // proceso ven el cierre y se reconectan al nuevo
+                if (c->shm) continue;
+                
+                UpgradeRecord* r = &records[n];
+                r->state = c->state;
+                memcpy(r->nick, c->cold->nick, NICK_SIZE);
+                r->idle_ms = (uint32_t)(now - c->last_activity);
+                r->line_mode = c->line_mode;
+                r->partial_len = c->partial_len;
+                if (c->partial_len > 0) memcpy(partials + offset, c->partial, c->partial_len);
+                offset += c->partial_len;
+                r->connected_at = (int64_t)time(NULL);
+                for (int j = 0; j < MAX_CLIENTS; j++) {
+                    if (client_list.clients[j].active && client_list.clients[j].sockfd == c->sockfd) {
+                        r->connected_at = (int64_t)client_list.clients[j].connected_at;
+                        r->watching = client_list.clients[j].watching;
+                        break;
+                    }
+                }
+                fds[n++] = c->sockfd;
+            }
+        }
+        pthread_mutex_unlock(&client_list.mutex);
+        
+        child = upgrade_spawn(argv, &sock);
+        if (child > 0 &&
+            upgrade_send_state(sock, server_sockfd, records, fds, count, partials, partials_len) == 0 &&
+            upgrade_wait_ack(sock, UPGRADE_ACK_TIMEOUT_MS) == 0) {
+            result = 0;
+        }
+    }
+    
+    free(records);
+    free(fds);
+    free(partials);
+    if (sock >= 0) close(sock);
+    
+    if (result < 0) {
+        // El proceso nuevo no arrancó: retomar el servicio como si nada
+        fprintf(stderr, "Upgrade fallido, el servidor sigue en el proceso %d\n", (int)getpid());
+        if (child > 0) {
+            kill(child, SIGKILL);
+            waitpid(child, NULL, 0);
+        }
+        upgrade_in_progress = 0;
+        server_running = 1;
+        lanes_start(config.bulk_queue_kb);
+        presence_start(config.presence_window, deliver_presence);
+        session_start(resume_sendiov, push_sendiov, expire_sessions);
+        coalesce_start(config.coalesce_ms, bulk_sendiov);
+        transfer_start(transfer_notify);
+        start_federation();
+        if (config.local_socket) local_sockfd = shm_listen(config.local_socket);
+        launch_workers(launched_workers);
+        pthread_create(dash_thread, NULL, dashboard_thread, dash_args);
+        if (config.admin_socket && admin_start(config.admin_socket) < 0) {
+            perror(config.admin_socket);
+        }
+    }
+    
+    return result;
+}
+
+// ============================================================================
+// Trazado (SIGUSR1)
+// ============================================================================
+
+// Apaga el trazado y vuelca lo anotado en config.trace_path
+static void dump_trace(void) {
+    char path[512];
+    
+    trace_disable();
+    if (config.trace_path) {
+        snprintf(path, sizeof(path), "%s", config.trace_path);
+    } else {
+        snprintf(path, sizeof(path), "traza-%d.json", (int)getpid());
+    }
+    if (trace_dump(path) < 0) perror(path);
+}
+
+// Primera señal: empezar a trazar; segunda: volcar y apagar
+static void toggle_trace(void) {
+    if (trace_enabled()) {
+        dump_trace();
+    } else {
+        trace_enable();
+    }
+}
+
+// ============================================================================
+// Límite de descriptores
+// ============================================================================
+
+// Cada cliente ocupa un descriptor: se sube el límite blando hasta lo que
+// pide MAX_CLIENTS (sin pasar el duro). No más que eso, porque la tabla de
+// estadísticas y la de canales locales se dimensionan con este límite.
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    rlim_t wanted = (rlim_t)MAX_CLIENTS + FD_RESERVED;
+    
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) return;
+    if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < wanted) {
+        rl.rlim_cur = rl.rlim_max != RLIM_INFINITY && rl.rlim_max < wanted ? rl.rlim_max : wanted;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0) getrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < wanted) {
+        printf("Aviso: el límite de descriptores (%llu) no alcanza para %d clientes; "
+               "los que no entren reciben \"Servidor lleno\"\n",
+               (unsigned long long)rl.rlim_cur, MAX_CLIENTS);
+    }
+}
+
+// Reserva un descriptor para poder atender a quien llega cuando no quedan
+static void reserve_spare_fd(void) {
+    if (spare_fd < 0) spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+// Sin descriptores libres accept() falla pero la conexión sigue en la cola
+// y poll() la vuelve a anunciar enseguida: se suelta la reserva, se acepta,
+// se avisa "Servidor lleno", se cierra y se vuelve a reservar
+static void reject_without_fd(int listen_fd) {
+    if (spare_fd < 0) {
+        usleep(100000);  // Sin reserva no queda más que esperar a que se libere alguno
+        reserve_spare_fd();
+        return;
+    }
+    
+    close(spare_fd);
+    spare_fd = -1;
+    int sockfd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (sockfd >= 0) {
+        send(sockfd, REPLY_SERVER_FULL, REPLY_LEN(REPLY_SERVER_FULL), MSG_NOSIGNAL | MSG_DONTWAIT);
+        close(sockfd);
+        __atomic_add_fetch(&fd_rejections, 1, __ATOMIC_RELAXED);
+    }
+    reserve_spare_fd();
+}
+
+// ============================================================================
+// Administración en caliente (--admin-socket)
+// ============================================================================
+
+// workers: subir lanza los que falten; bajar solo deja de darles conexiones
+// nuevas (las que ya tienen siguen hasta que se cierren)
+static int apply_workers(int count) {
+    if (count <= launched_workers) return 0;
+    
+    if (placement_enabled && plan_placement(launched_workers, count) < 0) return -1;
+    for (int i = launched_workers; i < count; i++) {
+        if (init_worker(i) < 0) return -1;
+        if (pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]) != 0) {
+            close(workers[i].notify_pipe[0]);
+            close(workers[i].notify_pipe[1]);
+            close(workers[i].epfd);
+            return -1;
+        }
+        launched_workers = i + 1;
+    }
+    return 0;
+}
+
+// backlog: un listen() nuevo sobre el mismo socket cambia la cola al instante
+static int apply_backlog(int backlog) {
+    if (server_sockfd >= 0 && listen(server_sockfd, backlog) < 0) return -1;
+    if (local_sockfd >= 0 && listen(local_sockfd, backlog) < 0) return -1;
+    return 0;
+}
+
+// max_clients: el resumen de /list muestra el cupo, hay que rearmarlo
+// (con el valor nuevo ya publicado para que la vista no tome el viejo)
+static int apply_max_clients(int limit) {
+    __atomic_store_n(&client_list.limit, limit, __ATOMIC_RELEASE);
+    list_snapshot_invalidate();
+    return 0;
+}
+
+static int apply_log_depth(int depth) {
+    message_log_set_depth(&message_log, depth);
+    return 0;
+}
+
+static int apply_dashboard_refresh(int ms) {
+    dashboard_set_refresh_ms(ms);
+    return 0;
+}
+
+static int apply_presence_window(int ms) {
+    presence_set_window(ms);
+    return 0;
+}
+
+static int apply_coalesce(int ms) {
+    coalesce_set_budget(ms);
+    return 0;
+}
+
+static int apply_zerocopy(int min_bytes) {
+    if (min_bytes > 0 && min_bytes < ZEROCOPY_MIN_BYTES) return -1;
+    zerocopy_set_min_bytes(min_bytes);
+    return 0;
+}
+
+static int apply_bulk_queue(int kb) {
+    lanes_set_bulk_limit(kb);
+    return 0;
+}
+
+static int apply_busy_poll(int us) {
+    dashboard_set_busy_poll_us(us);
+    return 0;
+}
+
+// Lo que ocupa de verdad un bloque de size bytes en el heap (con su encabezado)
+static size_t heap_block_size(size_t size) {
+    void* p = malloc(size);
+    if (!p) return size;
+    size_t usable = malloc_usable_size(p) + sizeof(size_t);
+    free(p);
+    return usable;
+}
+
+// Comando "memory": bytes por conexión inactiva, las tablas indexadas por fd
+// (se reservan enteras al arrancar) y lo prestado mientras hay datos en
+// camino (sin contar las ventanas de /session)
+static int admin_memory(const char* args, char* out, size_t size) {
+    (void)args;
+    
+    size_t hot = heap_block_size(sizeof(Connection));
+    size_t cold = heap_block_size(sizeof(ConnCold));
+    size_t idle = hot + cold + sizeof(ClientInfo) + sizeof(ConnStats);
+    int conns = __atomic_load_n(&live_connections, __ATOMIC_RELAXED);
+    
+    int read_in_use = 0;
+    int read_free = 0;
+    for (int i = 0; i < launched_workers; i++) {
+        read_in_use += __atomic_load_n(&workers[i].read_pool.in_use, __ATOMIC_RELAXED);
+        read_free += __atomic_load_n(&workers[i].read_pool.free_count, __ATOMIC_RELAXED);
+    }
+    
+    CoalesceStats cst;
+    coalesce_get_stats(&cst);
+    LaneStats lst;
+    lanes_get_stats(&lst);
+    ZerocopyStats zst;
+    zerocopy_get_stats(&zst);
+    
+    // Memoria del kernel para los buffers TCP de todo el sistema (en páginas)
+    long tcp_sockets = 0;
+    long tcp_pages = 0;
+    FILE* f = fopen("/proc/net/sockstat", "r");
+    if (f) {
+        char line[256];
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "TCP: inuse %*d orphan %*d tw %*d alloc %ld mem %ld", &tcp_sockets, &tcp_pages) == 2) break;
+        }
+        fclose(f);
+    }
+    
+    struct rlimit rl;
+    rlim_t fd_limit = getrlimit(RLIMIT_NOFILE, &rl) == 0 ? rl.rlim_cur : 0;
+    
+    size_t tables = (size_t)(lst.table_bytes + cst.table_bytes + zst.table_bytes + zst.socket_bytes);
+    size_t in_flight = (size_t)read_in_use * BUF_SIZE + (size_t)cst.outbox_bytes +
+                       (size_t)lst.queued_bytes + (size_t)zst.payload_bytes;
+    snprintf(out, size,
+             "conexiones            = %d\n"
+             "bytes_por_inactiva    = %zu (caliente %zu + fría %zu + registro %zu + contadores %zu)\n"
+             "tablas_por_fd         = %zu (carriles %llu + agrupado %llu + sin copia %llu)\n"
+             "buffers_de_lectura    = %d prestados, %d libres (%d bytes c/u)\n"
+             "colas_de_salida       = %llu prestadas (%llu bytes)\n"
+             "colas_por_carril      = %llu bytes encolados\n"
+             "envios_sin_copia      = %llu buffers (%llu bytes)\n"
+             "bytes_en_camino       = %zu\n"
+             "total_conexiones      = %zu\n"
+             "kernel_tcp            = %ld bytes en %ld sockets de todo el sistema\n"
+             "limite_descriptores   = %llu (rechazados sin descriptor: %lu)\n",
+             conns,
+             idle, hot, cold, sizeof(ClientInfo), sizeof(ConnStats),
+             tables, (unsigned long long)lst.table_bytes, (unsigned long long)cst.table_bytes,
+             (unsigned long long)(zst.table_bytes + zst.socket_bytes),
+             read_in_use, read_free, BUF_SIZE,
+             (unsigned long long)cst.outboxes, (unsigned long long)cst.outbox_bytes,
+             (unsigned long long)lst.queued_bytes,
+             (unsigned long long)zst.payloads, (unsigned long long)zst.payload_bytes,
+             in_flight,
+             (size_t)conns * idle + tables + in_flight,
+             tcp_pages * sysconf(_SC_PAGESIZE), tcp_sockets,
+             (unsigned long long)fd_limit, __atomic_load_n(&fd_rejections, __ATOMIC_RELAXED));
+    return 0;
+}
+
+// Comando "coalesce": mensajes por writev y envíos ahorrados desde el arranque
+static int admin_coalesce(const char* args, char* out, size_t size) {
+    CoalesceStats st;
+    (void)args;
+    
+    coalesce_get_stats(&st);
+    snprintf(out, size,
+             "plazo_ms          = %d\n"
+             "mensajes          = %llu\n"
+             "writev            = %llu\n"
+             "mensajes_x_writev = %.2f (máximo %llu)\n"
+             "envios_ahorrados  = %llu\n"
+             "espera_media_ms   = %.3f\n"
+             "vaciados_por_tope = %llu\n"
+             "descartados       = %llu\n",
+             st.budget_ms, (unsigned long long)st.msgs, (unsigned long long)st.flushes,
+             st.flushes ? (double)st.msgs / st.flushes : 0.0, (unsigned long long)st.max_batch,
+             (unsigned long long)(st.msgs - st.flushes),
+             st.flushes ? st.wait_us / 1000.0 / st.flushes : 0.0,
+             (unsigned long long)st.full_flushes, (unsigned long long)st.discarded);
+    return 0;
+}
+
+// Comando "zerocopy": envíos sin copia y cuántas veces se terminó copiando
+static int admin_zerocopy(const char* args, char* out, size_t size) {
+    ZerocopyStats st;
+    (void)args;
+    
+    zerocopy_get_stats(&st);
+    snprintf(out, size,
+             "minimo_bytes      = %d\n"
+             "envios            = %llu (%llu bytes)\n"
+             "confirmados       = %llu\n"
+             "copiados_kernel   = %llu (%.1f%% de los confirmados)\n"
+             "enviados_copiando = %llu\n"
+             "sin_confirmar     = %llu\n"
+             "buffers           = %llu (%llu bytes)\n",
+             st.min_bytes, (unsigned long long)st.sends, (unsigned long long)st.bytes,
+             (unsigned long long)st.completed,
+             (unsigned long long)st.copied, st.completed ? st.copied * 100.0 / st.completed : 0.0,
+             (unsigned long long)st.fallbacks, (unsigned long long)st.pending,
+             (unsigned long long)st.payloads, (unsigned long long)st.payload_bytes);
+    return 0;
+}
+
+// Comando "busypoll": cuánto evita dormir cada worker y cuánta CPU gira en vacío
+static int admin_busypoll(const char* args, char* out, size_t size) {
+    ThreadStats threads[STATS_MAX_THREADS + 1];
+    int count = stats_threads(threads, STATS_MAX_THREADS + 1);
+    size_t used;
+    (void)args;
+    
+    used = (size_t)snprintf(out, size,
+                            "giro_us         = %d\n"
+                            "so_busy_poll_us = %d (%lu conexiones sin poder ponerlo)\n",
+                            __atomic_load_n(&config.busy_poll_us, __ATOMIC_RELAXED),
+                            __atomic_load_n(&config.busy_poll_sock_us, __ATOMIC_RELAXED),
+                            __atomic_load_n(&busy_poll_sock_errors, __ATOMIC_RELAXED));
+    
+    for (int i = 0; i < count && used < size; i++) {
+        const ThreadStats* t = &threads[i];
+        uint64_t waits = t->spin_hits + t->sleeps;
+        if (strncmp(t->name, "worker-", 7) != 0 || waits == 0) continue;
+        used += (size_t)snprintf(out + used, size - used,
+                                 "%-15s = %llu esperas, %.1f%% sin dormir, %.3f s girando\n",
+                                 t->name, (unsigned long long)waits, 100.0 * t->spin_hits / waits,
+                                 t->spin_ns / 1e9);
+    }
+    return 0;
+}
+
+// Comando "lanes": cuánto esperan las respuestas en las colas de salida y
+// cuántos broadcasts se descartaron
+static int admin_lanes(const char* args, char* out, size_t size) {
+    static const char* names[LANE_COUNT] = { "control", "privados", "masivos" };
+    LaneStats st;
+    size_t used;
+    (void)args;
+    
+    lanes_get_stats(&st);
+    used = (size_t)snprintf(out, size,
+                            "tope_masivos_kb = %d\n"
+                            "con_cola        = %llu conexiones (%llu bytes)\n"
+                            "descartados     = %llu masivos (%llu bytes)\n"
+                            "cortadas        = %llu\n",
+                            st.bulk_limit_kb,
+                            (unsigned long long)st.congested, (unsigned long long)st.queued_bytes,
+                            (unsigned long long)st.dropped, (unsigned long long)st.dropped_bytes,
+                            (unsigned long long)st.cut);
+    
+    for (int i = 0; i < LANE_COUNT && used < size; i++) {
+        used += (size_t)snprintf(out + used, size - used,
+                                 "%-15s = %llu encolados, %llu salieron, espera media %.2f ms (máxima %.2f ms)\n",
+                                 names[i], (unsigned long long)st.queued[i], (unsigned long long)st.sent[i],
+                                 st.sent[i] ? st.wait_us[i] / 1000.0 / st.sent[i] : 0.0,
+                                 st.max_wait_us[i] / 1000.0);
+    }
+    return 0;
+}
+
+// Comando "search": tamaño del índice de /search y lo que tardan las búsquedas
+static int admin_search(const char* args, char* out, size_t size) {
+    SearchStats st;
+    (void)args;
+    
+    search_get_stats(&st);
+    snprintf(out, size,
+             "indexados      = %llu de %llu mensajes\n"
+             "terminos       = %llu\n"
+             "entradas       = %llu (%llu bytes comprimidas, %.2f bytes por entrada)\n"
+             "memoria        = %llu bytes\n"
+             "busquedas      = %llu (media %.0f us, maxima %llu us)\n",
+             (unsigned long long)st.indexed, (unsigned long long)st.stored,
+             (unsigned long long)st.terms,
+             (unsigned long long)st.postings, (unsigned long long)st.postings_bytes,
+             st.postings ? (double)st.postings_bytes / st.postings : 0.0,
+             (unsigned long long)st.memory,
+             (unsigned long long)st.queries, st.queries ? (double)st.query_us / st.queries : 0.0,
+             (unsigned long long)st.max_query_us);
+    return 0;
+}
+
+// Comando "trace on|off|dump": lo mismo que SIGUSR1, por partes
+static int admin_trace(const char* args, char* out, size_t size) {
+    if (strcmp(args, "on") == 0) {
+        trace_enable();
+        snprintf(out, size, "Trazado encendido\n");
+    } else if (strcmp(args, "off") == 0) {
+        trace_disable();
+        snprintf(out, size, "Trazado apagado (sin volcar)\n");
+    } else if (strcmp(args, "dump") == 0) {
+        dump_trace();
+        snprintf(out, size, "Trazado volcado y apagado\n");
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static void register_admin_tunables(void) {
+    static int log_depth = DEFAULT_MESSAGE_LOG_DEPTH;
+    const AdminTunable tunables[] = {
+        { "max_clients", "Clientes registrados a la vez (no desconecta a nadie al bajar)",
+          &client_list.limit, 1, MAX_CLIENTS, apply_max_clients },
+        { "backlog", "Conexiones en espera de accept()",
+          &config.backlog, 1, 65535, apply_backlog },
+        { "workers", "Workers que reciben conexiones nuevas",
+          &config.workers, 1, MAX_WORKERS, apply_workers },
+        { "rate_limit", "Comandos por segundo por conexión (0 = sin límite)",
+          &config.rate_limit, 0, 1000000, NULL },
+        { "rate_burst", "Comandos seguidos antes de aplicar rate_limit",
+          &config.rate_burst, 1, 1000000, NULL },
+        { "sndbuf_kb", "Buffer de envío de cada conexión nueva (0 = kernel)",
+          &config.sndbuf_kb, 0, 65536, NULL },
+        { "local_send_timeout_ms", "Espera máxima si el anillo de un cliente local está lleno",
+          &config.local_send_timeout, 0, 60000, NULL },
+        { "presence_window_ms", "Ventana en la que se juntan los avisos de /watch",
+          &config.presence_window, 0, 60000, apply_presence_window },
+        { "log_depth", "Mensajes que muestra el dashboard",
+          &log_depth, 1, MAX_MESSAGE_LOG, apply_log_depth },
+        { "dashboard_refresh_ms", "Milisegundos entre refrescos del dashboard",
+          &config.dashboard_refresh, 100, 60000, apply_dashboard_refresh },
+        { "handshake_timeout", "Segundos para enviar el nick (0 = sin límite)",
+          &config.handshake_timeout, 0, 86400, NULL },
+        { "idle_timeout", "Segundos sin comandos antes de desconectar (0 = nunca)",
+          &config.idle_timeout, 0, 86400 * 30, NULL },
+        { "ping_interval", "Segundos de silencio antes de enviar PING (0 = no)",
+          &config.ping_interval, 0, 86400, NULL },
+        { "pong_timeout", "Segundos para responder un PING",
+          &config.pong_timeout, 1, 3600, NULL },
+        { "resume_window", "Mensajes que guarda cada /session nueva (0 = sin sesiones)",
+          &config.resume_window, 0, SESSION_MAX_WINDOW, NULL },
+        { "resume_grace", "Segundos que se espera el /resume de una sesión cortada",
+          &config.resume_grace, 0, 86400, NULL },
+        { "coalesce_ms", "Plazo para agrupar los mensajes de cada destinatario (0 = no)",
+          &config.coalesce_ms, 0, COALESCE_MAX_MS, apply_coalesce },
+        { "zerocopy_min", "Broadcasts desde este tamaño salen sin copia (0 = no)",
+          &config.zerocopy_min, 0, MAX_LINE, apply_zerocopy },
+        { "busy_poll_us", "Microsegundos que gira cada worker antes de bloquearse (0 = no)",
+          &config.busy_poll_us, 0, BUSY_POLL_MAX_US, apply_busy_poll },
+        { "busy_poll_sock_us", "SO_BUSY_POLL de cada conexión nueva (0 = no)",
+          &config.busy_poll_sock_us, 0, BUSY_POLL_MAX_US, NULL },
+        { "bulk_queue_kb", "Broadcasts encolados por conexión lenta antes de descartar los más viejos",
+          &config.bulk_queue_kb, 1, LANES_BULK_MAX_KB, apply_bulk_queue }
+    };
+    
+    for (size_t i = 0; i < sizeof(tunables) / sizeof(tunables[0]); i++) {
+        admin_register(&tunables[i]);
+    }
+    admin_register_command("trace", "trace on|off|dump     Encender, apagar o volcar el trazado", admin_trace);
+    admin_register_command("coalesce", "coalesce              Cuánto agrupa --coalesce-ms", admin_coalesce);
+    admin_register_command("zerocopy", "zerocopy              Envíos sin copia y cuántos terminaron copiando", admin_zerocopy);
+    admin_register_command("lanes", "lanes                 Colas de salida por clase y broadcasts descartados", admin_lanes);
+    admin_register_command("busypoll", "busypoll              Esperas sin dormir y CPU girando de cada worker", admin_busypoll);
+    admin_register_command("search", "search                Tamaño del índice de /search y tiempos de búsqueda", admin_search);
+    admin_register_command("memory", "memory                Bytes por conexión inactiva y en camino", admin_memory);
+}
+// ============================================================================
+// Manejador de señales
+// ============================================================================
+
+void signal_handler(int signum) {
+    (void)signum;
+    shutdown_server();
+}
+
+// SIGUSR2: traspasar el servidor a un binario nuevo sin cortar clientes
+void upgrade_signal_handler(int signum) {
+    (void)signum;
+    char c = 'u';
+    upgrade_requested = 1;
+    if (write(wake_pipe[1], &c, 1) < 0) {
+        // Nada que hacer dentro de un manejador de señales
+    }
+}
+
+// SIGUSR1: encender el trazado o volcarlo (lo atiende el acceptor)
+void trace_signal_handler(int signum) {
+    (void)signum;
+    char c = 't';
+    trace_requested = 1;
+    if (write(wake_pipe[1], &c, 1) < 0) {
+        // Nada que hacer dentro de un manejador de señales
+    }
+}
+
+// ============================================================================
+// Función principal
+// ============================================================================
+
+static void usage(const char* prog) {
+    printf("Uso: %s <puerto> [opciones]\n", prog);
+    printf("Ejemplo: %s 5000\n", prog);
+    printf("\nOpciones:\n");
+    printf("  --workers <n>             Threads de atención (por defecto: uno por CPU)\n");
+    printf("  --handshake-timeout <s>   Plazo para enviar el nick (por defecto: %d, 0 = sin límite)\n",
+           config.handshake_timeout);
+    printf("  --idle-timeout <s>        Desconectar tras s segundos sin comandos (por defecto: %d, 0 = nunca)\n",
+           config.idle_timeout);
+    printf("  --ping-interval <s>       Enviar PING tras s segundos de silencio (por defecto: 0 = no)\n");
+    printf("  --pong-timeout <s>        Plazo para responder el PING (por defecto: %d)\n",
+           config.pong_timeout);
+    printf("  --history <ruta>          Prefijo de los archivos del historial (por defecto: %s)\n",
+           HISTORY_DEFAULT_PATH);
+    printf("  --no-history              No guardar historial de mensajes\n");
+    printf("  --node-id <nombre>        Activar la federación con este nombre de nodo\n");
+    printf("  --peer-port <puerto>      Aceptar enlaces de otros nodos en este puerto\n");
+    printf("  --peer <host:puerto>      Enlazarse con otro nodo (se puede repetir)\n");
+    printf("  --peer-secret-file <ruta> Clave compartida de la malla (sin ella, --peer-port solo acepta del mismo host)\n");
+    printf("  --local-socket <ruta>     Aceptar clientes locales por memoria compartida\n");
+    printf("  --capture <ruta>          Grabar el tráfico entrante para bench/replay\n");
+    printf("  --cpus <lista>            Fijar cada worker a una CPU (ej: 0-3,8), en orden\n");
+    printf("  --numa-nodes <lista>      Repartir los workers entre estos nodos NUMA\n");
+    printf("  --placement               Mostrar la ubicación y el steering esperado, y salir\n");
+    printf("  --trace <ruta>            Trazar desde el arranque; SIGUSR1 vuelca en ruta (por defecto: traza-<pid>.json)\n");
+    printf("  --admin-socket <ruta>     Ajustar límites en caliente por este socket UNIX (ver admin.h)\n");
+    printf("  --presence-window <ms>    Juntar los avisos de /watch durante ms (por defecto: %d)\n",
+           PRESENCE_DEFAULT_WINDOW_MS);
+    printf("  --resume-window <n>       Mensajes que guarda cada /session (por defecto: %d, 0 = sin sesiones)\n",
+           DEFAULT_RESUME_WINDOW);
+    printf("  --resume-grace <s>        Segundos que se espera el /resume de una sesión cortada (por defecto: %d)\n",
+           SESSION_DEFAULT_GRACE);
+    printf("  --backlog <n>             Conexiones en espera de accept() (por defecto: %d)\n", DEFAULT_BACKLOG);
+    printf("  --coalesce-ms <ms>        Agrupar los mensajes de cada destinatario en un writev cada ms (por defecto: 0 = no)\n");
+    printf("  --zerocopy-min <bytes>    Enviar los broadcasts desde este tamaño sin copiarlos (por defecto: 0 = no, mínimo %d)\n",
+           ZEROCOPY_MIN_BYTES);
+    printf("  --busy-poll-us <us>       Cada worker gira us microsegundos antes de bloquearse (por defecto: 0 = no)\n");
+    printf("  --busy-poll-sock <us>     Poner SO_BUSY_POLL a cada conexión (por defecto: 0 = no)\n");
+    printf("  --no-dashboard            No dibujar el dashboard en esta terminal (se sigue publicando)\n");
+    printf("  --stats-shm <nombre>      Segmento donde se publica el dashboard (por defecto: /servidor-<puerto>)\n");
+    printf("  --attach                  Mirar el dashboard del servidor que corre en <puerto> y salir con 'q'\n");
+}
+
+// Lee la clave de la federación: la primera línea del archivo, sin espacios
+// (en un archivo y no en la línea de comandos para que no aparezca en ps)
+static int load_peer_secret(const char* path) {
+    static char secret[FED_SECRET_SIZE];
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    
+    int ok = fgets(secret, sizeof(secret), file) != NULL;
+    fclose(file);
+    secret[strcspn(secret, "\r\n")] = '\0';
+    if (!ok || !secret[0] || strchr(secret, ' ')) {
+        fprintf(stderr, "Error: %s no tiene una clave válida (una línea sin espacios)\n", path);
+        return -1;
+    }
+    
+    config.peer_secret = secret;
+    return 0;
+}
+
+static int parse_args(int argc, char* argv[]) {
+    static struct option long_options[] = {
+        {"workers",           required_argument, 0, 'w'},
+        {"handshake-timeout", required_argument, 0, 'H'},
+        {"idle-timeout",      required_argument, 0, 'I'},
+        {"ping-interval",     required_argument, 0, 'P'},
+        {"pong-timeout",      required_argument, 0, 'T'},
+        {"history",           required_argument, 0, 'y'},
+        {"no-history",        no_argument,       0, 'Y'},
+        {"node-id",           required_argument, 0, 'n'},
+        {"peer-port",         required_argument, 0, 'o'},
+        {"peer",              required_argument, 0, 'p'},
+        {"peer-secret-file",  required_argument, 0, 'K'},
+        {"local-socket",      required_argument, 0, 'L'},
+        {"presence-window",   required_argument, 0, 'W'},
+        {"capture",           required_argument, 0, 'C'},
+        {"trace",             required_argument, 0, 'R'},
+        {"cpus",              required_argument, 0, 'c'},
+        {"numa-nodes",        required_argument, 0, 'N'},
+        {"placement",         no_argument,       0, 'A'},
+        {"admin-socket",      required_argument, 0, 'a'},
+        {"resume-window",     required_argument, 0, 'r'},
+        {"resume-grace",      required_argument, 0, 'g'},
+        {"backlog",           required_argument, 0, 'b'},
+        {"coalesce-ms",       required_argument, 0, 'k'},
+        {"zerocopy-min",      required_argument, 0, 'z'},
+        {"busy-poll-us",      required_argument, 0, 'u'},
+        {"busy-poll-sock",    required_argument, 0, 'U'},
+        {"no-dashboard",      no_argument,       0, 'D'},
+        {"stats-shm",         required_argument, 0, 'S'},
+        {"attach",            no_argument,       0, 't'},
+        {0, 0, 0, 0}
+    };
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'w': config.workers = atoi(optarg); break;
+            case 'H': config.handshake_timeout = atoi(optarg); break;
+            case 'I': config.idle_timeout = atoi(optarg); break;
+            case 'P': config.ping_interval = atoi(optarg); break;
+            case 'T': config.pong_timeout = atoi(optarg); break;
+            case 'y': config.history_path = optarg; break;
+            case 'Y': config.history_path = NULL; break;
+            case 'n': config.node_id = optarg; break;
+            case 'o': config.peer_port = atoi(optarg); break;
+            case 'L': config.local_socket = optarg; break;
+            case 'W': config.presence_window = atoi(optarg); break;
+            case 'C': config.capture_path = optarg; break;
+            case 'R': config.trace_path = optarg; break;
+            case 'c': config.cpu_list = optarg; break;
+            case 'N': config.numa_list = optarg; break;
+            case 'A': config.show_placement = 1; break;
+            case 'a': config.admin_socket = optarg; break;
+            case 'r': config.resume_window = atoi(optarg); break;
+            case 'g': config.resume_grace = atoi(optarg); break;
+            case 'b': config.backlog = atoi(optarg); break;
+            case 'k': config.coalesce_ms = atoi(optarg); break;
+            case 'z': config.zerocopy_min = atoi(optarg); break;
+            case 'u': config.busy_poll_us = atoi(optarg); break;
+            case 'U': config.busy_poll_sock_us = atoi(optarg); break;
+            case 'D': config.no_dashboard = 1; break;
+            case 'S': config.stats_shm = optarg; break;
+            case 't': config.attach = 1; break;
+            case 'p':
+                if (config.peer_count >= FED_MAX_PEERS) return -1;
+                config.peers[config.peer_count++] = optarg;
+                break;
+            case 'K':
+                if (load_peer_secret(optarg) < 0) return -1;
+                break;
+            default: return -1;
+        }
+    }
+    
+    if (optind != argc - 1) return -1;
+    config.port = atoi(argv[optind]);
+    
+    if (config.workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        config.workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (config.workers > MAX_WORKERS) config.workers = MAX_WORKERS;
+    if (config.pong_timeout <= 0) config.pong_timeout = 1;
+    if (config.resume_window < 0) config.resume_window = 0;
+    if (config.resume_window > SESSION_MAX_WINDOW) config.resume_window = SESSION_MAX_WINDOW;
+    if (config.resume_grace < 0) config.resume_grace = 0;
+    if (config.backlog < 1) config.backlog = 1;
+    if (config.backlog > 65535) config.backlog = 65535;
+    if (config.coalesce_ms < 0) config.coalesce_ms = 0;
+    if (config.coalesce_ms > COALESCE_MAX_MS) config.coalesce_ms = COALESCE_MAX_MS;
+    if (config.zerocopy_min < 0) config.zerocopy_min = 0;
+    if (config.zerocopy_min > 0 && config.zerocopy_min < ZEROCOPY_MIN_BYTES) config.zerocopy_min = ZEROCOPY_MIN_BYTES;
+    if (config.zerocopy_min > MAX_LINE) config.zerocopy_min = MAX_LINE;
+    if (config.busy_poll_us < 0) config.busy_poll_us = 0;
+    if (config.busy_poll_us > BUSY_POLL_MAX_US) config.busy_poll_us = BUSY_POLL_MAX_US;
+    if (config.busy_poll_sock_us < 0) config.busy_poll_sock_us = 0;
+    if (config.busy_poll_sock_us > BUSY_POLL_MAX_US) config.busy_poll_sock_us = BUSY_POLL_MAX_US;
+    if (!config.node_id && (config.peer_port > 0 || config.peer_count > 0 || config.peer_secret)) return -1;
+    if (config.cpu_list && config.numa_list) return -1;
+    if (config.stats_shm && (config.stats_shm[0] != '/' || strlen(config.stats_shm) >= DASHBOARD_SHM_NAME_SIZE)) {
+        return -1;
+    }
+    if (config.node_id && (strlen(config.node_id) >= FED_NODE_ID_SIZE || strchr(config.node_id, ' '))) {
+        return -1;
+    }
+    
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Verificar argumentos
+    if (parse_args(argc, argv) < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    int port = config.port;
+    
+    // Segmento del dashboard: lo publica el servidor y lo lee --attach
+    char shm_name[DASHBOARD_SHM_NAME_SIZE];
+    if (config.stats_shm) snprintf(shm_name, sizeof(shm_name), "%s", config.stats_shm);
+    else dashboard_shm_default_name(shm_name, sizeof(shm_name), port);
+    if (config.attach) {
+        if (dashboard_attach(shm_name) < 0) {
+            printf("Error: Ningún servidor publica el dashboard en %s (o es de otra versión)\n", shm_name);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    
+    // Ubicación de los workers; el acceptor (y los threads que lance) se
+    // queda en la unión de sus CPUs
+    if (plan_placement(0, config.workers) < 0) {
+        printf("Error: CPUs o nodos NUMA no disponibles: %s\n",
+               config.cpu_list ? config.cpu_list : config.numa_list);
+        return EXIT_FAILURE;
+    }
+    if (config.show_placement) {
+        print_placement(config.workers);
+        return EXIT_SUCCESS;
+    }
+    if (placement_enabled && affinity_pin_self(&placement_all) < 0) {
+        perror("sched_setaffinity");
+    }
+    
+    // Configurar manejador de señales
+    if (pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        perror("pipe");
+        return EXIT_FAILURE;
+    }
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGUSR2, upgrade_signal_handler);
+    signal(SIGUSR1, trace_signal_handler);
+    if (config.trace_path) trace_enable();
+    
+    // Abrir el historial persistente (si falla, el servidor sigue sin él)
+    if (config.history_path) {
+        message_store_open(&message_store, config.history_path);
+    }
+    
+    // Índice de /search: se arma en segundo plano desde lo ya guardado
+    if (message_store.data_fd >= 0 && search_start(&message_store) < 0) {
+        printf("Error: No se pudo iniciar el índice de búsqueda\n");
+    }
+    
+    // Descriptores para MAX_CLIENTS antes de dimensionar las tablas por fd
+    raise_fd_limit();
+    
+    // Contadores por conexión (antes de que los workers reciban clientes)
+    if (stats_init() < 0) {
+        printf("Error: No se pudo reservar la tabla de estadísticas\n");
+        return EXIT_FAILURE;
+    }
+    
+    // Tabla de canales locales (antes de que los workers reciban clientes)
+    if (config.local_socket && init_local_channels() < 0) {
+        printf("Error: No se pudo reservar la tabla de clientes locales\n");
+        return EXIT_FAILURE;
+    }
+    
+    // Crear los workers que atienden a los clientes
+    if (init_workers(config.workers) < 0) {
+        printf("Error: No se pudieron crear los workers\n");
+        return EXIT_FAILURE;
+    }
+    
+    // Si nos lanzó un upgrade, heredar sockets y clientes del proceso anterior
+    int upgrade_fd = upgrade_inherited_fd();
+    if (upgrade_fd >= 0) {
+        if (resume_from_upgrade(upgrade_fd) < 0) {
+            printf("Error: No se pudo recibir el estado del proceso anterior\n");
+            return EXIT_FAILURE;
+        }
+    } else {
+        // Crear socket del servidor
+        server_sockfd = CreateServerSocket(port);
+        if (server_sockfd < 0) {
+            printf("Error: No se pudo iniciar el servidor en el puerto %d\n", port);
+            return EXIT_FAILURE;
+        }
+        fcntl(server_sockfd, F_SETFD, FD_CLOEXEC);
+    }
+    
+    // Captura del tráfico: tras un upgrade el proceso nuevo graba en
+    // <ruta>.<pid> para no pisar la traza del anterior
+    if (config.capture_path) {
+        char capture_file[512];
+        if (upgrade_fd >= 0) {
+            snprintf(capture_file, sizeof(capture_file), "%s.%d", config.capture_path, (int)getpid());
+        } else {
+            snprintf(capture_file, sizeof(capture_file), "%s", config.capture_path);
+        }
+        if (capture_start(capture_file) < 0) {
+            printf("Error: No se pudo crear la traza %s\n", capture_file);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    // Carriles de salida antes que cualquier thread que envíe a los clientes
+    if (lanes_start(config.bulk_queue_kb) < 0) {
+        printf("Error: No se pudo iniciar el thread de carriles de salida\n");
+        return EXIT_FAILURE;
+    }
+    
+    // Avisos de /watch y enlaces con los otros nodos antes de atender comandos
+    if (presence_start(config.presence_window, deliver_presence) < 0) {
+        printf("Error: No se pudo iniciar el thread de presencia\n");
+        return EXIT_FAILURE;
+    }
+    if (session_start(resume_sendiov, push_sendiov, expire_sessions) < 0) {
+        printf("Error: No se pudo iniciar el thread de sesiones\n");
+        return EXIT_FAILURE;
+    }
+    if (coalesce_start(config.coalesce_ms, bulk_sendiov) < 0) {
+        printf("Error: No se pudo iniciar el agrupado de mensajes\n");
+        return EXIT_FAILURE;
+    }
+    if (zerocopy_start(config.zerocopy_min) < 0) {
+        printf("Error: No se pudo reservar la tabla de envíos sin copia\n");
+        return EXIT_FAILURE;
+    }
+    if (transfer_start(transfer_notify) < 0) {
+        printf("Error: No se pudo iniciar el thread de transferencias\n");
+        return EXIT_FAILURE;
+    }
+    start_federation();
+    
+    // Socket UNIX para clientes locales por memoria compartida
+    if (config.local_socket) {
+        local_sockfd = shm_listen(config.local_socket);
+        if (local_sockfd < 0) {
+            printf("Error: No se pudo crear el socket local %s\n", config.local_socket);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    // La cola de CreateServerSocket() es corta para ráfagas de conexiones
+    if (config.backlog != DEFAULT_BACKLOG && apply_backlog(config.backlog) < 0) {
+        perror("listen");
+    }
+    reserve_spare_fd();
+    
+    dashboard_set_busy_poll_us(config.busy_poll_us);
+    launch_workers(config.workers);
+    
+    // Socket de administración: los ajustes ya apuntan a su estado final
+    if (config.admin_socket) {
+        register_admin_tunables();
+        if (admin_start(config.admin_socket) < 0) {
+            printf("Error: No se pudo crear el socket de administración %s\n", config.admin_socket);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    // Avisar al proceso anterior que ya estamos sirviendo
+    if (upgrade_fd >= 0) {
+        upgrade_send_ack(upgrade_fd);
+        close(upgrade_fd);
+    }
+    
+    // Publicar el dashboard para --attach (si falla, el servidor sigue sin él)
+    static DashboardShm dash_shm;
+    int dash_shm_ok = dashboard_shm_create(&dash_shm, shm_name) == 0;
+    if (!dash_shm_ok) perror(shm_name);
+    
+    // Configurar argumentos para el thread del dashboard
+    DashboardThreadArgs dash_args = {
+        .client_list = &client_list,
+        .message_log = &message_log,
+        .server_running = &server_running,
+        .shutdown_callback = shutdown_server,
+        .shm = dash_shm_ok ? &dash_shm : NULL,
+        .interactive = !config.no_dashboard
+    };
+    
+    // Crear thread para el dashboard
+    pthread_t dash_thread;
+    pthread_create(&dash_thread, NULL, dashboard_thread, &dash_args);
+    
+    // Loop principal: aceptar clientes y repartirlos entre los workers
+    stats_register_thread("acceptor");
+    trace_register_thread("acceptor");
+    int next_worker = 0;
+    while (server_running) {
+        // Esperar conexiones o una señal (SIGUSR2 escribe en wake_pipe)
+        struct pollfd pfds[3] = {
+            { .fd = server_sockfd, .events = POLLIN },
+            { .fd = wake_pipe[0], .events = POLLIN },
+            { .fd = local_sockfd, .events = POLLIN }  // -1 si no hay socket local
+        };
+        if (poll(pfds, 3, -1) < 0 && !upgrade_requested) continue;
+        
+        if (trace_requested) {
+            char drain[16];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+            trace_requested = 0;
+            toggle_trace();
+            if (!upgrade_requested) continue;
+        }
+        
+        if (upgrade_requested) {
+            char drain[16];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {}
+            upgrade_requested = 0;
+            
+            if (perform_upgrade(argv, &dash_thread, &dash_args) == 0) {
+                // El proceso nuevo ya atiende a todos: salir sin cerrar nada
+                // (_exit evita que atexit() restaure la terminal del nuevo)
+                capture_stop();
+                if (trace_enabled()) dump_trace();
+                _exit(EXIT_SUCCESS);
+            }
+            continue;
+        }
+        
+        int client_sockfd;
+        int listen_fd;
+        if (pfds[2].revents & POLLIN) {
+            // Cliente local: el worker le negocia la memoria compartida
+            listen_fd = local_sockfd;
+            client_sockfd = accept4(local_sockfd, NULL, NULL, SOCK_CLOEXEC);
+        } else {
+            if (!(pfds[0].revents & (POLLIN | POLLERR | POLLHUP))) continue;
+            listen_fd = server_sockfd;
+            client_sockfd = AcceptClient(server_sockfd);
+        }
+        
+        if (client_sockfd < 0) {
+            // Si server_running es 0, significa que estamos cerrando
+            if (!server_running) {
+                break;
+            }
+            if (errno == EMFILE || errno == ENFILE) {
+                reject_without_fd(listen_fd);
+            } else if (errno == ENOBUFS || errno == ENOMEM) {
+                usleep(100000);  // Sin memoria del kernel: esperar antes de reintentar
+            }
+            // ECONNABORTED, EINTR, EAGAIN: esa conexión ya no está, seguir
+            continue;
+        }
+        
+        // Si estamos cerrando, no aceptar más clientes
+        if (!server_running) {
+            close(client_sockfd);
+            break;
+        }
+        
+        // Entregar el socket al worker de su CPU o, si no, en round-robin
+        Worker* w = placement_enabled ? worker_for_incoming_cpu(client_sockfd) : NULL;
+        if (!w) {
+            int active = __atomic_load_n(&config.workers, __ATOMIC_RELAXED);
+            if (next_worker >= active) next_worker = 0;
+            w = &workers[next_worker];
+            next_worker = (next_worker + 1) % active;
+        }
+        if (write(w->notify_pipe[1], &client_sockfd, sizeof(client_sockfd)) != sizeof(client_sockfd)) {
+            close(client_sockfd);
+        }
+    }
+    
+    // Esperar a que termine el thread del dashboard (publica la última muestra)
+    pthread_join(dash_thread, NULL);
+    if (dash_shm_ok) dashboard_shm_close(&dash_shm, 0);
+    admin_stop();
+    
+    // Detener los workers antes de tocar los sockets de los clientes
+    join_workers(launched_workers);
+    destroy_workers(launched_workers);
+    transfer_stop();
+    federation_stop();
+    presence_stop();
+    session_stop();
+    coalesce_stop();
+    lanes_stop();  // Desde acá la despedida sale bloqueando, como antes
+    zerocopy_stop();
+    search_stop();
+    capture_stop();
+    if (trace_enabled()) dump_trace();
+    
+    // Notificar y cerrar todas las conexiones de clientes
+    pthread_mutex_lock(&client_list.mutex);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (client_list.clients[i].active && client_list.clients[i].sockfd >= 0) {
+            // Enviar mensaje de despedida al cliente
+            client_send_const(client_list.clients[i].sockfd, REPLY_GOODBYE);
+            
+            // Cerrar la conexión
+            shutdown(client_list.clients[i].sockfd, SHUT_RDWR);
+            close(client_list.clients[i].sockfd);
+        }
+        session_destroy(client_list.clients[i].session);
+        client_list.clients[i].session = NULL;
+        client_list.clients[i].active = 0;
+    }
+    client_list.count = 0;
+    client_list.free_hint = 0;
+    pthread_mutex_unlock(&client_list.mutex);
+    
+    message_store_close(&message_store);
+    
+    if (local_sockfd >= 0) {
+        close(local_sockfd);
+        unlink(config.local_socket);
+    }
     
     // Cerrar servidor
     if (server_sockfd >= 0) {
@@ -0,0 +1,305 @@
+// ============================================================================
+// session.c - Implementación de las sesiones reanudables
+// ============================================================================
+
+#include "session.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/random.h>
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+// Un mensaje guardado (el buffer se reutiliza al dar la vuelta la ventana)
+typedef struct {
+    uint64_t seq;
+    char *data;
+    size_t len;
+    size_t capacity;
+} SessionEntry;
+
+struct Session {
+    char token[SESSION_TOKEN_SIZE];
+    pthread_mutex_t mutex;
+    int sockfd;               // -1 = desconectada
+    uint64_t detached_at_ms;
+    uint64_t last_seq;        // Último número asignado (el primero es 1)
+    int window;
+    SessionEntry *entries;    // entries[(seq - 1) % window]
+};
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int running;
+    int detached;             // Sesiones esperando reconexión
+    SessionSendFn send;
+    SessionSendFn push;
+    void (*sweep)(void);
+} sessions = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER
+};
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void count_detached(int delta) {
+    pthread_mutex_lock(&sessions.mutex);
+    sessions.detached += delta;
+    if (sessions.detached == 1 && delta > 0) pthread_cond_signal(&sessions.cond);
+    pthread_mutex_unlock(&sessions.mutex);
+}
+
+// Copia los fragmentos en la entrada con "#<seq> " después del primer espacio
+static int store_entry(SessionEntry *e, uint64_t seq, const struct iovec *iov, int count) {
+    char mark[24];
+    int mark_len = snprintf(mark, sizeof(mark), "#%llu ", (unsigned long long)seq);
+    size_t len = 0;
+    for (int i = 0; i < count; i++) len += iov[i].iov_len;
+    
+    if (len + (size_t)mark_len > e->capacity) {
+        size_t capacity = len + (size_t)mark_len + 64;
+        char *data = realloc(e->data, capacity);
+        if (!data) return -1;
+        e->data = data;
+        e->capacity = capacity;
+    }
+    
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(e->data + offset, iov[i].iov_base, iov[i].iov_len);
+        offset += iov[i].iov_len;
+    }
+    
+    char *space = memchr(e->data, ' ', len);
+    size_t at = space ? (size_t)(space - e->data) + 1 : 0;
+    memmove(e->data + at + mark_len, e->data + at, len - at);
+    memcpy(e->data + at, mark, mark_len);
+    e->seq = seq;
+    e->len = len + (size_t)mark_len;
+    return 0;
+}
+
+static void *session_thread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&sessions.mutex);
+    
+    while (sessions.running) {
+        while (sessions.running && sessions.detached == 0) {
+            pthread_cond_wait(&sessions.cond, &sessions.mutex);
+        }
+        if (!sessions.running) break;
+        
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += SESSION_SWEEP_MS / 1000;
+        while (sessions.running &&
+               pthread_cond_timedwait(&sessions.cond, &sessions.mutex, &deadline) == 0) {
+        }
+        if (!sessions.running) break;
+        
+        pthread_mutex_unlock(&sessions.mutex);
+        sessions.sweep();
+        pthread_mutex_lock(&sessions.mutex);
+    }
+    
+    pthread_mutex_unlock(&sessions.mutex);
+    return NULL;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int session_start(SessionSendFn send, SessionSendFn push, void (*sweep)(void)) {
+    pthread_mutex_lock(&sessions.mutex);
+    sessions.send = send;
+    sessions.push = push;
+    sessions.sweep = sweep;
+    sessions.running = 1;
+    pthread_mutex_unlock(&sessions.mutex);
+    
+    if (pthread_create(&sessions.thread, NULL, session_thread, NULL) != 0) {
+        sessions.running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void session_stop(void) {
+    pthread_mutex_lock(&sessions.mutex);
+    if (!sessions.running) {
+        pthread_mutex_unlock(&sessions.mutex);
+        return;
+    }
+    sessions.running = 0;
+    pthread_cond_broadcast(&sessions.cond);
+    pthread_mutex_unlock(&sessions.mutex);
+    
+    pthread_join(sessions.thread, NULL);
+}
+
+Session *session_create(int sockfd, int window) {
+    uint64_t bits;
+    
+    if (window < 1) window = 1;
+    if (window > SESSION_MAX_WINDOW) window = SESSION_MAX_WINDOW;
+    if (getrandom(&bits, sizeof(bits), 0) != sizeof(bits)) return NULL;
+    
+    Session *s = calloc(1, sizeof(Session));
+    if (!s) return NULL;
+    s->entries = calloc((size_t)window, sizeof(SessionEntry));
+    if (!s->entries) {
+        free(s);
+        return NULL;
+    }
+    
+    snprintf(s->token, sizeof(s->token), "%016llx", (unsigned long long)bits);
+    pthread_mutex_init(&s->mutex, NULL);
+    s->sockfd = sockfd;
+    s->window = window;
+    return s;
+}
+
+void session_destroy(Session *s) {
+    if (!s) return;
+    
+    if (s->sockfd < 0) count_detached(-1);
+    for (int i = 0; i < s->window; i++) free(s->entries[i].data);
+    free(s->entries);
+    pthread_mutex_destroy(&s->mutex);
+    free(s);
+}
+
+const char *session_token(const Session *s) {
+    return s->token;
+}
+
+uint64_t session_push(Session *s, const struct iovec *iov, int count) {
+    pthread_mutex_lock(&s->mutex);
+    
+    uint64_t seq = ++s->last_seq;
+    SessionEntry *e = &s->entries[(seq - 1) % (uint64_t)s->window];
+    if (store_entry(e, seq, iov, count) < 0) {
+        // Sin memoria: se envía sin guardar (no se podrá reenviar)
+        size_t len = 0;
+        for (int i = 0; i < count; i++) len += iov[i].iov_len;
+        e->seq = 0;
+        if (s->sockfd >= 0) sessions.push(s->sockfd, iov, count, len);
+    } else if (s->sockfd >= 0) {
+        struct iovec one = { .iov_base = e->data, .iov_len = e->len };
+        sessions.push(s->sockfd, &one, 1, e->len);
+    }
+    
+    pthread_mutex_unlock(&s->mutex);
+    return seq;
+}
+
+void session_detach(Session *s) {
+    pthread_mutex_lock(&s->mutex);
+    int was_attached = s->sockfd >= 0;
+    s->sockfd = -1;
+    s->detached_at_ms = now_ms();
+    pthread_mutex_unlock(&s->mutex);
+    
+    if (was_attached) count_detached(1);
+}
+
+int session_attach(Session *s, int sockfd, uint64_t last_seq, size_t max_bytes) {
+    char info[160];
+    pthread_mutex_lock(&s->mutex);
+    
+    int was_detached = s->sockfd < 0;
+    s->sockfd = sockfd;
+    
+    // Lo que sigue en la ventana: desde el más viejo guardado o desde last_seq
+    uint64_t oldest = s->last_seq > (uint64_t)s->window ? s->last_seq - (uint64_t)s->window + 1 : 1;
+    if (last_seq > s->last_seq) last_seq = s->last_seq;
+    uint64_t first = last_seq + 1 > oldest ? last_seq + 1 : oldest;
+    uint64_t lost = first - (last_seq + 1);
+    
+    // Un writev más grande que max_bytes cortaría al cliente: se reenvían los
+    // más nuevos que entran y los anteriores cuentan como perdidos
+    size_t room = max_bytes > sizeof(info) ? max_bytes - sizeof(info) : 0;
+    uint64_t from = s->last_seq + 1;
+    for (uint64_t seq = s->last_seq; seq >= first; seq--) {
+        SessionEntry *e = &s->entries[(seq - 1) % (uint64_t)s->window];
+        if (e->seq == seq) {
+            if (e->len > room) break;
+            room -= e->len;
+        }
+        from = seq;
+    }
+    lost += from - first;
+    first = from;
+    
+    // Sin memoria para los fragmentos se responde igual, sin reenviar nada
+    struct iovec info_only;
+    struct iovec *iov = malloc(((size_t)(s->last_seq - first + 1) + 1) * sizeof(struct iovec));
+    int replayed = 0;
+    int count = 1;
+    size_t len = 0;
+    
+    if (!iov) {
+        iov = &info_only;
+        lost += s->last_seq - first + 1;
+    } else {
+        for (uint64_t seq = first; seq <= s->last_seq; seq++) {
+            SessionEntry *e = &s->entries[(seq - 1) % (uint64_t)s->window];
+            if (e->seq != seq) {
+                lost++;  // No se pudo guardar
+                continue;
+            }
+            iov[count].iov_base = e->data;
+            iov[count].iov_len = e->len;
+            len += e->len;
+            count++;
+            replayed++;
+        }
+    }
+    
+    // Una sola línea de aviso: es la respuesta a /resume
+    int info_len;
+    if (lost > 0) {
+        info_len = snprintf(info, sizeof(info), RESP_INFO " Sesión retomada: %d mensajes pendientes "
+                            "(%llu perdidos)\n", replayed, (unsigned long long)lost);
+    } else {
+        info_len = snprintf(info, sizeof(info), RESP_INFO " Sesión retomada: %d mensajes pendientes\n",
+                            replayed);
+    }
+    iov[0].iov_base = info;
+    iov[0].iov_len = (size_t)info_len;
+    len += (size_t)info_len;
+    sessions.send(sockfd, iov, count, len);
+    if (iov != &info_only) free(iov);
+    
+    pthread_mutex_unlock(&s->mutex);
+    
+    if (was_detached) count_detached(-1);
+    return replayed;
+}
+
+int session_expired(Session *s, uint64_t grace_ms) {
+    pthread_mutex_lock(&s->mutex);
+    int expired = s->sockfd < 0 && now_ms() - s->detached_at_ms >= grace_ms;
+    pthread_mutex_unlock(&s->mutex);
+    return expired;
+}
@@ -0,0 +1,104 @@
+// ============================================================================
+// session.h - Sesiones reanudables con número de secuencia por mensaje
+// ============================================================================
+// Un cliente que pide /session recibe un token. Desde ahí cada mensaje que
+// le llega sin pedirlo (privados, broadcasts, avisos de /watch) lleva un
+// número de secuencia ("MSG_FROM: #17 ana: hola") y queda guardado en una
+// ventana acotada de la sesión. Si la conexión se corta, el nick sigue
+// registrado durante un plazo de gracia y los mensajes se siguen guardando;
+// al reconectar con "/resume <token> <última secuencia>" el cliente recibe
+// solo lo que se perdió, en un único writev, sin volver a entrar de cero.
+//
+// Las sesiones no sobreviven a un upgrade (SIGUSR2): el proceso nuevo recibe
+// las conexiones como clientes comunes.
+// ============================================================================
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define SESSION_TOKEN_SIZE 17          // 16 dígitos hexadecimales + '\0'
+#define SESSION_MAX_WINDOW 1000        // Mensajes por sesión (el writev de /resume queda < IOV_MAX)
+#define SESSION_DEFAULT_GRACE 60       // Segundos que se guarda una sesión desconectada
+#define SESSION_SWEEP_MS 1000          // Cada cuánto se buscan sesiones vencidas
+#define SESSION_REPLAY_MAX_BYTES (4 * 1024 * 1024)  // Tope del writev de /resume (lejos de LANES_MAX_BYTES)
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct Session Session;
+
+// Envía fragmentos al cliente por su transporte (client_sendiov del servidor)
+typedef ssize_t (*SessionSendFn)(int sockfd, const struct iovec *iov, int count, size_t len);
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Arranca el thread que vence las sesiones desconectadas
+ * @param send Envío del reenvío de /resume (sale en el momento)
+ * @param push Envío de cada mensaje nuevo (por el carril de privados, ver lanes.h)
+ * @param sweep Se llama cada SESSION_SWEEP_MS mientras haya sesiones
+ *              desconectadas (sin locks del módulo tomados)
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int session_start(SessionSendFn send, SessionSendFn push, void (*sweep)(void));
+
+/**
+ * Detiene el thread
+ */
+void session_stop(void);
+
+/**
+ * Crea una sesión conectada a sockfd que guarda los últimos window mensajes
+ * @return La sesión o NULL si no hay memoria
+ */
+Session *session_create(int sockfd, int window);
+
+/**
+ * Libera la sesión y sus mensajes guardados
+ */
+void session_destroy(Session *s);
+
+/**
+ * Token que el cliente usa en /resume
+ */
+const char *session_token(const Session *s);
+
+/**
+ * Guarda un mensaje con el próximo número de secuencia (insertado después
+ * del primer espacio) y lo envía si la sesión está conectada
+ * @return El número de secuencia asignado
+ */
+uint64_t session_push(Session *s, const struct iovec *iov, int count);
+
+/**
+ * La conexión se cortó: los mensajes se siguen guardando hasta que venza
+ */
+void session_detach(Session *s);
+
+/**
+ * Conecta la sesión a sockfd y le envía en un solo writev el aviso de
+ * retomada y los mensajes posteriores a last_seq que sigan en la ventana.
+ * Si no entran en max_bytes se reenvían los más nuevos que entren y el
+ * aviso cuenta los demás como perdidos.
+ * @return Mensajes reenviados
+ */
+int session_attach(Session *s, int sockfd, uint64_t last_seq, size_t max_bytes);
+
+/**
+ * Retorna 1 si la sesión lleva desconectada al menos grace_ms
+ */
+int session_expired(Session *s, uint64_t grace_ms);
+
+#endif // SESSION_H
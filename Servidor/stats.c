@@ -0,0 +1,184 @@
+// ============================================================================
+// stats.c - Implementación de los contadores por conexión y por thread
+// ============================================================================
+
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static ConnStats *conn_table = NULL;
+static int conn_table_size = 0;
+
+static ThreadStats thread_table[STATS_MAX_THREADS];
+static int thread_count = 0;
+static ThreadStats other_threads = { .name = "otros" };  // Compartida: atómicos
+static pthread_mutex_t register_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread ThreadStats *local = NULL;
+
+// El dueño de un contador lo actualiza con una carga y un guardado relajados:
+// ningún otro thread lo escribe, así que no hace falta una suma atómica
+#define OWNER_ADD(field, n) \
+    __atomic_store_n(&(field), __atomic_load_n(&(field), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+
+#define SHARED_ADD(field, n) __atomic_fetch_add(&(field), (n), __ATOMIC_RELAXED)
+#define SHARED_SUB(field, n) __atomic_fetch_sub(&(field), (n), __ATOMIC_RELAXED)
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static ConnStats *conn_entry(int fd) {
+    if (!conn_table || fd < 0 || fd >= conn_table_size) return NULL;
+    return &conn_table[fd];
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int stats_init(void) {
+    struct rlimit rl;
+    
+    if (conn_table) return 0;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) return -1;
+    
+    conn_table_size = rl.rlim_cur == RLIM_INFINITY ? 65536 : (int)rl.rlim_cur;
+    if (posix_memalign((void **)&conn_table, STATS_CACHE_LINE,
+                       (size_t)conn_table_size * sizeof(ConnStats)) != 0) {
+        conn_table = NULL;
+        return -1;
+    }
+    memset(conn_table, 0, (size_t)conn_table_size * sizeof(ConnStats));
+    return 0;
+}
+
+void stats_register_thread(const char *name) {
+    pthread_mutex_lock(&register_mutex);
+    
+    for (int i = 0; i < thread_count; i++) {
+        if (strncmp(thread_table[i].name, name, STATS_THREAD_NAME - 1) == 0) {
+            local = &thread_table[i];
+            pthread_mutex_unlock(&register_mutex);
+            return;
+        }
+    }
+    
+    if (thread_count < STATS_MAX_THREADS) {
+        ThreadStats *t = &thread_table[thread_count];
+        strncpy(t->name, name, STATS_THREAD_NAME - 1);
+        t->name[STATS_THREAD_NAME - 1] = '\0';
+        local = t;
+        // Publicar la entrada completa antes de que el dashboard la lea
+        __atomic_store_n(&thread_count, thread_count + 1, __ATOMIC_RELEASE);
+    }
+    
+    pthread_mutex_unlock(&register_mutex);
+}
+
+void stats_reset_conn(int fd) {
+    ConnStats *s = conn_entry(fd);
+    if (s) memset(s, 0, sizeof(*s));
+}
+
+void stats_bytes_in(int fd, size_t bytes) {
+    ConnStats *s = conn_entry(fd);
+    if (s) OWNER_ADD(s->in.bytes_in, bytes);
+    
+    if (local) OWNER_ADD(local->bytes_in, bytes);
+    else SHARED_ADD(other_threads.bytes_in, bytes);
+}
+
+void stats_message_in(int fd, uint64_t now_ms) {
+    ConnStats *s = conn_entry(fd);
+    if (s) {
+        OWNER_ADD(s->in.msgs_in, 1);
+        __atomic_store_n(&s->in.last_activity_ms, now_ms, __ATOMIC_RELAXED);
+    }
+    
+    if (local) OWNER_ADD(local->msgs_in, 1);
+    else SHARED_ADD(other_threads.msgs_in, 1);
+}
+
+void stats_sent(int fd, ssize_t sent, size_t len) {
+    ConnStats *s = conn_entry(fd);
+    ThreadStats *t = local;
+    
+    if (sent == (ssize_t)len) {
+        if (s) {
+            SHARED_ADD(s->out.bytes_out, len);
+            SHARED_ADD(s->out.msgs_out, 1);
+        }
+        if (t) {
+            OWNER_ADD(t->bytes_out, len);
+            OWNER_ADD(t->msgs_out, 1);
+        } else {
+            SHARED_ADD(other_threads.bytes_out, len);
+            SHARED_ADD(other_threads.msgs_out, 1);
+        }
+    } else {
+        if (s) SHARED_ADD(s->out.drops, 1);
+        if (t) OWNER_ADD(t->drops, 1);
+        else SHARED_ADD(other_threads.drops, 1);
+    }
+}
+
+void stats_unsent(int fd, size_t len) {
+    ConnStats *s = conn_entry(fd);
+    if (!s) return;
+    
+    SHARED_SUB(s->out.bytes_out, len);
+    SHARED_SUB(s->out.msgs_out, 1);
+    SHARED_ADD(s->out.drops, 1);
+}
+
+void stats_poll(uint64_t spin_ns, int hit) {
+    ThreadStats *t = local;
+    if (!t) return;
+    
+    if (spin_ns) OWNER_ADD(t->spin_ns, spin_ns);
+    if (hit) OWNER_ADD(t->spin_hits, 1);
+    else OWNER_ADD(t->sleeps, 1);
+}
+
+const ConnStats *stats_conn(int fd) {
+    return conn_entry(fd);
+}
+
+int stats_threads(ThreadStats *out, int max) {
+    int count = __atomic_load_n(&thread_count, __ATOMIC_ACQUIRE);
+    int n = 0;
+    
+    for (int i = 0; i < count && n < max; i++) {
+        ThreadStats *t = &thread_table[i];
+        memcpy(out[n].name, t->name, STATS_THREAD_NAME);
+        out[n].bytes_in = __atomic_load_n(&t->bytes_in, __ATOMIC_RELAXED);
+        out[n].msgs_in = __atomic_load_n(&t->msgs_in, __ATOMIC_RELAXED);
+        out[n].bytes_out = __atomic_load_n(&t->bytes_out, __ATOMIC_RELAXED);
+        out[n].msgs_out = __atomic_load_n(&t->msgs_out, __ATOMIC_RELAXED);
+        out[n].drops = __atomic_load_n(&t->drops, __ATOMIC_RELAXED);
+        out[n].spin_ns = __atomic_load_n(&t->spin_ns, __ATOMIC_RELAXED);
+        out[n].spin_hits = __atomic_load_n(&t->spin_hits, __ATOMIC_RELAXED);
+        out[n].sleeps = __atomic_load_n(&t->sleeps, __ATOMIC_RELAXED);
+        n++;
+    }
+    
+    if (n < max) {
+        memcpy(out[n].name, other_threads.name, STATS_THREAD_NAME);
+        out[n].bytes_in = __atomic_load_n(&other_threads.bytes_in, __ATOMIC_RELAXED);
+        out[n].msgs_in = __atomic_load_n(&other_threads.msgs_in, __ATOMIC_RELAXED);
+        out[n].bytes_out = __atomic_load_n(&other_threads.bytes_out, __ATOMIC_RELAXED);
+        out[n].msgs_out = __atomic_load_n(&other_threads.msgs_out, __ATOMIC_RELAXED);
+        out[n].drops = __atomic_load_n(&other_threads.drops, __ATOMIC_RELAXED);
+        out[n].spin_ns = out[n].spin_hits = out[n].sleeps = 0;
+        n++;
+    }
+    
+    return n;
+}
@@ -0,0 +1,119 @@
+// ============================================================================
+// stats.h - Contadores por conexión y por thread sin compartir líneas de cache
+// ============================================================================
+// Cada conexión tiene dos líneas de cache propias: la de entrada la escribe
+// solo el worker dueño (sin instrucciones atómicas) y la de salida la tocan
+// todos los threads que le envían algo (broadcasts de otros workers, avisos
+// de presencia, federación), así que ahí se usan sumas atómicas relajadas.
+// Cada thread tiene además sus totales en una línea propia que solo él
+// escribe. El dashboard lee todo sin locks y calcula las tasas.
+// ============================================================================
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define STATS_CACHE_LINE 64
+#define STATS_MAX_THREADS 80        // Workers + acceptor + los que se registren
+#define STATS_THREAD_NAME 16
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+// Contadores de una conexión (tabla indexada por fd)
+typedef struct {
+    // Solo los escribe el worker dueño de la conexión
+    struct {
+        uint64_t bytes_in;
+        uint64_t msgs_in;
+        uint64_t last_activity_ms;  // monotonic_ms() de la última línea
+    } __attribute__((aligned(STATS_CACHE_LINE))) in;
+    
+    // Los escribe cualquier thread que le envía algo (atómicos relajados)
+    struct {
+        uint64_t bytes_out;
+        uint64_t msgs_out;
+        uint64_t drops;             // Envíos fallidos o incompletos
+    } __attribute__((aligned(STATS_CACHE_LINE))) out;
+} ConnStats;
+
+// Totales de un thread (solo los escribe ese thread)
+typedef struct {
+    char name[STATS_THREAD_NAME];
+    uint64_t bytes_in;
+    uint64_t msgs_in;
+    uint64_t bytes_out;
+    uint64_t msgs_out;
+    uint64_t drops;
+    // Espera de eventos con --busy-poll-us (solo workers)
+    uint64_t spin_ns;         // CPU gastada girando en epoll_wait sin nada que hacer
+    uint64_t spin_hits;       // Vueltas que encontraron eventos sin dormir
+    uint64_t sleeps;          // Vueltas que terminaron bloqueadas en epoll_wait
+} __attribute__((aligned(STATS_CACHE_LINE))) ThreadStats;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Reserva la tabla de conexiones (una entrada por fd posible)
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int stats_init(void);
+
+/**
+ * Asigna al thread actual su línea de totales (reusa la de un thread
+ * anterior con el mismo nombre). Los threads sin registrar suman en una
+ * línea compartida "otros".
+ */
+void stats_register_thread(const char *name);
+
+/**
+ * Deja en cero los contadores de un fd nuevo (lo llama el worker dueño)
+ */
+void stats_reset_conn(int fd);
+
+/**
+ * Entrada: bytes leídos del socket y comandos procesados (worker dueño)
+ */
+void stats_bytes_in(int fd, size_t bytes);
+void stats_message_in(int fd, uint64_t now_ms);
+
+/**
+ * Salida: resultado de un envío de len bytes (cualquier thread)
+ */
+void stats_sent(int fd, ssize_t sent, size_t len);
+
+/**
+ * Un envío de len bytes que stats_sent() contó al encolarse y que la cola de
+ * salida descartó después: pasa de enviado a descartado en la conexión. Los
+ * totales del thread que lo envió no cambian (solo los escribe ese thread)
+ */
+void stats_unsent(int fd, size_t len);
+
+/**
+ * Una espera de eventos del worker actual: spin_ns de CPU girando antes de
+ * encontrar eventos (hit) o de rendirse y bloquearse
+ */
+void stats_poll(uint64_t spin_ns, int hit);
+
+/**
+ * Contadores de un fd (NULL si está fuera de la tabla)
+ */
+const ConnStats *stats_conn(int fd);
+
+/**
+ * Copia los totales de cada thread registrado (y "otros" al final)
+ * @return Cantidad de entradas copiadas
+ */
+int stats_threads(ThreadStats *out, int max);
+
+#endif // STATS_H
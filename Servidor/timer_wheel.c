@@ -0,0 +1,182 @@
+// ============================================================================
+// timer_wheel.c - Implementación de la rueda de timers jerárquica
+// ============================================================================
+// Esquema clásico de ruedas en cascada: el nivel 0 tiene un slot por tick y
+// cada nivel superior cubre 64 veces más tiempo. Cuando el nivel 0 da la
+// vuelta, el slot correspondiente del nivel 1 se redistribuye hacia abajo
+// (y así sucesivamente). Cada timer baja como mucho TW_LEVELS - 1 veces, por
+// lo que el costo amortizado sigue siendo O(1).
+// ============================================================================
+
+#include "timer_wheel.h"
+#include <time.h>
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void list_init(TimerNode *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static void list_unlink(TimerNode *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->next = NULL;
+    node->prev = NULL;
+}
+
+static void list_append(TimerNode *head, TimerNode *node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+// Ubica el nodo en el slot que le corresponde según cuánto falta para vencer
+static void insert_node(TimerWheel *tw, TimerNode *node) {
+    uint64_t expires = node->expires;
+    uint64_t delta = expires - tw->current_tick;
+    TimerNode *head;
+    
+    if ((int64_t)delta < 0) {
+        // Vencido: se ejecuta en el próximo tick procesado
+        head = &tw->slots[0][tw->current_tick & TW_SLOT_MASK];
+    } else if (delta < (1ULL << TW_SLOT_BITS)) {
+        head = &tw->slots[0][expires & TW_SLOT_MASK];
+    } else if (delta < (1ULL << (2 * TW_SLOT_BITS))) {
+        head = &tw->slots[1][(expires >> TW_SLOT_BITS) & TW_SLOT_MASK];
+    } else if (delta < (1ULL << (3 * TW_SLOT_BITS))) {
+        head = &tw->slots[2][(expires >> (2 * TW_SLOT_BITS)) & TW_SLOT_MASK];
+    } else {
+        // Más allá del último nivel se recorta al máximo representable
+        uint64_t max_delta = (1ULL << (4 * TW_SLOT_BITS)) - 1;
+        if (delta > max_delta) {
+            expires = tw->current_tick + max_delta;
+            node->expires = expires;
+        }
+        head = &tw->slots[3][(expires >> (3 * TW_SLOT_BITS)) & TW_SLOT_MASK];
+    }
+    
+    list_append(head, node);
+}
+
+// Redistribuye un slot de un nivel superior en los niveles inferiores.
+// Retorna el índice procesado para saber si hay que seguir subiendo.
+static int cascade(TimerWheel *tw, int level) {
+    int index = (int)((tw->current_tick >> (level * TW_SLOT_BITS)) & TW_SLOT_MASK);
+    TimerNode *head = &tw->slots[level][index];
+    
+    while (head->next != head) {
+        TimerNode *node = head->next;
+        list_unlink(node);
+        insert_node(tw, node);
+    }
+    
+    return index;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+void timer_wheel_init(TimerWheel *tw, unsigned int tick_ms) {
+    for (int level = 0; level < TW_LEVELS; level++) {
+        for (int i = 0; i < TW_SLOTS; i++) {
+            list_init(&tw->slots[level][i]);
+        }
+    }
+    tw->tick_ms = tick_ms > 0 ? tick_ms : TW_DEFAULT_TICK_MS;
+    tw->start_ms = monotonic_ms();
+    tw->current_tick = 0;
+    tw->armed = 0;
+}
+
+void timer_init(TimerNode *node, timer_callback callback, void *arg) {
+    node->next = NULL;
+    node->prev = NULL;
+    node->expires = 0;
+    node->callback = callback;
+    node->arg = arg;
+}
+
+int timer_pending(const TimerNode *node) {
+    return node->next != NULL;
+}
+
+void timer_cancel(TimerWheel *tw, TimerNode *node) {
+    if (!timer_pending(node)) return;
+    list_unlink(node);
+    tw->armed--;
+}
+
+void timer_arm(TimerWheel *tw, TimerNode *node, uint64_t delay_ms) {
+    timer_cancel(tw, node);
+    
+    // Redondear hacia arriba: nunca vencer antes de lo pedido
+    uint64_t ticks = (delay_ms + tw->tick_ms - 1) / tw->tick_ms;
+    if (ticks == 0) ticks = 1;
+    
+    node->expires = tw->current_tick + ticks;
+    insert_node(tw, node);
+    tw->armed++;
+}
+
+int timer_wheel_advance(TimerWheel *tw, uint64_t now_ms) {
+    if (now_ms < tw->start_ms) return 0;
+    
+    uint64_t target = (now_ms - tw->start_ms) / tw->tick_ms;
+    int fired = 0;
+    
+    while (tw->current_tick <= target) {
+        int index = (int)(tw->current_tick & TW_SLOT_MASK);
+        
+        // Al dar la vuelta el nivel 0, bajar los timers de los niveles superiores
+        if (index == 0) {
+            for (int level = 1; level < TW_LEVELS; level++) {
+                if (cascade(tw, level) != 0) break;
+            }
+        }
+        
+        tw->current_tick++;
+        
+        // Sacar de a un nodo: el callback puede rearmarlo o liberarlo
+        TimerNode *head = &tw->slots[0][index];
+        while (head->next != head) {
+            TimerNode *node = head->next;
+            list_unlink(node);
+            tw->armed--;
+            node->callback(node, node->arg);
+            fired++;
+        }
+    }
+    
+    return fired;
+}
+
+int timer_wheel_next_timeout(const TimerWheel *tw, uint64_t now_ms) {
+    if (tw->armed == 0) return -1;
+    
+    // Buscar el próximo slot ocupado del nivel 0 antes de la siguiente cascada
+    uint64_t next_tick = (tw->current_tick | TW_SLOT_MASK) + 1;
+    for (uint64_t tick = tw->current_tick; tick < next_tick; tick++) {
+        const TimerNode *head = &tw->slots[0][tick & TW_SLOT_MASK];
+        if (head->next != head) {
+            next_tick = tick;
+            break;
+        }
+    }
+    
+    uint64_t deadline = tw->start_ms + next_tick * tw->tick_ms;
+    if (deadline <= now_ms) return 0;
+    
+    uint64_t wait = deadline - now_ms;
+    return wait > 60000 ? 60000 : (int)wait;
+}
@@ -0,0 +1,102 @@
+// ============================================================================
+// timer_wheel.h - Rueda de timers jerárquica para timeouts de conexiones
+// ============================================================================
+// Cada nodo se enlaza de forma intrusiva en la lista de su slot, así que
+// armar, reiniciar y cancelar un timer cuesta O(1) sin reservar memoria.
+// La rueda no es thread-safe: cada worker del servidor tiene la suya y solo
+// ese thread la toca.
+// ============================================================================
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define TW_LEVELS 4                       // Niveles de la jerarquía
+#define TW_SLOT_BITS 6
+#define TW_SLOTS (1 << TW_SLOT_BITS)      // 64 slots por nivel
+#define TW_SLOT_MASK (TW_SLOTS - 1)
+#define TW_DEFAULT_TICK_MS 100            // Resolución por defecto
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+struct TimerNode;
+typedef void (*timer_callback)(struct TimerNode *node, void *arg);
+
+typedef struct TimerNode {
+    struct TimerNode *next;
+    struct TimerNode *prev;
+    uint64_t expires;         // Tick absoluto de vencimiento
+    timer_callback callback;
+    void *arg;
+} TimerNode;
+
+typedef struct {
+    TimerNode slots[TW_LEVELS][TW_SLOTS];  // Centinelas de listas circulares
+    uint64_t current_tick;                 // Próximo tick a procesar
+    uint64_t start_ms;                     // Reloj monotónico al crear la rueda
+    unsigned int tick_ms;
+    size_t armed;                          // Timers pendientes
+} TimerWheel;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Devuelve el reloj monotónico en milisegundos
+ */
+uint64_t monotonic_ms(void);
+
+/**
+ * Inicializa una rueda vacía
+ * @param tw Rueda a inicializar
+ * @param tick_ms Duración de un tick en milisegundos
+ */
+void timer_wheel_init(TimerWheel *tw, unsigned int tick_ms);
+
+/**
+ * Inicializa un nodo (sin armarlo)
+ * @param node Nodo a inicializar
+ * @param callback Función a llamar cuando vence
+ * @param arg Argumento que recibe el callback
+ */
+void timer_init(TimerNode *node, timer_callback callback, void *arg);
+
+/**
+ * Arma (o rearma) un timer para que venza dentro de delay_ms. O(1).
+ * Si el timer ya estaba pendiente se reprograma.
+ */
+void timer_arm(TimerWheel *tw, TimerNode *node, uint64_t delay_ms);
+
+/**
+ * Cancela un timer pendiente. O(1). No hace nada si no estaba armado.
+ */
+void timer_cancel(TimerWheel *tw, TimerNode *node);
+
+/**
+ * Indica si el timer está armado
+ */
+int timer_pending(const TimerNode *node);
+
+/**
+ * Procesa todos los ticks vencidos hasta now_ms y ejecuta sus callbacks.
+ * Los callbacks pueden armar, cancelar o liberar su propio nodo.
+ * @return Cantidad de timers ejecutados
+ */
+int timer_wheel_advance(TimerWheel *tw, uint64_t now_ms);
+
+/**
+ * Milisegundos hasta el próximo tick con trabajo, listo para epoll_wait()
+ * @return -1 si no hay timers armados
+ */
+int timer_wheel_next_timeout(const TimerWheel *tw, uint64_t now_ms);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,249 @@
+// ============================================================================
+// tracer.c - Implementación del trazado por thread
+// ============================================================================
+
+#define _GNU_SOURCE  // gettid()
+
+#include "tracer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+typedef struct {
+    uint64_t start_ns;
+    uint32_t dur_ns;
+    uint32_t msg;       // Id del mensaje (0 = fuera de una línea)
+    int32_t fd;
+    uint32_t bytes;
+    uint8_t stage;
+} TraceEvent;
+
+// Anillo de un thread: solo lo escribe su dueño; el volcado lo lee sin
+// locks y descarta lo que el dueño pudo pisar mientras lo copiaba
+typedef struct {
+    TraceEvent *events;
+    uint64_t head;      // Tramos escritos desde siempre (posición = head % TRACE_RING_EVENTS)
+    int in_use;         // 0 = su thread terminó; otro thread lo puede reusar
+    char name[TRACE_THREAD_NAME];
+} TraceRing;
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static const char *stage_names[TRACE_STAGE_COUNT] = {
+    "line", "recv", "parse", "lookup", "lock", "enqueue", "send", "log"
+};
+
+static int trace_on = 0;
+static uint64_t enabled_since = 0;   // Lo anterior no entra en el volcado
+static uint32_t next_msg = 0;
+
+static TraceRing rings[TRACE_MAX_THREADS];
+static int ring_count = 0;
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static __thread TraceRing *ring = NULL;
+static __thread int ring_failed = 0;
+static __thread char thread_name[TRACE_THREAD_NAME];
+static __thread uint32_t current_msg = 0;
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Al terminar un thread su anillo queda libre para el próximo
+static void release_ring(void *arg) {
+    TraceRing *r = arg;
+    __atomic_store_n(&r->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void create_ring_key(void) {
+    pthread_key_create(&ring_key, release_ring);
+}
+
+// Asigna un anillo al thread actual (solo la primera vez que anota algo)
+static TraceRing *acquire_ring(void) {
+    TraceRing *r = NULL;
+    
+    pthread_once(&ring_key_once, create_ring_key);
+    pthread_mutex_lock(&rings_mutex);
+    
+    for (int i = 0; i < ring_count && !r; i++) {
+        if (!__atomic_load_n(&rings[i].in_use, __ATOMIC_ACQUIRE)) r = &rings[i];
+    }
+    if (!r && ring_count < TRACE_MAX_THREADS) {
+        TraceEvent *events = calloc(TRACE_RING_EVENTS, sizeof(TraceEvent));
+        if (events) {
+            r = &rings[ring_count];
+            r->events = events;
+            __atomic_store_n(&ring_count, ring_count + 1, __ATOMIC_RELEASE);
+        }
+    }
+    
+    if (r) {
+        if (thread_name[0] == '\0') {
+            snprintf(thread_name, sizeof(thread_name), "thread-%d", (int)gettid());
+        }
+        memcpy(r->name, thread_name, TRACE_THREAD_NAME);
+        r->in_use = 1;
+        pthread_setspecific(ring_key, r);
+    }
+    
+    pthread_mutex_unlock(&rings_mutex);
+    return r;
+}
+
+static void json_escape(FILE *out, const char *s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        if ((unsigned char)*s >= 0x20) fputc(*s, out);
+    }
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+void trace_register_thread(const char *name) {
+    strncpy(thread_name, name, TRACE_THREAD_NAME - 1);
+    thread_name[TRACE_THREAD_NAME - 1] = '\0';
+    
+    if (ring) {
+        pthread_mutex_lock(&rings_mutex);
+        memcpy(ring->name, thread_name, TRACE_THREAD_NAME);
+        pthread_mutex_unlock(&rings_mutex);
+    }
+}
+
+void trace_enable(void) {
+    __atomic_store_n(&enabled_since, now_ns(), __ATOMIC_RELAXED);
+    __atomic_store_n(&trace_on, 1, __ATOMIC_RELEASE);
+}
+
+void trace_disable(void) {
+    __atomic_store_n(&trace_on, 0, __ATOMIC_RELEASE);
+}
+
+int trace_enabled(void) {
+    return __atomic_load_n(&trace_on, __ATOMIC_RELAXED);
+}
+
+uint64_t trace_begin(void) {
+    if (!__atomic_load_n(&trace_on, __ATOMIC_RELAXED)) return 0;
+    return now_ns();
+}
+
+void trace_end(uint64_t start, TraceStage stage, int fd, size_t bytes) {
+    if (start == 0) return;
+    
+    if (!ring) {
+        if (ring_failed) return;
+        ring = acquire_ring();
+        if (!ring) {
+            ring_failed = 1;  // Sin lugar: este thread no se traza
+            return;
+        }
+    }
+    
+    uint64_t end = now_ns();
+    uint64_t head = ring->head;
+    TraceEvent *e = &ring->events[head % TRACE_RING_EVENTS];
+    e->start_ns = start;
+    e->dur_ns = end - start > UINT32_MAX ? UINT32_MAX : (uint32_t)(end - start);
+    e->msg = current_msg;
+    e->fd = fd;
+    e->bytes = bytes > UINT32_MAX ? UINT32_MAX : (uint32_t)bytes;
+    e->stage = (uint8_t)stage;
+    
+    // Publicar el tramo completo antes de avanzar la cabeza
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void trace_message_begin(void) {
+    current_msg = trace_enabled() ? __atomic_add_fetch(&next_msg, 1, __ATOMIC_RELAXED) : 0;
+}
+
+void trace_message_end(void) {
+    current_msg = 0;
+}
+
+int trace_dump(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+    
+    TraceEvent *copy = malloc(TRACE_RING_EVENTS * sizeof(TraceEvent));
+    if (!copy) {
+        fclose(out);
+        return -1;
+    }
+    
+    uint64_t since = __atomic_load_n(&enabled_since, __ATOMIC_RELAXED);
+    int pid = (int)getpid();
+    int count = __atomic_load_n(&ring_count, __ATOMIC_ACQUIRE);
+    int written = 0;
+    
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"servidor\"}}", pid);
+    
+    for (int i = 0; i < count; i++) {
+        TraceRing *r = &rings[i];
+        char name[TRACE_THREAD_NAME];
+        
+        pthread_mutex_lock(&rings_mutex);
+        memcpy(name, r->name, TRACE_THREAD_NAME);
+        pthread_mutex_unlock(&rings_mutex);
+        
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        for (uint64_t n = first; n < head; n++) {
+            copy[n - first] = r->events[n % TRACE_RING_EVENTS];
+        }
+        
+        // Lo que el dueño escribió durante la copia pudo pisar los más viejos
+        // (incluido el lugar que estaba escribiendo en ese momento)
+        uint64_t head_after = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t valid = head_after >= TRACE_RING_EVENTS ? head_after - TRACE_RING_EVENTS + 1 : 0;
+        if (valid < first) valid = first;
+        
+        fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"",
+                pid, i + 1);
+        json_escape(out, name);
+        fprintf(out, "\"}}");
+        
+        for (uint64_t n = valid; n < head; n++) {
+            TraceEvent *e = &copy[n - first];
+            if (e->start_ns < since || e->stage >= TRACE_STAGE_COUNT) continue;
+            
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"chat\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"msg\":%u",
+                    stage_names[e->stage], pid, i + 1,
+                    (e->start_ns - since) / 1000.0, e->dur_ns / 1000.0, e->msg);
+            if (e->fd >= 0) fprintf(out, ",\"fd\":%d", e->fd);
+            if (e->bytes) fprintf(out, ",\"bytes\":%u", e->bytes);
+            fprintf(out, "}}");
+            written++;
+        }
+    }
+    
+    fprintf(out, "\n]}\n");
+    free(copy);
+    
+    if (fclose(out) != 0) return -1;
+    return written;
+}
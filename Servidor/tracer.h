@@ -0,0 +1,83 @@
+// ============================================================================
+// tracer.h - Trazado de la vida de cada mensaje (formato Chrome/Perfetto)
+// ============================================================================
+// Siempre compilado y apagado por defecto: mientras está apagado cada punto
+// de medición cuesta una lectura de un flag. Encendido, cada thread anota
+// sus tramos (recv, parseo, búsqueda en el registro, espera del mutex,
+// encolado hacia otros nodos, cada envío y el registro en el log) en un
+// anillo propio sin locks. SIGUSR1 lo enciende y, la segunda vez, lo apaga
+// y vuelca los anillos como JSON para chrome://tracing o ui.perfetto.dev.
+// ============================================================================
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define TRACE_RING_EVENTS 16384   // Tramos por thread (los más viejos se pisan)
+#define TRACE_MAX_THREADS 80
+#define TRACE_THREAD_NAME 16
+
+// Etapas de un mensaje (nombre del tramo en la traza)
+typedef enum {
+    TRACE_LINE = 0,   // Línea completa: contiene al resto de las etapas
+    TRACE_RECV,
+    TRACE_PARSE,
+    TRACE_LOOKUP,     // Búsqueda de un nick en el registro
+    TRACE_LOCK,       // Espera del mutex del registro
+    TRACE_ENQUEUE,    // Entrega a los enlaces de federación
+    TRACE_SEND,       // Cada escritura a un socket o anillo
+    TRACE_LOG,        // Log del dashboard e historial
+    TRACE_STAGE_COUNT
+} TraceStage;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Nombra el thread actual en la traza (los threads sin nombre aparecen
+ * como "thread-<tid>")
+ */
+void trace_register_thread(const char *name);
+
+/**
+ * Enciende o apaga el trazado. Al encender, el volcado siguiente solo
+ * incluye lo anotado desde ese momento.
+ */
+void trace_enable(void);
+void trace_disable(void);
+int trace_enabled(void);
+
+/**
+ * Empieza un tramo
+ * @return Instante de inicio, o 0 si el trazado está apagado
+ */
+uint64_t trace_begin(void);
+
+/**
+ * Cierra un tramo empezado con trace_begin() (no hace nada si start es 0)
+ * @param fd Socket involucrado (-1 si no hay)
+ * @param bytes Bytes leídos o enviados (0 si no aplica)
+ */
+void trace_end(uint64_t start, TraceStage stage, int fd, size_t bytes);
+
+/**
+ * Marca el inicio y el fin de una línea recibida: los tramos del thread
+ * entre ambas llamadas llevan el mismo id de mensaje
+ */
+void trace_message_begin(void);
+void trace_message_end(void);
+
+/**
+ * Vuelca los anillos de todos los threads en path como JSON de Chrome
+ * @return Cantidad de tramos escritos, -1 en caso de error
+ */
+int trace_dump(const char *path);
+
+#endif // TRACER_H
@@ -0,0 +1,493 @@
+// ============================================================================
+// transfer.c - Implementación de la transferencia de archivos
+// ============================================================================
+// Las ofertas y las conexiones de datos que esperan a su par se guardan con
+// xfer.mutex (las tocan los workers). Una vez unidas, la transferencia es
+// solo del thread: splice() y el epoll van sin lock.
+// ============================================================================
+
+#define _GNU_SOURCE  // splice(), pipe2(), F_SETPIPE_SZ
+
+#include "transfer.h"
+#include "timer_wheel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+
+#define TRANSFER_MAX_EVENTS 32
+#define TRANSFER_SWEEP_MS 1000  // Cada cuánto se buscan ofertas vencidas y transferencias trabadas
+
+#define SIDE_SENDER 0
+#define SIDE_RECEIVER 1
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+typedef enum {
+    XFER_OFFERED,
+    XFER_ACCEPTED,            // Esperando las dos conexiones de datos
+    XFER_READY,               // Llegaron las dos: el thread la arranca
+    XFER_RELAYING,            // Solo la toca el thread
+    XFER_DONE                 // Terminada en este ciclo: se avisa y se libera al final
+} TransferState;
+
+typedef struct Transfer {
+    TransferTicket ticket;
+    TransferState state;
+    const char *status;       // Cómo terminó (FILE_END)
+    int fd[2];                // Conexiones de datos por lado (-1 = todavía no llegó)
+    int pipe[2];
+    size_t pipe_size;
+    size_t in_pipe;           // Leído del emisor y todavía no escrito al receptor
+    int pipe_full;            // El pipe no aceptó más aunque no llegó a pipe_size
+    int reading;              // El emisor está en el epoll con EPOLLIN
+    int writing;              // El receptor, con EPOLLOUT
+    uint64_t received;
+    uint64_t moved;           // Atómico: lo lee transfer_get_stats()
+    uint64_t deadline;        // monotonic_ms() en que vence la oferta o se da por trabada
+    struct Transfer *next_done;
+} Transfer;
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static struct {
+    volatile int running;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    int epfd;
+    int wake_pipe[2];
+    TransferNotifyFn notify;
+    Transfer *slots[TRANSFER_MAX];
+    unsigned next_id;
+    Transfer *done;           // Solo el thread
+    TransferStats stats;      // bytes y throttled son atómicos; el resto con el mutex
+} xfer = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .epfd = -1,
+    .wake_pipe = {-1, -1}
+};
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static void wake_thread(void) {
+    char c = 'w';
+    if (write(xfer.wake_pipe[1], &c, 1) < 0) {
+        // El pipe lleno ya garantiza que el thread se va a despertar
+    }
+}
+
+static int make_token(char *out) {
+    unsigned long long bits;
+    if (getrandom(&bits, sizeof(bits), 0) != sizeof(bits)) return -1;
+    snprintf(out, TRANSFER_TOKEN_SIZE, "%016llx", bits);
+    return 0;
+}
+
+// Transferencia de id que todavía no empezó (con el mutex tomado)
+static int find_pending(unsigned id) {
+    for (int i = 0; i < TRANSFER_MAX; i++) {
+        Transfer *t = xfer.slots[i];
+        if (t && t->ticket.id == id && t->state <= XFER_ACCEPTED) return i;
+    }
+    return -1;
+}
+
+static void close_fds(Transfer *t) {
+    for (int side = 0; side < 2; side++) {
+        if (t->fd[side] >= 0) close(t->fd[side]);  // También lo saca del epoll
+        t->fd[side] = -1;
+    }
+    if (t->pipe[0] >= 0) close(t->pipe[0]);
+    if (t->pipe[1] >= 0) close(t->pipe[1]);
+    t->pipe[0] = t->pipe[1] = -1;
+}
+
+// Saca la transferencia de la tabla y la deja para avisar al final del
+// ciclo (con el mutex tomado; solo el thread)
+static void finish_locked(Transfer *t, const char *status) {
+    if (t->state == XFER_DONE) return;
+    
+    for (int i = 0; i < TRANSFER_MAX; i++) {
+        if (xfer.slots[i] == t) xfer.slots[i] = NULL;
+    }
+    if (strcmp(status, "completa") == 0) xfer.stats.completed++;
+    else xfer.stats.failed++;
+    
+    close_fds(t);
+    t->state = XFER_DONE;
+    t->status = status;
+    t->next_done = xfer.done;
+    xfer.done = t;
+}
+
+static void finish(Transfer *t, const char *status) {
+    pthread_mutex_lock(&xfer.mutex);
+    finish_locked(t, status);
+    pthread_mutex_unlock(&xfer.mutex);
+}
+
+// Registra en el epoll lo que hace falta esperar de cada lado
+static void update_interest(Transfer *t) {
+    int reading = !t->pipe_full && t->in_pipe < t->pipe_size && t->received < t->ticket.size;
+    int writing = t->in_pipe > 0;
+    
+    if (reading != t->reading) {
+        // Dejar de leer con bytes por llegar es el control de flujo
+        if (!reading && t->received < t->ticket.size) {
+            __atomic_add_fetch(&xfer.stats.throttled, 1, __ATOMIC_RELAXED);
+        }
+        struct epoll_event ev = { .events = reading ? EPOLLIN : 0, .data.ptr = t };
+        epoll_ctl(xfer.epfd, EPOLL_CTL_MOD, t->fd[SIDE_SENDER], &ev);
+        t->reading = reading;
+    }
+    if (writing != t->writing) {
+        struct epoll_event ev = {
+            .events = writing ? EPOLLOUT : 0,
+            .data.ptr = (void *)((uintptr_t)t | SIDE_RECEIVER)
+        };
+        epoll_ctl(xfer.epfd, EPOLL_CTL_MOD, t->fd[SIDE_RECEIVER], &ev);
+        t->writing = writing;
+    }
+}
+
+// Mueve lo que se pueda del emisor al pipe y del pipe al receptor, hasta
+// TRANSFER_BURST_BYTES (solo el thread)
+static void pump(Transfer *t) {
+    uint64_t start = t->moved;
+    
+    for (;;) {
+        int progress = 0;
+        
+        if (!t->pipe_full && t->in_pipe < t->pipe_size && t->received < t->ticket.size) {
+            size_t want = t->pipe_size - t->in_pipe;
+            if (want > t->ticket.size - t->received) want = (size_t)(t->ticket.size - t->received);
+            ssize_t n = splice(t->fd[SIDE_SENDER], NULL, t->pipe[1], NULL, want,
+                               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                t->received += (uint64_t)n;
+                t->in_pipe += (size_t)n;
+                progress = 1;
+            } else if (n == 0) {
+                finish(t, "cortada");  // El emisor cerró antes de tiempo
+                return;
+            } else if (errno == EAGAIN) {
+                // Con datos en el pipe, es el pipe el que no acepta más
+                if (t->in_pipe > 0) t->pipe_full = 1;
+            } else if (errno != EINTR) {
+                finish(t, "cortada");
+                return;
+            }
+        }
+        
+        if (t->in_pipe > 0) {
+            ssize_t n = splice(t->pipe[0], NULL, t->fd[SIDE_RECEIVER], NULL, t->in_pipe,
+                               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                t->in_pipe -= (size_t)n;
+                t->pipe_full = 0;
+                __atomic_add_fetch(&t->moved, (uint64_t)n, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&xfer.stats.bytes, (uint64_t)n, __ATOMIC_RELAXED);
+                progress = 1;
+            } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                finish(t, "cortada");  // El receptor se fue
+                return;
+            }
+        }
+        
+        if (t->moved == t->ticket.size) {
+            finish(t, "completa");
+            return;
+        }
+        if (!progress || t->moved - start >= TRANSFER_BURST_BYTES) break;
+    }
+    
+    if (t->moved != start) t->deadline = monotonic_ms() + TRANSFER_STALL_MS;
+    update_interest(t);
+}
+
+// Las dos conexiones llegaron: pipe, FILE_START y al epoll (con el mutex tomado)
+static int start_relay(Transfer *t) {
+    char line[64];
+    int len = snprintf(line, sizeof(line), RESP_FILE_START " %llu\n", (unsigned long long)t->ticket.size);
+    
+    if (pipe2(t->pipe, O_CLOEXEC | O_NONBLOCK) < 0) return -1;
+    fcntl(t->pipe[1], F_SETPIPE_SZ, TRANSFER_PIPE_BYTES);
+    int pipe_size = fcntl(t->pipe[1], F_GETPIPE_SZ);
+    t->pipe_size = pipe_size > 0 ? (size_t)pipe_size : 65536;
+    
+    for (int side = 0; side < 2; side++) {
+        fcntl(t->fd[side], F_SETFL, fcntl(t->fd[side], F_GETFL) | O_NONBLOCK);
+        if (send(t->fd[side], line, len, MSG_NOSIGNAL) != len) return -1;
+    }
+    
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = t };
+    if (epoll_ctl(xfer.epfd, EPOLL_CTL_ADD, t->fd[SIDE_SENDER], &ev) < 0) return -1;
+    ev.events = 0;  // ERR y HUP llegan igual
+    ev.data.ptr = (void *)((uintptr_t)t | SIDE_RECEIVER);
+    if (epoll_ctl(xfer.epfd, EPOLL_CTL_ADD, t->fd[SIDE_RECEIVER], &ev) < 0) return -1;
+    
+    t->reading = 1;
+    t->state = XFER_RELAYING;
+    t->deadline = monotonic_ms() + TRANSFER_STALL_MS;
+    return 0;
+}
+
+// Arranca las listas y vence las ofertas y transferencias trabadas (con el
+// mutex tomado). Retorna los milisegundos hasta el próximo vencimiento.
+static int sweep_locked(uint64_t now) {
+    uint64_t next = now + TRANSFER_SWEEP_MS;
+    
+    for (int i = 0; i < TRANSFER_MAX; i++) {
+        Transfer *t = xfer.slots[i];
+        if (!t) continue;
+        
+        if (t->state == XFER_READY && start_relay(t) < 0) {
+            finish_locked(t, "cortada");
+        } else if (now >= t->deadline) {
+            finish_locked(t, t->state == XFER_RELAYING ? "cortada" : "vencida");
+        } else if (t->deadline < next) {
+            next = t->deadline;
+        }
+    }
+    return (int)(next - now);
+}
+
+// Avisa FILE_END a los dos y libera lo terminado en el ciclo (sin el mutex)
+static void deliver_done(void) {
+    while (xfer.done) {
+        Transfer *t = xfer.done;
+        xfer.done = t->next_done;
+        
+        char line[128];
+        int len = snprintf(line, sizeof(line), RESP_FILE_END " %u %s %llu\n",
+                           t->ticket.id, t->status, (unsigned long long)t->moved);
+        xfer.notify(t->ticket.from, line, (size_t)len);
+        xfer.notify(t->ticket.to, line, (size_t)len);
+        free(t);
+    }
+}
+
+static void *transfer_thread(void *arg) {
+    (void)arg;
+    struct epoll_event events[TRANSFER_MAX_EVENTS];
+    int timeout = TRANSFER_SWEEP_MS;
+    sigset_t pipe_signal;
+    
+    // splice() no acepta MSG_NOSIGNAL: si el receptor se fue, que falle
+    // con EPIPE en lugar de terminar el proceso con SIGPIPE
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, NULL);
+    
+    while (xfer.running) {
+        int n = epoll_wait(xfer.epfd, events, TRANSFER_MAX_EVENTS, timeout);
+        
+        for (int i = 0; i < n && xfer.running; i++) {
+            uintptr_t tag = (uintptr_t)events[i].data.ptr;
+            if (tag == 0) {
+                char drain[64];
+                while (read(xfer.wake_pipe[0], drain, sizeof(drain)) > 0) {}
+                continue;
+            }
+            
+            Transfer *t = (Transfer *)(tag & ~(uintptr_t)1);
+            if (t->state != XFER_RELAYING) continue;  // Terminó antes en este lote
+            
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                finish(t, "cortada");
+            } else {
+                pump(t);
+            }
+        }
+        
+        pthread_mutex_lock(&xfer.mutex);
+        timeout = sweep_locked(monotonic_ms());
+        pthread_mutex_unlock(&xfer.mutex);
+        deliver_done();
+    }
+    
+    return NULL;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int transfer_start(TransferNotifyFn notify) {
+    xfer.notify = notify;
+    
+    xfer.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (xfer.epfd < 0 || pipe2(xfer.wake_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        perror("transferencias");
+        return -1;
+    }
+    
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(xfer.epfd, EPOLL_CTL_ADD, xfer.wake_pipe[0], &ev);
+    
+    xfer.running = 1;
+    if (pthread_create(&xfer.thread, NULL, transfer_thread, NULL) != 0) {
+        xfer.running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void transfer_stop(void) {
+    if (!xfer.running) return;
+    
+    xfer.running = 0;
+    wake_thread();
+    pthread_join(xfer.thread, NULL);
+    
+    pthread_mutex_lock(&xfer.mutex);
+    for (int i = 0; i < TRANSFER_MAX; i++) {
+        if (!xfer.slots[i]) continue;
+        close_fds(xfer.slots[i]);
+        free(xfer.slots[i]);
+        xfer.slots[i] = NULL;
+    }
+    pthread_mutex_unlock(&xfer.mutex);
+    while (xfer.done) {
+        Transfer *t = xfer.done;
+        xfer.done = t->next_done;
+        free(t);
+    }
+    
+    close(xfer.wake_pipe[0]);
+    close(xfer.wake_pipe[1]);
+    close(xfer.epfd);
+    
+    // Dejar el módulo listo para otro transfer_start() (upgrade fallido)
+    xfer.epfd = -1;
+    xfer.wake_pipe[0] = xfer.wake_pipe[1] = -1;
+}
+
+int transfer_offer(const char *from, const char *to, uint64_t size, const char *name,
+                   TransferTicket *ticket) {
+    Transfer *t = calloc(1, sizeof(Transfer));
+    if (!t) return -1;
+    
+    snprintf(t->ticket.from, sizeof(t->ticket.from), "%s", from);
+    snprintf(t->ticket.to, sizeof(t->ticket.to), "%s", to);
+    snprintf(t->ticket.name, sizeof(t->ticket.name), "%s", name);
+    t->ticket.size = size;
+    t->state = XFER_OFFERED;
+    t->fd[0] = t->fd[1] = -1;
+    t->pipe[0] = t->pipe[1] = -1;
+    t->deadline = monotonic_ms() + TRANSFER_OFFER_TIMEOUT_MS;
+    
+    pthread_mutex_lock(&xfer.mutex);
+    for (int i = 0; i < TRANSFER_MAX; i++) {
+        if (xfer.slots[i]) continue;
+        t->ticket.id = ++xfer.next_id;
+        xfer.slots[i] = t;
+        xfer.stats.offered++;
+        *ticket = t->ticket;
+        pthread_mutex_unlock(&xfer.mutex);
+        return 0;
+    }
+    pthread_mutex_unlock(&xfer.mutex);
+    
+    free(t);
+    return -1;
+}
+
+int transfer_accept(unsigned id, const char *nick, TransferTicket *ticket) {
+    int result = -1;
+    pthread_mutex_lock(&xfer.mutex);
+    
+    int i = find_pending(id);
+    Transfer *t = i >= 0 ? xfer.slots[i] : NULL;
+    if (t && t->state == XFER_OFFERED && strcmp(t->ticket.to, nick) == 0 &&
+        make_token(t->ticket.send_token) == 0 && make_token(t->ticket.recv_token) == 0) {
+        t->state = XFER_ACCEPTED;
+        t->deadline = monotonic_ms() + TRANSFER_OFFER_TIMEOUT_MS;
+        *ticket = t->ticket;
+        result = 0;
+    }
+    
+    pthread_mutex_unlock(&xfer.mutex);
+    return result;
+}
+
+int transfer_reject(unsigned id, const char *nick, TransferTicket *ticket) {
+    Transfer *t = NULL;
+    pthread_mutex_lock(&xfer.mutex);
+    
+    int i = find_pending(id);
+    if (i >= 0 && (strcmp(xfer.slots[i]->ticket.to, nick) == 0 ||
+                   strcmp(xfer.slots[i]->ticket.from, nick) == 0)) {
+        t = xfer.slots[i];
+        xfer.slots[i] = NULL;
+        xfer.stats.failed++;
+        *ticket = t->ticket;
+    }
+    
+    pthread_mutex_unlock(&xfer.mutex);
+    if (!t) return -1;
+    
+    close_fds(t);  // La conexión de datos que ya estaba esperando
+    free(t);
+    return 0;
+}
+
+int transfer_join(const char *token, int sockfd) {
+    int result = -1;
+    pthread_mutex_lock(&xfer.mutex);
+    
+    for (int i = 0; i < TRANSFER_MAX && result < 0; i++) {
+        Transfer *t = xfer.slots[i];
+        if (!t || t->state != XFER_ACCEPTED) continue;
+        
+        int side = strcmp(t->ticket.send_token, token) == 0 ? SIDE_SENDER :
+                   strcmp(t->ticket.recv_token, token) == 0 ? SIDE_RECEIVER : -1;
+        if (side < 0 || t->fd[side] >= 0) continue;
+        
+        t->fd[side] = sockfd;
+        if (t->fd[SIDE_SENDER] >= 0 && t->fd[SIDE_RECEIVER] >= 0) {
+            t->state = XFER_READY;
+            wake_thread();
+        }
+        result = 0;
+    }
+    
+    pthread_mutex_unlock(&xfer.mutex);
+    return result;
+}
+
+void transfer_get_stats(TransferStats *out) {
+    pthread_mutex_lock(&xfer.mutex);
+    *out = xfer.stats;
+    out->bytes = __atomic_load_n(&xfer.stats.bytes, __ATOMIC_RELAXED);
+    out->throttled = __atomic_load_n(&xfer.stats.throttled, __ATOMIC_RELAXED);
+    out->waiting = 0;
+    out->active = 0;
+    out->active_bytes = 0;
+    out->active_size = 0;
+    for (int i = 0; i < TRANSFER_MAX; i++) {
+        Transfer *t = xfer.slots[i];
+        if (!t) continue;
+        if (t->state == XFER_RELAYING) {
+            out->active++;
+            out->active_bytes += __atomic_load_n(&t->moved, __ATOMIC_RELAXED);
+            out->active_size += t->ticket.size;
+        } else {
+            out->waiting++;
+        }
+    }
+    pthread_mutex_unlock(&xfer.mutex);
+}
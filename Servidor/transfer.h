@@ -0,0 +1,124 @@
+// ============================================================================
+// transfer.h - Transferencia de archivos entre clientes, sin pasar por el servidor
+// ============================================================================
+// El archivo no viaja por la conexión de chat (el texto de /msg es acotado y
+// mezclarlo trabaría los mensajes). Se negocia por el chat y los bytes van
+// por dos conexiones de datos aparte, que el servidor une:
+//
+//   ana: /send bob 5000 foto.png      bob recibe FILE_OFFER: 3 ana 5000 foto.png
+//   bob: /accept 3                    bob recibe FILE_RECV: 3 <token> 5000 foto.png
+//                                     ana recibe FILE_SEND: 3 <token> 5000 foto.png
+//   cada uno abre otra conexión al mismo puerto y envía "/xfer <su token>"
+//   en lugar del nick; con las dos conectadas ambos reciben
+//   "FILE_START 5000" y ana escribe los 5000 bytes crudos
+//   al terminar ambos reciben por el chat FILE_END: 3 completa 5000
+//
+// Un thread propio pasa los bytes de un socket al otro con splice() a través
+// de un pipe: nunca se copian a memoria del proceso. El pipe es el control
+// de flujo: si el receptor no da abasto el pipe se llena, se deja de leer al
+// emisor y su ventana TCP se cierra sola. Los workers no tocan las
+// conexiones de datos, así que una transferencia no frena el chat.
+// ============================================================================
+
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "protocol.h"
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define TRANSFER_MAX 64                     // Ofrecidas, aceptadas o en curso a la vez
+#define TRANSFER_TOKEN_SIZE 17              // 16 dígitos hexadecimales + '\0'
+#define TRANSFER_NAME_SIZE 128              // Nombre sugerido del archivo
+#define TRANSFER_MAX_BYTES (1ULL << 40)
+#define TRANSFER_PIPE_BYTES (256 * 1024)    // Lo que puede quedar en camino entre los dos sockets
+#define TRANSFER_BURST_BYTES (1024 * 1024)  // Por evento, para turnarse con las demás
+#define TRANSFER_OFFER_TIMEOUT_MS 120000    // Para aceptar y abrir las dos conexiones de datos
+#define TRANSFER_STALL_MS 60000             // En curso sin mover un byte: se corta
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+// Avisa a un nick por su conexión de chat (line termina en '\n')
+typedef void (*TransferNotifyFn)(const char *nick, const char *line, size_t len);
+
+// Datos de una transferencia para armar los avisos
+typedef struct {
+    unsigned id;
+    char from[MAX_NICK_LENGTH];
+    char to[MAX_NICK_LENGTH];
+    uint64_t size;
+    char name[TRANSFER_NAME_SIZE];
+    char send_token[TRANSFER_TOKEN_SIZE];
+    char recv_token[TRANSFER_TOKEN_SIZE];
+} TransferTicket;
+
+typedef struct {
+    uint64_t offered;
+    uint64_t completed;
+    uint64_t failed;          // Cortadas, rechazadas o vencidas
+    uint64_t bytes;           // Movidos desde el arranque
+    uint64_t throttled;       // Veces que se dejó de leer al emisor (pipe lleno)
+    int waiting;              // Ofrecidas o esperando las conexiones de datos
+    int active;               // En curso
+    uint64_t active_bytes;    // Movidos de las que están en curso
+    uint64_t active_size;     // Tamaño total de las que están en curso
+} TransferStats;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Arranca el thread que une las conexiones de datos
+ * @param notify Envío de FILE_END a los dos nicks (sin locks del módulo tomados)
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int transfer_start(TransferNotifyFn notify);
+
+/**
+ * Detiene el thread y corta todas las transferencias (sin avisar)
+ */
+void transfer_stop(void);
+
+/**
+ * Registra una oferta de from a to
+ * @param ticket Se completa con el id asignado
+ * @return 0 si tiene éxito, -1 si ya hay TRANSFER_MAX
+ */
+int transfer_offer(const char *from, const char *to, uint64_t size, const char *name,
+                   TransferTicket *ticket);
+
+/**
+ * El destinatario acepta la oferta id
+ * @param ticket Se completa con los dos tokens
+ * @return 0 si tiene éxito, -1 si no existe, no es para nick o ya se aceptó
+ */
+int transfer_accept(unsigned id, const char *nick, TransferTicket *ticket);
+
+/**
+ * Cualquiera de los dos la rechaza o la cancela antes de que empiece
+ * @param ticket Se completa para avisarle al otro
+ * @return 0 si tiene éxito, -1 si no existe, no es de nick o ya empezó
+ */
+int transfer_reject(unsigned id, const char *nick, TransferTicket *ticket);
+
+/**
+ * Entrega una conexión de datos que envió "/xfer <token>" (ya fuera del
+ * epoll de su worker); el módulo pasa a ser su dueño
+ * @return 0 si tiene éxito, -1 si el token no sirve (el socket sigue siendo
+ *         de quien llama)
+ */
+int transfer_join(const char *token, int sockfd);
+
+/**
+ * Totales y progreso de las que están en curso
+ */
+void transfer_get_stats(TransferStats *out);
+
+#endif // TRANSFER_H
@@ -0,0 +1,259 @@
+// ============================================================================
+// upgrade.c - Implementación del traspaso de sockets entre procesos
+// ============================================================================
+
+#include "upgrade.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// ============================================================================
+// Estructuras del protocolo de traspaso
+// ============================================================================
+
+// Primer mensaje: acompaña al socket de escucha
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;          // Cantidad de registros que siguen
+    uint64_t partials_len;   // Bytes de líneas incompletas después de los registros
+} UpgradeHeader;
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+// Envía un mensaje con fds adjuntos (SCM_RIGHTS)
+static int send_with_fds(int sock, const void *data, size_t len, const int *fds, int nfds) {
+    struct iovec iov = { .iov_base = (void *)data, .iov_len = len };
+    char control[CMSG_SPACE(sizeof(int) * UPGRADE_BATCH)];
+    struct msghdr msg;
+    
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    
+    if (nfds > 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+        
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+    }
+    
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) != (ssize_t)len) {
+        perror("upgrade: sendmsg");
+        return -1;
+    }
+    return 0;
+}
+
+// Recibe un mensaje y los fds adjuntos. Retorna los bytes leídos o -1.
+static ssize_t recv_with_fds(int sock, void *data, size_t len, int *fds, int max_fds, int *nfds) {
+    struct iovec iov = { .iov_base = data, .iov_len = len };
+    char control[CMSG_SPACE(sizeof(int) * UPGRADE_BATCH)];
+    struct msghdr msg;
+    
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    
+    // Los sockets recibidos quedan con CLOEXEC para el próximo upgrade
+    ssize_t bytes = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (bytes < 0) {
+        perror("upgrade: recvmsg");
+        return -1;
+    }
+    
+    *nfds = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int n = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            if (n > max_fds) n = max_fds;
+            memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * n);
+            *nfds = n;
+        }
+    }
+    
+    if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        fprintf(stderr, "upgrade: mensaje truncado\n");
+        return -1;
+    }
+    
+    return bytes;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+pid_t upgrade_spawn(char *const argv[], int *sock_out) {
+    int sv[2];
+    
+    // SEQPACKET conserva los límites de cada mensaje
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        perror("upgrade: socketpair");
+        return -1;
+    }
+    
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("upgrade: fork");
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    
+    if (pid == 0) {
+        // Hijo: solo hereda su extremo del socketpair
+        char fd_str[16];
+        int flags = fcntl(sv[1], F_GETFD);
+        fcntl(sv[1], F_SETFD, flags & ~FD_CLOEXEC);
+        snprintf(fd_str, sizeof(fd_str), "%d", sv[1]);
+        setenv(UPGRADE_ENV_FD, fd_str, 1);
+        
+        if (strchr(argv[0], '/')) {
+            execv(argv[0], argv);
+        } else {
+            execvp(argv[0], argv);
+        }
+        perror("upgrade: exec");
+        _exit(127);
+    }
+    
+    close(sv[1]);
+    *sock_out = sv[0];
+    return pid;
+}
+
+int upgrade_send_state(int sock, int listen_fd, const UpgradeRecord *records,
+                       const int *fds, int count, const char *partials, size_t partials_len) {
+    UpgradeHeader header = {
+        .magic = UPGRADE_MAGIC,
+        .version = UPGRADE_VERSION,
+        .count = (uint32_t)count,
+        .partials_len = partials_len
+    };
+    
+    if (send_with_fds(sock, &header, sizeof(header), &listen_fd, 1) < 0) {
+        return -1;
+    }
+    
+    // Los registros viajan en lotes junto con sus sockets
+    for (int i = 0; i < count; i += UPGRADE_BATCH) {
+        int n = count - i < UPGRADE_BATCH ? count - i : UPGRADE_BATCH;
+        if (send_with_fds(sock, &records[i], sizeof(UpgradeRecord) * n, &fds[i], n) < 0) {
+            return -1;
+        }
+    }
+    
+    // Después, las líneas a medias: sin ellas el proceso nuevo tomaría el
+    // final de un comando como un comando entero
+    for (size_t off = 0; off < partials_len; off += UPGRADE_CHUNK) {
+        size_t n = partials_len - off < UPGRADE_CHUNK ? partials_len - off : UPGRADE_CHUNK;
+        if (send_with_fds(sock, partials + off, n, NULL, 0) < 0) {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+int upgrade_recv_state(int sock, int *listen_fd, UpgradeRecord **records,
+                       int **fds, int *count, char **partials) {
+    UpgradeHeader header;
+    int nfds = 0;
+    
+    ssize_t bytes = recv_with_fds(sock, &header, sizeof(header), listen_fd, 1, &nfds);
+    if (bytes != sizeof(header) || nfds != 1 ||
+        header.magic != UPGRADE_MAGIC || header.version != UPGRADE_VERSION) {
+        fprintf(stderr, "upgrade: encabezado inválido\n");
+        return -1;
+    }
+    
+    *count = (int)header.count;
+    *records = calloc(header.count + 1, sizeof(UpgradeRecord));
+    *fds = calloc(header.count + 1, sizeof(int));
+    *partials = malloc(header.partials_len + 1);
+    if (!*records || !*fds || !*partials) {
+        free(*records);
+        free(*fds);
+        free(*partials);
+        return -1;
+    }
+    
+    int received = 0;
+    while (received < *count) {
+        int n = *count - received < UPGRADE_BATCH ? *count - received : UPGRADE_BATCH;
+        bytes = recv_with_fds(sock, &(*records)[received], sizeof(UpgradeRecord) * n,
+                              &(*fds)[received], n, &nfds);
+        if (bytes != (ssize_t)(sizeof(UpgradeRecord) * n) || nfds != n) {
+            fprintf(stderr, "upgrade: lote incompleto\n");
+            for (int i = 0; i < received + nfds; i++) close((*fds)[i]);
+            free(*records);
+            free(*fds);
+            free(*partials);
+            return -1;
+        }
+        received += n;
+    }
+    
+    uint64_t total = 0;
+    for (int i = 0; i < *count; i++) total += (*records)[i].partial_len;
+    
+    size_t off = 0;
+    int stray_fd;
+    while (off < header.partials_len && total == header.partials_len) {
+        size_t n = header.partials_len - off < UPGRADE_CHUNK ? header.partials_len - off : UPGRADE_CHUNK;
+        bytes = recv_with_fds(sock, *partials + off, n, &stray_fd, 0, &nfds);
+        if (bytes != (ssize_t)n || nfds != 0) break;
+        off += n;
+    }
+    if (total != header.partials_len || off != header.partials_len) {
+        fprintf(stderr, "upgrade: líneas incompletas inválidas\n");
+        for (int i = 0; i < *count; i++) close((*fds)[i]);
+        free(*records);
+        free(*fds);
+        free(*partials);
+        return -1;
+    }
+    
+    return 0;
+}
+
+int upgrade_wait_ack(int sock, int timeout_ms) {
+    struct pollfd pfd = { .fd = sock, .events = POLLIN };
+    char ack = 0;
+    
+    if (poll(&pfd, 1, timeout_ms) != 1) return -1;
+    if (read(sock, &ack, 1) != 1 || ack != 'K') return -1;
+    return 0;
+}
+
+int upgrade_send_ack(int sock) {
+    char ack = 'K';
+    return write(sock, &ack, 1) == 1 ? 0 : -1;
+}
+
+int upgrade_inherited_fd(void) {
+    const char *value = getenv(UPGRADE_ENV_FD);
+    if (!value) return -1;
+    
+    int fd = atoi(value);
+    unsetenv(UPGRADE_ENV_FD);
+    
+    // El fd heredado no debe pasar a futuros procesos
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
@@ -0,0 +1,89 @@
+// ============================================================================
+// upgrade.h - Reinicio sin cortes: traspaso de sockets a un binario nuevo
+// ============================================================================
+// El proceso viejo lanza el binario nuevo con un extremo de un socketpair
+// UNIX y le pasa por ahí el socket de escucha y los de todos los clientes
+// (SCM_RIGHTS), junto con el estado del registro de nicks serializado y las
+// líneas que cada cliente dejó a medio enviar.
+// ============================================================================
+
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "dashboard.h"
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define UPGRADE_ENV_FD "SERVIDOR_UPGRADE_FD"  // Variable con el fd del socketpair
+#define UPGRADE_MAGIC 0x50554843u              // "CHUP"
+#define UPGRADE_VERSION 3
+#define UPGRADE_BATCH 128                      // fds por mensaje (< SCM_MAX_FD)
+#define UPGRADE_ACK_TIMEOUT_MS 5000
+#define UPGRADE_CHUNK 65536                    // Bytes de líneas a medias por mensaje
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+// Estado serializado de una conexión (el fd viaja aparte, en el mismo orden)
+typedef struct {
+    int32_t state;           // 0 = esperando nick, 1 = registrado
+    char nick[NICK_SIZE];
+    int64_t connected_at;    // time_t del alta en el registro
+    uint32_t idle_ms;        // Tiempo transcurrido desde el último comando
+    int32_t watching;        // Suscripto a /watch
+    int32_t line_mode;       // Termina sus comandos con '\n' (ver handle_readable())
+    uint32_t partial_len;    // Bytes de su línea incompleta (viajan después de los registros)
+} UpgradeRecord;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Lanza el binario nuevo (fork + exec) pasándole un extremo del socketpair
+ * en la variable de entorno UPGRADE_ENV_FD
+ * @param argv Argumentos con los que se lanzó el servidor actual
+ * @param sock_out Extremo del socketpair que conserva el proceso viejo
+ * @return PID del hijo o -1 en caso de error
+ */
+pid_t upgrade_spawn(char *const argv[], int *sock_out);
+
+/**
+ * Envía el socket de escucha, los registros y los sockets de los clientes
+ * @param partials Líneas incompletas de todos, una tras otra en el orden de
+ *        los registros (cada una de records[i].partial_len bytes)
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int upgrade_send_state(int sock, int listen_fd, const UpgradeRecord *records,
+                       const int *fds, int count, const char *partials, size_t partials_len);
+
+/**
+ * Recibe el estado enviado por upgrade_send_state()
+ * Los arreglos devueltos se liberan con free()
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int upgrade_recv_state(int sock, int *listen_fd, UpgradeRecord **records,
+                       int **fds, int *count, char **partials);
+
+/**
+ * Espera la confirmación del proceso nuevo
+ * @return 0 si el proceso nuevo tomó el control, -1 si no
+ */
+int upgrade_wait_ack(int sock, int timeout_ms);
+
+/**
+ * Confirma al proceso viejo que el nuevo ya está sirviendo
+ */
+int upgrade_send_ack(int sock);
+
+/**
+ * Devuelve el fd heredado si este proceso fue lanzado por un upgrade, o -1
+ */
+int upgrade_inherited_fd(void);
+
+#endif // UPGRADE_H
@@ -0,0 +1,311 @@
+// ============================================================================
+// zerocopy.c - Implementación del envío sin copia
+// ============================================================================
+
+#include "zerocopy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+// ============================================================================
+// Estructuras internas
+// ============================================================================
+
+#define FIFO_INITIAL 8
+
+struct ZcPayload {
+    int refs;                 // Atómico: lo sueltan el que lo crea y cada envío confirmado
+    size_t len;
+    size_t map_size;
+    char data[];
+};
+
+// Envíos sin confirmar de un socket, en el orden en que el kernel los numera
+typedef struct {
+    ZcPayload **fifo;         // Anillo
+    uint32_t head;
+    uint32_t count;
+    uint32_t cap;
+    int unsupported;          // setsockopt(SO_ZEROCOPY) falló: siempre copiando
+} ZcSocket;
+
+// ============================================================================
+// Estado del módulo
+// ============================================================================
+
+static struct {
+    pthread_mutex_t mutex;
+    ZcSocket **sockets;       // Indexada por fd; solo los que enviaron sin copia
+    int size;
+    int min_bytes;
+    ZerocopyStats stats;      // payloads y payload_bytes son atómicos (fuera del mutex)
+} zc = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER
+};
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+// Hay lugar para un envío más en el anillo (con el mutex tomado)
+static int fifo_reserve(ZcSocket *s) {
+    if (s->count < s->cap) return 0;
+    
+    uint32_t cap = s->cap ? s->cap * 2 : FIFO_INITIAL;
+    ZcPayload **fifo = malloc(cap * sizeof(ZcPayload *));
+    if (!fifo) return -1;
+    for (uint32_t i = 0; i < s->count; i++) fifo[i] = s->fifo[(s->head + i) % s->cap];
+    free(s->fifo);
+    zc.stats.socket_bytes += (cap - s->cap) * sizeof(ZcPayload *);
+    s->fifo = fifo;
+    s->head = 0;
+    s->cap = cap;
+    return 0;
+}
+
+// Suelta los n envíos más viejos (con el mutex tomado). Un aviso puede
+// cubrir envíos que este proceso no hizo (los del anterior a un upgrade):
+// nunca se suelta más de lo que hay.
+static void fifo_release(ZcSocket *s, uint32_t n) {
+    if (!s) return;
+    if (n > s->count) n = s->count;
+    
+    for (uint32_t i = 0; i < n; i++) {
+        zerocopy_payload_release(s->fifo[s->head]);
+        s->head = (s->head + 1) % s->cap;
+    }
+    s->count -= n;
+    zc.stats.pending -= n;
+}
+
+// Lee todos los avisos de la cola de errores de sockfd (con el mutex tomado)
+static int reap_locked(int sockfd, ZcSocket *s) {
+    int notices = 0;
+    
+    for (;;) {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+        notices++;
+        
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (!(c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) &&
+                !(c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR)) {
+                continue;
+            }
+            struct sock_extended_err *e = (struct sock_extended_err *)CMSG_DATA(c);
+            if (e->ee_origin != SO_EE_ORIGIN_ZEROCOPY || e->ee_errno != 0) continue;
+            
+            // Rango [ee_info, ee_data] de envíos terminados, contiguo y en orden
+            uint32_t n = e->ee_data - e->ee_info + 1;
+            zc.stats.completed += n;
+            if (e->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) zc.stats.copied += n;
+            fifo_release(s, n);
+        }
+    }
+    return notices;
+}
+
+// Estado de sockfd; la primera vez activa SO_ZEROCOPY (con el mutex tomado)
+static ZcSocket *socket_get(int sockfd) {
+    ZcSocket *s = zc.sockets[sockfd];
+    if (s) return s;
+    
+    s = calloc(1, sizeof(ZcSocket));
+    if (!s) return NULL;
+    int one = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) s->unsupported = 1;
+    zc.sockets[sockfd] = s;
+    zc.stats.socket_bytes += sizeof(ZcSocket);
+    return s;
+}
+
+static void socket_free(int sockfd) {
+    ZcSocket *s = zc.sockets[sockfd];
+    if (!s) return;
+    
+    fifo_release(s, s->count);
+    zc.stats.socket_bytes -= sizeof(ZcSocket) + s->cap * sizeof(ZcPayload *);
+    free(s->fifo);
+    free(s);
+    zc.sockets[sockfd] = NULL;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int zerocopy_start(int min_bytes) {
+    struct rlimit rl;
+    
+    pthread_mutex_lock(&zc.mutex);
+    if (!zc.sockets) {
+        if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+            pthread_mutex_unlock(&zc.mutex);
+            return -1;
+        }
+        zc.size = rl.rlim_cur == RLIM_INFINITY ? 65536 : (int)rl.rlim_cur;
+        zc.sockets = calloc((size_t)zc.size, sizeof(ZcSocket *));
+        if (!zc.sockets) {
+            pthread_mutex_unlock(&zc.mutex);
+            return -1;
+        }
+    }
+    pthread_mutex_unlock(&zc.mutex);
+    
+    zerocopy_set_min_bytes(min_bytes);
+    return 0;
+}
+
+void zerocopy_stop(void) {
+    pthread_mutex_lock(&zc.mutex);
+    __atomic_store_n(&zc.min_bytes, 0, __ATOMIC_RELAXED);
+    if (zc.sockets) {
+        for (int i = 0; i < zc.size; i++) socket_free(i);
+        free(zc.sockets);
+        zc.sockets = NULL;
+    }
+    pthread_mutex_unlock(&zc.mutex);
+}
+
+void zerocopy_set_min_bytes(int min_bytes) {
+    if (min_bytes < 0) min_bytes = 0;
+    if (min_bytes > 0 && min_bytes < ZEROCOPY_MIN_BYTES) min_bytes = ZEROCOPY_MIN_BYTES;
+    __atomic_store_n(&zc.min_bytes, min_bytes, __ATOMIC_RELAXED);
+}
+
+int zerocopy_wanted(size_t len) {
+    int min_bytes = __atomic_load_n(&zc.min_bytes, __ATOMIC_RELAXED);
+    return min_bytes > 0 && len >= (size_t)min_bytes;
+}
+
+ZcPayload *zerocopy_payload_new(const struct iovec *iov, int count) {
+    size_t len = 0;
+    for (int i = 0; i < count; i++) len += iov[i].iov_len;
+    
+    // Un mapeo propio: al soltarlo las páginas no vuelven al heap mientras
+    // el kernel las tenga fijadas
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t map_size = (sizeof(ZcPayload) + len + page - 1) & ~(page - 1);
+    ZcPayload *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    
+    p->refs = 1;
+    p->len = len;
+    p->map_size = map_size;
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(p->data + offset, iov[i].iov_base, iov[i].iov_len);
+        offset += iov[i].iov_len;
+    }
+    
+    __atomic_add_fetch(&zc.stats.payloads, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&zc.stats.payload_bytes, map_size, __ATOMIC_RELAXED);
+    return p;
+}
+
+void zerocopy_payload_release(ZcPayload *p) {
+    if (!p || __atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    
+    __atomic_sub_fetch(&zc.stats.payloads, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&zc.stats.payload_bytes, p->map_size, __ATOMIC_RELAXED);
+    munmap(p, p->map_size);
+}
+
+int zerocopy_send(int sockfd, ZcPayload *p, int nonblock, ssize_t *sent) {
+    pthread_mutex_lock(&zc.mutex);
+    
+    ZcSocket *s = zc.sockets && sockfd >= 0 && sockfd < zc.size ? socket_get(sockfd) : NULL;
+    if (!s || s->unsupported) {
+        zc.stats.fallbacks++;
+        pthread_mutex_unlock(&zc.mutex);
+        return -1;
+    }
+    
+    // Muchos envíos sin confirmar: leer los avisos acá, sin esperar al worker
+    if (s->count >= ZEROCOPY_REAP_PENDING) reap_locked(sockfd, s);
+    
+    size_t offset = 0;
+    int flags = MSG_NOSIGNAL | MSG_ZEROCOPY | (nonblock ? MSG_DONTWAIT : 0);
+    while (offset < p->len) {
+        // Sin lugar para recordar el envío no se lo puede hacer sin copia
+        if ((flags & MSG_ZEROCOPY) && fifo_reserve(s) < 0) {
+            flags &= ~MSG_ZEROCOPY;
+            zc.stats.fallbacks++;
+        }
+        
+        ssize_t n = send(sockfd, p->data + offset, p->len - offset, flags);
+        if (n < 0 && errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+            // Sin memoria para el aviso (net.core.optmem_max): seguir copiando
+            if (offset == 0) {
+                zc.stats.fallbacks++;
+                pthread_mutex_unlock(&zc.mutex);
+                return -1;
+            }
+            flags &= ~MSG_ZEROCOPY;
+            zc.stats.fallbacks++;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && nonblock && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0) {
+            *sent = -1;
+            pthread_mutex_unlock(&zc.mutex);
+            return 0;
+        }
+        
+        if (flags & MSG_ZEROCOPY) {
+            __atomic_add_fetch(&p->refs, 1, __ATOMIC_RELAXED);
+            s->fifo[(s->head + s->count) % s->cap] = p;
+            s->count++;
+            zc.stats.sends++;
+            zc.stats.bytes += (uint64_t)n;
+            zc.stats.pending++;
+        }
+        offset += (size_t)n;
+    }
+    
+    pthread_mutex_unlock(&zc.mutex);
+    *sent = (ssize_t)offset;
+    return 0;
+}
+
+int zerocopy_reap(int sockfd) {
+    pthread_mutex_lock(&zc.mutex);
+    ZcSocket *s = zc.sockets && sockfd >= 0 && sockfd < zc.size ? zc.sockets[sockfd] : NULL;
+    int notices = reap_locked(sockfd, s);
+    pthread_mutex_unlock(&zc.mutex);
+    return notices;
+}
+
+void zerocopy_forget(int sockfd) {
+    pthread_mutex_lock(&zc.mutex);
+    if (zc.sockets && sockfd >= 0 && sockfd < zc.size) socket_free(sockfd);
+    pthread_mutex_unlock(&zc.mutex);
+}
+
+void zerocopy_get_stats(ZerocopyStats *out) {
+    pthread_mutex_lock(&zc.mutex);
+    *out = zc.stats;
+    out->min_bytes = __atomic_load_n(&zc.min_bytes, __ATOMIC_RELAXED);
+    out->table_bytes = zc.sockets ? (uint64_t)zc.size * sizeof(ZcSocket *) : 0;
+    pthread_mutex_unlock(&zc.mutex);
+}
@@ -0,0 +1,121 @@
+// ============================================================================
+// zerocopy.h - Envío sin copia (MSG_ZEROCOPY) de los broadcasts grandes
+// ============================================================================
+// Un broadcast de decenas de KB a miles de clientes se copia entero en el
+// buffer de cada socket: la CPU se va en memcpy. Con --zerocopy-min el
+// mensaje se copia una sola vez a un buffer compartido y cada send() lleva
+// MSG_ZEROCOPY: el kernel fija esas páginas y las transmite sin copiarlas.
+//
+// El buffer no se puede liberar hasta que el kernel termine con él. Cada
+// socket guarda, en orden, los envíos sin confirmar; el kernel avisa por la
+// cola de errores del socket (EPOLLERR en el worker dueño) con rangos de
+// envíos terminados, y recién ahí se suelta la referencia. El aviso dice
+// además si el kernel terminó copiando igual (loopback, placa sin
+// scatter-gather): eso y los envíos que no pudieron ir sin copia se cuentan.
+//
+// Los buffers son mapeos propios (mmap), nunca memoria del heap: aunque un
+// socket se cierre con envíos sin confirmar, sus páginas siguen fijadas por
+// el kernel y nadie más las reutiliza.
+// ============================================================================
+
+#ifndef ZEROCOPY_H
+#define ZEROCOPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define ZEROCOPY_MIN_BYTES 4096        // Por debajo fijar páginas cuesta más que copiarlas
+#define ZEROCOPY_REAP_PENDING 64       // Envíos sin confirmar que hacen leer los avisos al enviar
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct ZcPayload ZcPayload;
+
+typedef struct {
+    int min_bytes;            // Umbral actual (0 = desactivado)
+    uint64_t sends;           // send() con MSG_ZEROCOPY
+    uint64_t bytes;
+    uint64_t completed;       // Envíos que el kernel confirmó
+    uint64_t copied;          // ... de esos, los que el kernel igual copió
+    uint64_t fallbacks;       // Mensajes grandes que salieron copiando (socket sin soporte, ENOBUFS)
+    uint64_t pending;         // Envíos esperando el aviso
+    uint64_t payloads;        // Buffers compartidos vivos
+    uint64_t payload_bytes;   // Memoria de esos buffers
+    uint64_t socket_bytes;    // Estado de los sockets que enviaron sin copia
+    uint64_t table_bytes;     // Tabla de sockets (un puntero por fd posible)
+} ZerocopyStats;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Reserva la tabla de envíos pendientes (una entrada por fd posible)
+ * @param min_bytes Tamaño desde el que un broadcast va sin copia (0 = nunca)
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int zerocopy_start(int min_bytes);
+
+/**
+ * Suelta lo pendiente de todos los sockets y libera la tabla
+ */
+void zerocopy_stop(void);
+
+/**
+ * Cambia el umbral (0 = desactivado; los envíos en curso se confirman igual)
+ */
+void zerocopy_set_min_bytes(int min_bytes);
+
+/**
+ * Retorna 1 si un mensaje de len bytes debe ir sin copia
+ */
+int zerocopy_wanted(size_t len);
+
+/**
+ * Copia el mensaje a un buffer compartido
+ * @return El buffer (con una referencia de quien lo crea) o NULL sin memoria
+ */
+ZcPayload *zerocopy_payload_new(const struct iovec *iov, int count);
+
+/**
+ * Suelta una referencia (NULL no hace nada)
+ */
+void zerocopy_payload_release(ZcPayload *p);
+
+/**
+ * Envía el buffer a sockfd con MSG_ZEROCOPY; cada envío aceptado toma una
+ * referencia hasta que llegue su aviso
+ * @param nonblock Con el buffer del socket lleno, devolver lo enviado hasta
+ *        ahí en vez de esperar (el resto lo envía el que llama)
+ * @param sent Bytes enviados o -1 si el socket falló (con errno)
+ * @return 0 si se intentó sin copia, -1 si hay que enviarlo copiando
+ */
+int zerocopy_send(int sockfd, ZcPayload *p, int nonblock, ssize_t *sent);
+
+/**
+ * Lee los avisos de la cola de errores de sockfd y suelta los buffers de
+ * los envíos confirmados (lo llama el worker dueño ante EPOLLERR)
+ * @return Avisos leídos (0 = el EPOLLERR es un error de verdad)
+ */
+int zerocopy_reap(int sockfd);
+
+/**
+ * Olvida los envíos pendientes de sockfd (antes de cerrarlo: el fd se
+ * reutiliza y sus avisos ya no se van a poder leer)
+ */
+void zerocopy_forget(int sockfd);
+
+/**
+ * Totales desde el arranque
+ */
+void zerocopy_get_stats(ZerocopyStats *out);
+
+#endif // ZEROCOPY_H
@@ -0,0 +1,256 @@
+// ============================================================================
+// microbench.c - Microbenchmarks de las primitivas del camino caliente
+// ============================================================================
+// Compila servidor.c adentro de este archivo (para llegar a sus funciones
+// static) con los envíos redirigidos a sumideros en memoria, así se mide solo
+// el trabajo del servidor y no el del kernel. Reporta ns/op y reservas de
+// memoria por operación (malloc/calloc/realloc, vía --wrap del linker).
+//
+// El registro tiene tamaño fijo (MAX_CLIENTS), así que "make microbench" lo
+// compila una vez por tamaño (100, 1000, 10000 y 100000) y corre cada uno
+// con el registro lleno.
+//
+// Ejecutar: make microbench
+//           ./bench/microbench_1000 [segundos por caso]
+// ============================================================================
+
+// Headers del sistema primero: las redirecciones de abajo solo deben tocar
+// las llamadas de servidor.c, no las declaraciones
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include "../Servidor/lanes.h"
+
+#define BENCH_FD_BASE (1 << 24)  // Sockets falsos: nunca chocan con un fd real
+
+static ssize_t bench_send(int sockfd, const void* data, size_t len, int flags);
+static ssize_t bench_lanes_send(int sockfd, const struct iovec* iov, int count, size_t len, LaneClass lane);
+static int bench_close(int fd);
+
+#define send(sockfd, data, len, flags) bench_send((sockfd), (data), (len), (flags))
+#define lanes_send(sockfd, iov, count, len, lane) bench_lanes_send((sockfd), (iov), (count), (len), (lane))
+#define close(fd) bench_close(fd)
+#define main servidor_main
+
+#include "../Servidor/servidor.c"
+
+#undef main
+#undef close
+
+// ============================================================================
+// Sumideros en memoria y conteo de reservas
+// ============================================================================
+
+static size_t sink_bytes[MAX_CLIENTS + 1];  // Bytes "enviados" a cada socket falso
+static unsigned long alloc_count = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+
+static ssize_t bench_send(int sockfd, const void* data, size_t len, int flags) {
+    (void)data;
+    (void)flags;
+    int idx = sockfd - BENCH_FD_BASE;
+    if (idx >= 0 && idx <= MAX_CLIENTS) sink_bytes[idx] += len;
+    return (ssize_t)len;
+}
+
+static ssize_t bench_lanes_send(int sockfd, const struct iovec* iov, int count, size_t len, LaneClass lane) {
+    (void)iov;
+    (void)count;
+    (void)lane;
+    return bench_send(sockfd, NULL, len, 0);
+}
+
+static int bench_close(int fd) {
+    if (fd >= BENCH_FD_BASE) return 0;
+    return close(fd);
+}
+
+// ============================================================================
+// Harness
+// ============================================================================
+
+static double seconds_per_case = 0.2;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Corre fn en tandas cada vez más grandes hasta llenar el tiempo del caso
+// Retorna ns/op
+static double run_case(const char* name, void (*fn)(void)) {
+    uint64_t iterations = 1;
+    uint64_t elapsed = 0;
+    unsigned long allocs = 0;
+    uint64_t budget = (uint64_t)(seconds_per_case * 1e9);
+    
+    fn();  // Calentar caches y la vista de /list
+    
+    for (;;) {
+        unsigned long allocs_before = alloc_count;
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < iterations; i++) fn();
+        elapsed = now_ns() - start;
+        allocs = alloc_count - allocs_before;
+        
+        if (elapsed >= budget || iterations >= (1ull << 40)) break;
+        
+        // Apuntar al presupuesto con la medición de esta tanda
+        uint64_t next = elapsed > 0 ? iterations * budget / elapsed + 1 : iterations * 100;
+        if (next > iterations * 100) next = iterations * 100;
+        if (next <= iterations) next = iterations * 2;
+        iterations = next;
+    }
+    
+    double ns_per_op = (double)elapsed / (double)iterations;
+    printf("  %-40s %12.1f %12.2f\n", name, ns_per_op, (double)allocs / (double)iterations);
+    return ns_per_op;
+}
+
+// ============================================================================
+// Casos
+// ============================================================================
+
+static ConnCold bench_cold;
+static Connection bench_conn = { .cold = &bench_cold };
+static char first_nick[NICK_SIZE];
+static char last_nick[NICK_SIZE];
+static char line_help[] = "/help";
+static char line_unknown[] = "hola a todos";
+static char line_msg[64];
+static Reply broadcast_reply;
+
+static void fill_registry(void) {
+    char nick[NICK_SIZE];
+    
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        snprintf(nick, sizeof(nick), "u%d", i);
+        add_client(BENCH_FD_BASE + i, nick);
+    }
+    snprintf(first_nick, sizeof(first_nick), "u%d", 0);
+    snprintf(last_nick, sizeof(last_nick), "u%d", MAX_CLIENTS - 1);
+    snprintf(line_msg, sizeof(line_msg), "/msg %s hola, ¿cómo va?", last_nick);
+    
+    bench_conn.sockfd = BENCH_FD_BASE + MAX_CLIENTS;
+    bench_conn.state = CONN_ACTIVE;
+    strcpy(bench_conn.cold->nick, "bench");
+}
+
+static void bench_parse_help(void) {
+    handle_command(&bench_conn, line_help);
+}
+
+static void bench_parse_unknown(void) {
+    handle_command(&bench_conn, line_unknown);
+}
+
+static void bench_parse_msg(void) {
+    handle_command(&bench_conn, line_msg);
+}
+
+static void bench_find_first(void) {
+    find_client_by_nick(first_nick);
+}
+
+static void bench_find_last(void) {
+    find_client_by_nick(last_nick);
+}
+
+static void bench_find_missing(void) {
+    find_client_by_nick("no-existe");
+}
+
+// Sale y vuelve a entrar el último cliente (el peor caso de los recorridos)
+static void bench_churn(void) {
+    remove_client(BENCH_FD_BASE + MAX_CLIENTS - 1);
+    add_client(BENCH_FD_BASE + MAX_CLIENTS - 1, last_nick);
+}
+
+static void bench_log_message(void) {
+    log_message(&message_log, "bench", last_nick, "hola, ¿cómo va?");
+}
+
+static void bench_list_cached(void) {
+    send_client_list(bench_conn.sockfd, "");
+}
+
+static void bench_list_rebuild(void) {
+    list_snapshot_invalidate();
+    send_client_list(bench_conn.sockfd, "");
+}
+
+static void bench_list_page(void) {
+    send_client_list(bench_conn.sockfd, "1");
+}
+
+static void bench_broadcast(void) {
+    broadcast_to_all(bench_conn.sockfd, &broadcast_reply);
+}
+
+// ============================================================================
+// Función principal
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) seconds_per_case = atof(argv[1]);
+    if (seconds_per_case <= 0) seconds_per_case = 0.2;
+    
+    fill_registry();
+    build_chat_reply(&broadcast_reply, RESP_BROADCAST " ", REPLY_LEN(RESP_BROADCAST " "),
+                     "bench", "hola a todos");
+    
+    printf("\nRegistro de %d clientes\n", MAX_CLIENTS);
+    printf("  %-40s %12s %12s\n", "caso", "ns/op", "allocs/op");
+    
+    run_case("comando /help", bench_parse_help);
+    run_case("comando desconocido", bench_parse_unknown);
+    run_case("comando /msg (destino al final)", bench_parse_msg);
+    run_case("find_client_by_nick (primero)", bench_find_first);
+    run_case("find_client_by_nick (último)", bench_find_last);
+    run_case("find_client_by_nick (inexistente)", bench_find_missing);
+    run_case("remove_client + add_client", bench_churn);
+    run_case("log_message", bench_log_message);
+    run_case("/list (vista en cache)", bench_list_cached);
+    run_case("/list 1 (vista en cache)", bench_list_page);
+    run_case("/list (reconstruyendo la vista)", bench_list_rebuild);
+    double fanout = run_case("broadcast_to_all", bench_broadcast);
+    printf("  %-40s %12.1f\n", "broadcast_to_all (por destinatario)", fanout / MAX_CLIENTS);
+    
+    // Evitar que el compilador descarte los envíos
+    size_t total = 0;
+    for (int i = 0; i <= MAX_CLIENTS; i++) total += sink_bytes[i];
+    return total == 0;
+}
@@ -0,0 +1,386 @@
+// ============================================================================
+// replay.c - Reproduce una traza de --capture contra uno o dos servidores
+// ============================================================================
+// Abre una conexión por cada conexión de la traza y envía cada línea en su
+// instante original dividido por la velocidad (1 = tiempo real, 10 = diez
+// veces más rápido, max = sin esperas). Mide cuánto tarda cada respuesta y,
+// con dos servidores, corre la traza contra cada uno y compara los builds.
+// El protocolo (lotes de salida y respuestas esperadas) lo maneja
+// libchatclient; acá solo se reparte el tiempo y se junta la estadística.
+//
+// Compilar: make replay
+// Ejecutar: ./bench/replay traza.bin 127.0.0.1:5000 [127.0.0.1:5001] [--speed 1|10|max]
+// ============================================================================
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "../Cliente/chatclient.h"
+#include "../Servidor/capture.h"
+
+#define REPLAY_MAX_EVENTS 256
+#define REPLAY_DRAIN_MS 5000   // Espera máxima por las respuestas al terminar la traza
+#define REPLAY_MAX_BATCH 64    // Eventos disparados por vuelta sin esperas (--speed max)
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct {
+    ChatClient* client;      // NULL = sin abrir o ya cerrada
+    int dirty;               // Tiene comandos en el lote sin enviar
+} ReplayConn;
+
+typedef struct {
+    uint64_t sent;
+    uint64_t answered;
+    uint64_t lost;
+    uint64_t connect_errors;
+    uint64_t* latencies_us;
+    size_t latency_count;
+    size_t latency_cap;
+    double elapsed_s;
+} ReplayStats;
+
+// ============================================================================
+// Variables globales
+// ============================================================================
+
+static CaptureTrace trace;
+static double speed = 1.0;       // 0 = sin esperas
+static int epfd = -1;
+static ReplayConn** dirty = NULL; // Conexiones con lote pendiente en esta vuelta
+static size_t dirty_count = 0;
+static uint64_t outstanding = 0; // Respuestas esperadas en todas las conexiones
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void record_latency(ReplayStats* stats, uint64_t latency_ns) {
+    if (stats->latency_count == stats->latency_cap) {
+        size_t cap = stats->latency_cap ? stats->latency_cap * 2 : 4096;
+        uint64_t* latencies = realloc(stats->latencies_us, cap * sizeof(uint64_t));
+        if (!latencies) return;
+        stats->latencies_us = latencies;
+        stats->latency_cap = cap;
+    }
+    stats->latencies_us[stats->latency_count++] = latency_ns / 1000;
+}
+
+// libchatclient completó la respuesta más vieja de una conexión
+static void on_reply(ChatClient* client, const ChatReply* reply, void* user) {
+    ReplayStats* stats = user;
+    (void)client;
+    
+    record_latency(stats, reply->latency_ns);
+    outstanding--;
+    stats->answered++;
+}
+
+static const ChatClientCallbacks callbacks = { .on_reply = on_reply };
+
+static void drop_connection(ReplayConn* c, ReplayStats* stats) {
+    if (!c->client) return;
+    
+    size_t lost = chat_client_pending_replies(c->client);
+    stats->lost += lost;
+    outstanding -= lost;
+    
+    epoll_ctl(epfd, EPOLL_CTL_DEL, chat_client_fd(c->client), NULL);
+    chat_client_close(c->client);
+    c->client = NULL;
+}
+
+// Intenta vaciar el lote; con el socket lleno espera EPOLLOUT
+static void flush_out(ReplayConn* c, ReplayStats* stats) {
+    ssize_t left = chat_client_flush(c->client);
+    if (left < 0) {
+        drop_connection(c, stats);
+        return;
+    }
+    
+    struct epoll_event ev = { .events = EPOLLIN | (left ? EPOLLOUT : 0), .data.ptr = c };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, chat_client_fd(c->client), &ev);
+}
+
+static void handle_readable(ReplayConn* c, ReplayStats* stats) {
+    if (chat_client_process(c->client) < 0) drop_connection(c, stats);
+}
+
+static int open_connection(ReplayConn* c, const char* host, int port, ReplayStats* stats) {
+    ChatClient* client = chat_client_connect(host, port, &callbacks, stats);
+    if (!client) return -1;
+    chat_client_set_nonblocking(client);
+    
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, chat_client_fd(client), &ev) < 0) {
+        chat_client_close(client);
+        return -1;
+    }
+    
+    c->client = client;
+    return 0;
+}
+
+static void fire_event(ReplayConn* conns, const CaptureEvent* e, const char* host, int port,
+                       ReplayStats* stats) {
+    ReplayConn* c = &conns[e->conn_id];
+    
+    switch (e->type) {
+        case CAPTURE_OPEN:
+            if (open_connection(c, host, port, stats) < 0) stats->connect_errors++;
+            break;
+        
+        case CAPTURE_LINE: {
+            if (!c->client) break;  // No se pudo conectar o el servidor la cerró
+            size_t before = chat_client_pending_replies(c->client);
+            if (chat_client_queue(c->client, e->line, e->len) < 0) break;
+            outstanding += chat_client_pending_replies(c->client) - before;
+            stats->sent++;
+            // Se envía al terminar la vuelta: las líneas que vencen juntas
+            // salen en un solo send()
+            if (!c->dirty) {
+                c->dirty = 1;
+                dirty[dirty_count++] = c;
+            }
+            break;
+        }
+        
+        case CAPTURE_CLOSE:
+            if (!c->client) break;
+            // Cerrar solo la escritura: las respuestas pendientes siguen llegando
+            chat_client_shutdown(c->client);
+            flush_out(c, stats);
+            break;
+    }
+}
+
+// ============================================================================
+// Reproducción
+// ============================================================================
+
+static int run_replay(const char* target, ReplayStats* stats) {
+    char host[256];
+    const char* colon = strrchr(target, ':');
+    if (!colon || colon == target || (size_t)(colon - target) >= sizeof(host)) return -1;
+    memcpy(host, target, colon - target);
+    host[colon - target] = '\0';
+    int port = atoi(colon + 1);
+    if (port <= 0) return -1;
+    
+    ReplayConn* conns = calloc((size_t)trace.max_conn_id + 1, sizeof(ReplayConn));
+    dirty = calloc((size_t)trace.max_conn_id + 1, sizeof(ReplayConn*));
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!conns || !dirty || epfd < 0) {
+        free(conns);
+        free(dirty);
+        return -1;
+    }
+    dirty_count = 0;
+    
+    memset(stats, 0, sizeof(*stats));
+    outstanding = 0;
+    
+    struct epoll_event events[REPLAY_MAX_EVENTS];
+    uint64_t start = now_ns();
+    uint64_t drain_deadline = 0;
+    size_t next = 0;
+    
+    for (;;) {
+        uint64_t now = now_ns();
+        
+        // Disparar los eventos que ya vencieron (en tiempo escalado)
+        int fired = 0;
+        while (next < trace.count) {
+            const CaptureEvent* e = &trace.events[next];
+            uint64_t due = speed > 0 ? start + (uint64_t)((double)e->time_us * 1000.0 / speed) : 0;
+            if (due > now || (speed == 0 && fired >= REPLAY_MAX_BATCH)) break;
+            fire_event(conns, e, host, port, stats);
+            next++;
+            fired++;
+        }
+        for (size_t i = 0; i < dirty_count; i++) {
+            dirty[i]->dirty = 0;
+            if (dirty[i]->client) flush_out(dirty[i], stats);
+        }
+        dirty_count = 0;
+        
+        int timeout;
+        if (next < trace.count) {
+            if (speed == 0) {
+                timeout = 0;
+            } else {
+                uint64_t due = start + (uint64_t)((double)trace.events[next].time_us * 1000.0 / speed);
+                timeout = due > now ? (int)((due - now + 999999) / 1000000) : 0;
+            }
+        } else {
+            if (!drain_deadline) drain_deadline = now + (uint64_t)REPLAY_DRAIN_MS * 1000000;
+            if (outstanding == 0 || now >= drain_deadline) break;
+            timeout = (int)((drain_deadline - now) / 1000000) + 1;
+        }
+        
+        int n = epoll_wait(epfd, events, REPLAY_MAX_EVENTS, timeout);
+        for (int i = 0; i < n; i++) {
+            ReplayConn* c = events[i].data.ptr;
+            if (!c->client) continue;
+            if (events[i].events & EPOLLOUT) flush_out(c, stats);
+            if (c->client && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                handle_readable(c, stats);
+            }
+        }
+    }
+    
+    stats->elapsed_s = (double)(now_ns() - start) / 1e9;
+    
+    for (uint32_t i = 0; i <= trace.max_conn_id; i++) {
+        drop_connection(&conns[i], stats);
+    }
+    free(conns);
+    free(dirty);
+    close(epfd);
+    return 0;
+}
+
+// ============================================================================
+// Reporte
+// ============================================================================
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const ReplayStats* stats, double p) {
+    if (stats->latency_count == 0) return 0;
+    size_t idx = (size_t)(p * (double)(stats->latency_count - 1));
+    return (double)stats->latencies_us[idx];
+}
+
+typedef struct {
+    const char* name;
+    double value[2];
+} ReportRow;
+
+static void print_report(const char* targets[], ReplayStats stats[], int runs) {
+    ReportRow rows[10];
+    int count = 0;
+    
+    for (int r = 0; r < runs; r++) {
+        ReplayStats* s = &stats[r];
+        qsort(s->latencies_us, s->latency_count, sizeof(uint64_t), compare_u64);
+        
+        int i = 0;
+        rows[i].name = "comandos enviados";      rows[i++].value[r] = (double)s->sent;
+        rows[i].name = "respuestas";             rows[i++].value[r] = (double)s->answered;
+        rows[i].name = "sin respuesta";          rows[i++].value[r] = (double)s->lost;
+        rows[i].name = "errores de conexión";    rows[i++].value[r] = (double)s->connect_errors;
+        rows[i].name = "duración (s)";           rows[i++].value[r] = s->elapsed_s;
+        rows[i].name = "comandos/s";             rows[i++].value[r] = s->elapsed_s > 0 ? (double)s->sent / s->elapsed_s : 0;
+        rows[i].name = "latencia p50 (µs)";      rows[i++].value[r] = percentile(s, 0.50);
+        rows[i].name = "latencia p90 (µs)";      rows[i++].value[r] = percentile(s, 0.90);
+        rows[i].name = "latencia p99 (µs)";      rows[i++].value[r] = percentile(s, 0.99);
+        rows[i].name = "latencia máx (µs)";      rows[i++].value[r] = percentile(s, 1.0);
+        count = i;
+    }
+    
+    printf("\n  %-24s %16s", "", targets[0]);
+    if (runs > 1) printf(" %16s %10s", targets[1], "dif.");
+    printf("\n");
+    
+    for (int i = 0; i < count; i++) {
+        printf("  %-24s %16.1f", rows[i].name, rows[i].value[0]);
+        if (runs > 1) {
+            printf(" %16.1f", rows[i].value[1]);
+            if (rows[i].value[0] != 0) {
+                printf(" %+9.1f%%", (rows[i].value[1] - rows[i].value[0]) * 100.0 / rows[i].value[0]);
+            } else {
+                printf(" %10s", "-");
+            }
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+// ============================================================================
+// Función principal
+// ============================================================================
+
+static void usage(const char* prog) {
+    printf("Uso: %s <traza> <host:puerto> [host:puerto] [--speed 1|10|max]\n", prog);
+    printf("Ejemplo: %s traza.bin 127.0.0.1:5000 127.0.0.1:5001 --speed 10\n", prog);
+    printf("\nCon dos servidores corre la traza contra cada uno (en orden) y compara.\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = NULL;
+    const char* targets[2];
+    int runs = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            i++;
+            speed = strcmp(argv[i], "max") == 0 ? 0 : atof(argv[i]);
+            if (speed < 0) speed = 1;
+        } else if (!path) {
+            path = argv[i];
+        } else if (runs < 2) {
+            targets[runs++] = argv[i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!path || runs == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    if (capture_load(path, &trace) < 0) {
+        fprintf(stderr, "Error: No se pudo leer la traza %s\n", path);
+        return EXIT_FAILURE;
+    }
+    
+    // Una conexión de la traza = un socket: subir el límite de fds
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    
+    double duration = trace.count ? (double)trace.events[trace.count - 1].time_us / 1e6 : 0;
+    printf("Traza %s: %zu eventos, %u conexiones, %.1f s grabados\n",
+           path, trace.count, trace.max_conn_id, duration);
+    if (speed > 0) printf("Velocidad: %gx\n", speed);
+    else printf("Velocidad: sin esperas\n");
+    
+    ReplayStats stats[2];
+    for (int r = 0; r < runs; r++) {
+        printf("Reproduciendo contra %s...\n", targets[r]);
+        if (run_replay(targets[r], &stats[r]) < 0) {
+            fprintf(stderr, "Error: No se pudo usar el servidor %s\n", targets[r]);
+            capture_free(&trace);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    print_report(targets, stats, runs);
+    
+    for (int r = 0; r < runs; r++) free(stats[r].latencies_us);
+    capture_free(&trace);
+    return EXIT_SUCCESS;
+}
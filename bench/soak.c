@@ -0,0 +1,627 @@
+// ============================================================================
+// soak.c - Prueba de resistencia: miles de conexiones inactivas y unas pocas activas
+// ============================================================================
+// Abre --conns conexiones que solo mandan su nick ("s<n>") y se quedan
+// quietas, repartidas entre varias direcciones de origen 127.0.0.x (cada
+// dirección tiene su propio rango de puertos efímeros, así se pasa de los
+// ~28000 de una sola), y --active clientes de libchatclient ("a<n>") que
+// se mandan /msg con la hora de envío adentro. Mantiene todo abierto
+// --duration segundos y cada --interval segundos imprime:
+//   - conexiones establecidas y la latencia de aceptación (del connect() a
+//     la bienvenida: incluye la cola de listen y el registro del nick),
+//   - mensajes por segundo y la latencia de punta a punta de los /msg,
+//   - RSS y CPU del servidor (con --pid, leídos de /proc).
+// Sale con error si el servidor cortó conexiones o no llegó ningún mensaje.
+//
+// Compilar: make soak (compila también un servidor con MAX_CLIENTS a medida)
+// Ejecutar: ./bench/soak 127.0.0.1:5000 [--conns 100000] [--active 10] [--duration 60] [--pid PID]
+// ============================================================================
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "../Cliente/chatclient.h"
+#include "../Servidor/reply.h"
+
+#define SOAK_MAX_EVENTS 1024
+#define SOAK_TICK_MS 10              // Cada cuánto se reparten los /msg que vencieron
+#define SOAK_HANDSHAKE_TIMEOUT_MS 30000  // Una conexión sin bienvenida en este plazo cuenta como error
+#define SOAK_DEFAULT_SOURCES 4
+#define SOAK_DEFAULT_INFLIGHT 512    // Conexiones abiertas a la vez sin bienvenida
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+// Estado de una conexión inactiva (16 bytes: hay cien mil)
+typedef enum {
+    IDLE_PENDING,        // Todavía no se abrió
+    IDLE_CONNECTING,     // connect() en curso
+    IDLE_WELCOME,        // Nick enviado, esperando la bienvenida
+    IDLE_OPEN,           // Establecida y quieta
+    IDLE_DONE            // Rechazada, fallida o cortada
+} IdleState;
+
+typedef struct {
+    int fd;
+    uint32_t state;
+    uint64_t started_ns;
+} IdleConn;
+
+typedef struct {
+    ChatClient* client;      // NULL = cortada
+    int ready;               // El servidor ya respondió al nick
+} ActiveConn;
+
+// Latencias en µs; las de un intervalo son el tramo [mark, count)
+typedef struct {
+    uint64_t* values;
+    size_t count;
+    size_t cap;
+    size_t mark;
+} Samples;
+
+typedef struct {
+    uint64_t established;
+    uint64_t rejected;       // "Servidor lleno"
+    uint64_t errors;         // connect() falló o no llegó la bienvenida
+    uint64_t closed;         // El servidor cortó una conexión establecida
+    uint64_t msgs_sent;
+    uint64_t msgs_received;
+    uint64_t msgs_mark;      // msgs_received al empezar el intervalo
+    Samples accept_us;
+    Samples msg_us;
+} SoakStats;
+
+// Muestra de /proc/<pid> del servidor
+typedef struct {
+    long rss_kb;
+    uint64_t cpu_ticks;      // utime + stime
+    uint64_t at_ns;
+} ProcSample;
+
+// ============================================================================
+// Variables globales
+// ============================================================================
+
+static struct sockaddr_in target;
+static char target_host[256];
+static int target_port;
+static int conn_count = 100000;
+static int active_count = 10;
+static double rate = 10.0;           // /msg por segundo de cada cliente activo
+static int duration_s = 60;
+static int interval_s = 5;
+static int source_count = SOAK_DEFAULT_SOURCES;
+static int inflight_max = SOAK_DEFAULT_INFLIGHT;
+static pid_t server_pid = 0;
+
+static int epfd = -1;
+static IdleConn* idle = NULL;
+static ActiveConn* active = NULL;
+static int active_ready = 0;
+static int inflight = 0;             // Inactivas abiertas sin bienvenida todavía
+static SoakStats stats;
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void record(Samples* s, uint64_t value_us) {
+    if (s->count == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 4096;
+        uint64_t* values = realloc(s->values, cap * sizeof(uint64_t));
+        if (!values) return;
+        s->values = values;
+        s->cap = cap;
+    }
+    s->values[s->count++] = value_us;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Ordena values[from, count) y retorna el percentil p de ese tramo
+static double percentile(Samples* s, size_t from, double p) {
+    if (s->count <= from) return 0;
+    size_t n = s->count - from;
+    qsort(s->values + from, n, sizeof(uint64_t), compare_u64);
+    return (double)s->values[from + (size_t)(p * (double)(n - 1))];
+}
+
+static int read_proc(pid_t pid, ProcSample* out) {
+    char path[64];
+    char buf[1024];
+    
+    out->at_ns = now_ns();
+    out->rss_kb = -1;
+    out->cpu_ticks = 0;
+    
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    while (fgets(buf, sizeof(buf), f)) {
+        if (sscanf(buf, "VmRSS: %ld kB", &out->rss_kb) == 1) break;
+    }
+    fclose(f);
+    
+    // Campos 14 y 15 de stat; el nombre entre paréntesis puede tener espacios
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    f = fopen(path, "r");
+    if (!f) return -1;
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[len] = '\0';
+    char* p = strrchr(buf, ')');
+    unsigned long long utime, stime;
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+                     &utime, &stime) != 2) {
+        return -1;
+    }
+    out->cpu_ticks = utime + stime;
+    return 0;
+}
+
+// ============================================================================
+// Conexiones inactivas
+// ============================================================================
+
+static void idle_finish(int i, uint64_t* counter) {
+    IdleConn* c = &idle[i];
+    if (c->state == IDLE_CONNECTING || c->state == IDLE_WELCOME) inflight--;
+    if (c->fd >= 0) close(c->fd);  // close() también lo saca de epoll
+    c->fd = -1;
+    c->state = IDLE_DONE;
+    (*counter)++;
+}
+
+// Abre la conexión i desde 127.0.0.(1 + i % sources) sin esperar al connect()
+static int idle_open(int i) {
+    IdleConn* c = &idle[i];
+    c->started_ns = now_ns();
+    
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    
+    if (source_count > 1) {
+        // El puerto se elige en connect(), por destino: sin esto bind() agota
+        // los puertos efímeros igual que si hubiera una sola dirección
+        int one = 1;
+        setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+        struct sockaddr_in src = { .sin_family = AF_INET };
+        src.sin_addr.s_addr = htonl(INADDR_LOOPBACK + (uint32_t)(i % source_count));
+        if (bind(fd, (struct sockaddr*)&src, sizeof(src)) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    
+    if (connect(fd, (struct sockaddr*)&target, sizeof(target)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    
+    struct epoll_event ev = { .events = EPOLLOUT, .data.u64 = (uint64_t)i };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd);
+        return -1;
+    }
+    c->fd = fd;
+    c->state = IDLE_CONNECTING;
+    inflight++;
+    return 0;
+}
+
+static void idle_event(int i, uint32_t events) {
+    IdleConn* c = &idle[i];
+    
+    if (c->state == IDLE_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        char nick[32];
+        int nick_len = snprintf(nick, sizeof(nick), "s%d\n", i);
+        if (err || send(c->fd, nick, (size_t)nick_len, MSG_NOSIGNAL) != nick_len) {
+            idle_finish(i, &stats.errors);
+            return;
+        }
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.u64 = (uint64_t)i };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->state = IDLE_WELCOME;
+        return;
+    }
+    
+    char buf[512];
+    ssize_t n = recv(c->fd, buf, sizeof(buf) - 1, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR) && !(events & (EPOLLHUP | EPOLLERR))) return;
+    
+    if (c->state == IDLE_WELCOME) {
+        if (n <= 0) {
+            idle_finish(i, &stats.errors);
+            return;
+        }
+        buf[n] = '\0';
+        if (strncmp(buf, REPLY_SERVER_FULL, REPLY_LEN(REPLY_SERVER_FULL)) == 0) {
+            idle_finish(i, &stats.rejected);
+            return;
+        }
+        record(&stats.accept_us, (now_ns() - c->started_ns) / 1000);
+        c->state = IDLE_OPEN;
+        inflight--;
+        stats.established++;
+        return;
+    }
+    
+    // Establecida: lo que llegue se descarta (PING, avisos); el cierre se cuenta
+    if (n <= 0 || (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        stats.established--;
+        idle_finish(i, &stats.closed);
+    }
+}
+
+// ============================================================================
+// Clientes activos
+// ============================================================================
+
+// Cada /msg lleva la hora de envío: la latencia se mide al recibirlo
+static void on_private(ChatClient* client, const char* from, const char* text, void* user) {
+    (void)client;
+    (void)from;
+    (void)user;
+    
+    uint64_t sent = strtoull(text, NULL, 10);
+    uint64_t now = now_ns();
+    if (sent == 0 || sent > now) return;
+    record(&stats.msg_us, (now - sent) / 1000);
+    stats.msgs_received++;
+}
+
+static void on_reply(ChatClient* client, const ChatReply* reply, void* user) {
+    ActiveConn* a = user;
+    (void)client;
+    
+    if (reply->command != CHAT_CMD_NICK || a->ready) return;
+    if (reply->error) {
+        stats.rejected++;
+        return;
+    }
+    a->ready = 1;
+    active_ready++;
+}
+
+static const ChatClientCallbacks callbacks = {
+    .on_private = on_private,
+    .on_reply = on_reply
+};
+
+static void active_drop(int i) {
+    ActiveConn* a = &active[i];
+    if (!a->client) return;
+    
+    if (a->ready) active_ready--;
+    chat_client_close(a->client);
+    a->client = NULL;
+    stats.closed++;
+}
+
+static int active_open(int i) {
+    ActiveConn* a = &active[i];
+    ChatClient* client = chat_client_connect(target_host, target_port, &callbacks, a);
+    if (!client) return -1;
+    chat_client_set_nonblocking(client);
+    
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = (uint64_t)(conn_count + i) };
+    char nick[32];
+    snprintf(nick, sizeof(nick), "a%d", i);
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, chat_client_fd(client), &ev) < 0 ||
+        chat_client_send(client, nick) < 0) {
+        chat_client_close(client);
+        return -1;
+    }
+    a->client = client;
+    return 0;
+}
+
+// Encola un /msg para el siguiente cliente activo (en ronda)
+static void active_send(int i) {
+    ActiveConn* a = &active[i];
+    if (!a->client || !a->ready) return;
+    
+    char line[96];
+    int len = snprintf(line, sizeof(line), "/msg a%d %llu", (i + 1) % active_count,
+                       (unsigned long long)now_ns());
+    if (chat_client_queue(a->client, line, (size_t)len) < 0) {
+        active_drop(i);
+        return;
+    }
+    stats.msgs_sent++;
+}
+
+static void active_flush(int i) {
+    ActiveConn* a = &active[i];
+    if (!a->client) return;
+    
+    ssize_t left = chat_client_flush(a->client);
+    if (left < 0) {
+        active_drop(i);
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLIN | (left ? EPOLLOUT : 0), .data.u64 = (uint64_t)(conn_count + i) };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, chat_client_fd(a->client), &ev);
+}
+
+static void active_event(int i, uint32_t events) {
+    ActiveConn* a = &active[i];
+    if (!a->client) return;
+    
+    if (events & EPOLLOUT) active_flush(i);
+    if (a->client && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        if (chat_client_process(a->client) < 0) active_drop(i);
+    }
+}
+
+// ============================================================================
+// Reporte
+// ============================================================================
+
+static void print_header(void) {
+    printf("\n%7s %8s %9s %9s %8s %9s %9s %9s %6s\n",
+           "t (s)", "abiertas", "acep p50", "acep p99", "msgs/s", "msg p50", "msg p99", "RSS (MB)", "CPU %");
+    printf("%7s %8s %9s %9s %8s %9s %9s %9s %6s\n",
+           "", "", "(ms)", "(ms)", "", "(µs)", "(µs)", "", "");
+}
+
+static void print_interval(double t, double span_s, ProcSample* prev, long* rss_peak) {
+    double acc50 = percentile(&stats.accept_us, stats.accept_us.mark, 0.50) / 1000.0;
+    double acc99 = percentile(&stats.accept_us, stats.accept_us.mark, 0.99) / 1000.0;
+    double msg50 = percentile(&stats.msg_us, stats.msg_us.mark, 0.50);
+    double msg99 = percentile(&stats.msg_us, stats.msg_us.mark, 0.99);
+    double msgs = span_s > 0 ? (double)(stats.msgs_received - stats.msgs_mark) / span_s : 0;
+    
+    printf("%7.1f %8llu %9.2f %9.2f %8.0f %9.0f %9.0f",
+           t, (unsigned long long)stats.established, acc50, acc99, msgs, msg50, msg99);
+    
+    ProcSample now;
+    if (server_pid > 0 && read_proc(server_pid, &now) == 0) {
+        double wall_s = (double)(now.at_ns - prev->at_ns) / 1e9;
+        double cpu = wall_s > 0 ? (double)(now.cpu_ticks - prev->cpu_ticks) / (double)sysconf(_SC_CLK_TCK) / wall_s * 100.0 : 0;
+        printf(" %9.1f %6.1f\n", (double)now.rss_kb / 1024.0, cpu);
+        if (now.rss_kb > *rss_peak) *rss_peak = now.rss_kb;
+        *prev = now;
+    } else {
+        printf(" %9s %6s\n", "-", "-");
+    }
+    fflush(stdout);
+    
+    stats.accept_us.mark = stats.accept_us.count;
+    stats.msg_us.mark = stats.msg_us.count;
+    stats.msgs_mark = stats.msgs_received;
+}
+
+static void print_summary(double ramp_s, double hold_s, long rss_start, long rss_peak, long rss_end) {
+    printf("\n  %-32s %12d\n", "conexiones pedidas", conn_count + active_count);
+    printf("  %-32s %12llu\n", "establecidas al final", (unsigned long long)(stats.established + (uint64_t)active_ready));
+    printf("  %-32s %12llu\n", "rechazadas (servidor lleno)", (unsigned long long)stats.rejected);
+    printf("  %-32s %12llu\n", "errores de conexión", (unsigned long long)stats.errors);
+    printf("  %-32s %12llu\n", "cortadas por el servidor", (unsigned long long)stats.closed);
+    printf("  %-32s %12.1f\n", "rampa (s)", ramp_s);
+    printf("  %-32s %12.1f\n", "espera (s)", hold_s);
+    printf("  %-32s %12.2f\n", "aceptación p50 (ms)", percentile(&stats.accept_us, 0, 0.50) / 1000.0);
+    printf("  %-32s %12.2f\n", "aceptación p99 (ms)", percentile(&stats.accept_us, 0, 0.99) / 1000.0);
+    printf("  %-32s %12.2f\n", "aceptación máx (ms)", percentile(&stats.accept_us, 0, 1.0) / 1000.0);
+    printf("  %-32s %12llu\n", "mensajes enviados", (unsigned long long)stats.msgs_sent);
+    printf("  %-32s %12llu\n", "mensajes recibidos", (unsigned long long)stats.msgs_received);
+    printf("  %-32s %12.0f\n", "mensaje p50 (µs)", percentile(&stats.msg_us, 0, 0.50));
+    printf("  %-32s %12.0f\n", "mensaje p99 (µs)", percentile(&stats.msg_us, 0, 0.99));
+    printf("  %-32s %12.0f\n", "mensaje máx (µs)", percentile(&stats.msg_us, 0, 1.0));
+    if (rss_end >= 0) {
+        uint64_t open = stats.established + (uint64_t)active_ready;
+        printf("  %-32s %12.1f\n", "RSS máximo (MB)", (double)rss_peak / 1024.0);
+        if (open > 0 && rss_start >= 0) {
+            printf("  %-32s %12.0f\n", "RSS por conexión (bytes)", (double)(rss_end - rss_start) * 1024.0 / (double)open);
+        }
+    }
+    printf("\n");
+}
+
+// ============================================================================
+// Función principal
+// ============================================================================
+
+static void usage(const char* prog) {
+    printf("Uso: %s <host:puerto> [opciones]\n", prog);
+    printf("Ejemplo: %s 127.0.0.1:5000 --conns 100000 --duration 300 --pid $(pgrep servidor)\n", prog);
+    printf("\nOpciones:\n");
+    printf("  --conns <n>       Conexiones inactivas (por defecto: %d)\n", conn_count);
+    printf("  --active <n>      Clientes que se mandan /msg (por defecto: %d)\n", active_count);
+    printf("  --rate <n>        /msg por segundo de cada cliente activo (por defecto: %g)\n", rate);
+    printf("  --duration <s>    Segundos con todo abierto tras la rampa (por defecto: %d)\n", duration_s);
+    printf("  --interval <s>    Cada cuánto se imprime una fila (por defecto: %d)\n", interval_s);
+    printf("  --sources <n>     Direcciones de origen 127.0.0.1..n (por defecto: %d)\n", source_count);
+    printf("  --inflight <n>    Conexiones esperando la bienvenida a la vez (por defecto: %d)\n", inflight_max);
+    printf("  --pid <pid>       Servidor del que se leen RSS y CPU en /proc\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* target_arg = NULL;
+    
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--conns") == 0) conn_count = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--active") == 0) active_count = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--rate") == 0) rate = atof(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--duration") == 0) duration_s = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--interval") == 0) interval_s = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--sources") == 0) source_count = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--inflight") == 0) inflight_max = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--pid") == 0) server_pid = (pid_t)atoi(argv[++i]);
+        else if (!target_arg && argv[i][0] != '-') target_arg = argv[i];
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    const char* colon = target_arg ? strrchr(target_arg, ':') : NULL;
+    if (!colon || colon == target_arg || (size_t)(colon - target_arg) >= sizeof(target_host) ||
+        conn_count < 0 || active_count < 0 || rate < 0 || duration_s < 0 ||
+        interval_s <= 0 || source_count <= 0 || inflight_max <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    memcpy(target_host, target_arg, colon - target_arg);
+    target_host[colon - target_arg] = '\0';
+    target_port = atoi(colon + 1);
+    target.sin_family = AF_INET;
+    target.sin_port = htons((uint16_t)target_port);
+    if (target_port <= 0 || inet_pton(AF_INET, target_host, &target.sin_addr) != 1) {
+        fprintf(stderr, "Error: %s no es una dirección IPv4 con puerto\n", target_arg);
+        return EXIT_FAILURE;
+    }
+    if ((ntohl(target.sin_addr.s_addr) >> 24) != 127) source_count = 1;  // Solo en loopback
+    
+    // Un socket por conexión: subir el límite de fds
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        getrlimit(RLIMIT_NOFILE, &rl);
+        if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < (rlim_t)conn_count + (rlim_t)active_count + 16) {
+            fprintf(stderr, "Error: el límite de descriptores (%llu) no alcanza para %d conexiones "
+                    "(subir el límite duro con ulimit -Hn)\n",
+                    (unsigned long long)rl.rlim_cur, conn_count + active_count);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    idle = calloc((size_t)conn_count + 1, sizeof(IdleConn));
+    active = calloc((size_t)active_count + 1, sizeof(ActiveConn));
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!idle || !active || epfd < 0) {
+        fprintf(stderr, "Error: sin memoria para %d conexiones\n", conn_count);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < conn_count; i++) idle[i].fd = -1;
+    
+    ProcSample prev = { .rss_kb = -1 };
+    long rss_start = -1;
+    long rss_peak = -1;
+    if (server_pid > 0 && read_proc(server_pid, &prev) == 0) rss_start = rss_peak = prev.rss_kb;
+    
+    printf("Soak contra %s: %d inactivas desde %d direcciones, %d activas a %g /msg/s, %d s\n",
+           target_arg, conn_count, source_count, active_count, rate, duration_s);
+    
+    // Los activos primero: la latencia de los mensajes se mide también en la rampa
+    for (int i = 0; i < active_count; i++) {
+        if (active_open(i) < 0) stats.errors++;
+    }
+    print_header();
+    
+    struct epoll_event events[SOAK_MAX_EVENTS];
+    uint64_t start = now_ns();
+    uint64_t last_report = start;
+    uint64_t hold_start = 0;
+    uint64_t msgs_start = 0;          // Cuándo estuvieron listos todos los activos
+    uint64_t msgs_due = 0;
+    int next_idle = 0;
+    int scan = 0;                     // Próxima conexión a revisar por plazo vencido
+    
+    for (;;) {
+        uint64_t now = now_ns();
+        
+        // Rampa: abrir hasta --inflight sin bienvenida
+        while (next_idle < conn_count && inflight < inflight_max) {
+            if (idle_open(next_idle) < 0) idle_finish(next_idle, &stats.errors);
+            next_idle++;
+        }
+        
+        // Las que no recibieron bienvenida en el plazo cuentan como error
+        for (int k = 0; k < 256 && scan < next_idle; k++, scan++) {
+            IdleConn* c = &idle[scan];
+            if (c->state == IDLE_CONNECTING || c->state == IDLE_WELCOME) {
+                if (now < c->started_ns + (uint64_t)SOAK_HANDSHAKE_TIMEOUT_MS * 1000000) break;
+                idle_finish(scan, &stats.errors);
+            }
+        }
+        
+        if (!hold_start && next_idle == conn_count && inflight == 0) {
+            hold_start = now;
+            printf("-- rampa completa en %.1f s: %llu establecidas, %llu rechazadas, %llu errores\n",
+                   (double)(now - start) / 1e9, (unsigned long long)stats.established,
+                   (unsigned long long)stats.rejected, (unsigned long long)stats.errors);
+        }
+        if (hold_start && now - hold_start >= (uint64_t)duration_s * 1000000000ull) break;
+        
+        // /msg en ronda al ritmo pedido, desde que todos los activos tienen nick
+        if (!msgs_start && active_count > 0 && active_ready == active_count) msgs_start = now;
+        if (msgs_start) {
+            uint64_t target_total = (uint64_t)((double)(now - msgs_start) / 1e9 * rate * active_count);
+            while (msgs_due < target_total) {
+                active_send((int)(msgs_due % (uint64_t)active_count));
+                msgs_due++;
+            }
+            for (int i = 0; i < active_count; i++) active_flush(i);
+        }
+        
+        if (now - last_report >= (uint64_t)interval_s * 1000000000ull) {
+            print_interval((double)(now - start) / 1e9, (double)(now - last_report) / 1e9, &prev, &rss_peak);
+            last_report = now;
+        }
+        
+        int n = epoll_wait(epfd, events, SOAK_MAX_EVENTS, SOAK_TICK_MS);
+        for (int e = 0; e < n; e++) {
+            int id = (int)events[e].data.u64;
+            if (id >= conn_count) {
+                active_event(id - conn_count, events[e].events);
+                continue;
+            }
+            if (idle[id].state != IDLE_DONE) idle_event(id, events[e].events);
+        }
+    }
+    
+    uint64_t end = now_ns();
+    ProcSample last = { .rss_kb = -1 };
+    if (server_pid > 0) read_proc(server_pid, &last);
+    if (last.rss_kb > rss_peak) rss_peak = last.rss_kb;
+    
+    print_summary((double)(hold_start - start) / 1e9, (double)(end - hold_start) / 1e9,
+                  rss_start, rss_peak, last.rss_kb);
+    
+    int failed = stats.closed > 0 || (active_count > 0 && stats.msgs_received == 0);
+    
+    for (int i = 0; i < conn_count; i++) {
+        if (idle[i].fd >= 0) close(idle[i].fd);
+    }
+    for (int i = 0; i < active_count; i++) {
+        if (active[i].client) chat_client_close(active[i].client);
+    }
+    free(idle);
+    free(active);
+    free(stats.accept_us.values);
+    free(stats.msg_us.values);
+    close(epfd);
+    
+    if (failed) {
+        fprintf(stderr, "Error: el servidor cortó conexiones o no entregó mensajes\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -15,6 +15,17 @@
 #define CMD_BROADCAST "/broadcast" // Enviar mensaje a todos: /broadcast <mensaje>
 #define CMD_QUIT "/quit"           // Desconectarse
 #define CMD_HELP "/help"           // Mostrar ayuda
+#define CMD_PONG "/pong"           // Respuesta a un PING del servidor
+#define CMD_HISTORY "/history"     // Mensajes anteriores: /history [n|HH:MM|30m|2h|1d]
+#define CMD_WATCH "/watch"         // Recibir avisos de entradas y salidas
+#define CMD_UNWATCH "/unwatch"     // Dejar de recibirlos
+#define CMD_SESSION "/session"     // Pedir un token para retomar la sesión si se corta
+#define CMD_RESUME "/resume"       // Primera línea al reconectar: /resume <token> <última secuencia>
+#define CMD_SEND "/send"           // Ofrecer un archivo: /send <nick> <bytes> [nombre]
+#define CMD_ACCEPT "/accept"       // Aceptar una oferta: /accept <id>
+#define CMD_REJECT "/reject"       // Rechazar una oferta (o cancelar la propia): /reject <id>
+#define CMD_XFER "/xfer"           // Primera línea de una conexión de datos: /xfer <token>
+#define CMD_SEARCH "/search"       // Buscar en el historial: /search <palabras> [from:nick] [since:30m]
 
 // Prefijos de respuesta del servidor
 #define RESP_LIST_START "LIST_START"
@@ -22,15 +33,35 @@
 #define RESP_LIST_END "LIST_END"
 #define RESP_ERROR "ERROR:"
 #define RESP_INFO "INFO:"
+#define RESP_HELP_END "HELP_END"        // Fin de la ayuda de /help
 #define RESP_MSG_FROM "MSG_FROM:"       // Mensaje privado de otro usuario
 #define RESP_BROADCAST "BROADCAST_FROM:" // Mensaje broadcast de otro usuario
+#define RESP_PING "PING"                // Sondeo de vida: el cliente responde /pong
+#define RESP_HISTORY_START "HISTORY_START" // Inicio de historial: HISTORY_START <cantidad>
+#define RESP_HISTORY "HISTORY:"         // Mensaje del historial
+#define RESP_HISTORY_END "HISTORY_END"
+#define RESP_SEARCH_START "SEARCH_START" // Resultados de /search: SEARCH_START <mostrados> <encontrados>
+#define RESP_SEARCH "SEARCH:"           // Un mensaje encontrado (como los de HISTORY:)
+#define RESP_SEARCH_END "SEARCH_END"
+#define RESP_PRESENCE "PRESENCE:"       // Entradas y salidas: PRESENCE: +nick -nick@nodo ...
+#define RESP_SESSION "SESSION:"         // Token de /session: SESSION: <token>
+#define RESP_FILE_OFFER "FILE_OFFER:"   // Oferta recibida: FILE_OFFER: <id> <nick> <bytes> [nombre]
+#define RESP_FILE_SEND "FILE_SEND:"     // Aceptaron la tuya: FILE_SEND: <id> <token> <bytes> [nombre]
+#define RESP_FILE_RECV "FILE_RECV:"     // Respuesta a /accept: FILE_RECV: <id> <token> <bytes> [nombre]
+#define RESP_FILE_END "FILE_END:"       // FILE_END: <id> completa|cortada|rechazada|vencida <bytes>
+#define RESP_FILE_START "FILE_START"    // Por la conexión de datos: FILE_START <bytes>, después los bytes
+
+// Con sesión, MSG_FROM, BROADCAST_FROM, PRESENCE y los FILE_ que llegan sin
+// pedirlos llevan su número de secuencia después del prefijo:
+// "MSG_FROM: #17 ana: hola"
+#define RESP_SEQ_MARK '#'
 
 // ============================================================================
 // Constantes del protocolo
 // ============================================================================
 
 #define MAX_NICK_LENGTH 32
-#define MAX_MSG_LENGTH 1024
+#define MAX_MSG_LENGTH 32768   // Texto de /msg o /broadcast (el servidor acepta la línea con el comando)
 
 #endif // PROTOCOL_H
 
@@ -0,0 +1,404 @@
+// ============================================================================
+// shm_channel.c - Implementación del transporte por memoria compartida
+// ============================================================================
+
+#define _GNU_SOURCE  // memfd_create()
+
+#include "shm_channel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#define CACHE_LINE 64
+#define SHM_EVENTFDS 4  // Datos y espacio de cada dirección
+
+// ============================================================================
+// Estructuras en memoria compartida
+// ============================================================================
+
+// Cabecera de un anillo: productor y consumidor en líneas de caché distintas
+struct ShmRing {
+    _Atomic uint64_t head;              // Solo la escribe el productor
+    char pad0[CACHE_LINE - sizeof(uint64_t)];
+    _Atomic uint64_t tail;              // Solo la escribe el consumidor
+    char pad1[CACHE_LINE - sizeof(uint64_t)];
+    _Atomic uint32_t reader_waiting;    // El consumidor duerme en el eventfd de datos
+    _Atomic uint32_t writer_waiting;    // El productor duerme en el eventfd de espacio
+    char pad2[CACHE_LINE - 2 * sizeof(uint32_t)];
+    char data[SHM_RING_SIZE];
+};
+
+// Mensaje de negociación que acompaña al memfd y los eventfd
+typedef struct {
+    uint32_t magic;
+    uint32_t ring_size;
+} ShmHello;
+
+// Orden de los fds en la negociación: memfd y después los eventfd
+enum { UP_DATA, UP_SPACE, DOWN_DATA, DOWN_SPACE };
+
+// ============================================================================
+// Funciones auxiliares
+// ============================================================================
+
+static void signal_efd(int efd) {
+    uint64_t one = 1;
+    if (write(efd, &one, sizeof(one)) < 0) {
+        // Contador saturado: el otro extremo igual se va a despertar
+    }
+}
+
+static void drain_efd(int efd) {
+    uint64_t value;
+    if (read(efd, &value, sizeof(value)) < 0) {
+        // Sin nada pendiente (eventfd no bloqueante)
+    }
+}
+
+// Asigna los anillos y eventfd según el rol. El servidor lee el anillo "up".
+static void bind_channel(ShmChannel *ch, const int efds[SHM_EVENTFDS], int is_server) {
+    ShmRing *up = (ShmRing *)ch->base;
+    ShmRing *down = up + 1;
+    
+    ch->rx = is_server ? up : down;
+    ch->tx = is_server ? down : up;
+    ch->rx_data_efd = efds[is_server ? UP_DATA : DOWN_DATA];
+    ch->rx_space_efd = efds[is_server ? UP_SPACE : DOWN_SPACE];
+    ch->tx_data_efd = efds[is_server ? DOWN_DATA : UP_DATA];
+    ch->tx_space_efd = efds[is_server ? DOWN_SPACE : UP_SPACE];
+    pthread_mutex_init(&ch->tx_mutex, NULL);
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// Espera un eventfd o que se cierre el socket del otro extremo
+static int wait_efd(ShmChannel *ch, int efd, int timeout_ms) {
+    struct pollfd pfds[2] = {
+        { .fd = efd, .events = POLLIN },
+        { .fd = ch->peer_fd, .events = POLLIN }
+    };
+    
+    int rc;
+    do {
+        rc = poll(pfds, 2, timeout_ms);
+    } while (rc < 0 && errno == EINTR);
+    
+    if (rc < 0 || (pfds[1].revents & (POLLIN | POLLHUP | POLLERR))) return -1;
+    if (rc == 0) return 0;
+    
+    drain_efd(efd);
+    return 1;
+}
+
+// ============================================================================
+// Implementación de funciones públicas
+// ============================================================================
+
+int shm_listen(const char *path) {
+    struct sockaddr_un addr;
+    
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    
+    int sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd < 0) return -1;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    
+    if (bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sockfd, 64) < 0) {
+        perror("socket local");
+        close(sockfd);
+        return -1;
+    }
+    
+    return sockfd;
+}
+
+int shm_channel_create(ShmChannel *ch, int peer_fd) {
+    int fds[1 + SHM_EVENTFDS];
+    int nfds = 0;
+    
+    memset(ch, 0, sizeof(*ch));
+    ch->peer_fd = peer_fd;
+    ch->map_size = 2 * sizeof(ShmRing);
+    
+    fds[nfds] = memfd_create("chat-shm", MFD_CLOEXEC);
+    if (fds[nfds] < 0) return -1;
+    nfds++;
+    
+    if (ftruncate(fds[0], (off_t)ch->map_size) < 0) goto fail;
+    
+    for (int i = 0; i < SHM_EVENTFDS; i++) {
+        fds[nfds] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (fds[nfds] < 0) goto fail;
+        nfds++;
+    }
+    
+    ch->base = mmap(NULL, ch->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    if (ch->base == MAP_FAILED) {
+        ch->base = NULL;
+        goto fail;
+    }
+    
+    // memfd nuevo: los anillos ya arrancan en cero. Los consumidores empiezan
+    // dormidos para que la primera escritura de cada lado los despierte.
+    ShmRing *rings = (ShmRing *)ch->base;
+    atomic_store(&rings[0].reader_waiting, 1);
+    atomic_store(&rings[1].reader_waiting, 1);
+    
+    ShmHello hello = { .magic = SHM_MAGIC, .ring_size = SHM_RING_SIZE };
+    struct iovec iov = { .iov_base = &hello, .iov_len = sizeof(hello) };
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct msghdr msg;
+    
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    
+    if (sendmsg(peer_fd, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(hello)) goto fail;
+    
+    // El memfd ya no hace falta: el mapeo lo mantiene vivo
+    close(fds[0]);
+    bind_channel(ch, fds + 1, 1);
+    return 0;
+
+fail:
+    if (ch->base) munmap(ch->base, ch->map_size);
+    for (int i = 0; i < nfds; i++) close(fds[i]);
+    ch->base = NULL;
+    return -1;
+}
+
+int shm_channel_connect(ShmChannel *ch, const char *path) {
+    struct sockaddr_un addr;
+    int fds[1 + SHM_EVENTFDS];
+    ShmHello hello;
+    
+    memset(ch, 0, sizeof(*ch));
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    
+    int sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd < 0) return -1;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sockfd);
+        return -1;
+    }
+    
+    struct iovec iov = { .iov_base = &hello, .iov_len = sizeof(hello) };
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct msghdr msg;
+    
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    
+    ssize_t bytes = recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (bytes != sizeof(hello) || !cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        close(sockfd);
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    
+    // Un servidor compilado con otro tamaño de anillo no es compatible
+    if (hello.magic != SHM_MAGIC || hello.ring_size != SHM_RING_SIZE) {
+        for (int i = 0; i < 1 + SHM_EVENTFDS; i++) close(fds[i]);
+        close(sockfd);
+        return -1;
+    }
+    
+    ch->peer_fd = sockfd;
+    ch->map_size = 2 * sizeof(ShmRing);
+    ch->base = mmap(NULL, ch->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (ch->base == MAP_FAILED) {
+        for (int i = 1; i < 1 + SHM_EVENTFDS; i++) close(fds[i]);
+        close(sockfd);
+        ch->base = NULL;
+        return -1;
+    }
+    
+    bind_channel(ch, fds + 1, 0);
+    return 0;
+}
+
+ssize_t shm_channel_read(ShmChannel *ch, void *buf, size_t len) {
+    ShmRing *ring = ch->rx;
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t avail = head - tail;
+    
+    if (avail == 0) {
+        // Avisar que vamos a dormir y volver a mirar: si el productor publicó
+        // justo antes, lo vemos ahora; si publica después, ve el aviso
+        atomic_store(&ring->reader_waiting, 1);
+        head = atomic_load(&ring->head);
+        avail = head - tail;
+        if (avail == 0) return 0;
+        atomic_store_explicit(&ring->reader_waiting, 0, memory_order_relaxed);
+    }
+    
+    // El otro extremo no es confiable: índices imposibles cortan el canal
+    if (avail > SHM_RING_SIZE) return -1;
+    
+    size_t n = avail < len ? (size_t)avail : len;
+    size_t pos = (size_t)(tail & (SHM_RING_SIZE - 1));
+    size_t first = SHM_RING_SIZE - pos < n ? SHM_RING_SIZE - pos : n;
+    memcpy(buf, ring->data + pos, first);
+    memcpy((char *)buf + first, ring->data, n - first);
+    
+    atomic_store(&ring->tail, tail + n);
+    if (atomic_exchange(&ring->writer_waiting, 0)) {
+        signal_efd(ch->rx_space_efd);
+    }
+    
+    return (ssize_t)n;
+}
+
+ssize_t shm_channel_writev(ShmChannel *ch, const struct iovec *iov, int iovcnt, int timeout_ms) {
+    ShmRing *ring = ch->tx;
+    size_t total = 0;
+    size_t written = 0;
+    size_t offset = 0;  // Dentro de iov[i]
+    int i = 0;
+    int err = 0;
+    
+    for (int k = 0; k < iovcnt; k++) total += iov[k].iov_len;
+    
+    // Un mensaje que entra en el anillo se publica entero o nada: se espera
+    // lugar para todo. Solo uno más grande que el anillo sale por partes
+    size_t need = total <= SHM_RING_SIZE ? total : 1;
+    uint64_t deadline = timeout_ms > 0 ? now_ms() + (uint64_t)timeout_ms : 0;
+    
+    pthread_mutex_lock(&ch->tx_mutex);
+    if (ch->broken) {
+        pthread_mutex_unlock(&ch->tx_mutex);
+        errno = EPIPE;
+        return -1;
+    }
+    
+    while (written < total) {
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        uint64_t used = head - tail;
+        
+        if (used > SHM_RING_SIZE) {  // Anillo corrupto
+            err = EPIPE;
+            break;
+        }
+        
+        if (SHM_RING_SIZE - used < need) {
+            // Sin lugar: mismo protocolo de aviso que el consumidor
+            atomic_store(&ring->writer_waiting, 1);
+            tail = atomic_load(&ring->tail);
+            if (SHM_RING_SIZE - (head - tail) < need) {
+                int wait = timeout_ms;
+                if (timeout_ms > 0) {
+                    uint64_t now = now_ms();
+                    wait = now < deadline ? (int)(deadline - now) : 0;
+                }
+                int rc = wait_efd(ch, ch->tx_space_efd, wait);
+                if (rc <= 0) {
+                    err = rc < 0 ? EPIPE : EAGAIN;
+                    break;
+                }
+            }
+            continue;
+        }
+        
+        // Copiar todos los fragmentos que entren y publicarlos juntos
+        size_t space = SHM_RING_SIZE - (size_t)used;
+        while (space > 0 && i < iovcnt) {
+            size_t avail = iov[i].iov_len - offset;
+            size_t n = avail < space ? avail : space;
+            size_t pos = (size_t)(head & (SHM_RING_SIZE - 1));
+            size_t first = SHM_RING_SIZE - pos < n ? SHM_RING_SIZE - pos : n;
+            const char *data = (const char *)iov[i].iov_base + offset;
+            memcpy(ring->data + pos, data, first);
+            memcpy(ring->data, data + first, n - first);
+            
+            head += n;
+            space -= n;
+            written += n;
+            offset += n;
+            if (offset == iov[i].iov_len) {
+                i++;
+                offset = 0;
+            }
+        }
+        
+        atomic_store(&ring->head, head);
+        if (atomic_exchange(&ring->reader_waiting, 0)) {
+            signal_efd(ch->tx_data_efd);
+        }
+    }
+    
+    // Lo publicado no se puede retirar: lo próximo quedaría pegado a un
+    // mensaje cortado, así que el canal no se vuelve a usar
+    if (written < total && written > 0) {
+        ch->broken = 1;
+        err = EPIPE;
+    }
+    
+    pthread_mutex_unlock(&ch->tx_mutex);
+    if (written == total) return (ssize_t)total;
+    errno = err;
+    return -1;
+}
+
+ssize_t shm_channel_write(ShmChannel *ch, const void *buf, size_t len, int timeout_ms) {
+    struct iovec iov = { .iov_base = (void *)buf, .iov_len = len };
+    return shm_channel_writev(ch, &iov, 1, timeout_ms);
+}
+
+int shm_channel_wait(ShmChannel *ch, int timeout_ms) {
+    return wait_efd(ch, ch->rx_data_efd, timeout_ms);
+}
+
+void shm_channel_ack(ShmChannel *ch) {
+    drain_efd(ch->rx_data_efd);
+}
+
+void shm_channel_destroy(ShmChannel *ch) {
+    if (!ch->base) return;
+    
+    munmap(ch->base, ch->map_size);
+    close(ch->rx_data_efd);
+    close(ch->rx_space_efd);
+    close(ch->tx_data_efd);
+    close(ch->tx_space_efd);
+    pthread_mutex_destroy(&ch->tx_mutex);
+    ch->base = NULL;
+}
@@ -0,0 +1,113 @@
+// ============================================================================
+// shm_channel.h - Transporte por memoria compartida para clientes locales
+// ============================================================================
+// El cliente se conecta por un socket UNIX y el servidor le responde con un
+// memfd que contiene dos anillos (cliente->servidor y servidor->cliente) y
+// los eventfd para despertar a cada extremo (SCM_RIGHTS). Desde ahí los
+// bytes viajan por memoria compartida: el socket solo queda abierto para
+// detectar que el otro extremo se fue.
+//
+// Cada anillo es de un solo productor y un solo consumidor. El consumidor
+// avisa que va a dormir y el productor escribe en el eventfd solo en ese
+// caso, así que con tráfico continuo no hay syscalls por mensaje.
+// ============================================================================
+
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// ============================================================================
+// Constantes
+// ============================================================================
+
+#define SHM_RING_SIZE (256 * 1024)  // Bytes de datos por dirección (potencia de 2)
+#define SHM_MAGIC 0x53484d31        // "SHM1"
+
+// ============================================================================
+// Estructuras
+// ============================================================================
+
+typedef struct ShmRing ShmRing;  // Vive en la memoria compartida (shm_channel.c)
+
+// Vista local de un canal (cada proceso tiene la suya)
+typedef struct {
+    void *base;              // mmap del memfd
+    size_t map_size;
+    ShmRing *rx;             // Anillo del que este extremo lee
+    ShmRing *tx;             // Anillo en el que este extremo escribe
+    int rx_data_efd;         // Nos despierta el otro extremo cuando hay datos
+    int rx_space_efd;        // Despertamos al otro extremo cuando liberamos espacio
+    int tx_data_efd;
+    int tx_space_efd;
+    int peer_fd;             // Socket UNIX del otro extremo
+    int broken;              // Quedó un mensaje a medias en tx: no se escribe más
+    pthread_mutex_t tx_mutex;  // Serializa a los productores de este proceso
+} ShmChannel;
+
+// ============================================================================
+// Funciones públicas
+// ============================================================================
+
+/**
+ * Crea un socket UNIX de escucha en path (borra un socket viejo si quedó)
+ * @return El socket o -1 en caso de error
+ */
+int shm_listen(const char *path);
+
+/**
+ * Servidor: crea el canal y se lo envía al cliente conectado en peer_fd
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int shm_channel_create(ShmChannel *ch, int peer_fd);
+
+/**
+ * Cliente: se conecta al socket UNIX path y mapea el canal que envía el servidor
+ * @return 0 si tiene éxito, -1 en caso de error
+ */
+int shm_channel_connect(ShmChannel *ch, const char *path);
+
+/**
+ * Lee lo disponible sin bloquear
+ * @return Bytes leídos; 0 si el anillo está vacío (queda armado el aviso por
+ *         rx_data_efd); -1 si el otro extremo corrompió el anillo
+ */
+ssize_t shm_channel_read(ShmChannel *ch, void *buf, size_t len);
+
+/**
+ * Escribe len bytes; si no hay lugar para todos espera hasta timeout_ms
+ * (0 = no esperar, -1 = sin límite). Lo que entra en el anillo se publica
+ * entero o nada; uno más grande sale por partes y, si no termina, el canal
+ * queda inutilizable (broken)
+ * @return len si tiene éxito; -1 con errno EAGAIN si venció el plazo sin
+ *         escribir nada, EPIPE si el otro extremo se fue o el canal quedó roto
+ */
+ssize_t shm_channel_write(ShmChannel *ch, const void *buf, size_t len, int timeout_ms);
+
+/**
+ * Igual que shm_channel_write() para varios fragmentos, sin intercalarse con
+ * otros productores del mismo proceso
+ */
+ssize_t shm_channel_writev(ShmChannel *ch, const struct iovec *iov, int iovcnt, int timeout_ms);
+
+/**
+ * Espera a que lleguen datos después de un shm_channel_read() que devolvió 0
+ * @return 1 si hay datos, 0 si venció el plazo, -1 si el otro extremo se fue
+ */
+int shm_channel_wait(ShmChannel *ch, int timeout_ms);
+
+/**
+ * Vacía el contador del eventfd de datos (consumidores que usan epoll)
+ */
+void shm_channel_ack(ShmChannel *ch);
+
+/**
+ * Libera el mapeo y los eventfd (no cierra peer_fd)
+ */
+void shm_channel_destroy(ShmChannel *ch);
+
+#endif // SHM_CHANNEL_H